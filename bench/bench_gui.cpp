@@ -0,0 +1,23 @@
+#include <benchmark/benchmark.h>
+#include "file_loader.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+void BM_LoadObjFile(benchmark::State &state, const std::string &name) {
+    const std::string path = std::string(MAG3D_SOURCE_DIR) + "/src/obj_files/" + name;
+    std::size_t vertices = 0;
+    for (auto _ : state) {
+        const auto loaded = FileLoader::load_obj_file(path);
+        vertices = loaded.size();
+        benchmark::DoNotOptimize(loaded.data());
+    }
+    state.counters["vertices"] = static_cast<double>(vertices);
+}
+BENCHMARK_CAPTURE(BM_LoadObjFile, sphere, std::string("sphere.obj"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_LoadObjFile, sphere_auto_smooth, std::string("sphere_auto_smooth.obj"))
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_LoadObjFile, sphere_centered_scaled, std::string("sphere_centered_scaled.obj"))
+    ->Unit(benchmark::kMillisecond);
+}
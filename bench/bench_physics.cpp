@@ -0,0 +1,191 @@
+#include <benchmark/benchmark.h>
+#include "collision_detector.h"
+#include "ephemeris.h"
+#include "kepler.h"
+#include "solar_system_calculator.h"
+
+namespace {
+// The inner solar system plus count - 5 light asteroids between 2 and 3.5 au.
+void make_system(SolarSystemCalculator &calculator, const std::size_t count) {
+    calculator.init();
+    calculator.add_belt(count - calculator.state.size(), calculator.gravitational_constant(), 2.0, 3.5, 1e-10);
+}
+
+void body_counts(benchmark::internal::Benchmark *benchmark) {
+    for (const int count : {5, 100, 1000, 10000, 100000})
+        benchmark->Arg(count);
+    benchmark->Unit(benchmark::kMicrosecond)->Complexity();
+}
+
+void BM_ComputeAccelerations(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        calculator.compute_accelerations();
+        benchmark::DoNotOptimize(calculator.state.ax.data());
+        benchmark::ClobberMemory();
+    }
+    const auto n = static_cast<double>(calculator.state.size());
+    state.counters["interactions/s"] =
+        benchmark::Counter(n * n * static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_ComputeAccelerations)->Apply(body_counts);
+
+// Direct summation at each Precision (0 = double, 1 = mixed, 2 = float).
+void BM_ComputeAccelerationsPrecision(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    calculator.set_precision(static_cast<Precision>(state.range(1)));
+    for (auto _ : state) {
+        calculator.compute_accelerations();
+        benchmark::DoNotOptimize(calculator.state.ax.data());
+        benchmark::ClobberMemory();
+    }
+    const auto n = static_cast<double>(calculator.state.size());
+    state.counters["interactions/s"] =
+        benchmark::Counter(n * n * static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ComputeAccelerationsPrecision)
+    ->ArgsProduct({{1000, 10000}, {0, 1, 2}})
+    ->ArgNames({"bodies", "precision"})
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_ComputeAccelerationsBarnesHut(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    calculator.force_engine = ForceEngine::BARNES_HUT;
+    for (auto _ : state) {
+        calculator.compute_accelerations();
+        benchmark::DoNotOptimize(calculator.state.ax.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_ComputeAccelerationsBarnesHut)->Apply(body_counts);
+
+void BM_UpdateBodiesVerlet(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        calculator.update_bodies_verlet(0.25);
+        benchmark::DoNotOptimize(calculator.state.x.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_UpdateBodiesVerlet)->Apply(body_counts);
+
+// One step with velocity Verlet (0) or the hybrid Kepler integrator (4),
+// which keeps the asteroids on Kepler orbits.
+void BM_StepIntegrator(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    calculator.set_integrator(static_cast<IntegratorKind>(state.range(1)));
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    calculator.step(0.25);
+    for (auto _ : state) {
+        calculator.step(0.25);
+        benchmark::DoNotOptimize(calculator.state.x.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StepIntegrator)
+    ->ArgsProduct({{1000, 10000}, {0, 4}})
+    ->ArgNames({"bodies", "integrator"})
+    ->Unit(benchmark::kMicrosecond);
+
+// Kepler drifts of belt orbits, one at a time (0) or batched (1).
+void BM_KeplerDrift(benchmark::State &state) {
+    const double mu = 2.96e-4;
+    TracerStore orbits;
+    orbits.add_belt(10000, mu, 2.1, 3.3);
+    const GravityTracers view = GravityKernel::tracers_of(orbits);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (std::size_t i = 0; i < orbits.size(); i++) {
+                glm::dvec3 r = orbits.position(i);
+                glm::dvec3 v = orbits.velocity(i);
+                Kepler::drift(mu, r, v, 0.25);
+                orbits.x[i] = r.x;
+                orbits.y[i] = r.y;
+                orbits.z[i] = r.z;
+                orbits.vx[i] = v.x;
+                orbits.vy[i] = v.y;
+                orbits.vz[i] = v.z;
+            }
+        } else {
+            Kepler::drift(mu, view, 0, view.count, 0.25);
+        }
+        benchmark::DoNotOptimize(orbits.x.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(orbits.size()));
+}
+BENCHMARK(BM_KeplerDrift)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+void BM_StepTracers(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    calculator.init();
+    calculator.set_precision(static_cast<Precision>(state.range(1)));
+    calculator.tracers.add_belt(static_cast<std::size_t>(state.range(0)),
+                                calculator.gravitational_constant(), 2.1, 3.3);
+    for (auto _ : state) {
+        calculator.step(0.25);
+        benchmark::DoNotOptimize(calculator.tracers.x.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StepTracers)
+    ->ArgsProduct({{10000, 1000000}, {0, 1, 2}})
+    ->ArgNames({"tracers", "precision"})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_DetectCollisions(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    calculator.init();
+    calculator.tracers.add_belt(static_cast<std::size_t>(state.range(0)),
+                                calculator.gravitational_constant(), 2.1, 3.3);
+    CollisionDetector detector;
+    for (auto _ : state) {
+        detector.process(calculator.state, calculator.bodies, calculator.tracers, calculator.pool(), 0.0, 0.25);
+        benchmark::DoNotOptimize(detector.candidate_pairs());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DetectCollisions)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+// Position of one body at a time inside a 10 year ephemeris, against
+// integrating there again from the start.
+void BM_EphemerisLookup(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    calculator.init();
+    Ephemeris ephemeris(calculator.state.size());
+    for (int i = 0; i <= 4 * 3650; i++) {
+        ephemeris.record(calculator.elapsed_simulation_time, calculator.state);
+        calculator.step(0.25);
+    }
+    glm::dvec3 position;
+    double time = 0.0;
+    for (auto _ : state) {
+        time += 123.4567;
+        if (time > 3600.0) time -= 3600.0;
+        ephemeris.position(3, time, position);
+        benchmark::DoNotOptimize(position);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EphemerisLookup)->Unit(benchmark::kNanosecond);
+
+void BM_EphemerisRecord(benchmark::State &state) {
+    SolarSystemCalculator calculator;
+    make_system(calculator, static_cast<std::size_t>(state.range(0)));
+    Ephemeris ephemeris(calculator.state.size());
+    double time = 0.0;
+    for (auto _ : state) {
+        ephemeris.record(time, calculator.state);
+        time += 0.25;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EphemerisRecord)->Arg(5)->Arg(1000)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,30 @@
+#include <benchmark/benchmark.h>
+#include "planet_instances.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+// Packing the instance buffer for the planet draw call, once a frame. Only
+// this and one buffer upload grow with the body count.
+void BM_PlanetInstances(benchmark::State &state) {
+    const auto count = static_cast<std::size_t>(state.range(0));
+    std::vector<glm::vec3> positions(count);
+    std::vector<double> masses(count, 1e-9);
+    std::vector<Body> bodies(count);
+    bodies[0].is_emitter = true;
+    masses[0] = 1.0;
+    for (std::size_t i = 0; i < count; i++) {
+        const float angle = 0.1f * static_cast<float>(i);
+        positions[i] = glm::vec3(std::cos(angle), std::sin(angle), 0.0f) * (1.0f + 1e-4f * static_cast<float>(i));
+    }
+    PlanetInstances instances;
+    for (auto _ : state) {
+        instances.update(positions, masses, bodies, 42);
+        benchmark::DoNotOptimize(instances.instances().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["upload bytes"] = static_cast<double>(count * sizeof(PlanetInstance));
+}
+BENCHMARK(BM_PlanetInstances)->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,17 @@
+#include <benchmark/benchmark.h>
+#include "profiler.h"
+
+namespace {
+// The cost of a zone around an empty scope, with the profiler off and on.
+void BM_ProfileZone(benchmark::State &state) {
+    Profiler::reset();
+    Profiler::set_enabled(state.range(0) != 0);
+    for (auto _ : state) {
+        const ProfileZone zone("bench");
+        benchmark::ClobberMemory();
+    }
+    Profiler::set_enabled(false);
+    Profiler::reset();
+}
+BENCHMARK(BM_ProfileZone)->ArgName("enabled")->Arg(0)->Arg(1);
+}
@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+#include "compact_trail.h"
+#include "glm/glm.hpp"
+#include "orbit_inset.h"
+#include "trail_ring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+// Adding a sample to a simplified trail of a circular orbit, as update()
+// does every trail interval. Reports the points kept and bytes used against
+// the one vec3 per sample the trails used to hold.
+void BM_CompactTrailAdd(benchmark::State &state) {
+    const auto length = static_cast<std::size_t>(state.range(0));
+    CompactTrail trail(0.1 * static_cast<double>(length), 1e-3f, length);
+    // About Earth's orbit in the viewer's units and trail interval.
+    const auto position = [](const double time) {
+        const double angle = 2.0 * M_PI * time / 365.0;
+        return glm::vec3(2.0f * static_cast<float>(std::cos(angle)), 2.0f * static_cast<float>(std::sin(angle)), 0.0f);
+    };
+    double time = 0.0;
+    for (std::size_t i = 0; i < length; i++, time += 0.1) trail.add(time, position(time));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(trail.add(time, position(time)));
+        time += 0.1;
+    }
+    state.counters["points"] = static_cast<double>(trail.size());
+    state.counters["bytes"] = static_cast<double>(trail.bytes());
+    state.counters["vec3 bytes"] = static_cast<double>(length * sizeof(glm::vec3));
+}
+// 2000 for Mercury, 5000 by default, 10000 for Mars.
+BENCHMARK(BM_CompactTrailAdd)->Arg(2000)->Arg(5000)->Arg(10000);
+
+// One frame of the GPU trail ring with the inner planets' trail lengths:
+// append a point per trail, collect the ranges to upload and the strips to
+// draw. "upload bytes" is what goes to the GPU per frame, against the whole
+// history the old per-body glBufferData sent.
+void BM_TrailRingFrame(benchmark::State &state) {
+    const std::vector<std::size_t> lengths{10, 2000, 5000, 5000, 10000};
+    TrailRing ring;
+    ring.reset(lengths);
+    std::uint32_t sample = 0;
+    for (; sample < 10000; sample++) {
+        for (std::size_t trail = 0; trail < lengths.size(); trail++) {
+            const float angle = 1e-3f * static_cast<float>(sample);
+            ring.append(trail, glm::vec3(std::cos(angle), std::sin(angle), 0.0f), sample, glm::vec3(1.0f));
+        }
+    }
+    ring.clear_dirty();
+    std::vector<std::int32_t> firsts, counts;
+    std::size_t upload_bytes = 0;
+    for (auto _ : state) {
+        for (std::size_t trail = 0; trail < lengths.size(); trail++) {
+            ring.append(trail, glm::vec3(0.5f), sample, glm::vec3(1.0f));
+        }
+        sample++;
+        upload_bytes = 0;
+        for (const auto &range: ring.dirty()) upload_bytes += range.count * sizeof(TrailVertex);
+        ring.clear_dirty();
+        ring.draw_ranges(firsts, counts);
+        benchmark::DoNotOptimize(firsts.data());
+    }
+    state.counters["upload bytes"] = static_cast<double>(upload_bytes);
+}
+BENCHMARK(BM_TrailRingFrame);
+
+// The inner planets' trails, full, each sampled every 0.1 days.
+std::vector<CompactTrail> make_inset_trails(const std::vector<std::size_t> &lengths, double &time) {
+    std::vector<CompactTrail> paths;
+    for (const std::size_t length : lengths) paths.emplace_back(0.1 * static_cast<double>(length), 1e-3f, length);
+    for (time = 0.0; time < 1000.0; time += 0.1) {
+        for (std::size_t b = 0; b < paths.size(); b++) {
+            const float radius = 0.4f * static_cast<float>(b);
+            const double angle = 2.0 * M_PI * time / (100.0 * static_cast<double>(b + 1));
+            paths[b].add(time, glm::vec3(radius * static_cast<float>(std::cos(angle)),
+                                         radius * static_cast<float>(std::sin(angle)), 0.0f));
+        }
+    }
+    return paths;
+}
+
+// One frame of the orbit view after a new sample per trail: what gets drawn
+// into its texture. "vertices" stays the same however long the trails are.
+void BM_OrbitInsetFrame(benchmark::State &state) {
+    const std::vector<std::size_t> lengths{10, 2000, 5000, 5000, 10000};
+    double time = 0.0;
+    auto paths = make_inset_trails(lengths, time);
+    const std::vector<Body> bodies(lengths.size());
+    OrbitInset inset;
+    inset.update(paths, bodies, 0.015f, 184, 165);
+    std::size_t vertices = 0;
+    for (auto _ : state) {
+        for (std::size_t b = 0; b < paths.size(); b++) {
+            const float radius = 0.4f * static_cast<float>(b);
+            const double angle = 2.0 * M_PI * time / (100.0 * static_cast<double>(b + 1));
+            paths[b].add(time, glm::vec3(radius * static_cast<float>(std::cos(angle)),
+                                         radius * static_cast<float>(std::sin(angle)), 0.0f));
+        }
+        time += 0.1;
+        inset.update(paths, bodies, 0.015f, 184, 165);
+        vertices = std::max(vertices, inset.vertices().size());
+        benchmark::DoNotOptimize(inset.vertices().data());
+    }
+    state.counters["vertices"] = static_cast<double>(vertices);
+}
+BENCHMARK(BM_OrbitInsetFrame);
+
+// The full redraw after the scale changed.
+void BM_OrbitInsetRedraw(benchmark::State &state) {
+    const std::vector<std::size_t> lengths{10, 2000, 5000, 5000, 10000};
+    double time = 0.0;
+    const auto paths = make_inset_trails(lengths, time);
+    const std::vector<Body> bodies(lengths.size());
+    OrbitInset inset;
+    float scale = 0.015f;
+    for (auto _ : state) {
+        scale = scale == 0.015f ? 0.016f : 0.015f;
+        inset.update(paths, bodies, scale, 184, 165);
+        benchmark::DoNotOptimize(inset.vertices().data());
+    }
+    state.counters["vertices"] = static_cast<double>(inset.vertices().size());
+}
+BENCHMARK(BM_OrbitInsetRedraw);
+}
@@ -0,0 +1,275 @@
+#include "barnes_hut.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr unsigned max_level = 21;
+
+std::uint64_t spread_bits(std::uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffff;
+  v = (v | v << 16) & 0x1f0000ff0000ff;
+  v = (v | v << 8) & 0x100f00f00f00f00f;
+  v = (v | v << 4) & 0x10c30c30c30c30c3;
+  v = (v | v << 2) & 0x1249249249249249;
+  return v;
+}
+
+unsigned octant_at(const std::uint64_t key, const unsigned level) {
+  return static_cast<unsigned>(key >> (3 * (max_level - 1 - level))) & 7u;
+}
+
+} // namespace
+
+void BarnesHutTree::build(const GravitySources &sources) {
+  const std::size_t n = sources.count;
+  nodes.clear();
+  if (n == 0) {
+    sorted_index.clear();
+    return;
+  }
+
+  double min_x = std::numeric_limits<double>::max();
+  double min_y = min_x;
+  double min_z = min_x;
+  double max_x = std::numeric_limits<double>::lowest();
+  double max_y = max_x;
+  double max_z = max_x;
+  for (std::size_t i = 0; i < n; ++i) {
+    min_x = std::min(min_x, sources.x[i]);
+    min_y = std::min(min_y, sources.y[i]);
+    min_z = std::min(min_z, sources.z[i]);
+    max_x = std::max(max_x, sources.x[i]);
+    max_y = std::max(max_y, sources.y[i]);
+    max_z = std::max(max_z, sources.z[i]);
+  }
+  const double size =
+      std::max({max_x - min_x, max_y - min_y, max_z - min_z, 1e-12}) *
+      (1.0 + 1e-9);
+  const double scale = static_cast<double>(1u << max_level) / size;
+  constexpr double max_cell = (1u << max_level) - 1;
+
+  keys.resize(n);
+  sorted_index.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto quantize = [&](const double v, const double lo) {
+      return static_cast<std::uint64_t>(std::min((v - lo) * scale, max_cell));
+    };
+    keys[i] = spread_bits(quantize(sources.x[i], min_x)) << 2 |
+              spread_bits(quantize(sources.y[i], min_y)) << 1 |
+              spread_bits(quantize(sources.z[i], min_z));
+    sorted_index[i] = static_cast<std::uint32_t>(i);
+  }
+  sort_by_key();
+
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+  mass.resize(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    const std::uint32_t i = sorted_index[k];
+    x[k] = sources.x[i];
+    y[k] = sources.y[i];
+    z[k] = sources.z[i];
+    mass[k] = sources.mass[i];
+  }
+
+  const double half = 0.5 * size;
+  // build_node() sums up the mass and its center.
+  nodes.push_back({.com_x = 0.0,
+                   .com_y = 0.0,
+                   .com_z = 0.0,
+                   .mass = 0.0,
+                   .center_x = min_x + half,
+                   .center_y = min_y + half,
+                   .center_z = min_z + half,
+                   .half_size = half,
+                   .first_child = 0,
+                   .child_count = 0,
+                   .begin = 0,
+                   .end = static_cast<std::uint32_t>(n)});
+  build_node(0, 0);
+}
+
+// LSD radix sort on bytes of the Morton key, skipping bytes that are equal
+// for all bodies (usually the high ones).
+void BarnesHutTree::sort_by_key() {
+  const std::size_t n = keys.size();
+  scratch_keys.resize(n);
+  scratch_index.resize(n);
+  for (unsigned shift = 0; shift < 64; shift += 8) {
+    std::array<std::size_t, 257> offsets{};
+    for (const auto key : keys)
+      ++offsets[((key >> shift) & 0xff) + 1];
+    if (std::ranges::any_of(offsets, [n](auto c) { return c == n; }))
+      continue;
+    for (std::size_t b = 1; b < offsets.size(); ++b)
+      offsets[b] += offsets[b - 1];
+    for (std::size_t k = 0; k < n; ++k) {
+      const std::size_t dst = offsets[(keys[k] >> shift) & 0xff]++;
+      scratch_keys[dst] = keys[k];
+      scratch_index[dst] = sorted_index[k];
+    }
+    keys.swap(scratch_keys);
+    sorted_index.swap(scratch_index);
+  }
+}
+
+void BarnesHutTree::build_node(const std::uint32_t node_index,
+                               const unsigned level) {
+  const Node parent = nodes[node_index];
+  if (parent.end - parent.begin <= leaf_size || level == max_level) {
+    double m = 0.0;
+    double mx = 0.0;
+    double my = 0.0;
+    double mz = 0.0;
+    for (std::uint32_t k = parent.begin; k < parent.end; ++k) {
+      m += mass[k];
+      mx += mass[k] * x[k];
+      my += mass[k] * y[k];
+      mz += mass[k] * z[k];
+    }
+    auto &node = nodes[node_index];
+    node.mass = m;
+    node.com_x = m > 0.0 ? mx / m : parent.center_x;
+    node.com_y = m > 0.0 ? my / m : parent.center_y;
+    node.com_z = m > 0.0 ? mz / m : parent.center_z;
+    return;
+  }
+
+  // Bodies are Morton sorted, so each octant is a contiguous sub-range.
+  std::array<std::uint32_t, 9> bounds{};
+  std::uint32_t k = parent.begin;
+  for (unsigned octant = 0; octant < 8; ++octant) {
+    bounds[octant] = k;
+    while (k < parent.end && octant_at(keys[k], level) == octant)
+      ++k;
+  }
+  bounds[8] = parent.end;
+
+  const auto first_child = static_cast<std::uint32_t>(nodes.size());
+  const double quarter = 0.5 * parent.half_size;
+  for (unsigned octant = 0; octant < 8; ++octant) {
+    if (bounds[octant] == bounds[octant + 1])
+      continue;
+    nodes.push_back(
+        {.com_x = 0.0,
+         .com_y = 0.0,
+         .com_z = 0.0,
+         .mass = 0.0,
+         .center_x = parent.center_x + ((octant & 4u) ? quarter : -quarter),
+         .center_y = parent.center_y + ((octant & 2u) ? quarter : -quarter),
+         .center_z = parent.center_z + ((octant & 1u) ? quarter : -quarter),
+         .half_size = quarter,
+         .first_child = 0,
+         .child_count = 0,
+         .begin = bounds[octant],
+         .end = bounds[octant + 1]});
+  }
+  const auto child_count =
+      static_cast<std::uint32_t>(nodes.size()) - first_child;
+
+  double m = 0.0;
+  double mx = 0.0;
+  double my = 0.0;
+  double mz = 0.0;
+  for (std::uint32_t c = first_child; c < first_child + child_count; ++c) {
+    build_node(c, level + 1);
+    const auto &child = nodes[c];
+    m += child.mass;
+    mx += child.mass * child.com_x;
+    my += child.mass * child.com_y;
+    mz += child.mass * child.com_z;
+  }
+  auto &node = nodes[node_index];
+  node.first_child = first_child;
+  node.child_count = child_count;
+  node.mass = m;
+  node.com_x = m > 0.0 ? mx / m : parent.center_x;
+  node.com_y = m > 0.0 ? my / m : parent.center_y;
+  node.com_z = m > 0.0 ? mz / m : parent.center_z;
+}
+
+glm::dvec3 BarnesHutTree::acceleration_at(const double xi, const double yi,
+                                          const double zi,
+                                          const double theta_squared,
+                                          const double softening_squared) const {
+  std::array<std::uint32_t, 8 * max_level + 8> stack{};
+  double ax = 0.0;
+  double ay = 0.0;
+  double az = 0.0;
+
+  std::size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node = nodes[stack[--top]];
+    const double dx = node.com_x - xi;
+    const double dy = node.com_y - yi;
+    const double dz = node.com_z - zi;
+    const double d2 = dx * dx + dy * dy + dz * dz;
+    const double size = 2.0 * node.half_size;
+    const bool inside = std::abs(xi - node.center_x) <= node.half_size &&
+                        std::abs(yi - node.center_y) <= node.half_size &&
+                        std::abs(zi - node.center_z) <= node.half_size;
+
+    if (!inside && size * size < theta_squared * d2) {
+      const double r2 = d2 + softening_squared;
+      const double s = node.mass / (r2 * std::sqrt(r2));
+      ax += s * dx;
+      ay += s * dy;
+      az += s * dz;
+    } else if (node.first_child == 0) {
+      for (std::uint32_t k = node.begin; k < node.end; ++k) {
+        const double bx = x[k] - xi;
+        const double by = y[k] - yi;
+        const double bz = z[k] - zi;
+        const double r2 = bx * bx + by * by + bz * bz + softening_squared;
+        if (r2 == 0.0)
+          continue;
+        const double s = mass[k] / (r2 * std::sqrt(r2));
+        ax += s * bx;
+        ay += s * by;
+        az += s * bz;
+      }
+    } else {
+      for (std::uint32_t c = 0; c < node.child_count; ++c)
+        stack[top++] = node.first_child + c;
+    }
+  }
+  return {ax, ay, az};
+}
+
+void BarnesHutTree::evaluate(const GravityTargets &targets,
+                             const std::size_t begin, const std::size_t end,
+                             const double g, const double theta,
+                             const double softening_squared) const {
+  for (std::size_t i = begin; i < end; ++i) {
+    const auto a = nodes.empty()
+                       ? glm::dvec3(0.0)
+                       : acceleration_at(targets.x[i], targets.y[i],
+                                         targets.z[i], theta * theta,
+                                         softening_squared);
+    targets.ax[i] = g * a.x;
+    targets.ay[i] = g * a.y;
+    targets.az[i] = g * a.z;
+  }
+}
+
+void BarnesHutTree::evaluate_sources(const GravityTargets &targets,
+                                     const std::size_t begin,
+                                     const std::size_t end, const double g,
+                                     const double theta,
+                                     const double softening_squared) const {
+  for (std::size_t k = begin; k < end; ++k) {
+    const std::uint32_t i = sorted_index[k];
+    const auto a =
+        acceleration_at(x[k], y[k], z[k], theta * theta, softening_squared);
+    targets.ax[i] = g * a.x;
+    targets.ay[i] = g * a.y;
+    targets.az[i] = g * a.z;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "gravity_kernel.h"
+
+// Accuracy of an approximate force engine measured against direct summation
+// on a sample of targets. Errors are |a - a_direct| / |a_direct|.
+struct ForceErrorReport {
+  double rms_relative_error = 0.0;
+  double max_relative_error = 0.0;
+  std::size_t samples = 0;
+};
+
+// Octree over the sources, built from Morton-sorted positions. Nodes further
+// away than size / theta are replaced by their monopole; leaves hold up to
+// leaf_size bodies summed directly.
+class BarnesHutTree {
+public:
+  static constexpr std::size_t leaf_size = 8;
+
+  void build(const GravitySources &sources);
+  void evaluate(const GravityTargets &targets, std::size_t begin,
+                std::size_t end, double g, double theta,
+                double softening_squared) const;
+
+  // Self-gravity of the sources the tree was built from, written to the
+  // matching entries of targets. [begin, end) counts bodies in tree order so
+  // neighbouring targets share most of their traversal.
+  void evaluate_sources(const GravityTargets &targets, std::size_t begin,
+                        std::size_t end, double g, double theta,
+                        double softening_squared) const;
+
+  [[nodiscard]] std::size_t size() const { return sorted_index.size(); }
+  [[nodiscard]] std::size_t node_count() const { return nodes.size(); }
+
+private:
+  struct Node {
+    double com_x, com_y, com_z, mass;
+    double center_x, center_y, center_z, half_size;
+    std::uint32_t first_child; // 0 for leaves, the root is never a child
+    std::uint32_t child_count;
+    std::uint32_t begin, end; // range of bodies in tree order
+  };
+
+  std::vector<Node> nodes;
+  std::vector<std::uint64_t> keys;
+  std::vector<std::uint64_t> scratch_keys;
+  std::vector<std::uint32_t> sorted_index;
+  std::vector<std::uint32_t> scratch_index;
+  AlignedVector<double> x, y, z, mass;
+
+  void sort_by_key();
+  glm::dvec3 acceleration_at(double xi, double yi, double zi,
+                             double theta_squared,
+                             double softening_squared) const;
+  void build_node(std::uint32_t node_index, unsigned level);
+};
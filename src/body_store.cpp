@@ -0,0 +1,46 @@
+#include "body_store.h"
+
+std::size_t BodyStore::add(const glm::dvec3 &position,
+                           const glm::dvec3 &velocity, const double body_mass) {
+  x.push_back(position.x);
+  y.push_back(position.y);
+  z.push_back(position.z);
+  vx.push_back(velocity.x);
+  vy.push_back(velocity.y);
+  vz.push_back(velocity.z);
+  mass.push_back(body_mass);
+  ax.push_back(0.0);
+  ay.push_back(0.0);
+  az.push_back(0.0);
+  return mass.size() - 1;
+}
+
+void BodyStore::clear() {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az}) {
+    component->clear();
+  }
+}
+
+void BodyStore::resize(const std::size_t count) {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az}) {
+    component->resize(count);
+  }
+}
+
+void BodyStore::erase(const std::size_t i) {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az}) {
+    component->erase(component->begin() + static_cast<std::ptrdiff_t>(i));
+  }
+}
+
+void BodyStore::set_position(const std::size_t i, const glm::dvec3 &position) {
+  x[i] = position.x;
+  y[i] = position.y;
+  z[i] = position.z;
+}
+
+void BodyStore::set_velocity(const std::size_t i, const glm::dvec3 &velocity) {
+  vx[i] = velocity.x;
+  vy[i] = velocity.y;
+  vz[i] = velocity.z;
+}
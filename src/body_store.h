@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "aligned_allocator.h"
+#include "glm/glm.hpp"
+
+// Hot simulation state in structure-of-arrays layout. Everything the force
+// kernels and integrators touch per step lives here; names, colors and paths
+// stay in Body.
+struct BodyStore {
+  AlignedVector<double> x, y, z;    // au
+  AlignedVector<double> vx, vy, vz; // au/day
+  AlignedVector<double> mass;       // m_sun
+  AlignedVector<double> ax, ay, az; // au/day^2
+
+  [[nodiscard]] std::size_t size() const { return mass.size(); }
+
+  std::size_t add(const glm::dvec3 &position, const glm::dvec3 &velocity,
+                  double body_mass);
+  void clear();
+  void resize(std::size_t count);
+  // Shifts the bodies after i down by one.
+  void erase(std::size_t i);
+
+  [[nodiscard]] glm::dvec3 position(const std::size_t i) const {
+    return {x[i], y[i], z[i]};
+  }
+  [[nodiscard]] glm::dvec3 velocity(const std::size_t i) const {
+    return {vx[i], vy[i], vz[i]};
+  }
+  [[nodiscard]] glm::dvec3 acceleration(const std::size_t i) const {
+    return {ax[i], ay[i], az[i]};
+  }
+  void set_position(std::size_t i, const glm::dvec3 &position);
+  void set_velocity(std::size_t i, const glm::dvec3 &velocity);
+};
+
+// Per-body data that the integrator never touches. The simulation state
+// (position, velocity, mass, acceleration) lives in SolarSystemCalculator::state
+// at the same index.
+struct Body {
+  std::string name;
+  glm::vec3 color{1.0f};
+  bool is_emitter = false;
+  std::size_t max_path = 5000; // trail length in recorded points
+  double radius = 0.0; // au, for collisions; 0 = derived from the mass
+};
@@ -0,0 +1,292 @@
+#include "checkpoint.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'A', 'G', '3', 'D', 'C', 'K', 'P'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr std::uint64_t ALIGNMENT = 64;
+
+std::uint64_t align(const std::uint64_t offset) {
+  return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+struct SectionData {
+  const void *data = nullptr;
+  std::uint64_t size = 0;
+};
+
+template <typename T> SectionData section_of(const std::vector<T> &values) {
+  return {values.data(), values.size() * sizeof(T)};
+}
+
+template <typename T>
+SectionData section_of(const AlignedVector<T> &values) {
+  return {values.data(), values.size() * sizeof(T)};
+}
+
+template <typename Store, typename T>
+void assign(Store &target, const std::span<const T> source) {
+  target.assign(source.begin(), source.end());
+}
+
+} // namespace
+
+CheckpointFile::CheckpointFile(const std::string &path) {
+  const int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0)
+    throw std::runtime_error("Cannot open checkpoint " + path);
+  struct stat file_status {};
+  if (::fstat(descriptor, &file_status) != 0 ||
+      static_cast<std::size_t>(file_status.st_size) < sizeof(Header)) {
+    ::close(descriptor);
+    throw std::runtime_error("Checkpoint " + path + " is truncated");
+  }
+  size = static_cast<std::size_t>(file_status.st_size);
+  data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  ::close(descriptor);
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    throw std::runtime_error("Cannot map checkpoint " + path);
+  }
+  ::madvise(data, size, MADV_SEQUENTIAL);
+
+  const auto &h = header();
+  std::string error;
+  if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+    error = " is not a checkpoint";
+  else if (h.version != Checkpoint::VERSION)
+    error = " has unsupported version " + std::to_string(h.version);
+  else if (h.byte_order != BYTE_ORDER_MARK)
+    error = " was written with a different byte order";
+  for (std::uint32_t id = 0; error.empty() && id < SECTION_COUNT; ++id) {
+    if (h.section_offset[id] % ALIGNMENT != 0 ||
+        h.section_offset[id] > size ||
+        h.section_size[id] > size - h.section_offset[id])
+      error = " is truncated";
+  }
+  if (!error.empty()) {
+    ::munmap(data, size);
+    data = nullptr;
+    throw std::runtime_error("Checkpoint " + path + error);
+  }
+}
+
+CheckpointFile::~CheckpointFile() {
+  if (data != nullptr)
+    ::munmap(data, size);
+}
+
+CheckpointState Checkpoint::capture(const SolarSystemCalculator &calculator,
+                                    std::vector<std::vector<glm::vec3>> paths) {
+  return {.state = calculator.state,
+          .tracers = calculator.tracers,
+          .bodies = calculator.bodies,
+          .elapsed_simulation_time = calculator.elapsed_simulation_time,
+          .integrator = calculator.integrator_kind(),
+          .force_engine = calculator.force_engine,
+          .opening_angle = calculator.opening_angle,
+          .precision = calculator.precision(),
+          .integrator_state = calculator.current_integrator().save_state(),
+          .paths = std::move(paths)};
+}
+
+void Checkpoint::write(const std::string &path, const CheckpointState &state) {
+  using Section = CheckpointFile::Section;
+  CheckpointFile::Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.body_count = state.state.size();
+  header.tracer_count = state.tracers.size();
+  header.elapsed_simulation_time = state.elapsed_simulation_time;
+  header.opening_angle = state.opening_angle;
+  header.integrator = static_cast<std::int32_t>(state.integrator);
+  header.force_engine = static_cast<std::int32_t>(state.force_engine);
+  header.precision = static_cast<std::int32_t>(state.precision);
+
+  std::vector<CheckpointFile::BodyRecord> records;
+  std::string names;
+  for (const auto &body : state.bodies) {
+    records.push_back({.color = {body.color.r, body.color.g, body.color.b},
+                       .is_emitter = body.is_emitter ? 1u : 0u,
+                       .max_path = body.max_path,
+                       .name_offset = names.size(),
+                       .name_length = body.name.size(),
+                       .radius = body.radius});
+    names += body.name;
+  }
+
+  std::vector<std::uint64_t> path_lengths;
+  std::vector<glm::vec3> path_points;
+  if (state.paths.size() == state.state.size()) {
+    for (const auto &trail : state.paths) {
+      path_lengths.push_back(trail.size());
+      path_points.insert(path_points.end(), trail.begin(), trail.end());
+    }
+  }
+
+  SectionData sections[CheckpointFile::SECTION_COUNT];
+  sections[Section::X] = section_of(state.state.x);
+  sections[Section::Y] = section_of(state.state.y);
+  sections[Section::Z] = section_of(state.state.z);
+  sections[Section::VX] = section_of(state.state.vx);
+  sections[Section::VY] = section_of(state.state.vy);
+  sections[Section::VZ] = section_of(state.state.vz);
+  sections[Section::MASS] = section_of(state.state.mass);
+  sections[Section::AX] = section_of(state.state.ax);
+  sections[Section::AY] = section_of(state.state.ay);
+  sections[Section::AZ] = section_of(state.state.az);
+  sections[Section::TRACER_X] = section_of(state.tracers.x);
+  sections[Section::TRACER_Y] = section_of(state.tracers.y);
+  sections[Section::TRACER_Z] = section_of(state.tracers.z);
+  sections[Section::TRACER_VX] = section_of(state.tracers.vx);
+  sections[Section::TRACER_VY] = section_of(state.tracers.vy);
+  sections[Section::TRACER_VZ] = section_of(state.tracers.vz);
+  sections[Section::BODY_RECORDS] = section_of(records);
+  sections[Section::NAMES] = {names.data(), names.size()};
+  sections[Section::INTEGRATOR_STATE] = section_of(state.integrator_state);
+  sections[Section::PATH_LENGTHS] = section_of(path_lengths);
+  sections[Section::PATH_POINTS] = section_of(path_points);
+
+  std::uint64_t offset = align(sizeof(header));
+  for (std::uint32_t id = 0; id < CheckpointFile::SECTION_COUNT; ++id) {
+    header.section_offset[id] = offset;
+    header.section_size[id] = sections[id].size;
+    offset = align(offset + sections[id].size);
+  }
+
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw std::runtime_error("Cannot create checkpoint " + temporary_path);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    const char padding[ALIGNMENT] = {};
+    std::uint64_t written = sizeof(header);
+    for (std::uint32_t id = 0; id < CheckpointFile::SECTION_COUNT; ++id) {
+      file.write(padding,
+                 static_cast<std::streamsize>(header.section_offset[id] -
+                                              written));
+      file.write(static_cast<const char *>(sections[id].data),
+                 static_cast<std::streamsize>(sections[id].size));
+      written = header.section_offset[id] + sections[id].size;
+    }
+    file.flush();
+    if (!file)
+      throw std::runtime_error("Cannot write checkpoint " + temporary_path);
+  }
+  std::filesystem::rename(temporary_path, path);
+}
+
+std::future<void> Checkpoint::write_async(std::string path,
+                                          CheckpointState state) {
+  return std::async(std::launch::async,
+                    [path = std::move(path), state = std::move(state)] {
+                      write(path, state);
+                    });
+}
+
+std::vector<std::vector<glm::vec3>>
+Checkpoint::load(const std::string &path, SolarSystemCalculator &calculator) {
+  using Section = CheckpointFile::Section;
+  const CheckpointFile file(path);
+  const auto &header = file.header();
+  const std::uint64_t n = header.body_count;
+  const std::uint64_t tracer_count = header.tracer_count;
+
+  bool valid = header.integrator >= 0 &&
+               header.integrator <=
+                   static_cast<std::int32_t>(IntegratorKind::HYBRID) &&
+               header.force_engine >= 0 &&
+               header.force_engine <=
+                   static_cast<std::int32_t>(ForceEngine::BARNES_HUT) &&
+               header.precision >= 0 &&
+               header.precision <= static_cast<std::int32_t>(Precision::FLOAT);
+  for (std::uint32_t id = Section::X; id <= Section::AZ; ++id)
+    valid = valid && header.section_size[id] == n * sizeof(double);
+  for (std::uint32_t id = Section::TRACER_X; id <= Section::TRACER_VZ; ++id)
+    valid = valid && header.section_size[id] == tracer_count * sizeof(double);
+  valid = valid && header.section_size[Section::BODY_RECORDS] ==
+                       n * sizeof(CheckpointFile::BodyRecord);
+  const auto names = file.section<char>(Section::NAMES);
+  const auto records =
+      file.section<CheckpointFile::BodyRecord>(Section::BODY_RECORDS);
+  for (std::size_t i = 0; valid && i < records.size(); ++i)
+    valid = records[i].name_offset <= names.size() &&
+            records[i].name_length <= names.size() - records[i].name_offset;
+  auto integrator =
+      Integrator::create(static_cast<IntegratorKind>(header.integrator));
+  valid = valid && integrator->restore_state(
+                       file.section<std::byte>(Section::INTEGRATOR_STATE), n);
+  if (!valid)
+    throw std::runtime_error("Checkpoint " + path + " is inconsistent");
+
+  BodyStore state;
+  assign(state.x, file.section<double>(Section::X));
+  assign(state.y, file.section<double>(Section::Y));
+  assign(state.z, file.section<double>(Section::Z));
+  assign(state.vx, file.section<double>(Section::VX));
+  assign(state.vy, file.section<double>(Section::VY));
+  assign(state.vz, file.section<double>(Section::VZ));
+  assign(state.mass, file.section<double>(Section::MASS));
+  assign(state.ax, file.section<double>(Section::AX));
+  assign(state.ay, file.section<double>(Section::AY));
+  assign(state.az, file.section<double>(Section::AZ));
+
+  TracerStore tracers;
+  assign(tracers.x, file.section<double>(Section::TRACER_X));
+  assign(tracers.y, file.section<double>(Section::TRACER_Y));
+  assign(tracers.z, file.section<double>(Section::TRACER_Z));
+  assign(tracers.vx, file.section<double>(Section::TRACER_VX));
+  assign(tracers.vy, file.section<double>(Section::TRACER_VY));
+  assign(tracers.vz, file.section<double>(Section::TRACER_VZ));
+
+  std::vector<Body> bodies;
+  bodies.reserve(n);
+  for (const auto &record : records) {
+    bodies.push_back(
+        {.name = std::string(names.data() + record.name_offset,
+                             record.name_length),
+         .color = {record.color[0], record.color[1], record.color[2]},
+         .is_emitter = record.is_emitter != 0,
+         .max_path = static_cast<std::size_t>(record.max_path),
+         .radius = record.radius});
+  }
+
+  std::vector<std::vector<glm::vec3>> paths;
+  const auto path_lengths = file.section<std::uint64_t>(Section::PATH_LENGTHS);
+  const auto path_points = file.section<glm::vec3>(Section::PATH_POINTS);
+  if (path_lengths.size() == n) {
+    std::size_t first = 0;
+    for (const auto length : path_lengths) {
+      if (length > path_points.size() - first)
+        break;
+      paths.emplace_back(path_points.begin() + first,
+                         path_points.begin() + first + length);
+      first += length;
+    }
+    if (paths.size() != n)
+      paths.clear();
+  }
+
+  calculator.state = std::move(state);
+  calculator.tracers = std::move(tracers);
+  calculator.bodies = std::move(bodies);
+  calculator.elapsed_simulation_time = header.elapsed_simulation_time;
+  calculator.force_engine = static_cast<ForceEngine>(header.force_engine);
+  calculator.opening_angle = header.opening_angle;
+  calculator.set_precision(static_cast<Precision>(header.precision));
+  calculator.set_integrator(std::move(integrator));
+  return paths;
+}
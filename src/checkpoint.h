@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "solar_system_calculator.h"
+
+// Everything a checkpoint holds, copied out of the calculator so that
+// writing it can run on another thread while the simulation continues.
+struct CheckpointState {
+  BodyStore state;
+  TracerStore tracers;
+  std::vector<Body> bodies;
+  double elapsed_simulation_time = 0.0;
+  IntegratorKind integrator = IntegratorKind::VERLET;
+  ForceEngine force_engine = ForceEngine::DIRECT;
+  double opening_angle = 0.5;
+  Precision precision = Precision::DOUBLE;
+  std::vector<std::byte> integrator_state;
+  std::vector<std::vector<glm::vec3>> paths; // optional, one per body
+};
+
+// Read-only view of a checkpoint file mapped into memory. Arrays are
+// stored 64-byte aligned in native layout, so sections are used in place.
+class CheckpointFile {
+public:
+  enum Section : std::uint32_t {
+    X, Y, Z, VX, VY, VZ, MASS, AX, AY, AZ,
+    TRACER_X, TRACER_Y, TRACER_Z, TRACER_VX, TRACER_VY, TRACER_VZ,
+    BODY_RECORDS, NAMES, INTEGRATOR_STATE, PATH_LENGTHS, PATH_POINTS,
+    SECTION_COUNT
+  };
+
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order; // 0x01020304 as written
+    std::uint64_t body_count;
+    std::uint64_t tracer_count;
+    double elapsed_simulation_time;
+    double opening_angle;
+    std::int32_t integrator;
+    std::int32_t force_engine;
+    std::int32_t precision;
+    std::int32_t reserved;
+    std::uint64_t section_offset[SECTION_COUNT];
+    std::uint64_t section_size[SECTION_COUNT]; // bytes
+  };
+
+  struct BodyRecord {
+    float color[3];
+    std::uint32_t is_emitter;
+    std::uint64_t max_path;
+    std::uint64_t name_offset;
+    std::uint64_t name_length;
+    double radius;
+  };
+
+  // Throws std::runtime_error if the file cannot be mapped or is not a
+  // checkpoint of a supported version.
+  explicit CheckpointFile(const std::string &path);
+  ~CheckpointFile();
+  CheckpointFile(const CheckpointFile &) = delete;
+  CheckpointFile &operator=(const CheckpointFile &) = delete;
+
+  [[nodiscard]] const Header &header() const {
+    return *static_cast<const Header *>(data);
+  }
+
+  template <typename T>
+  [[nodiscard]] std::span<const T> section(const Section id) const {
+    return {reinterpret_cast<const T *>(static_cast<const std::byte *>(data) +
+                                        header().section_offset[id]),
+            header().section_size[id] / sizeof(T)};
+  }
+
+private:
+  void *data = nullptr;
+  std::size_t size = 0;
+};
+
+class Checkpoint {
+public:
+  static constexpr std::uint32_t VERSION = 4;
+
+  // paths, if given, must hold one trail per body.
+  static CheckpointState
+  capture(const SolarSystemCalculator &calculator,
+          std::vector<std::vector<glm::vec3>> paths = {});
+
+  // Writes to a temporary file next to path and renames it into place, so
+  // an interrupted save never leaves a truncated checkpoint. Throws
+  // std::runtime_error on failure.
+  static void write(const std::string &path, const CheckpointState &state);
+  static std::future<void> write_async(std::string path,
+                                       CheckpointState state);
+
+  // Replaces the bodies, tracers, time, integrator and precision of
+  // calculator. Returns the saved trails, empty if the checkpoint has none.
+  static std::vector<std::vector<glm::vec3>>
+  load(const std::string &path, SolarSystemCalculator &calculator);
+};
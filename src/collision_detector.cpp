@@ -0,0 +1,533 @@
+#include "collision_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "glm/gtc/constants.hpp"
+
+namespace {
+
+constexpr std::uint64_t EMPTY = std::numeric_limits<std::uint64_t>::max();
+constexpr std::uint64_t AXIS_MASK = (std::uint64_t{1} << 21) - 1;
+constexpr std::size_t TRACER_GRAIN = 4096;
+constexpr std::size_t BODY_GRAIN = 256;
+
+std::int64_t cell_of(const double coordinate, const double inverse_size) {
+  const double cell = std::floor(coordinate * inverse_size);
+  constexpr double limit = 1e15;
+  return static_cast<std::int64_t>(std::clamp(cell, -limit, limit));
+}
+
+std::uint64_t pack(const std::int64_t ix, const std::int64_t iy,
+                   const std::int64_t iz) {
+  return ((static_cast<std::uint64_t>(ix) & AXIS_MASK) << 42) |
+         ((static_cast<std::uint64_t>(iy) & AXIS_MASK) << 21) |
+         (static_cast<std::uint64_t>(iz) & AXIS_MASK);
+}
+
+std::size_t slot_of(const std::uint64_t key, const std::size_t mask) {
+  return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 20) & mask;
+}
+
+// Closest approach of two objects moving on straight lines that end at
+// p_a, p_b with velocities v_a, v_b after dt. Times are since the start.
+struct Approach {
+  double time;
+  double distance;
+  double start_distance;
+};
+
+Approach closest_approach(const glm::dvec3 &p_a, const glm::dvec3 &v_a,
+                          const glm::dvec3 &p_b, const glm::dvec3 &v_b,
+                          const double dt) {
+  // Relative position at dt - u is dr - dv * u for u in [0, dt].
+  const glm::dvec3 dr = p_b - p_a;
+  const glm::dvec3 dv = v_b - v_a;
+  const double speed_squared = glm::dot(dv, dv);
+  double u = 0.0;
+  if (speed_squared > 0.0)
+    u = std::clamp(glm::dot(dr, dv) / speed_squared, 0.0, dt);
+  return {.time = dt - u,
+          .distance = glm::length(dr - dv * u),
+          .start_distance = glm::length(dr - dv * dt)};
+}
+
+// First time since the start at which the distance falls to contact, or 0
+// if the objects already overlap at the start.
+double contact_time(const glm::dvec3 &p_a, const glm::dvec3 &v_a,
+                    const glm::dvec3 &p_b, const glm::dvec3 &v_b,
+                    const double dt, const double contact,
+                    const double closest_time) {
+  const glm::dvec3 dv = v_b - v_a;
+  const glm::dvec3 start = p_b - p_a - dv * dt;
+  const double a = glm::dot(dv, dv);
+  const double b = 2.0 * glm::dot(start, dv);
+  const double c = glm::dot(start, start) - contact * contact;
+  if (c <= 0.0 || a == 0.0)
+    return 0.0;
+  const double discriminant = std::max(0.0, b * b - 4.0 * a * c);
+  const double time = (-b - std::sqrt(discriminant)) / (2.0 * a);
+  return std::clamp(time, 0.0, closest_time);
+}
+
+} // namespace
+
+double CollisionDetector::radius_of(const Body &body, const double mass,
+                                    const double density) {
+  if (body.radius > 0.0)
+    return body.radius;
+  if (!(mass > 0.0) || !(density > 0.0))
+    return 0.0;
+  return std::cbrt(3.0 * mass / (4.0 * glm::pi<double>() * density));
+}
+
+bool CollisionDetector::process(BodyStore &state, std::vector<Body> &bodies,
+                                TracerStore &tracers, ThreadPool &pool,
+                                const double time, const double dt) {
+  candidates = 0;
+  if (state.size() == 0 || !(dt > 0.0))
+    return false;
+  prepare_bodies(state, bodies, dt);
+
+  // Bodies that reach further than almost all others are checked against
+  // everything instead of making every cell large.
+  std::vector<double> sorted_reach(reach.begin(), reach.end());
+  const std::size_t n = sorted_reach.size();
+  const std::size_t quantile = n - 1 - n / 128;
+  std::nth_element(sorted_reach.begin(), sorted_reach.begin() + quantile,
+                   sorted_reach.end());
+  grid_reach = sorted_reach[quantile];
+  large.clear();
+  is_large.assign(n, false);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (reach[i] > grid_reach) {
+      large.push_back(static_cast<std::uint32_t>(i));
+      is_large[i] = true;
+    }
+  }
+
+  // Powers of two so the size, and with it the sort order, rarely changes.
+  const double wanted =
+      std::max(2.0 * grid_reach, std::numeric_limits<double>::min());
+  const double size = std::exp2(std::ceil(std::log2(wanted)));
+  if (size != cell_size) {
+    cell_size = size;
+    order.clear();
+  }
+  sort_cells(state);
+
+  std::vector<Hit> hits;
+  find_body_pairs(state, pool, dt, hits);
+  if (settings.tracers && tracers.size() > 0)
+    find_tracer_hits(state, tracers, pool, dt, hits);
+  return respond(hits, state, bodies, tracers, time, dt);
+}
+
+void CollisionDetector::prepare_bodies(const BodyStore &state,
+                                       const std::vector<Body> &bodies,
+                                       const double dt) {
+  const std::size_t n = state.size();
+  radius.resize(n);
+  encounter.resize(n);
+  reach.resize(n);
+  const std::size_t central = static_cast<std::size_t>(
+      std::max_element(state.mass.begin(), state.mass.end()) -
+      state.mass.begin());
+  const double central_mass = state.mass[central];
+  const glm::dvec3 central_position = state.position(central);
+  for (std::size_t i = 0; i < n; ++i) {
+    radius[i] = i < bodies.size()
+                    ? radius_of(bodies[i], state.mass[i], settings.density)
+                    : 0.0;
+    encounter[i] = 0.0;
+    if (i != central && state.mass[i] > 0.0 && central_mass > 0.0) {
+      const double distance =
+          glm::length(state.position(i) - central_position);
+      encounter[i] = settings.hill_factor * distance *
+                     std::cbrt(state.mass[i] / (3.0 * central_mass));
+    }
+    reach[i] = std::max(radius[i], encounter[i]) +
+               glm::length(state.velocity(i)) * dt;
+  }
+}
+
+std::uint64_t CollisionDetector::key_of(const double x, const double y,
+                                        const double z) const {
+  const double inverse = 1.0 / cell_size;
+  return pack(cell_of(x, inverse), cell_of(y, inverse), cell_of(z, inverse));
+}
+
+// The order of the last step is nearly sorted again, so the insertion sort
+// moves few entries. It gives up and sorts from scratch after 8 moves per
+// body, which happens after the cell size or the bodies changed.
+void CollisionDetector::sort_cells(const BodyStore &state) {
+  const std::size_t n = state.size();
+  const std::size_t grid_count = n - large.size();
+  bool rebuild = order.size() != grid_count;
+  if (!rebuild) {
+    for (const auto index : order) {
+      if (index >= n || is_large[index]) {
+        rebuild = true;
+        break;
+      }
+    }
+  }
+  if (rebuild) {
+    order.clear();
+    for (std::uint32_t i = 0; i < n; ++i) {
+      if (!is_large[i])
+        order.push_back(i);
+    }
+  }
+
+  keys.resize(order.size());
+  grid_min = glm::dvec3(std::numeric_limits<double>::max());
+  grid_max = glm::dvec3(std::numeric_limits<double>::lowest());
+  for (std::size_t k = 0; k < order.size(); ++k) {
+    const std::size_t i = order[k];
+    keys[k] = key_of(state.x[i], state.y[i], state.z[i]);
+    grid_min = glm::min(grid_min, state.position(i));
+    grid_max = glm::max(grid_max, state.position(i));
+  }
+
+  std::size_t budget = 8 * order.size();
+  bool sorted = !rebuild;
+  for (std::size_t k = 1; sorted && k < order.size(); ++k) {
+    const std::uint64_t key = keys[k];
+    const std::uint32_t index = order[k];
+    std::size_t j = k;
+    while (j > 0 && keys[j - 1] > key) {
+      keys[j] = keys[j - 1];
+      order[j] = order[j - 1];
+      --j;
+      if (--budget == 0) {
+        sorted = false;
+        break;
+      }
+    }
+    keys[j] = key;
+    order[j] = index;
+  }
+  if (!sorted) {
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> pairs(order.size());
+    for (std::size_t k = 0; k < order.size(); ++k)
+      pairs[k] = {keys[k], order[k]};
+    std::sort(pairs.begin(), pairs.end());
+    for (std::size_t k = 0; k < order.size(); ++k) {
+      keys[k] = pairs[k].first;
+      order[k] = pairs[k].second;
+    }
+  }
+
+  std::size_t cells = 0;
+  for (std::size_t k = 0; k < keys.size(); ++k)
+    cells += k == 0 || keys[k] != keys[k - 1];
+  std::size_t table_size = 16;
+  while (table_size < 2 * cells)
+    table_size *= 2;
+  table.assign(table_size, {EMPTY, 0, 0});
+  const std::size_t mask = table_size - 1;
+  for (std::size_t k = 0; k < keys.size();) {
+    std::size_t end = k + 1;
+    while (end < keys.size() && keys[end] == keys[k])
+      ++end;
+    std::size_t slot = slot_of(keys[k], mask);
+    while (table[slot].key != EMPTY)
+      slot = (slot + 1) & mask;
+    table[slot] = {keys[k], static_cast<std::uint32_t>(k),
+                   static_cast<std::uint32_t>(end)};
+    k = end;
+  }
+}
+
+const CollisionDetector::CellRange *
+CollisionDetector::find(const std::uint64_t key) const {
+  const std::size_t mask = table.size() - 1;
+  for (std::size_t slot = slot_of(key, mask);; slot = (slot + 1) & mask) {
+    if (table[slot].key == key)
+      return &table[slot];
+    if (table[slot].key == EMPTY)
+      return nullptr;
+  }
+}
+
+template <typename Visit>
+void CollisionDetector::for_neighbours(const glm::dvec3 &point,
+                                       const double distance,
+                                       Visit &&visit) const {
+  const glm::dvec3 low = point - glm::dvec3(distance);
+  const glm::dvec3 high = point + glm::dvec3(distance);
+  if (order.empty() || high.x < grid_min.x || high.y < grid_min.y ||
+      high.z < grid_min.z || low.x > grid_max.x || low.y > grid_max.y ||
+      low.z > grid_max.z)
+    return;
+  // Cells are twice the largest grid reach, so bodies look at one or two
+  // cells per axis; only fast tracers span more.
+  const double inverse = 1.0 / cell_size;
+  const std::int64_t x0 = cell_of(low.x, inverse);
+  const std::int64_t x1 = cell_of(high.x, inverse);
+  const std::int64_t y0 = cell_of(low.y, inverse);
+  const std::int64_t y1 = cell_of(high.y, inverse);
+  const std::int64_t z0 = cell_of(low.z, inverse);
+  const std::int64_t z1 = cell_of(high.z, inverse);
+  for (std::int64_t ix = x0; ix <= x1; ++ix) {
+    for (std::int64_t iy = y0; iy <= y1; ++iy) {
+      for (std::int64_t iz = z0; iz <= z1; ++iz) {
+        const CellRange *range = find(pack(ix, iy, iz));
+        if (range == nullptr)
+          continue;
+        for (std::uint32_t k = range->begin; k < range->end; ++k)
+          visit(static_cast<std::size_t>(order[k]));
+      }
+    }
+  }
+}
+
+void CollisionDetector::find_body_pairs(const BodyStore &state,
+                                        ThreadPool &pool, const double dt,
+                                        std::vector<Hit> &hits) {
+  const std::size_t n = state.size();
+  const std::size_t chunks = (n + BODY_GRAIN - 1) / BODY_GRAIN;
+  chunk_hits.assign(chunks, {});
+  std::vector<std::size_t> chunk_candidates(chunks, 0);
+
+  pool.parallel_for(0, n, BODY_GRAIN, [&](const std::size_t begin,
+                                          const std::size_t end) {
+    auto &out = chunk_hits[begin / BODY_GRAIN];
+    std::size_t tested = 0;
+    const auto test = [&](const std::size_t i, const std::size_t j) {
+      const glm::dvec3 p_i = state.position(i);
+      const glm::dvec3 p_j = state.position(j);
+      if (glm::length(p_j - p_i) > reach[i] + reach[j])
+        return;
+      ++tested;
+      const glm::dvec3 v_i = state.velocity(i);
+      const glm::dvec3 v_j = state.velocity(j);
+      const Approach approach = closest_approach(p_i, v_i, p_j, v_j, dt);
+      const double contact = radius[i] + radius[j];
+      const double limit = std::max(encounter[i], encounter[j]);
+      const double speed = glm::length(v_j - v_i);
+      if (approach.distance <= contact) {
+        out.push_back({contact_time(p_i, v_i, p_j, v_j, dt, contact,
+                                    approach.time),
+                       approach.distance, speed, i, j, false, true});
+      } else if (approach.distance <= limit &&
+                 approach.start_distance > limit) {
+        out.push_back(
+            {approach.time, approach.distance, speed, i, j, false, false});
+      }
+    };
+    for (std::size_t i = begin; i < end; ++i) {
+      if (is_large[i]) {
+        for (std::size_t j = 0; j < n; ++j) {
+          if (j != i && (!is_large[j] || j > i))
+            test(i, j);
+        }
+      } else {
+        for_neighbours(state.position(i), reach[i] + grid_reach,
+                       [&](const std::size_t j) {
+                         if (j > i)
+                           test(i, j);
+                       });
+      }
+    }
+    chunk_candidates[begin / BODY_GRAIN] = tested;
+  });
+
+  for (std::size_t c = 0; c < chunks; ++c) {
+    hits.insert(hits.end(), chunk_hits[c].begin(), chunk_hits[c].end());
+    candidates += chunk_candidates[c];
+  }
+}
+
+void CollisionDetector::find_tracer_hits(const BodyStore &state,
+                                         const TracerStore &tracers,
+                                         ThreadPool &pool, const double dt,
+                                         std::vector<Hit> &hits) {
+  const std::size_t count = tracers.size();
+  const std::size_t chunks = (count + TRACER_GRAIN - 1) / TRACER_GRAIN;
+  chunk_hits.assign(chunks, {});
+  std::vector<std::size_t> chunk_candidates(chunks, 0);
+
+  // Most tracers are nowhere near a body and are rejected against the box
+  // around the grid bodies before any cell is looked up.
+  const glm::dvec3 low = grid_min - glm::dvec3(grid_reach);
+  const glm::dvec3 high = grid_max + glm::dvec3(grid_reach);
+  pool.parallel_for(0, count, TRACER_GRAIN, [&](const std::size_t begin,
+                                                const std::size_t end) {
+    auto &out = chunk_hits[begin / TRACER_GRAIN];
+    std::size_t tested = 0;
+    for (std::size_t t = begin; t < end; ++t) {
+      const double x = tracers.x[t];
+      const double y = tracers.y[t];
+      const double z = tracers.z[t];
+      const double step = dt * std::sqrt(tracers.vx[t] * tracers.vx[t] +
+                                         tracers.vy[t] * tracers.vy[t] +
+                                         tracers.vz[t] * tracers.vz[t]);
+      // Without short-circuits: the comparisons are cheaper than the
+      // mispredicted branches.
+      const bool near_grid =
+          !order.empty() & (x >= low.x - step) & (x <= high.x + step) &
+          (y >= low.y - step) & (y <= high.y + step) & (z >= low.z - step) &
+          (z <= high.z + step);
+      if (!near_grid && large.empty())
+        continue;
+      const glm::dvec3 p_t(x, y, z);
+      const glm::dvec3 v_t = tracers.velocity(t);
+      const auto test = [&](const std::size_t j) {
+        const glm::dvec3 p_j = state.position(j);
+        if (glm::length(p_t - p_j) > reach[j] + step)
+          return;
+        ++tested;
+        const glm::dvec3 v_j = state.velocity(j);
+        const Approach approach = closest_approach(p_j, v_j, p_t, v_t, dt);
+        const double speed = glm::length(v_t - v_j);
+        if (approach.distance <= radius[j]) {
+          out.push_back({contact_time(p_j, v_j, p_t, v_t, dt, radius[j],
+                                      approach.time),
+                         approach.distance, speed, j, t, true, true});
+        } else if (approach.distance <= encounter[j] &&
+                   approach.start_distance > encounter[j]) {
+          out.push_back(
+              {approach.time, approach.distance, speed, j, t, true, false});
+        }
+      };
+      for (const auto j : large)
+        test(j);
+      if (near_grid)
+        for_neighbours(p_t, grid_reach + step, test);
+    }
+    chunk_candidates[begin / TRACER_GRAIN] = tested;
+  });
+
+  for (std::size_t c = 0; c < chunks; ++c) {
+    hits.insert(hits.end(), chunk_hits[c].begin(), chunk_hits[c].end());
+    candidates += chunk_candidates[c];
+  }
+}
+
+// Collisions are resolved in time order on the straight-line paths, so a
+// body merged early in the step takes no part in later hits.
+bool CollisionDetector::respond(std::vector<Hit> &hits, BodyStore &state,
+                                std::vector<Body> &bodies,
+                                TracerStore &tracers, const double time,
+                                const double dt) {
+  if (hits.empty())
+    return false;
+  std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+    if (a.time != b.time)
+      return a.time < b.time;
+    if (a.body != b.body)
+      return a.body < b.body;
+    if (a.other_is_tracer != b.other_is_tracer)
+      return b.other_is_tracer;
+    return a.other < b.other;
+  });
+
+  std::vector<bool> body_removed(state.size(), false);
+  std::vector<std::size_t> tracers_removed;
+  const double e = settings.restitution;
+  const auto name_of = [&](const std::size_t i) {
+    return i < bodies.size() ? bodies[i].name : "body " + std::to_string(i);
+  };
+
+  for (const Hit &hit : hits) {
+    const std::size_t i = hit.body;
+    const std::size_t j = hit.other;
+    if (body_removed[i] ||
+        (!hit.other_is_tracer && body_removed[j]) ||
+        (hit.other_is_tracer &&
+         std::binary_search(tracers_removed.begin(), tracers_removed.end(),
+                            j)))
+      continue;
+    event_log.push_back(
+        {.type = hit.collision ? EncounterType::COLLISION
+                               : EncounterType::CLOSE_ENCOUNTER,
+         .time = time - dt + hit.time,
+         .body = name_of(i),
+         .other = hit.other_is_tracer ? "tracer " + std::to_string(j)
+                                      : name_of(j),
+         .distance = hit.distance,
+         .relative_speed = hit.relative_speed});
+    if (!hit.collision || settings.response == CollisionResponse::NONE)
+      continue;
+
+    const double remaining = dt - hit.time;
+    if (hit.other_is_tracer) {
+      if (settings.response == CollisionResponse::MERGE) {
+        tracers_removed.insert(std::upper_bound(tracers_removed.begin(),
+                                                tracers_removed.end(), j),
+                               j);
+        continue;
+      }
+      const glm::dvec3 v_body = state.velocity(i);
+      glm::dvec3 v_t = tracers.velocity(j);
+      const glm::dvec3 contact_body = state.position(i) - v_body * remaining;
+      const glm::dvec3 contact_t = tracers.position(j) - v_t * remaining;
+      const glm::dvec3 normal = glm::normalize(contact_t - contact_body);
+      const double normal_speed = glm::dot(v_t - v_body, normal);
+      if (normal_speed < 0.0 && std::isfinite(normal_speed)) {
+        v_t -= (1.0 + e) * normal_speed * normal;
+        const glm::dvec3 p_t = contact_t + v_t * remaining;
+        tracers.x[j] = p_t.x;
+        tracers.y[j] = p_t.y;
+        tracers.z[j] = p_t.z;
+        tracers.vx[j] = v_t.x;
+        tracers.vy[j] = v_t.y;
+        tracers.vz[j] = v_t.z;
+      }
+      continue;
+    }
+
+    const double m_i = state.mass[i];
+    const double m_j = state.mass[j];
+    const double total = m_i + m_j;
+    const double share_i = total > 0.0 ? m_i / total : 0.5;
+    const double share_j = 1.0 - share_i;
+    if (settings.response == CollisionResponse::MERGE) {
+      const std::size_t keep = m_j > m_i ? j : i;
+      const std::size_t gone = keep == i ? j : i;
+      state.set_position(keep, share_i * state.position(i) +
+                                   share_j * state.position(j));
+      state.set_velocity(keep, share_i * state.velocity(i) +
+                                   share_j * state.velocity(j));
+      state.mass[keep] = total;
+      if (keep < bodies.size())
+        bodies[keep].radius = std::cbrt(radius[i] * radius[i] * radius[i] +
+                                        radius[j] * radius[j] * radius[j]);
+      body_removed[gone] = true;
+      continue;
+    }
+
+    glm::dvec3 v_i = state.velocity(i);
+    glm::dvec3 v_j = state.velocity(j);
+    const glm::dvec3 contact_i = state.position(i) - v_i * remaining;
+    const glm::dvec3 contact_j = state.position(j) - v_j * remaining;
+    const glm::dvec3 normal = glm::normalize(contact_j - contact_i);
+    const double normal_speed = glm::dot(v_j - v_i, normal);
+    if (!(normal_speed < 0.0) || !std::isfinite(normal_speed))
+      continue;
+    v_i += (1.0 + e) * share_j * normal_speed * normal;
+    v_j -= (1.0 + e) * share_i * normal_speed * normal;
+    state.set_velocity(i, v_i);
+    state.set_velocity(j, v_j);
+    state.set_position(i, contact_i + v_i * remaining);
+    state.set_position(j, contact_j + v_j * remaining);
+  }
+
+  if (!tracers_removed.empty())
+    tracers.remove(tracers_removed);
+  bool removed = false;
+  for (std::size_t i = state.size(); i-- > 0;) {
+    if (!body_removed[i])
+      continue;
+    state.erase(i);
+    if (i < bodies.size())
+      bodies.erase(bodies.begin() + static_cast<std::ptrdiff_t>(i));
+    removed = true;
+  }
+  if (removed)
+    order.clear();
+  return removed;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "body_store.h"
+#include "thread_pool.h"
+#include "tracer_store.h"
+
+enum class CollisionResponse {
+  NONE,   // only log
+  MERGE,  // bodies combine, tracers are absorbed
+  BOUNCE, // bodies and tracers reflect off each other
+};
+
+struct CollisionSettings {
+  // A close encounter is a pass within hill_factor Hill radii of the body
+  // with the larger Hill sphere. The central body has none.
+  double hill_factor = 3.0;
+  CollisionResponse response = CollisionResponse::MERGE;
+  double restitution = 1.0; // normal speed kept by a bounce
+  // m_sun/au^3, gives the radius of bodies whose Body::radius is 0.
+  // 3.4e6 is 2 g/cm^3.
+  double density = 3.4e6;
+  bool tracers = true; // also check tracers against the massive bodies
+};
+
+enum class EncounterType { CLOSE_ENCOUNTER, COLLISION };
+
+struct EncounterEvent {
+  EncounterType type;
+  double time; // of closest approach, days
+  std::string body;
+  std::string other;    // "tracer N" for a tracer
+  double distance;      // closest approach, au
+  double relative_speed; // at closest approach, au/day
+};
+
+// Finds close encounters and collisions after every step. The massive
+// bodies are sorted into a uniform grid keyed by cell; the order is kept
+// between steps and re-sorted with an insertion sort, which costs O(N)
+// while few bodies change cells. Bodies and tracers then look up the cells
+// within their reach, at most 27, so a step costs O(N) for N tracers.
+//
+// Within a step every object is taken to move on a straight line ending at
+// its current position with its current velocity. Pairs are refined to the
+// time of closest approach on those lines, which also catches pairs that
+// passed through each other between two steps.
+class CollisionDetector {
+public:
+  CollisionSettings settings;
+
+  explicit CollisionDetector(CollisionSettings settings = {})
+      : settings(settings) {}
+
+  // Checks the step of length dt that ended at time and applies the
+  // response to collisions, earliest first. Returns true if bodies were
+  // removed; their entries in state and bodies are erased in place.
+  bool process(BodyStore &state, std::vector<Body> &bodies,
+               TracerStore &tracers, ThreadPool &pool, double time,
+               double dt);
+
+  [[nodiscard]] const std::vector<EncounterEvent> &events() const {
+    return event_log;
+  }
+  void clear_events() { event_log.clear(); }
+
+  // Pairs that passed the grid lookup in the last step.
+  [[nodiscard]] std::size_t candidate_pairs() const { return candidates; }
+
+  [[nodiscard]] static double radius_of(const Body &body, double mass,
+                                        double density);
+
+private:
+  struct Hit {
+    double time;      // since the start of the step
+    double distance;
+    double relative_speed;
+    std::size_t body;
+    std::size_t other;
+    bool other_is_tracer;
+    bool collision;
+  };
+
+  struct CellRange {
+    std::uint64_t key;
+    std::uint32_t begin, end;
+  };
+
+  std::vector<EncounterEvent> event_log;
+  std::size_t candidates = 0;
+
+  // Per body, recomputed every step.
+  AlignedVector<double> radius;    // physical
+  AlignedVector<double> encounter; // hill_factor Hill radii
+  AlignedVector<double> reach;     // largest of both plus the step's path
+
+  // Bodies that reach much further than the rest stay out of the grid.
+  std::vector<std::uint32_t> large;
+  std::vector<bool> is_large;
+  double grid_reach = 0.0; // largest reach in the grid
+
+  double cell_size = 0.0;
+  std::vector<std::uint32_t> order; // body indices sorted by cell key
+  std::vector<std::uint64_t> keys;  // of order[k]
+  std::vector<CellRange> table;     // open addressing, power of two
+  glm::dvec3 grid_min{0.0}, grid_max{0.0};
+
+  std::vector<std::vector<Hit>> chunk_hits;
+
+  void prepare_bodies(const BodyStore &state, const std::vector<Body> &bodies,
+                      double dt);
+  void sort_cells(const BodyStore &state);
+  [[nodiscard]] const CellRange *find(std::uint64_t key) const;
+  [[nodiscard]] std::uint64_t key_of(double x, double y, double z) const;
+
+  // Visits the grid bodies in all cells within distance of the point.
+  template <typename Visit>
+  void for_neighbours(const glm::dvec3 &point, double distance,
+                      Visit &&visit) const;
+
+  void find_body_pairs(const BodyStore &state, ThreadPool &pool, double dt,
+                       std::vector<Hit> &hits);
+  void find_tracer_hits(const BodyStore &state, const TracerStore &tracers,
+                        ThreadPool &pool, double dt, std::vector<Hit> &hits);
+  bool respond(std::vector<Hit> &hits, BodyStore &state,
+               std::vector<Body> &bodies, TracerStore &tracers, double time,
+               double dt);
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+// RGBA8 as vertex attributes take it, red in the lowest byte. Channels are
+// clamped to [0, 1] and rounded.
+inline std::uint32_t pack_color(const glm::vec3 &color,
+                                const float alpha = 1.0f) {
+  const auto channel = [](const float value) {
+    return static_cast<std::uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f +
+                                      0.5f);
+  };
+  return channel(color.r) | channel(color.g) << 8 | channel(color.b) << 16 |
+         channel(alpha) << 24;
+}
@@ -0,0 +1,125 @@
+#include "compact_trail.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Samples one newest point may stand in for; bounds the cost of add().
+constexpr std::size_t MAX_PENDING = 256;
+// Time deltas of up to four durations fit in 16 bits.
+constexpr double TIME_STEPS = 16384.0;
+} // namespace
+
+CompactTrail::CompactTrail(const double duration, const float tolerance,
+                           const std::size_t max_points)
+    : span(duration), tolerance(tolerance),
+      max_points(std::max<std::size_t>(max_points, 2)),
+      quantum(0.25f * tolerance),
+      time_quantum(std::max(duration, 1e-9) / TIME_STEPS) {}
+
+void CompactTrail::clear() {
+  first = 0;
+  count = 0;
+  pending.clear();
+}
+
+bool CompactTrail::encode(const glm::vec3 &from, const double from_time,
+                          const glm::vec3 &to, const double to_time,
+                          Entry &entry) const {
+  constexpr float limit = std::numeric_limits<std::int16_t>::max();
+  const glm::vec3 steps = (to - from) / quantum;
+  const float dx = std::round(steps.x);
+  const float dy = std::round(steps.y);
+  const float dz = std::round(steps.z);
+  const double dt = std::round((to_time - from_time) / time_quantum);
+  if (!(std::abs(dx) <= limit && std::abs(dy) <= limit &&
+        std::abs(dz) <= limit && dt >= 0.0 &&
+        dt <= std::numeric_limits<std::uint16_t>::max()))
+    return false;
+  entry = {static_cast<std::int16_t>(dx), static_cast<std::int16_t>(dy),
+           static_cast<std::int16_t>(dz), static_cast<std::uint16_t>(dt)};
+  return true;
+}
+
+void CompactTrail::push(const Entry &entry) {
+  if (count == entries.size()) {
+    std::vector<Entry> grown(std::max<std::size_t>(8, 2 * entries.size()));
+    for (std::size_t k = 0; k < count; ++k)
+      grown[k] = entries[(first + k) % entries.size()];
+    entries = std::move(grown);
+    first = 0;
+  }
+  entries[(first + count) % entries.size()] = entry;
+  ++count;
+}
+
+void CompactTrail::restart(const double time, const glm::vec3 &position) {
+  clear();
+  push({});
+  base = anchor = last = position;
+  base_time = anchor_time = last_time = time;
+}
+
+bool CompactTrail::covers(const glm::vec3 &from, const glm::vec3 &to) const {
+  const glm::vec3 line = to - from;
+  const float length2 = glm::dot(line, line);
+  for (const glm::vec3 &sample : pending) {
+    float t = 0.0f;
+    if (length2 > 0.0f)
+      t = std::clamp(glm::dot(sample - from, line) / length2, 0.0f, 1.0f);
+    const glm::vec3 offset = sample - (from + t * line);
+    if (glm::dot(offset, offset) > tolerance * tolerance)
+      return false;
+  }
+  return true;
+}
+
+std::size_t CompactTrail::expire() {
+  std::size_t expired = 0;
+  // The anchor and the newest point always stay.
+  while (count > 2 &&
+         (count > max_points || base_time < last_time - span)) {
+    first = (first + 1) % entries.size();
+    --count;
+    const Entry &next = entries[first];
+    base += quantum * glm::vec3(next.dx, next.dy, next.dz);
+    base_time += time_quantum * next.dt;
+    ++expired;
+  }
+  return expired;
+}
+
+CompactTrail::Update CompactTrail::add(const double time,
+                                       const glm::vec3 &position) {
+  const auto restarted = [&] {
+    restart(time, position);
+    return Update{Update::Kind::RESTARTED, 0};
+  };
+  if (count == 0 || time < last_time)
+    return restarted();
+
+  Entry entry{};
+  if (count >= 2 && pending.size() < MAX_PENDING &&
+      encode(anchor, anchor_time, position, time, entry)) {
+    const glm::vec3 candidate =
+        anchor + quantum * glm::vec3(entry.dx, entry.dy, entry.dz);
+    if (covers(anchor, candidate)) {
+      entries[(first + count - 1) % entries.size()] = entry;
+      last = candidate;
+      last_time = anchor_time + time_quantum * entry.dt;
+      pending.push_back(position);
+      return {Update::Kind::REPLACED, expire()};
+    }
+  }
+
+  if (!encode(last, last_time, position, time, entry))
+    return restarted();
+  push(entry);
+  anchor = last;
+  anchor_time = last_time;
+  last += quantum * glm::vec3(entry.dx, entry.dy, entry.dz);
+  last_time += time_quantum * entry.dt;
+  pending.assign(1, position);
+  return {Update::Kind::APPENDED, expire()};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// A body's trail over the last `duration` days of simulated time, simplified
+// as it grows: a new sample replaces the newest point as long as every
+// sample since the last kept point stays within `tolerance` of the line to
+// it, so smooth arcs keep few points and sharp turns many. Points are
+// stored as 16-bit deltas of position and time from their predecessor, 8
+// bytes each, quantized against the reconstructed predecessor so rounding
+// does not add up along the trail.
+class CompactTrail {
+public:
+  // What add() did to the points, for copies that follow along.
+  struct Update {
+    enum class Kind {
+      APPENDED, // a new newest point
+      REPLACED, // the newest point moved
+      RESTARTED // everything before was dropped
+    };
+    Kind kind;
+    std::size_t expired; // oldest points dropped after the change
+  };
+
+  explicit CompactTrail(double duration = 500.0, float tolerance = 1e-3f,
+                        std::size_t max_points = 5000);
+
+  // Adds the sample at time. A sample before the newest point, or one too
+  // far from it for the 16-bit deltas, starts the trail over.
+  Update add(double time, const glm::vec3 &position);
+  void clear();
+
+  [[nodiscard]] std::size_t size() const { return count; }
+  [[nodiscard]] bool empty() const { return count == 0; }
+  [[nodiscard]] std::size_t bytes() const {
+    return entries.capacity() * sizeof(Entry);
+  }
+  [[nodiscard]] const glm::vec3 &oldest() const { return base; }
+  [[nodiscard]] const glm::vec3 &newest() const { return last; }
+  [[nodiscard]] double newest_time() const { return last_time; }
+  [[nodiscard]] double duration() const { return span; }
+
+  // Calls visit(time, position) for every point, oldest first.
+  template <typename F> void for_each(F &&visit) const {
+    glm::vec3 position = base;
+    double time = base_time;
+    for (std::size_t k = 0; k < count; ++k) {
+      const Entry &entry = entries[(first + k) % entries.size()];
+      if (k > 0) {
+        position += quantum * glm::vec3(entry.dx, entry.dy, entry.dz);
+        time += time_quantum * entry.dt;
+      }
+      visit(time, position);
+    }
+  }
+
+private:
+  struct Entry {
+    std::int16_t dx, dy, dz; // in quanta, from the previous point
+    std::uint16_t dt;        // in time quanta
+  };
+
+  double span;
+  float tolerance;
+  std::size_t max_points;
+  float quantum;       // position resolution, a quarter of the tolerance
+  double time_quantum; // time resolution
+  std::vector<Entry> entries; // ring
+  std::size_t first = 0;
+  std::size_t count = 0;
+  glm::vec3 base{0.0f}; // oldest point
+  double base_time = 0.0;
+  glm::vec3 anchor{0.0f}; // last kept point, the one before the newest
+  double anchor_time = 0.0;
+  glm::vec3 last{0.0f}; // newest point
+  double last_time = 0.0;
+  // Samples since the anchor that the newest point stands in for.
+  std::vector<glm::vec3> pending;
+
+  bool encode(const glm::vec3 &from, double from_time, const glm::vec3 &to,
+              double to_time, Entry &entry) const;
+  void push(const Entry &entry);
+  void restart(double time, const glm::vec3 &position);
+  [[nodiscard]] bool covers(const glm::vec3 &from, const glm::vec3 &to) const;
+  std::size_t expire();
+};
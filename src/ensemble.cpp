@@ -0,0 +1,228 @@
+#include "ensemble.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+#include "x86_simd.h"
+
+namespace {
+
+constexpr std::size_t LANES = Ensemble::ENSEMBLE_LANES;
+
+// Bodies x lanes; element [body * LANES + lane].
+struct Batch {
+  std::size_t bodies = 0;
+  AlignedVector<double> x, y, z, vx, vy, vz, mass, ax, ay, az;
+
+  explicit Batch(const std::size_t body_count) : bodies(body_count) {
+    for (auto *component : {&x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az})
+      component->assign(body_count * LANES, 0.0);
+  }
+};
+
+using BatchAccelerationFn = void (*)(Batch &batch, double g);
+
+void accelerations_scalar(Batch &batch, const double g) {
+  const std::size_t n = batch.bodies;
+  for (std::size_t i = 0; i < n; ++i) {
+    double ax[LANES] = {};
+    double ay[LANES] = {};
+    double az[LANES] = {};
+    for (std::size_t j = 0; j < n; ++j) {
+      if (j == i)
+        continue;
+      for (std::size_t l = 0; l < LANES; ++l) {
+        const double dx = batch.x[j * LANES + l] - batch.x[i * LANES + l];
+        const double dy = batch.y[j * LANES + l] - batch.y[i * LANES + l];
+        const double dz = batch.z[j * LANES + l] - batch.z[i * LANES + l];
+        const double r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 == 0.0)
+          continue;
+        const double s = batch.mass[j * LANES + l] / (r2 * std::sqrt(r2));
+        ax[l] += s * dx;
+        ay[l] += s * dy;
+        az[l] += s * dz;
+      }
+    }
+    for (std::size_t l = 0; l < LANES; ++l) {
+      batch.ax[i * LANES + l] = g * ax[l];
+      batch.ay[i * LANES + l] = g * ay[l];
+      batch.az[i * LANES + l] = g * az[l];
+    }
+  }
+}
+
+#ifdef MAG3D_X86_KERNELS
+
+static_assert(LANES == 4, "the AVX2 batch kernel holds one member per lane");
+
+__attribute__((target("avx2,fma"))) void accelerations_avx2(Batch &batch,
+                                                            const double g) {
+  const std::size_t n = batch.bodies;
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d three_halves = _mm256_set1_pd(1.5);
+  const __m256d gv = _mm256_set1_pd(g);
+  for (std::size_t i = 0; i < n; ++i) {
+    const __m256d xi = _mm256_load_pd(batch.x.data() + i * LANES);
+    const __m256d yi = _mm256_load_pd(batch.y.data() + i * LANES);
+    const __m256d zi = _mm256_load_pd(batch.z.data() + i * LANES);
+    __m256d ax = zero;
+    __m256d ay = zero;
+    __m256d az = zero;
+    for (std::size_t j = 0; j < n; ++j) {
+      if (j == i)
+        continue;
+      const std::size_t k = j * LANES;
+      const __m256d dx = _mm256_sub_pd(_mm256_load_pd(batch.x.data() + k), xi);
+      const __m256d dy = _mm256_sub_pd(_mm256_load_pd(batch.y.data() + k), yi);
+      const __m256d dz = _mm256_sub_pd(_mm256_load_pd(batch.z.data() + k), zi);
+      __m256d r2 = _mm256_mul_pd(dx, dx);
+      r2 = _mm256_fmadd_pd(dy, dy, r2);
+      r2 = _mm256_fmadd_pd(dz, dz, r2);
+      const __m256d nonzero = _mm256_cmp_pd(r2, zero, _CMP_NEQ_OQ);
+      const __m256d inv_r = rsqrt(r2, half, three_halves);
+      const __m256d inv_r3 = _mm256_and_pd(
+          _mm256_mul_pd(inv_r, _mm256_mul_pd(inv_r, inv_r)), nonzero);
+      const __m256d s =
+          _mm256_mul_pd(_mm256_load_pd(batch.mass.data() + k), inv_r3);
+      ax = _mm256_fmadd_pd(s, dx, ax);
+      ay = _mm256_fmadd_pd(s, dy, ay);
+      az = _mm256_fmadd_pd(s, dz, az);
+    }
+    _mm256_store_pd(batch.ax.data() + i * LANES, _mm256_mul_pd(gv, ax));
+    _mm256_store_pd(batch.ay.data() + i * LANES, _mm256_mul_pd(gv, ay));
+    _mm256_store_pd(batch.az.data() + i * LANES, _mm256_mul_pd(gv, az));
+  }
+}
+
+#endif
+
+BatchAccelerationFn batch_kernel(const KernelIsa isa) {
+#ifdef MAG3D_X86_KERNELS
+  if (isa == KernelIsa::AVX2)
+    return accelerations_avx2;
+#endif
+  (void)isa;
+  return accelerations_scalar;
+}
+
+double lane_energy(const Batch &batch, const std::size_t lane,
+                   const double g) {
+  double energy = 0.0;
+  for (std::size_t i = 0; i < batch.bodies; ++i) {
+    const std::size_t a = i * LANES + lane;
+    const double v2 = batch.vx[a] * batch.vx[a] + batch.vy[a] * batch.vy[a] +
+                      batch.vz[a] * batch.vz[a];
+    energy += 0.5 * batch.mass[a] * v2;
+    for (std::size_t j = i + 1; j < batch.bodies; ++j) {
+      const std::size_t b = j * LANES + lane;
+      const glm::dvec3 d(batch.x[b] - batch.x[a], batch.y[b] - batch.y[a],
+                         batch.z[b] - batch.z[a]);
+      energy -= g * batch.mass[a] * batch.mass[b] / glm::length(d);
+    }
+  }
+  return energy;
+}
+
+void kick(Batch &batch, const double dt) {
+  for (std::size_t k = 0; k < batch.bodies * LANES; ++k) {
+    batch.vx[k] += dt * batch.ax[k];
+    batch.vy[k] += dt * batch.ay[k];
+    batch.vz[k] += dt * batch.az[k];
+  }
+}
+
+void drift(Batch &batch, const double dt) {
+  for (std::size_t k = 0; k < batch.bodies * LANES; ++k) {
+    batch.x[k] += dt * batch.vx[k];
+    batch.y[k] += dt * batch.vy[k];
+    batch.z[k] += dt * batch.vz[k];
+  }
+}
+
+} // namespace
+
+std::vector<EnsembleSummary>
+Ensemble::run(const BodyStore &base, const double g,
+              const std::vector<EnsembleMember> &members,
+              const EnsembleSettings &settings, const KernelIsa isa) {
+  std::vector<EnsembleSummary> summaries(members.size());
+  const std::size_t n = base.size();
+  const std::size_t batch_count = (members.size() + LANES - 1) / LANES;
+  const auto steps =
+      static_cast<std::size_t>(std::llround(settings.duration / settings.dt));
+  const BatchAccelerationFn accelerations = batch_kernel(isa);
+
+  ThreadPool pool(settings.max_threads);
+  pool.parallel_for(0, batch_count, 1, [&](const std::size_t first,
+                                           const std::size_t last) {
+    for (std::size_t b = first; b < last; ++b) {
+      // A short last batch repeats its final member in the spare lanes.
+      const std::size_t first_member = b * LANES;
+      const auto member_of = [&](const std::size_t lane) {
+        return std::min(first_member + lane, members.size() - 1);
+      };
+
+      Batch batch(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t l = 0; l < LANES; ++l) {
+          const std::size_t k = i * LANES + l;
+          batch.x[k] = base.x[i];
+          batch.y[k] = base.y[i];
+          batch.z[k] = base.z[i];
+          batch.vx[k] = base.vx[i];
+          batch.vy[k] = base.vy[i];
+          batch.vz[k] = base.vz[i];
+          batch.mass[k] = members[member_of(l)].masses[i];
+        }
+      }
+
+      double initial_energy[LANES];
+      for (std::size_t l = 0; l < LANES; ++l)
+        initial_energy[l] = lane_energy(batch, l, g);
+
+      // Kick-drift-kick; the closing acceleration of one step opens the next.
+      accelerations(batch, g);
+      for (std::size_t s = 0; s < steps; ++s) {
+        kick(batch, 0.5 * settings.dt);
+        drift(batch, settings.dt);
+        accelerations(batch, g);
+        kick(batch, 0.5 * settings.dt);
+      }
+
+      for (std::size_t l = 0; l < LANES && first_member + l < members.size();
+           ++l) {
+        auto &summary = summaries[first_member + l];
+        summary.positions.resize(n);
+        summary.velocities.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+          const std::size_t k = i * LANES + l;
+          summary.positions[i] = {batch.x[k], batch.y[k], batch.z[k]};
+          summary.velocities[i] = {batch.vx[k], batch.vy[k], batch.vz[k]};
+        }
+        summary.relative_energy_error =
+            std::abs(lane_energy(batch, l, g) / initial_energy[l] - 1.0);
+      }
+    }
+  });
+  return summaries;
+}
+
+std::vector<EnsembleMember>
+Ensemble::mass_sweep(const BodyStore &base, const std::size_t body,
+                     const double min_mass, const double max_mass,
+                     const std::size_t count) {
+  std::vector<EnsembleMember> members(count);
+  const std::vector<double> base_masses(base.mass.begin(), base.mass.end());
+  for (std::size_t m = 0; m < count; ++m) {
+    const double fraction =
+        count > 1 ? static_cast<double>(m) / static_cast<double>(count - 1)
+                  : 0.0;
+    members[m].masses = base_masses;
+    members[m].masses[body] =
+        min_mass * std::pow(max_mass / min_mass, fraction);
+  }
+  return members;
+}
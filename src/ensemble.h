@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "body_store.h"
+#include "glm/glm.hpp"
+#include "gravity_kernel.h"
+
+// One variation of the base system; only the masses change, so every member
+// has the same bodies in the same order.
+struct EnsembleMember {
+  std::vector<double> masses; // m_sun, one per body of the base system
+};
+
+struct EnsembleSettings {
+  double dt = 0.25;          // days
+  double duration = 3650.0;  // days
+  std::size_t max_threads = 0;
+};
+
+struct EnsembleSummary {
+  std::vector<glm::dvec3> positions;  // au, final
+  std::vector<glm::dvec3> velocities; // au/day, final
+  double relative_energy_error = 0.0; // |E_end / E_start - 1|
+};
+
+// Runs many copies of a small system with velocity Verlet. Members are packed
+// ENSEMBLE_LANES at a time into one structure-of-arrays batch whose inner
+// loops run across members, so the kernel vectorizes even for a handful of
+// bodies. Batches are independent and run whole on the thread pool.
+class Ensemble {
+public:
+  static constexpr std::size_t ENSEMBLE_LANES = 4;
+
+  static std::vector<EnsembleSummary>
+  run(const BodyStore &base, double g,
+      const std::vector<EnsembleMember> &members,
+      const EnsembleSettings &settings,
+      KernelIsa isa = GravityKernel::detect_isa());
+
+  // count members with body `body` at masses spaced evenly in log between
+  // min_mass and max_mass; the other masses come from base.
+  static std::vector<EnsembleMember> mass_sweep(const BodyStore &base,
+                                                std::size_t body,
+                                                double min_mass,
+                                                double max_mass,
+                                                std::size_t count);
+};
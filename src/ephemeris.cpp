@@ -0,0 +1,356 @@
+#include "ephemeris.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Samples per interval kept by record(), in multiples of the coefficients.
+constexpr double SAMPLES_PER_COEFFICIENT = 4.0;
+
+// T_k(tau) and dT_k/dtau for k < order.
+void chebyshev(const double tau, const std::size_t order, double *t,
+               double *dt) {
+  t[0] = 1.0;
+  dt[0] = 0.0;
+  if (order > 1) {
+    t[1] = tau;
+    dt[1] = 1.0;
+  }
+  for (std::size_t k = 2; k < order; ++k) {
+    t[k] = 2.0 * tau * t[k - 1] - t[k - 2];
+    dt[k] = 2.0 * t[k - 1] + 2.0 * tau * dt[k - 1] - dt[k - 2];
+  }
+}
+
+// Clenshaw's recurrence for the x, y and z series of one body at once, which
+// interleaves three independent dependency chains. Only the multiply-add on
+// b1 is on each chain; c[k] - b2 is ready a step earlier.
+glm::dvec3 clenshaw(const double *c, const std::size_t order,
+                    const double tau) {
+  const double *cy = c + order;
+  const double *cz = c + 2 * order;
+  const double two_tau = 2.0 * tau;
+  glm::dvec3 b1(0.0), b2(0.0);
+  for (std::size_t k = order - 1; k > 0; --k) {
+    const glm::dvec3 b0(two_tau * b1.x + (c[k] - b2.x),
+                        two_tau * b1.y + (cy[k] - b2.y),
+                        two_tau * b1.z + (cz[k] - b2.z));
+    b2 = b1;
+    b1 = b0;
+  }
+  return {tau * b1.x - b2.x + c[0], tau * b1.y - b2.y + cy[0],
+          tau * b1.z - b2.z + cz[0]};
+}
+
+// Value and derivative with respect to tau.
+void evaluate(const double *c, const std::size_t order, const double tau,
+              double &value, double &derivative) {
+  double t_prev = 1.0, t = tau;
+  double dt_prev = 0.0, dt = 1.0;
+  value = c[0];
+  derivative = 0.0;
+  if (order > 1) {
+    value += c[1] * tau;
+    derivative += c[1];
+  }
+  for (std::size_t k = 2; k < order; ++k) {
+    const double t_next = 2.0 * tau * t - t_prev;
+    const double dt_next = 2.0 * t + 2.0 * tau * dt - dt_prev;
+    t_prev = t;
+    t = t_next;
+    dt_prev = dt;
+    dt = dt_next;
+    value += c[k] * t;
+    derivative += c[k] * dt;
+  }
+}
+
+// Cholesky factorization in place, lower triangle. Returns false if the
+// matrix is not positive definite.
+bool cholesky(std::vector<double> &a, const std::size_t n) {
+  for (std::size_t j = 0; j < n; ++j) {
+    double pivot = a[j * n + j];
+    for (std::size_t k = 0; k < j; ++k)
+      pivot -= a[j * n + k] * a[j * n + k];
+    if (!(pivot > 0.0))
+      return false;
+    a[j * n + j] = std::sqrt(pivot);
+    for (std::size_t i = j + 1; i < n; ++i) {
+      double sum = a[i * n + j];
+      for (std::size_t k = 0; k < j; ++k)
+        sum -= a[i * n + k] * a[j * n + k];
+      a[i * n + j] = sum / a[j * n + j];
+    }
+  }
+  return true;
+}
+
+void cholesky_solve(const std::vector<double> &l, const std::size_t n,
+                    double *x) {
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t k = 0; k < i; ++k)
+      x[i] -= l[i * n + k] * x[k];
+    x[i] /= l[i * n + i];
+  }
+  for (std::size_t i = n; i-- > 0;) {
+    for (std::size_t k = i + 1; k < n; ++k)
+      x[i] -= l[k * n + i] * x[k];
+    x[i] /= l[i * n + i];
+  }
+}
+
+} // namespace
+
+Ephemeris::Ephemeris(const std::size_t body_count,
+                     const EphemerisSettings settings)
+    : bodies(body_count), config(settings) {
+  if (!(config.interval > 0.0))
+    throw std::runtime_error("Ephemeris interval must be positive");
+}
+
+void Ephemeris::record(const double time, const BodyStore &state) {
+  if (state.size() != bodies)
+    throw std::runtime_error("Ephemeris expects " + std::to_string(bodies) +
+                             " bodies, got " + std::to_string(state.size()));
+  if (!std::isfinite(time))
+    return;
+  if (!sample_times.empty() && time < sample_times.back()) {
+    sample_times.clear();
+    sample_values.clear();
+  }
+  const std::int64_t index = interval_of(time);
+  if (sample_times.empty()) {
+    open_interval = index;
+  } else if (index == open_interval) {
+    const double spacing =
+        config.interval /
+        (SAMPLES_PER_COEFFICIENT * static_cast<double>(config.degree + 1));
+    if (time - sample_times.back() < spacing)
+      return;
+  }
+
+  sample_times.push_back(time);
+  for (const auto *component : {&state.x, &state.y, &state.z, &state.vx,
+                                &state.vy, &state.vz})
+    sample_values.insert(sample_values.end(), component->begin(),
+                         component->end());
+
+  const std::size_t stride = 6 * bodies;
+  while (time >= static_cast<double>(open_interval + 1) * config.interval) {
+    // An interval recording started inside of is left to the source.
+    if (sample_times.front() <=
+        static_cast<double>(open_interval) * config.interval)
+      fit_samples(open_interval);
+    ++open_interval;
+    const double start = static_cast<double>(open_interval) * config.interval;
+    std::size_t keep = 0;
+    while (keep + 1 < sample_times.size() && sample_times[keep + 1] <= start)
+      ++keep;
+    sample_times.erase(sample_times.begin(),
+                       sample_times.begin() + static_cast<long>(keep));
+    sample_values.erase(sample_values.begin(),
+                        sample_values.begin() +
+                            static_cast<long>(keep * stride));
+  }
+}
+
+void Ephemeris::set_source(PositionSource position_source, const double begin,
+                           const double end) {
+  source = std::move(position_source);
+  source_begin = begin;
+  source_end = end;
+}
+
+bool Ephemeris::position(const std::size_t body, const double time,
+                         glm::dvec3 &position) {
+  const Segment *segment = body < bodies ? find(time) : nullptr;
+  if (segment == nullptr)
+    return false;
+  const double tau = (2.0 * time - segment->begin - segment->end) /
+                     (segment->end - segment->begin);
+  position = clenshaw(segment->coefficients.data() + body * 3 * segment->order,
+                      segment->order, tau);
+  return true;
+}
+
+bool Ephemeris::state(const std::size_t body, const double time,
+                      glm::dvec3 &position, glm::dvec3 &velocity) {
+  const Segment *segment = body < bodies ? find(time) : nullptr;
+  if (segment == nullptr)
+    return false;
+  const double scale = 2.0 / (segment->end - segment->begin);
+  const double tau = (time - segment->begin) * scale - 1.0;
+  const double *c = segment->coefficients.data() + body * 3 * segment->order;
+  for (int axis = 0; axis < 3; ++axis) {
+    double derivative;
+    evaluate(c + axis * segment->order, segment->order, tau, position[axis],
+             derivative);
+    velocity[axis] = derivative * scale;
+  }
+  return true;
+}
+
+bool Ephemeris::positions(const double time,
+                          std::vector<glm::dvec3> &positions) {
+  const Segment *segment = find(time);
+  if (segment == nullptr)
+    return false;
+  const double tau = (2.0 * time - segment->begin - segment->end) /
+                     (segment->end - segment->begin);
+  const std::size_t order = segment->order;
+  positions.resize(bodies);
+  for (std::size_t body = 0; body < bodies; ++body)
+    positions[body] =
+        clenshaw(segment->coefficients.data() + body * 3 * order, order, tau);
+  return true;
+}
+
+std::int64_t Ephemeris::interval_of(const double time) const {
+  return static_cast<std::int64_t>(std::floor(time / config.interval));
+}
+
+const Ephemeris::Segment *Ephemeris::find(const double time) {
+  if (!std::isfinite(time))
+    return nullptr;
+  const std::int64_t index = interval_of(time);
+  // A time on a boundary also belongs to the interval before.
+  for (const std::int64_t k : {index, index - 1}) {
+    const auto it = segments.find(k);
+    if (it != segments.end() && time >= it->second.begin &&
+        time <= it->second.end) {
+      it->second.last_used = ++use_counter;
+      return &it->second;
+    }
+  }
+  if (time < source_begin || time > source_end)
+    return nullptr;
+  return fit_from_source(index);
+}
+
+// Interpolates at the Chebyshev nodes, which needs no solve: the
+// coefficients are a cosine transform of the samples.
+const Ephemeris::Segment *Ephemeris::fit_from_source(const std::int64_t index) {
+  if (!source)
+    return nullptr;
+  const double begin =
+      std::max(static_cast<double>(index) * config.interval, source_begin);
+  const double end =
+      std::min(static_cast<double>(index + 1) * config.interval, source_end);
+  if (!(end > begin))
+    return nullptr;
+
+  const std::size_t order = config.degree + 1;
+  const auto n = static_cast<double>(order);
+  Segment segment{.begin = begin,
+                  .end = end,
+                  .order = order,
+                  .last_used = 0,
+                  .coefficients = std::vector<double>(3 * bodies * order)};
+  std::vector<double> cosines(order);
+  for (std::size_t j = 0; j < order; ++j) {
+    const double angle =
+        std::numbers::pi * (static_cast<double>(j) + 0.5) / n;
+    const double time = 0.5 * (begin + end) + 0.5 * (end - begin) *
+                                                  std::cos(angle);
+    source(time, source_positions);
+    if (source_positions.size() != bodies)
+      throw std::runtime_error("Ephemeris source returned " +
+                               std::to_string(source_positions.size()) +
+                               " bodies, expected " + std::to_string(bodies));
+    for (std::size_t k = 0; k < order; ++k)
+      cosines[k] = std::cos(static_cast<double>(k) * angle) * 2.0 / n;
+    cosines[0] *= 0.5;
+    for (std::size_t body = 0; body < bodies; ++body) {
+      double *c = segment.coefficients.data() + body * 3 * order;
+      for (int axis = 0; axis < 3; ++axis)
+        for (std::size_t k = 0; k < order; ++k)
+          c[axis * order + k] += cosines[k] * source_positions[body][axis];
+    }
+  }
+  insert(index, std::move(segment));
+  return &segments.at(index);
+}
+
+// Least squares, shared by all series, so the normal matrix is factored
+// once. Integrators' velocities agree with their positions only to about
+// dt^2, so they are fitted too only where the positions are fewer than the
+// coefficients, scaled to the same units by the half interval.
+void Ephemeris::fit_samples(const std::int64_t index) {
+  const std::size_t count = sample_times.size();
+  const bool velocities = count < config.degree + 1;
+  const std::size_t order =
+      std::min(config.degree + 1, velocities ? 2 * count : count);
+  const double begin = static_cast<double>(index) * config.interval;
+  const double half = 0.5 * config.interval;
+  const double velocity_weight = velocities ? half : 0.0;
+
+  std::vector<double> t(count * order), dt(count * order);
+  for (std::size_t i = 0; i < count; ++i) {
+    chebyshev((sample_times[i] - begin - half) / half, order, &t[i * order],
+              &dt[i * order]);
+    if (!velocities)
+      std::fill_n(&dt[i * order], order, 0.0);
+  }
+  std::vector<double> normal(order * order, 0.0);
+  for (std::size_t i = 0; i < count; ++i) {
+    for (std::size_t a = 0; a < order; ++a)
+      for (std::size_t b = 0; b <= a; ++b)
+        normal[a * order + b] += t[i * order + a] * t[i * order + b] +
+                                 dt[i * order + a] * dt[i * order + b];
+  }
+  if (!cholesky(normal, order))
+    return;
+
+  Segment segment{.begin = begin,
+                  .end = begin + config.interval,
+                  .order = order,
+                  .last_used = 0,
+                  .coefficients = std::vector<double>(3 * bodies * order)};
+  // Sample by sample, which reads the states in the order they were stored.
+  for (std::size_t i = 0; i < count; ++i) {
+    const double *sample = sample_values.data() + i * 6 * bodies;
+    const double *ti = &t[i * order];
+    const double *dti = &dt[i * order];
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      for (std::size_t body = 0; body < bodies; ++body) {
+        const double x = sample[axis * bodies + body];
+        const double v =
+            velocity_weight * sample[(axis + 3) * bodies + body];
+        double *c = segment.coefficients.data() + (body * 3 + axis) * order;
+        for (std::size_t k = 0; k < order; ++k)
+          c[k] += ti[k] * x + dti[k] * v;
+      }
+    }
+  }
+  for (std::size_t series = 0; series < 3 * bodies; ++series)
+    cholesky_solve(normal, order,
+                   segment.coefficients.data() + series * order);
+  insert(index, std::move(segment));
+}
+
+// At least the new interval is kept, even if it alone exceeds the budget.
+void Ephemeris::insert(const std::int64_t index, Segment segment) {
+  if (const auto it = segments.find(index); it != segments.end()) {
+    used_bytes -= it->second.coefficients.size() * sizeof(double);
+    segments.erase(it);
+  }
+  const std::size_t bytes = segment.coefficients.size() * sizeof(double);
+  while (!segments.empty() && used_bytes + bytes > config.max_bytes) {
+    const auto oldest = std::min_element(
+        segments.begin(), segments.end(), [](const auto &a, const auto &b) {
+          return a.second.last_used < b.second.last_used;
+        });
+    used_bytes -= oldest->second.coefficients.size() * sizeof(double);
+    segments.erase(oldest);
+    ++evicted;
+  }
+  segment.last_used = ++use_counter;
+  segments.emplace(index, std::move(segment));
+  used_bytes += bytes;
+  ++fitted;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "body_store.h"
+#include "glm/glm.hpp"
+
+struct EphemerisSettings {
+  double interval = 16.0; // days covered by one polynomial
+  std::size_t degree = 12;
+  // Coefficients kept before the least recently used intervals go.
+  std::size_t max_bytes = std::size_t{64} << 20;
+};
+
+// Piecewise Chebyshev series of all body positions, as in the JPL DE files:
+// one polynomial per body and axis on each interval
+// [k * interval, (k + 1) * interval] of simulated time. A lookup finds the
+// interval by division and evaluates one series per axis, so its cost does
+// not depend on how much is cached.
+//
+// Intervals are fitted as states arrive through record(), by least squares
+// on the recorded positions and velocities. Times nothing was recorded for
+// are fitted on first use from a position source, sampled at the Chebyshev
+// nodes of the interval. Used from a single thread.
+class Ephemeris {
+public:
+  // Positions in au of all bodies at a time.
+  using PositionSource =
+      std::function<void(double time, std::vector<glm::dvec3> &positions)>;
+
+  explicit Ephemeris(std::size_t body_count, EphemerisSettings settings = {});
+
+  // Adds the state at time to the open interval and fits it once time
+  // passes its end. States closer than a fraction of the interval to the
+  // previous one are skipped. A time before the previous one starts over,
+  // as after loading a checkpoint. Throws std::runtime_error if state does
+  // not hold body_count() bodies.
+  void record(double time, const BodyStore &state);
+
+  // Fills misses between begin and end from source.
+  void set_source(PositionSource position_source, double begin, double end);
+
+  // Each returns false, leaving the outputs alone, if no interval covers
+  // time and the source cannot provide one.
+  bool position(std::size_t body, double time, glm::dvec3 &position);
+  bool state(std::size_t body, double time, glm::dvec3 &position,
+             glm::dvec3 &velocity);
+  bool positions(double time, std::vector<glm::dvec3> &positions);
+
+  [[nodiscard]] std::size_t body_count() const { return bodies; }
+  [[nodiscard]] const EphemerisSettings &settings() const { return config; }
+  [[nodiscard]] std::size_t interval_count() const { return segments.size(); }
+  [[nodiscard]] std::size_t bytes_used() const { return used_bytes; }
+  [[nodiscard]] std::uint64_t intervals_fitted() const { return fitted; }
+  [[nodiscard]] std::uint64_t intervals_evicted() const { return evicted; }
+
+private:
+  struct Segment {
+    double begin, end;
+    std::size_t order; // coefficients per series
+    std::uint64_t last_used;
+    // order coefficients for x, y and z of body 0, then body 1, ...
+    std::vector<double> coefficients;
+  };
+
+  std::size_t bodies;
+  EphemerisSettings config;
+  std::unordered_map<std::int64_t, Segment> segments;
+  std::size_t used_bytes = 0;
+  std::uint64_t use_counter = 0;
+  std::uint64_t fitted = 0;
+  std::uint64_t evicted = 0;
+
+  // Recorded states of the open interval: for each sample, x, y, z, vx, vy
+  // and vz with one entry per body. The first one is at or before the start
+  // of the interval if recording began before it.
+  std::vector<double> sample_times;
+  std::vector<double> sample_values;
+  std::int64_t open_interval = 0;
+
+  PositionSource source;
+  double source_begin = 0.0, source_end = 0.0;
+  std::vector<glm::dvec3> source_positions;
+
+  [[nodiscard]] std::int64_t interval_of(double time) const;
+  const Segment *find(double time);
+  const Segment *fit_from_source(std::int64_t index);
+  void fit_samples(std::int64_t index);
+  void insert(std::int64_t index, Segment segment);
+};
@@ -74,31 +74,30 @@ std::vector<ObjVertex> FileLoader::load_obj_file(std::string_view path) {
   return vertices;
 }
 
-std::pair<GLuint, GLuint>
-FileLoader::init_shape(const std::span<glm::vec3> vertex_buffer_data,
-                       const std::span<glm::vec3> normal_buffer_data) {
-
-  GLuint vertex_array_id;
-  glGenVertexArrays(1, &vertex_array_id);
-  glBindVertexArray(vertex_array_id);
-
-  GLuint vertex_buffer_id;
-  glGenBuffers(1, &vertex_buffer_id);
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id);
+// The attribute layout is set up here once; drawing only binds the vertex
+// array.
+Shape FileLoader::init_shape(const std::span<glm::vec3> vertex_buffer_data,
+                             const std::span<glm::vec3> normal_buffer_data) {
+  const GLuint vertex_array_id = OpenGLUtils::create_vertex_array();
+
+  const GLuint vertex_buffer_id = OpenGLUtils::create_buffer();
+  OpenGLUtils::bind_buffer(vertex_buffer_id);
   glBufferData(
       GL_ARRAY_BUFFER,
       static_cast<GLsizeiptr>(sizeof(glm::vec3) * vertex_buffer_data.size()),
       vertex_buffer_data.data(), GL_STATIC_DRAW);
+  OpenGLUtils::bind_array_buffer(0, vertex_buffer_id);
 
-  GLuint normal_buffer_id;
-  glGenBuffers(1, &normal_buffer_id);
-  glBindBuffer(GL_ARRAY_BUFFER, normal_buffer_id);
+  const GLuint normal_buffer_id = OpenGLUtils::create_buffer();
+  OpenGLUtils::bind_buffer(normal_buffer_id);
   glBufferData(
       GL_ARRAY_BUFFER,
       static_cast<GLsizeiptr>(sizeof(glm::vec3) * normal_buffer_data.size()),
       normal_buffer_data.data(), GL_STATIC_DRAW);
+  OpenGLUtils::bind_array_buffer(1, normal_buffer_id);
 
-  return {vertex_buffer_id, normal_buffer_id};
+  return {static_cast<GLsizei>(vertex_buffer_data.size()), vertex_array_id,
+          vertex_buffer_id, normal_buffer_id};
 }
 
 Shape FileLoader::load_shape(const std::string &path) {
@@ -110,9 +109,7 @@ Shape FileLoader::load_shape(const std::string &path) {
   std::ranges::transform(vertices, normals.begin(),
                          [](const ObjVertex &v) { return v.normal; });
 
-  auto [vertex_buffer_id, normal_buffer_id] = init_shape(positions, normals);
-  return {static_cast<GLsizei>(vertices.size()), vertex_buffer_id,
-          normal_buffer_id};
+  return init_shape(positions, normals);
 }
 
 void FileLoader::open_shader_file(const std::string &vertex_shader_path,
@@ -29,8 +29,10 @@ struct ObjVertex {
 };
 
 
+// A mesh and its vertex array, with positions at location 0 and normals at 1.
 struct Shape {
     GLsizei number_of_triangles;
+    GLuint vertex_array_id;
     GLuint vertex_buffer_id;
     GLuint normal_buffer_id;
 };
@@ -40,7 +42,7 @@ enum class GLType {
   };
 
 class FileLoader {
-    static std::pair<GLuint, GLuint> init_shape(std::span<glm::vec3> vertex_buffer_data,
+    static Shape init_shape(std::span<glm::vec3> vertex_buffer_data,
                std::span<glm::vec3> normal_buffer_data);
         public:
     static std::vector<ObjVertex> load_obj_file(std::string_view path);
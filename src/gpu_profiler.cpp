@@ -0,0 +1,106 @@
+#include "gpu_profiler.h"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace {
+struct QueryPair {
+    const char* name;
+    GLuint begin = 0;
+    GLuint end = 0;
+};
+
+struct Frame {
+    std::vector<QueryPair> zones;
+    GLuint last = 0; // completes after all others
+};
+
+// Frames whose results have not arrived after this many are dropped.
+constexpr std::size_t MAX_PENDING_FRAMES = 8;
+constexpr std::int64_t CLOCK_SYNC_INTERVAL = 1'000'000'000;
+
+std::vector<GLuint> free_queries;
+Frame current;
+std::deque<Frame> pending;
+std::int64_t clock_offset = 0; // steady clock minus GL clock, ns
+std::int64_t last_sync = 0;
+
+GLuint timestamp() {
+    GLuint query;
+    if (free_queries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = free_queries.back();
+        free_queries.pop_back();
+    }
+    glQueryCounter(query, GL_TIMESTAMP);
+    current.last = query;
+    return query;
+}
+
+void recycle(const Frame& frame) {
+    for (const auto& zone: frame.zones) {
+        free_queries.push_back(zone.begin);
+        if (zone.end != 0) free_queries.push_back(zone.end);
+    }
+}
+
+// The GL clock drifts against the CPU clock, so this is repeated now and then.
+void sync_clocks() {
+    GLint64 gl_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gl_time);
+    last_sync = Profiler::now();
+    clock_offset = last_sync - gl_time;
+}
+}
+
+void GpuProfiler::init() {
+    sync_clocks();
+}
+
+void GpuProfiler::shutdown() {
+    recycle(current);
+    for (const auto& frame: pending) recycle(frame);
+    if (!free_queries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(free_queries.size()), free_queries.data());
+    }
+    free_queries.clear();
+    current = {};
+    pending.clear();
+}
+
+std::size_t GpuProfiler::begin(const char* name) {
+    current.zones.push_back({.name = name, .begin = timestamp()});
+    return current.zones.size() - 1;
+}
+
+void GpuProfiler::end(const std::size_t zone) {
+    current.zones[zone].end = timestamp();
+}
+
+void GpuProfiler::end_frame() {
+    if (!current.zones.empty()) pending.push_back(std::exchange(current, {}));
+
+    while (!pending.empty()) {
+        const auto& frame = pending.front();
+        GLint available = 0;
+        glGetQueryObjectiv(frame.last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && pending.size() <= MAX_PENDING_FRAMES) break;
+        if (available) {
+            for (const auto& zone: frame.zones) {
+                if (zone.end == 0) continue;
+                GLuint64 begin = 0;
+                GLuint64 end = 0;
+                glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+                Profiler::record_gpu(zone.name, static_cast<std::int64_t>(begin) + clock_offset,
+                                     static_cast<std::int64_t>(end) + clock_offset);
+            }
+        }
+        recycle(frame);
+        pending.pop_front();
+    }
+
+    if (Profiler::enabled() && Profiler::now() - last_sync > CLOCK_SYNC_INTERVAL) sync_clocks();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <OpenGL/gl3.h>
+#include <cstddef>
+
+#include "profiler.h"
+
+// GL timestamp queries around render stages. The results are read back once
+// the GPU has caught up, usually two or three frames later, so profiling never
+// waits on the pipeline. Zones are handed to Profiler::record_gpu on the
+// steady clock.
+class GpuProfiler {
+public:
+    // Call with the GL context current.
+    static void init();
+    static void shutdown();
+
+    static std::size_t begin(const char* name);
+    static void end(std::size_t zone);
+    // Closes the frame's queries and records all finished frames.
+    static void end_frame();
+};
+
+class GpuZone {
+    std::size_t zone = 0;
+    bool active;
+
+public:
+    explicit GpuZone(const char* name) : active(Profiler::enabled()) {
+        if (active) zone = GpuProfiler::begin(name);
+    }
+    ~GpuZone() {
+        if (active) GpuProfiler::end(zone);
+    }
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+};
+
+// Times the rest of the enclosing scope on the CPU and on the GPU.
+#ifdef MAG3D_PROFILER
+#define MAG3D_PROFILE_GPU_ZONE(name)                                                                                  \
+    MAG3D_PROFILE_ZONE(name);                                                                                         \
+    const GpuZone MAG3D_PROFILE_CONCAT(gpu_zone_, __LINE__) { name }
+#else
+#define MAG3D_PROFILE_GPU_ZONE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,832 @@
+#include "gravity_kernel.h"
+
+#include <cmath>
+
+#include "aligned_allocator.h"
+#include "x86_simd.h"
+
+namespace {
+
+void accumulate_scalar(const GravitySources &sources,
+                       const GravityTargets &targets, const std::size_t begin,
+                       const std::size_t end, const double g,
+                       const double softening_squared) {
+  for (std::size_t i = begin; i < end; ++i) {
+    const double xi = targets.x[i];
+    const double yi = targets.y[i];
+    const double zi = targets.z[i];
+    double ax = 0.0;
+    double ay = 0.0;
+    double az = 0.0;
+    for (std::size_t j = 0; j < sources.count; ++j) {
+      const double dx = sources.x[j] - xi;
+      const double dy = sources.y[j] - yi;
+      const double dz = sources.z[j] - zi;
+      const double r2 = dx * dx + dy * dy + dz * dz + softening_squared;
+      if (r2 == 0.0)
+        continue;
+      const double s = sources.mass[j] / (r2 * std::sqrt(r2));
+      ax += s * dx;
+      ay += s * dy;
+      az += s * dz;
+    }
+    targets.ax[i] = g * ax;
+    targets.ay[i] = g * ay;
+    targets.az[i] = g * az;
+  }
+}
+
+void tracer_acceleration(const GravitySources &sources, const double x,
+                         const double y, const double z, const double g,
+                         double &ax, double &ay, double &az) {
+  ax = 0.0;
+  ay = 0.0;
+  az = 0.0;
+  for (std::size_t j = 0; j < sources.count; ++j) {
+    const double dx = sources.x[j] - x;
+    const double dy = sources.y[j] - y;
+    const double dz = sources.z[j] - z;
+    const double r2 = dx * dx + dy * dy + dz * dz;
+    if (r2 == 0.0)
+      continue;
+    const double s = g * sources.mass[j] / (r2 * std::sqrt(r2));
+    ax += s * dx;
+    ay += s * dy;
+    az += s * dz;
+  }
+}
+
+void step_tracers_scalar(const GravitySources &sources_before,
+                         const GravitySources &sources_after,
+                         const GravityTracers &tracers,
+                         const std::size_t begin, const std::size_t end,
+                         const double g, const double dt) {
+  const double half_dt = 0.5 * dt;
+  for (std::size_t i = begin; i < end; ++i) {
+    double ax, ay, az;
+    tracer_acceleration(sources_before, tracers.x[i], tracers.y[i],
+                        tracers.z[i], g, ax, ay, az);
+    const double vx = tracers.vx[i] + half_dt * ax;
+    const double vy = tracers.vy[i] + half_dt * ay;
+    const double vz = tracers.vz[i] + half_dt * az;
+    const double x = tracers.x[i] + dt * vx;
+    const double y = tracers.y[i] + dt * vy;
+    const double z = tracers.z[i] + dt * vz;
+    tracer_acceleration(sources_after, x, y, z, g, ax, ay, az);
+    tracers.x[i] = x;
+    tracers.y[i] = y;
+    tracers.z[i] = z;
+    tracers.vx[i] = vx + half_dt * ax;
+    tracers.vy[i] = vy + half_dt * ay;
+    tracers.vz[i] = vz + half_dt * az;
+  }
+}
+
+// The portable reduced precision kernels round exactly like the AVX2 ones
+// below, over LANES independent sums, but compilers do not reliably vectorize
+// the masked sqrt; they keep other ISAs correct rather than fast.
+constexpr std::size_t LANES = 16;
+
+// All sources of a chunk converted to Real once, relative to the chunk's
+// first target, and padded with massless sources to a multiple of LANES.
+template <typename Real> struct LocalSources {
+  AlignedVector<Real> x, y, z, mass;
+};
+
+template <typename Real>
+const LocalSources<Real> &local_sources(const GravitySources &sources,
+                                        const double ox, const double oy,
+                                        const double oz) {
+  thread_local LocalSources<Real> local;
+  const std::size_t padded = (sources.count + LANES - 1) / LANES * LANES;
+  local.x.assign(padded, Real(0));
+  local.y.assign(padded, Real(0));
+  local.z.assign(padded, Real(0));
+  local.mass.assign(padded, Real(0));
+  for (std::size_t j = 0; j < sources.count; ++j) {
+    local.x[j] = static_cast<Real>(sources.x[j] - ox);
+    local.y[j] = static_cast<Real>(sources.y[j] - oy);
+    local.z[j] = static_cast<Real>(sources.z[j] - oz);
+    local.mass[j] = static_cast<Real>(sources.mass[j]);
+  }
+  return local;
+}
+
+// s = m / r^3, or 0 for a pair at zero separation. Both branches are
+// computed so the selection stays a vector blend.
+template <typename Real>
+[[gnu::always_inline]] inline Real inverse_cube(const Real mass,
+                                                const Real r2) {
+  const Real safe = r2 > Real(0) ? r2 : Real(1);
+  return r2 > Real(0) ? mass / (safe * std::sqrt(safe)) : Real(0);
+}
+
+template <typename Real, typename Sum>
+[[gnu::always_inline]] inline void
+accumulate_reduced(const GravitySources &sources,
+                   const GravityTargets &targets, const std::size_t begin,
+                   const std::size_t end, const double g,
+                   const double softening_squared) {
+  if (begin >= end)
+    return;
+  const double ox = targets.x[begin];
+  const double oy = targets.y[begin];
+  const double oz = targets.z[begin];
+  const auto &local = local_sources<Real>(sources, ox, oy, oz);
+  const Real *sx = local.x.data();
+  const Real *sy = local.y.data();
+  const Real *sz = local.z.data();
+  const Real *sm = local.mass.data();
+  const std::size_t padded = local.x.size();
+  const auto eps2 = static_cast<Real>(softening_squared);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const auto xi = static_cast<Real>(targets.x[i] - ox);
+    const auto yi = static_cast<Real>(targets.y[i] - oy);
+    const auto zi = static_cast<Real>(targets.z[i] - oz);
+    Sum ax[LANES] = {};
+    Sum ay[LANES] = {};
+    Sum az[LANES] = {};
+    for (std::size_t j = 0; j < padded; j += LANES) {
+      for (std::size_t l = 0; l < LANES; ++l) {
+        const Real dx = sx[j + l] - xi;
+        const Real dy = sy[j + l] - yi;
+        const Real dz = sz[j + l] - zi;
+        const Real r2 = dx * dx + dy * dy + dz * dz + eps2;
+        const Real s = inverse_cube(sm[j + l], r2);
+        ax[l] += static_cast<Sum>(s * dx);
+        ay[l] += static_cast<Sum>(s * dy);
+        az[l] += static_cast<Sum>(s * dz);
+      }
+    }
+    Sum sum_x = 0;
+    Sum sum_y = 0;
+    Sum sum_z = 0;
+    for (std::size_t l = 0; l < LANES; ++l) {
+      sum_x += ax[l];
+      sum_y += ay[l];
+      sum_z += az[l];
+    }
+    targets.ax[i] = g * static_cast<double>(sum_x);
+    targets.ay[i] = g * static_cast<double>(sum_y);
+    targets.az[i] = g * static_cast<double>(sum_z);
+  }
+}
+
+// Accelerations of LANES tracers, without the factor g. The separations are
+// taken in double before rounding, so tracers far from the Sun lose nothing.
+template <typename Real, typename Sum>
+[[gnu::always_inline]] inline void
+tracer_accelerations(const GravitySources &sources, const double *x,
+                     const double *y, const double *z, Sum *ax, Sum *ay,
+                     Sum *az) {
+  for (std::size_t l = 0; l < LANES; ++l) {
+    ax[l] = 0;
+    ay[l] = 0;
+    az[l] = 0;
+  }
+  for (std::size_t j = 0; j < sources.count; ++j) {
+    const double sx = sources.x[j];
+    const double sy = sources.y[j];
+    const double sz = sources.z[j];
+    const auto mass = static_cast<Real>(sources.mass[j]);
+    for (std::size_t l = 0; l < LANES; ++l) {
+      const auto dx = static_cast<Real>(sx - x[l]);
+      const auto dy = static_cast<Real>(sy - y[l]);
+      const auto dz = static_cast<Real>(sz - z[l]);
+      const Real s = inverse_cube(mass, dx * dx + dy * dy + dz * dz);
+      ax[l] += static_cast<Sum>(s * dx);
+      ay[l] += static_cast<Sum>(s * dy);
+      az[l] += static_cast<Sum>(s * dz);
+    }
+  }
+}
+
+template <typename Real, typename Sum>
+[[gnu::always_inline]] inline void
+step_tracers_reduced(const GravitySources &sources_before,
+                     const GravitySources &sources_after,
+                     const GravityTracers &tracers, const std::size_t begin,
+                     const std::size_t end, const double g, const double dt) {
+  const std::size_t vector_end = begin + (end - begin) / LANES * LANES;
+  const double kick = 0.5 * dt * g;
+  double x[LANES], y[LANES], z[LANES];
+  double vx[LANES], vy[LANES], vz[LANES];
+  Sum ax[LANES], ay[LANES], az[LANES];
+
+  for (std::size_t i = begin; i < vector_end; i += LANES) {
+    tracer_accelerations<Real>(sources_before, tracers.x + i, tracers.y + i,
+                               tracers.z + i, ax, ay, az);
+    for (std::size_t l = 0; l < LANES; ++l) {
+      vx[l] = tracers.vx[i + l] + kick * static_cast<double>(ax[l]);
+      vy[l] = tracers.vy[i + l] + kick * static_cast<double>(ay[l]);
+      vz[l] = tracers.vz[i + l] + kick * static_cast<double>(az[l]);
+      x[l] = tracers.x[i + l] + dt * vx[l];
+      y[l] = tracers.y[i + l] + dt * vy[l];
+      z[l] = tracers.z[i + l] + dt * vz[l];
+    }
+    tracer_accelerations<Real>(sources_after, x, y, z, ax, ay, az);
+    for (std::size_t l = 0; l < LANES; ++l) {
+      tracers.x[i + l] = x[l];
+      tracers.y[i + l] = y[l];
+      tracers.z[i + l] = z[l];
+      tracers.vx[i + l] = vx[l] + kick * static_cast<double>(ax[l]);
+      tracers.vy[i + l] = vy[l] + kick * static_cast<double>(ay[l]);
+      tracers.vz[i + l] = vz[l] + kick * static_cast<double>(az[l]);
+    }
+  }
+  step_tracers_scalar(sources_before, sources_after, tracers, vector_end, end,
+                      g, dt);
+}
+
+// Baseline instantiations: SSE2 on x86-64, NEON on arm64.
+void accumulate_mixed(const GravitySources &sources,
+                      const GravityTargets &targets, const std::size_t begin,
+                      const std::size_t end, const double g,
+                      const double softening_squared) {
+  accumulate_reduced<float, double>(sources, targets, begin, end, g,
+                                    softening_squared);
+}
+
+void accumulate_float(const GravitySources &sources,
+                      const GravityTargets &targets, const std::size_t begin,
+                      const std::size_t end, const double g,
+                      const double softening_squared) {
+  accumulate_reduced<float, float>(sources, targets, begin, end, g,
+                                   softening_squared);
+}
+
+void step_tracers_mixed(const GravitySources &sources_before,
+                        const GravitySources &sources_after,
+                        const GravityTracers &tracers,
+                        const std::size_t begin, const std::size_t end,
+                        const double g, const double dt) {
+  step_tracers_reduced<float, double>(sources_before, sources_after, tracers,
+                                      begin, end, g, dt);
+}
+
+void step_tracers_float(const GravitySources &sources_before,
+                        const GravitySources &sources_after,
+                        const GravityTracers &tracers,
+                        const std::size_t begin, const std::size_t end,
+                        const double g, const double dt) {
+  step_tracers_reduced<float, float>(sources_before, sources_after, tracers,
+                                     begin, end, g, dt);
+}
+
+#ifdef MAG3D_X86_KERNELS
+
+double horizontal_sum(const __m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+void accumulate_sse2(const GravitySources &sources,
+                     const GravityTargets &targets, const std::size_t begin,
+                     const std::size_t end, const double g,
+                     const double softening_squared) {
+  const std::size_t vector_end = sources.count & ~std::size_t{1};
+  const __m128d eps2 = _mm_set1_pd(softening_squared);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d one = _mm_set1_pd(1.0);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const __m128d xi = _mm_set1_pd(targets.x[i]);
+    const __m128d yi = _mm_set1_pd(targets.y[i]);
+    const __m128d zi = _mm_set1_pd(targets.z[i]);
+    __m128d ax = zero;
+    __m128d ay = zero;
+    __m128d az = zero;
+    for (std::size_t j = 0; j < vector_end; j += 2) {
+      const __m128d dx = _mm_sub_pd(_mm_loadu_pd(sources.x + j), xi);
+      const __m128d dy = _mm_sub_pd(_mm_loadu_pd(sources.y + j), yi);
+      const __m128d dz = _mm_sub_pd(_mm_loadu_pd(sources.z + j), zi);
+      __m128d r2 = _mm_add_pd(_mm_mul_pd(dx, dx), eps2);
+      r2 = _mm_add_pd(r2, _mm_mul_pd(dy, dy));
+      r2 = _mm_add_pd(r2, _mm_mul_pd(dz, dz));
+      const __m128d nonzero = _mm_cmpneq_pd(r2, zero);
+      const __m128d denominator = _mm_mul_pd(r2, _mm_sqrt_pd(r2));
+      const __m128d inv = _mm_and_pd(_mm_div_pd(one, denominator), nonzero);
+      const __m128d s = _mm_mul_pd(_mm_loadu_pd(sources.mass + j), inv);
+      ax = _mm_add_pd(ax, _mm_mul_pd(s, dx));
+      ay = _mm_add_pd(ay, _mm_mul_pd(s, dy));
+      az = _mm_add_pd(az, _mm_mul_pd(s, dz));
+    }
+    double sx = horizontal_sum(ax);
+    double sy = horizontal_sum(ay);
+    double sz = horizontal_sum(az);
+    for (std::size_t j = vector_end; j < sources.count; ++j) {
+      const double dx = sources.x[j] - targets.x[i];
+      const double dy = sources.y[j] - targets.y[i];
+      const double dz = sources.z[j] - targets.z[i];
+      const double r2 = dx * dx + dy * dy + dz * dz + softening_squared;
+      if (r2 == 0.0)
+        continue;
+      const double s = sources.mass[j] / (r2 * std::sqrt(r2));
+      sx += s * dx;
+      sy += s * dy;
+      sz += s * dz;
+    }
+    targets.ax[i] = g * sx;
+    targets.ay[i] = g * sy;
+    targets.az[i] = g * sz;
+  }
+}
+
+__attribute__((target("avx2,fma"))) double horizontal_sum(const __m256d v) {
+  const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v),
+                                 _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+__attribute__((target("avx2,fma"))) void
+accumulate_avx2(const GravitySources &sources, const GravityTargets &targets,
+                const std::size_t begin, const std::size_t end, const double g,
+                const double softening_squared) {
+  const std::size_t vector_end = sources.count & ~std::size_t{3};
+  const __m256d eps2 = _mm256_set1_pd(softening_squared);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d three_halves = _mm256_set1_pd(1.5);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const __m256d xi = _mm256_set1_pd(targets.x[i]);
+    const __m256d yi = _mm256_set1_pd(targets.y[i]);
+    const __m256d zi = _mm256_set1_pd(targets.z[i]);
+    __m256d ax = zero;
+    __m256d ay = zero;
+    __m256d az = zero;
+    for (std::size_t j = 0; j < vector_end; j += 4) {
+      const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(sources.x + j), xi);
+      const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(sources.y + j), yi);
+      const __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(sources.z + j), zi);
+      __m256d r2 = _mm256_fmadd_pd(dx, dx, eps2);
+      r2 = _mm256_fmadd_pd(dy, dy, r2);
+      r2 = _mm256_fmadd_pd(dz, dz, r2);
+      const __m256d nonzero = _mm256_cmp_pd(r2, zero, _CMP_NEQ_OQ);
+      const __m256d inv_r = rsqrt(r2, half, three_halves);
+      const __m256d inv_r3 =
+          _mm256_and_pd(_mm256_mul_pd(inv_r, _mm256_mul_pd(inv_r, inv_r)),
+                        nonzero);
+      const __m256d s =
+          _mm256_mul_pd(_mm256_loadu_pd(sources.mass + j), inv_r3);
+      ax = _mm256_fmadd_pd(s, dx, ax);
+      ay = _mm256_fmadd_pd(s, dy, ay);
+      az = _mm256_fmadd_pd(s, dz, az);
+    }
+    double sx = horizontal_sum(ax);
+    double sy = horizontal_sum(ay);
+    double sz = horizontal_sum(az);
+    for (std::size_t j = vector_end; j < sources.count; ++j) {
+      const double dx = sources.x[j] - targets.x[i];
+      const double dy = sources.y[j] - targets.y[i];
+      const double dz = sources.z[j] - targets.z[i];
+      const double r2 = dx * dx + dy * dy + dz * dz + softening_squared;
+      if (r2 == 0.0)
+        continue;
+      const double s = sources.mass[j] / (r2 * std::sqrt(r2));
+      sx += s * dx;
+      sy += s * dy;
+      sz += s * dz;
+    }
+    targets.ax[i] = g * sx;
+    targets.ay[i] = g * sy;
+    targets.az[i] = g * sz;
+  }
+}
+
+// Four tracers per vector against one broadcast source at a time.
+__attribute__((target("avx2,fma"))) void
+tracer_acceleration_avx2(const GravitySources &sources, const __m256d &x,
+                         const __m256d &y, const __m256d &z, __m256d &ax,
+                         __m256d &ay, __m256d &az) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d three_halves = _mm256_set1_pd(1.5);
+  ax = zero;
+  ay = zero;
+  az = zero;
+  for (std::size_t j = 0; j < sources.count; ++j) {
+    const __m256d dx = _mm256_sub_pd(_mm256_set1_pd(sources.x[j]), x);
+    const __m256d dy = _mm256_sub_pd(_mm256_set1_pd(sources.y[j]), y);
+    const __m256d dz = _mm256_sub_pd(_mm256_set1_pd(sources.z[j]), z);
+    __m256d r2 = _mm256_mul_pd(dx, dx);
+    r2 = _mm256_fmadd_pd(dy, dy, r2);
+    r2 = _mm256_fmadd_pd(dz, dz, r2);
+    const __m256d nonzero = _mm256_cmp_pd(r2, zero, _CMP_NEQ_OQ);
+    const __m256d inv_r = rsqrt(r2, half, three_halves);
+    const __m256d inv_r3 = _mm256_and_pd(
+        _mm256_mul_pd(inv_r, _mm256_mul_pd(inv_r, inv_r)), nonzero);
+    const __m256d s = _mm256_mul_pd(_mm256_set1_pd(sources.mass[j]), inv_r3);
+    ax = _mm256_fmadd_pd(s, dx, ax);
+    ay = _mm256_fmadd_pd(s, dy, ay);
+    az = _mm256_fmadd_pd(s, dz, az);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void
+step_tracers_avx2(const GravitySources &sources_before,
+                  const GravitySources &sources_after,
+                  const GravityTracers &tracers, const std::size_t begin,
+                  const std::size_t end, const double g, const double dt) {
+  const std::size_t vector_end = begin + ((end - begin) & ~std::size_t{3});
+  const __m256d kick = _mm256_set1_pd(0.5 * dt * g);
+  const __m256d drift = _mm256_set1_pd(dt);
+  __m256d ax, ay, az;
+
+  for (std::size_t i = begin; i < vector_end; i += 4) {
+    __m256d x = _mm256_loadu_pd(tracers.x + i);
+    __m256d y = _mm256_loadu_pd(tracers.y + i);
+    __m256d z = _mm256_loadu_pd(tracers.z + i);
+    tracer_acceleration_avx2(sources_before, x, y, z, ax, ay, az);
+    __m256d vx = _mm256_fmadd_pd(kick, ax, _mm256_loadu_pd(tracers.vx + i));
+    __m256d vy = _mm256_fmadd_pd(kick, ay, _mm256_loadu_pd(tracers.vy + i));
+    __m256d vz = _mm256_fmadd_pd(kick, az, _mm256_loadu_pd(tracers.vz + i));
+    x = _mm256_fmadd_pd(drift, vx, x);
+    y = _mm256_fmadd_pd(drift, vy, y);
+    z = _mm256_fmadd_pd(drift, vz, z);
+    tracer_acceleration_avx2(sources_after, x, y, z, ax, ay, az);
+    vx = _mm256_fmadd_pd(kick, ax, vx);
+    vy = _mm256_fmadd_pd(kick, ay, vy);
+    vz = _mm256_fmadd_pd(kick, az, vz);
+    _mm256_storeu_pd(tracers.x + i, x);
+    _mm256_storeu_pd(tracers.y + i, y);
+    _mm256_storeu_pd(tracers.z + i, z);
+    _mm256_storeu_pd(tracers.vx + i, vx);
+    _mm256_storeu_pd(tracers.vy + i, vy);
+    _mm256_storeu_pd(tracers.vz + i, vz);
+  }
+  step_tracers_scalar(sources_before, sources_after, tracers, vector_end, end,
+                      g, dt);
+}
+
+// Running sums of eight float terms per component, kept in float or widened
+// to two double vectors.
+struct FloatSums {
+  __m256 x, y, z;
+
+  __attribute__((target("avx2,fma"))) void clear() {
+    x = y = z = _mm256_setzero_ps();
+  }
+  __attribute__((target("avx2,fma"))) void add(const __m256 s, const __m256 dx,
+                                               const __m256 dy,
+                                               const __m256 dz) {
+    x = _mm256_fmadd_ps(s, dx, x);
+    y = _mm256_fmadd_ps(s, dy, y);
+    z = _mm256_fmadd_ps(s, dz, z);
+  }
+  // Lanes 0-3 or 4-7 of a component.
+  __attribute__((target("avx2,fma"))) static __m256d half(const __m256 v,
+                                                          const int upper) {
+    return _mm256_cvtps_pd(upper ? _mm256_extractf128_ps(v, 1)
+                                 : _mm256_castps256_ps128(v));
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_x(const int upper) const {
+    return half(x, upper);
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_y(const int upper) const {
+    return half(y, upper);
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_z(const int upper) const {
+    return half(z, upper);
+  }
+};
+
+struct MixedSums {
+  __m256d x[2], y[2], z[2];
+
+  __attribute__((target("avx2,fma"))) void clear() {
+    for (int h = 0; h < 2; ++h)
+      x[h] = y[h] = z[h] = _mm256_setzero_pd();
+  }
+  __attribute__((target("avx2,fma"))) void add(const __m256 s, const __m256 dx,
+                                               const __m256 dy,
+                                               const __m256 dz) {
+    widen_add(x, _mm256_mul_ps(s, dx));
+    widen_add(y, _mm256_mul_ps(s, dy));
+    widen_add(z, _mm256_mul_ps(s, dz));
+  }
+  __attribute__((target("avx2,fma"))) static void widen_add(__m256d *sum,
+                                                            const __m256 t) {
+    const __m128 lower = _mm256_castps256_ps128(t);
+    const __m128 upper = _mm256_extractf128_ps(t, 1);
+    sum[0] = _mm256_add_pd(sum[0], _mm256_cvtps_pd(lower));
+    sum[1] = _mm256_add_pd(sum[1], _mm256_cvtps_pd(upper));
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_x(const int upper) const {
+    return x[upper];
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_y(const int upper) const {
+    return y[upper];
+  }
+  __attribute__((target("avx2,fma"))) __m256d half_z(const int upper) const {
+    return z[upper];
+  }
+};
+
+// Eight sources per vector, converted once per chunk as in the portable
+// kernel. The padding sources are massless.
+template <typename Sums>
+__attribute__((target("avx2,fma"))) void
+accumulate_reduced_avx2(const GravitySources &sources,
+                        const GravityTargets &targets, const std::size_t begin,
+                        const std::size_t end, const double g,
+                        const double softening_squared) {
+  if (begin >= end)
+    return;
+  const double ox = targets.x[begin];
+  const double oy = targets.y[begin];
+  const double oz = targets.z[begin];
+  const auto &local = local_sources<float>(sources, ox, oy, oz);
+  const std::size_t padded = local.x.size();
+  const __m256 eps2 = _mm256_set1_ps(static_cast<float>(softening_squared));
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 three_halves = _mm256_set1_ps(1.5f);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const __m256 xi = _mm256_set1_ps(static_cast<float>(targets.x[i] - ox));
+    const __m256 yi = _mm256_set1_ps(static_cast<float>(targets.y[i] - oy));
+    const __m256 zi = _mm256_set1_ps(static_cast<float>(targets.z[i] - oz));
+    Sums sums;
+    sums.clear();
+    for (std::size_t j = 0; j < padded; j += 8) {
+      const __m256 dx = _mm256_sub_ps(_mm256_load_ps(&local.x[j]), xi);
+      const __m256 dy = _mm256_sub_ps(_mm256_load_ps(&local.y[j]), yi);
+      const __m256 dz = _mm256_sub_ps(_mm256_load_ps(&local.z[j]), zi);
+      __m256 r2 = _mm256_fmadd_ps(dx, dx, eps2);
+      r2 = _mm256_fmadd_ps(dy, dy, r2);
+      r2 = _mm256_fmadd_ps(dz, dz, r2);
+      const __m256 nonzero = _mm256_cmp_ps(r2, zero, _CMP_NEQ_OQ);
+      const __m256 inv_r = rsqrt(r2, half, three_halves);
+      const __m256 inv_r3 = _mm256_and_ps(
+          _mm256_mul_ps(inv_r, _mm256_mul_ps(inv_r, inv_r)), nonzero);
+      const __m256 s = _mm256_mul_ps(_mm256_load_ps(&local.mass[j]), inv_r3);
+      sums.add(s, dx, dy, dz);
+    }
+    targets.ax[i] = g * horizontal_sum(_mm256_add_pd(sums.half_x(0),
+                                                     sums.half_x(1)));
+    targets.ay[i] = g * horizontal_sum(_mm256_add_pd(sums.half_y(0),
+                                                     sums.half_y(1)));
+    targets.az[i] = g * horizontal_sum(_mm256_add_pd(sums.half_z(0),
+                                                     sums.half_z(1)));
+  }
+}
+
+// Rounds four double separations of each half to one float vector.
+__attribute__((target("avx2,fma"))) __m256 separation(const double source,
+                                                      const __m256d *tracer) {
+  const __m256d s = _mm256_set1_pd(source);
+  return _mm256_set_m128(_mm256_cvtpd_ps(_mm256_sub_pd(s, tracer[1])),
+                         _mm256_cvtpd_ps(_mm256_sub_pd(s, tracer[0])));
+}
+
+// Eight tracers per vector, without the factor g. As in the portable kernel
+// the separations are taken in double before rounding.
+template <typename Sums>
+__attribute__((target("avx2,fma"))) void
+tracer_accelerations_avx2(const GravitySources &sources, const __m256d *x,
+                          const __m256d *y, const __m256d *z, Sums &sums) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 three_halves = _mm256_set1_ps(1.5f);
+  sums.clear();
+  for (std::size_t j = 0; j < sources.count; ++j) {
+    const __m256 dx = separation(sources.x[j], x);
+    const __m256 dy = separation(sources.y[j], y);
+    const __m256 dz = separation(sources.z[j], z);
+    __m256 r2 = _mm256_mul_ps(dx, dx);
+    r2 = _mm256_fmadd_ps(dy, dy, r2);
+    r2 = _mm256_fmadd_ps(dz, dz, r2);
+    const __m256 nonzero = _mm256_cmp_ps(r2, zero, _CMP_NEQ_OQ);
+    const __m256 inv_r = rsqrt(r2, half, three_halves);
+    const __m256 inv_r3 = _mm256_and_ps(
+        _mm256_mul_ps(inv_r, _mm256_mul_ps(inv_r, inv_r)), nonzero);
+    const __m256 s = _mm256_mul_ps(
+        _mm256_set1_ps(static_cast<float>(sources.mass[j])), inv_r3);
+    sums.add(s, dx, dy, dz);
+  }
+}
+
+template <typename Sums>
+__attribute__((target("avx2,fma"))) void
+step_tracers_reduced_avx2(const GravitySources &sources_before,
+                          const GravitySources &sources_after,
+                          const GravityTracers &tracers,
+                          const std::size_t begin, const std::size_t end,
+                          const double g, const double dt) {
+  const std::size_t vector_end = begin + ((end - begin) & ~std::size_t{7});
+  const __m256d kick = _mm256_set1_pd(0.5 * dt * g);
+  const __m256d drift = _mm256_set1_pd(dt);
+  __m256d x[2], y[2], z[2], vx[2], vy[2], vz[2];
+  Sums sums;
+
+  for (std::size_t i = begin; i < vector_end; i += 8) {
+    for (int h = 0; h < 2; ++h) {
+      x[h] = _mm256_loadu_pd(tracers.x + i + 4 * h);
+      y[h] = _mm256_loadu_pd(tracers.y + i + 4 * h);
+      z[h] = _mm256_loadu_pd(tracers.z + i + 4 * h);
+    }
+    tracer_accelerations_avx2(sources_before, x, y, z, sums);
+    for (int h = 0; h < 2; ++h) {
+      vx[h] = _mm256_fmadd_pd(kick, sums.half_x(h),
+                              _mm256_loadu_pd(tracers.vx + i + 4 * h));
+      vy[h] = _mm256_fmadd_pd(kick, sums.half_y(h),
+                              _mm256_loadu_pd(tracers.vy + i + 4 * h));
+      vz[h] = _mm256_fmadd_pd(kick, sums.half_z(h),
+                              _mm256_loadu_pd(tracers.vz + i + 4 * h));
+      x[h] = _mm256_fmadd_pd(drift, vx[h], x[h]);
+      y[h] = _mm256_fmadd_pd(drift, vy[h], y[h]);
+      z[h] = _mm256_fmadd_pd(drift, vz[h], z[h]);
+    }
+    tracer_accelerations_avx2(sources_after, x, y, z, sums);
+    for (int h = 0; h < 2; ++h) {
+      _mm256_storeu_pd(tracers.x + i + 4 * h, x[h]);
+      _mm256_storeu_pd(tracers.y + i + 4 * h, y[h]);
+      _mm256_storeu_pd(tracers.z + i + 4 * h, z[h]);
+      _mm256_storeu_pd(tracers.vx + i + 4 * h,
+                       _mm256_fmadd_pd(kick, sums.half_x(h), vx[h]));
+      _mm256_storeu_pd(tracers.vy + i + 4 * h,
+                       _mm256_fmadd_pd(kick, sums.half_y(h), vy[h]));
+      _mm256_storeu_pd(tracers.vz + i + 4 * h,
+                       _mm256_fmadd_pd(kick, sums.half_z(h), vz[h]));
+    }
+  }
+  step_tracers_scalar(sources_before, sources_after, tracers, vector_end, end,
+                      g, dt);
+}
+
+__attribute__((target("avx2,fma"))) void
+accumulate_mixed_avx2(const GravitySources &sources,
+                      const GravityTargets &targets, const std::size_t begin,
+                      const std::size_t end, const double g,
+                      const double softening_squared) {
+  accumulate_reduced_avx2<MixedSums>(sources, targets, begin, end, g,
+                                     softening_squared);
+}
+
+__attribute__((target("avx2,fma"))) void
+accumulate_float_avx2(const GravitySources &sources,
+                      const GravityTargets &targets, const std::size_t begin,
+                      const std::size_t end, const double g,
+                      const double softening_squared) {
+  accumulate_reduced_avx2<FloatSums>(sources, targets, begin, end, g,
+                                     softening_squared);
+}
+
+__attribute__((target("avx2,fma"))) void
+step_tracers_mixed_avx2(const GravitySources &sources_before,
+                        const GravitySources &sources_after,
+                        const GravityTracers &tracers,
+                        const std::size_t begin, const std::size_t end,
+                        const double g, const double dt) {
+  step_tracers_reduced_avx2<MixedSums>(sources_before, sources_after, tracers,
+                                       begin, end, g, dt);
+}
+
+__attribute__((target("avx2,fma"))) void
+step_tracers_float_avx2(const GravitySources &sources_before,
+                        const GravitySources &sources_after,
+                        const GravityTracers &tracers,
+                        const std::size_t begin, const std::size_t end,
+                        const double g, const double dt) {
+  step_tracers_reduced_avx2<FloatSums>(sources_before, sources_after, tracers,
+                                       begin, end, g, dt);
+}
+
+#endif
+
+} // namespace
+
+KernelIsa GravityKernel::detect_isa() {
+#ifdef MAG3D_X86_KERNELS
+  static const KernelIsa isa = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return KernelIsa::AVX2;
+    return KernelIsa::SSE2;
+  }();
+  return isa;
+#else
+  return KernelIsa::SCALAR;
+#endif
+}
+
+GravityKernelFn GravityKernel::get(const KernelIsa isa,
+                                   const Precision precision) {
+  switch (precision) {
+  case Precision::MIXED:
+#ifdef MAG3D_X86_KERNELS
+    if (isa == KernelIsa::AVX2)
+      return accumulate_mixed_avx2;
+#endif
+    return accumulate_mixed;
+  case Precision::FLOAT:
+#ifdef MAG3D_X86_KERNELS
+    if (isa == KernelIsa::AVX2)
+      return accumulate_float_avx2;
+#endif
+    return accumulate_float;
+  default:
+    break;
+  }
+  switch (isa) {
+#ifdef MAG3D_X86_KERNELS
+  case KernelIsa::AVX2:
+    return accumulate_avx2;
+  case KernelIsa::SSE2:
+    return accumulate_sse2;
+#endif
+  default:
+    return accumulate_scalar;
+  }
+}
+
+// SSE2 falls back to the scalar tracer kernel in double precision.
+TracerKernelFn GravityKernel::get_tracer(const KernelIsa isa,
+                                         const Precision precision) {
+  switch (precision) {
+  case Precision::MIXED:
+#ifdef MAG3D_X86_KERNELS
+    if (isa == KernelIsa::AVX2)
+      return step_tracers_mixed_avx2;
+#endif
+    return step_tracers_mixed;
+  case Precision::FLOAT:
+#ifdef MAG3D_X86_KERNELS
+    if (isa == KernelIsa::AVX2)
+      return step_tracers_float_avx2;
+#endif
+    return step_tracers_float;
+  default:
+    break;
+  }
+  switch (isa) {
+#ifdef MAG3D_X86_KERNELS
+  case KernelIsa::AVX2:
+    return step_tracers_avx2;
+#endif
+  default:
+    return step_tracers_scalar;
+  }
+}
+
+const char *GravityKernel::isa_name(const KernelIsa isa) {
+  switch (isa) {
+  case KernelIsa::AVX2:
+    return "avx2";
+  case KernelIsa::SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+const char *GravityKernel::precision_name(const Precision precision) {
+  switch (precision) {
+  case Precision::MIXED:
+    return "mixed";
+  case Precision::FLOAT:
+    return "float";
+  default:
+    return "double";
+  }
+}
+
+std::optional<Precision>
+GravityKernel::parse_precision(const std::string_view name) {
+  if (name == "double")
+    return Precision::DOUBLE;
+  if (name == "mixed")
+    return Precision::MIXED;
+  if (name == "float")
+    return Precision::FLOAT;
+  return std::nullopt;
+}
+
+GravitySources GravityKernel::sources_of(const BodyStore &store) {
+  return {.x = store.x.data(),
+          .y = store.y.data(),
+          .z = store.z.data(),
+          .mass = store.mass.data(),
+          .count = store.size()};
+}
+
+GravityTargets GravityKernel::targets_of(BodyStore &store) {
+  return {.x = store.x.data(),
+          .y = store.y.data(),
+          .z = store.z.data(),
+          .ax = store.ax.data(),
+          .ay = store.ay.data(),
+          .az = store.az.data(),
+          .count = store.size()};
+}
+
+GravityTracers GravityKernel::tracers_of(TracerStore &store) {
+  return {.x = store.x.data(),
+          .y = store.y.data(),
+          .z = store.z.data(),
+          .vx = store.vx.data(),
+          .vy = store.vy.data(),
+          .vz = store.vz.data(),
+          .count = store.size()};
+}
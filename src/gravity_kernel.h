@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "body_store.h"
+#include "tracer_store.h"
+
+// Bodies that attract. Masses may be zero.
+struct GravitySources {
+  const double *x;
+  const double *y;
+  const double *z;
+  const double *mass;
+  std::size_t count;
+};
+
+// Points the acceleration is evaluated at. The kernels overwrite ax/ay/az.
+struct GravityTargets {
+  const double *x;
+  const double *y;
+  const double *z;
+  double *ax;
+  double *ay;
+  double *az;
+  std::size_t count;
+};
+
+// Massless particles advanced in place by the tracer kernels.
+struct GravityTracers {
+  double *x;
+  double *y;
+  double *z;
+  double *vx;
+  double *vy;
+  double *vz;
+  std::size_t count;
+};
+
+enum class KernelIsa { SCALAR, SSE2, AVX2 };
+
+// Arithmetic of the direct-summation and tracer kernels. Positions and
+// velocities are always integrated in double; FLOAT and MIXED evaluate the
+// separations and 1/r^3 in float, twice as many per vector, and sum the
+// accelerations in float or double. Each pair of precision and ISA is its
+// own instantiation of one kernel template.
+enum class Precision { DOUBLE, MIXED, FLOAT };
+
+// Computes a_i = g * sum_j m_j * r_ij / (|r_ij|^2 + softening_squared)^(3/2)
+// for targets [begin, end). Source/target pairs at zero separation are
+// skipped, so a store can be passed as both sources and targets.
+using GravityKernelFn = void (*)(const GravitySources &sources,
+                                 const GravityTargets &targets,
+                                 std::size_t begin, std::size_t end, double g,
+                                 double softening_squared);
+
+// One kick-drift-kick step of length dt for tracers [begin, end). The first
+// kick uses the sources at the start of the step, the second those at the
+// end. Vectorized across tracers, since there are few sources.
+using TracerKernelFn = void (*)(const GravitySources &sources_before,
+                                const GravitySources &sources_after,
+                                const GravityTracers &tracers,
+                                std::size_t begin, std::size_t end, double g,
+                                double dt);
+
+class GravityKernel {
+public:
+  static KernelIsa detect_isa();
+  static GravityKernelFn get(KernelIsa isa,
+                             Precision precision = Precision::DOUBLE);
+  static TracerKernelFn get_tracer(KernelIsa isa,
+                                   Precision precision = Precision::DOUBLE);
+  static GravityKernelFn best() { return get(detect_isa()); }
+  static const char *isa_name(KernelIsa isa);
+  static const char *precision_name(Precision precision);
+  // "double", "mixed" or "float".
+  static std::optional<Precision> parse_precision(std::string_view name);
+
+  static GravitySources sources_of(const BodyStore &store);
+  static GravityTargets targets_of(BodyStore &store);
+  static GravityTracers tracers_of(TracerStore &store);
+};
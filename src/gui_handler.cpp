@@ -12,6 +12,12 @@
 #include "imgui_impl_sdl2.h"
 #include <SDL_opengl.h>
 
+#include "checkpoint.h"
+#include "gpu_profiler.h"
+#include "opengl_utils.h"
+#include "profiler.h"
+#include "scenario.h"
+#include "simulation_thread.h"
 #include "solar_system_calculator.h"
 #include "solar_system_graphics.h"
 
@@ -81,6 +87,8 @@ void GuiHandler::init() {
   glEnable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS);
+  GpuProfiler::init();
+  Profiler::set_thread_name("main");
 
   int drawableWidth, drawableHeight;
   SDL_GL_GetDrawableSize(window, &drawableWidth, &drawableHeight);
@@ -89,6 +97,7 @@ void GuiHandler::init() {
 }
 
 void GuiHandler::shutdown() const {
+  GpuProfiler::shutdown();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
@@ -133,14 +142,23 @@ void GuiHandler::start_imgui_frame() {
 void GuiHandler::start_main_loop() {
 
   SolarSystemCalculator solar_system_calculator;
-  solar_system_calculator.init();
+  if (restore_path) {
+    Checkpoint::load(*restore_path, solar_system_calculator);
+  } else if (scenario_path) {
+    Scenario::load(*scenario_path, solar_system_calculator);
+  } else {
+    solar_system_calculator.init();
+  }
+  SimulationThread simulation(solar_system_calculator, 240.0,
+                              restore_path.value_or("mag3d.ckpt"));
 
-  SolarSystemGraphics solar_system_graphics(solar_system_calculator, camera);
+  SolarSystemGraphics solar_system_graphics(simulation, camera);
   int drawableWidth, drawableHeight;
   SDL_GL_GetDrawableSize(window, &drawableWidth, &drawableHeight);
   solar_system_graphics.init(drawableWidth, drawableHeight);
 
-  double delta_time_seconds = 0.0;
+  simulation.start();
+
   now_time = SDL_GetPerformanceCounter();
   last_time = now_time;
 
@@ -148,13 +166,14 @@ void GuiHandler::start_main_loop() {
     now_time = SDL_GetPerformanceCounter();
     delta_time = static_cast<double>((now_time - last_time) * 1000) /
                  static_cast<double>(SDL_GetPerformanceFrequency());
-    delta_time_seconds = static_cast<double>(now_time - last_time) /
-                  static_cast<double>(SDL_GetPerformanceFrequency());
     last_time = now_time;
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    done = camera.handle_events(static_cast<float>(delta_time));
+    {
+      MAG3D_PROFILE_ZONE("handle_events");
+      done = camera.handle_events(static_cast<float>(delta_time));
+    }
 
     if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
       SDL_Delay(10);
@@ -163,19 +182,25 @@ void GuiHandler::start_main_loop() {
 
     start_imgui_frame();
 
+    solar_system_graphics.update();
     solar_system_graphics.draw_control_window();
     solar_system_graphics.draw_orbit_view();
     solar_system_graphics.draw_solar_system();
 
-    if (!solar_system_calculator.paused) {
-      const auto dt_days =static_cast<float>(delta_time_seconds) / 86400 * solar_system_calculator.simulation_time_factor;
-      solar_system_calculator.elapsed_simulation_time += dt_days;
-      solar_system_calculator.update_bodies_verlet(dt_days);
+    {
+      MAG3D_PROFILE_GPU_ZONE("imgui");
+      ImGui::Render();
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
-
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    SDL_GL_SwapWindow(window);
+    {
+      // Mostly waiting for vsync.
+      MAG3D_PROFILE_ZONE("swap");
+      SDL_GL_SwapWindow(window);
+    }
+    GpuProfiler::end_frame();
+    OpenGLUtils::end_frame();
+    Profiler::end_frame();
   }
+  simulation.stop();
   shutdown();
 }
@@ -2,6 +2,9 @@
 
 #include <SDL.h>
 
+#include <optional>
+#include <string>
+
 #include <glm/glm.hpp>
 #include <OpenGL/gl3.h>
 
@@ -32,6 +35,11 @@ class GuiHandler {
   static void start_imgui_frame();
 
 public:
+  // Checkpoint to resume from instead of the built-in solar system.
+  std::optional<std::string> restore_path;
+  // Scenario file to start from instead of the built-in solar system.
+  std::optional<std::string> scenario_path;
+
   void init();
   void start_main_loop();
 };
@@ -0,0 +1,479 @@
+// Batch runner without a window: integrates a scenario for a number of
+// simulated days as fast as possible and reports the throughput.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "checkpoint.h"
+#include "ensemble.h"
+#include "ephemeris.h"
+#include "profiler.h"
+#include "scenario.h"
+#include "solar_system_calculator.h"
+#include "trajectory_recorder.h"
+
+namespace {
+
+struct Options {
+  double days = 3650.0;
+  double dt = 0.25;
+  IntegratorKind integrator = IntegratorKind::VERLET;
+  ForceEngine engine = ForceEngine::DIRECT;
+  std::optional<Precision> precision;
+  double theta = 0.5;
+  std::size_t threads = 0;
+  std::size_t belt = 0;
+  std::size_t tracers = 0;
+  std::size_t members = 0;
+  std::size_t sweep_body = 0;
+  double sweep_min = 0.5;
+  double sweep_max = 2.0;
+  std::string scenario;
+  std::string restore;
+  std::string checkpoint;
+  double checkpoint_every = 0.0;
+  std::string record;
+  double record_every = 1.0;
+  double ephemeris = 0.0;
+  std::optional<CollisionResponse> collisions;
+  double hill_factor = 3.0;
+  std::string events;
+  std::string trace;
+};
+
+void print_usage() {
+  std::puts(
+      "Usage: mag3d_headless [options]\n"
+      "  --days D           simulated days (default 3650)\n"
+      "  --dt D             step size in days (default 0.25)\n"
+      "  --integrator NAME  verlet | block | yoshida4 | wisdom-holman | hybrid\n"
+      "  --engine NAME      direct | barnes-hut\n"
+      "  --theta T          Barnes-Hut opening angle (default 0.5)\n"
+      "  --precision NAME   double | mixed | float kernel arithmetic,\n"
+      "                     overrides the scenario or checkpoint\n"
+      "  --threads N        worker threads, 0 = all (default 0)\n"
+      "  --belt N           add N massive asteroids between 2 and 3.5 au\n"
+      "  --tracers N        add N massless tracers in the main belt\n"
+      "  --scenario FILE    start from a scenario file instead of the\n"
+      "                     inner solar system\n"
+      "  --restore FILE     continue from a checkpoint; its integrator,\n"
+      "                     engine and bodies replace the options above\n"
+      "  --checkpoint FILE  save a checkpoint when done\n"
+      "  --checkpoint-every D  also save every D simulated days\n"
+      "  --record FILE      write a compressed trajectory of all bodies\n"
+      "  --record-every D   simulated days between frames (default 1)\n"
+      "  --ephemeris D      fit Chebyshev series over D day intervals while\n"
+      "                     running and report their error and lookup time\n"
+      "  --collisions MODE  detect encounters and collisions each step:\n"
+      "                     merge | bounce | log\n"
+      "  --hill F           close encounter within F Hill radii (default 3)\n"
+      "  --events FILE      write the encounter log as CSV\n"
+      "  --trace FILE       profile every step and write a Chrome trace\n"
+      "\n"
+      "Ensemble mode (velocity Verlet, one CSV line per member):\n"
+      "  --members N        run N copies with one mass swept\n"
+      "  --sweep-body I     index of the body whose mass is swept (default 0)\n"
+      "  --sweep-min M      smallest mass in m_sun (default 0.5)\n"
+      "  --sweep-max M      largest mass in m_sun (default 2)");
+}
+
+std::optional<IntegratorKind> parse_integrator(const std::string_view name) {
+  if (name == "verlet")
+    return IntegratorKind::VERLET;
+  if (name == "block")
+    return IntegratorKind::BLOCK;
+  if (name == "yoshida4")
+    return IntegratorKind::YOSHIDA4;
+  if (name == "wisdom-holman")
+    return IntegratorKind::WISDOM_HOLMAN;
+  if (name == "hybrid")
+    return IntegratorKind::HYBRID;
+  return std::nullopt;
+}
+
+std::optional<ForceEngine> parse_engine(const std::string_view name) {
+  if (name == "direct")
+    return ForceEngine::DIRECT;
+  if (name == "barnes-hut")
+    return ForceEngine::BARNES_HUT;
+  return std::nullopt;
+}
+
+std::optional<CollisionResponse> parse_response(const std::string_view name) {
+  if (name == "merge")
+    return CollisionResponse::MERGE;
+  if (name == "bounce")
+    return CollisionResponse::BOUNCE;
+  if (name == "log")
+    return CollisionResponse::NONE;
+  return std::nullopt;
+}
+
+std::optional<Options> parse_options(const int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view flag = argv[i];
+    if (flag == "--help" || flag == "-h" || i + 1 >= argc)
+      return std::nullopt;
+    const char *value = argv[++i];
+    if (flag == "--days") {
+      options.days = std::atof(value);
+    } else if (flag == "--dt") {
+      options.dt = std::atof(value);
+    } else if (flag == "--integrator") {
+      const auto kind = parse_integrator(value);
+      if (!kind)
+        return std::nullopt;
+      options.integrator = *kind;
+    } else if (flag == "--engine") {
+      const auto engine = parse_engine(value);
+      if (!engine)
+        return std::nullopt;
+      options.engine = *engine;
+    } else if (flag == "--precision") {
+      options.precision = GravityKernel::parse_precision(value);
+      if (!options.precision)
+        return std::nullopt;
+    } else if (flag == "--theta") {
+      options.theta = std::atof(value);
+    } else if (flag == "--threads") {
+      options.threads = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--belt") {
+      options.belt = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--tracers") {
+      options.tracers = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--scenario") {
+      options.scenario = value;
+    } else if (flag == "--restore") {
+      options.restore = value;
+    } else if (flag == "--checkpoint") {
+      options.checkpoint = value;
+    } else if (flag == "--checkpoint-every") {
+      options.checkpoint_every = std::atof(value);
+    } else if (flag == "--record") {
+      options.record = value;
+    } else if (flag == "--record-every") {
+      options.record_every = std::atof(value);
+    } else if (flag == "--ephemeris") {
+      options.ephemeris = std::atof(value);
+    } else if (flag == "--collisions") {
+      options.collisions = parse_response(value);
+      if (!options.collisions)
+        return std::nullopt;
+    } else if (flag == "--hill") {
+      options.hill_factor = std::atof(value);
+    } else if (flag == "--events") {
+      options.events = value;
+    } else if (flag == "--trace") {
+      options.trace = value;
+    } else if (flag == "--members") {
+      options.members = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--sweep-body") {
+      options.sweep_body = std::strtoul(value, nullptr, 10);
+    } else if (flag == "--sweep-min") {
+      options.sweep_min = std::atof(value);
+    } else if (flag == "--sweep-max") {
+      options.sweep_max = std::atof(value);
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (options.days <= 0.0 || options.dt <= 0.0 || options.ephemeris < 0.0)
+    return std::nullopt;
+  return options;
+}
+
+int run_ensemble(const SolarSystemCalculator &calculator,
+                 const Options &options) {
+  if (options.sweep_body >= calculator.state.size() ||
+      options.sweep_min <= 0.0 || options.sweep_max <= 0.0) {
+    print_usage();
+    return 1;
+  }
+  const auto members =
+      Ensemble::mass_sweep(calculator.state, options.sweep_body,
+                           options.sweep_min, options.sweep_max,
+                           options.members);
+  const auto start = std::chrono::steady_clock::now();
+  const auto summaries = Ensemble::run(
+      calculator.state, calculator.gravitational_constant(), members,
+      {.dt = options.dt, .duration = options.days,
+       .max_threads = options.threads});
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::printf("member,mass,relative_energy_error");
+  for (std::size_t i = 0; i < calculator.state.size(); ++i)
+    std::printf(",x%zu,y%zu,z%zu", i, i, i);
+  std::printf("\n");
+  for (std::size_t m = 0; m < summaries.size(); ++m) {
+    std::printf("%zu,%.9g,%.3e", m, members[m].masses[options.sweep_body],
+                summaries[m].relative_energy_error);
+    for (const auto &position : summaries[m].positions)
+      std::printf(",%.9f,%.9f,%.9f", position.x, position.y, position.z);
+    std::printf("\n");
+  }
+
+  const double member_steps = static_cast<double>(members.size()) *
+                              std::round(options.days / options.dt);
+  std::fprintf(stderr, "%zu members in %.3f s, %.3e member-steps/s\n",
+               members.size(), seconds, member_steps / seconds);
+  return 0;
+}
+
+// Distance of the fitted positions from the integrated ones at the probes
+// inside fitted intervals, and the time of a lookup.
+void report_ephemeris(Ephemeris &ephemeris, const std::vector<double> &times,
+                      const std::vector<BodyStore> &states) {
+  double max_error = 0.0;
+  std::vector<double> covered;
+  std::vector<glm::dvec3> positions;
+  for (std::size_t s = 0; s < times.size(); ++s) {
+    if (!ephemeris.positions(times[s], positions))
+      continue;
+    covered.push_back(times[s]);
+    for (std::size_t i = 0; i < positions.size(); ++i)
+      max_error = std::max(
+          max_error, glm::length(positions[i] - states[s].position(i)));
+  }
+  std::printf("ephemeris: %zu intervals, %.2f MB, max error %.3g km at %zu "
+              "probes\n",
+              ephemeris.interval_count(),
+              static_cast<double>(ephemeris.bytes_used()) / 1e6,
+              max_error * 1.495978707e8, covered.size());
+  if (covered.empty())
+    return;
+
+  constexpr std::size_t LOOKUPS = 1000000;
+  glm::dvec3 position;
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t k = 0; k < LOOKUPS; ++k)
+    ephemeris.position(k % ephemeris.body_count(), covered[k % covered.size()],
+                       position);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  std::printf("ephemeris lookup: %.0f ns per body\n",
+              seconds / static_cast<double>(LOOKUPS) * 1e9);
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  const auto options = parse_options(argc, argv);
+  if (!options) {
+    print_usage();
+    return 1;
+  }
+
+  SolarSystemCalculator calculator;
+  calculator.set_max_threads(options->threads);
+  if (!options->restore.empty()) {
+    try {
+      Checkpoint::load(options->restore, calculator);
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+  } else {
+    try {
+      if (options->scenario.empty())
+        calculator.init();
+      else
+        Scenario::load(options->scenario, calculator);
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+    calculator.add_belt(options->belt, calculator.gravitational_constant(),
+                        2.0, 3.5, 1e-10);
+    calculator.tracers.add_belt(options->tracers,
+                                calculator.gravitational_constant(), 2.1, 3.3);
+    calculator.set_integrator(options->integrator);
+    calculator.force_engine = options->engine;
+    calculator.opening_angle = options->theta;
+  }
+  if (options->precision)
+    calculator.set_precision(*options->precision);
+  if (options->members > 0)
+    return run_ensemble(calculator, *options);
+  if (options->collisions)
+    calculator.collisions.emplace(
+        CollisionSettings{.hill_factor = options->hill_factor,
+                          .response = *options->collisions});
+  std::FILE *event_file = nullptr;
+  if (!options->events.empty()) {
+    event_file = std::fopen(options->events.c_str(), "w");
+    if (event_file == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", options->events.c_str());
+      return 1;
+    }
+    std::fputs("time,type,body,other,distance,relative_speed\n", event_file);
+  }
+  std::uint64_t encounters = 0;
+  std::uint64_t collisions = 0;
+
+  // The energy check is a direct O(N^2) sum; skip it for large systems.
+  const bool check_energy = calculator.state.size() <= 20000;
+  const double initial_energy = check_energy ? calculator.total_energy() : 0.0;
+
+  const auto steps =
+      static_cast<std::uint64_t>(std::ceil(options->days / options->dt));
+  const auto checkpoint_interval =
+      options->checkpoint.empty() || options->checkpoint_every <= 0.0
+          ? std::uint64_t{0}
+          : std::max<std::uint64_t>(
+                1, static_cast<std::uint64_t>(options->checkpoint_every /
+                                              options->dt));
+  std::future<void> pending_save;
+  std::optional<TrajectoryRecorder> recorder;
+  // About 64 states kept along the way to check the ephemeris against.
+  std::optional<Ephemeris> ephemeris;
+  const std::uint64_t probe_every = std::max<std::uint64_t>(1, steps / 64);
+  std::vector<double> probe_times;
+  std::vector<BodyStore> probe_states;
+  if (options->ephemeris > 0.0) {
+    ephemeris.emplace(calculator.state.size(),
+                      EphemerisSettings{.interval = options->ephemeris});
+    ephemeris->record(calculator.elapsed_simulation_time, calculator.state);
+  }
+  if (!options->trace.empty())
+    Profiler::set_enabled(true);
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0.0;
+  try {
+    if (!options->record.empty()) {
+      recorder.emplace(options->record, calculator.state.size(),
+                       TrajectorySettings{.interval = options->record_every,
+                                          .drop_when_behind = false});
+      recorder->record(calculator.elapsed_simulation_time, calculator.state);
+    }
+    for (std::uint64_t i = 0; i < steps; ++i) {
+      calculator.step(options->dt);
+      Profiler::end_frame();
+      // A merge changes the body count, which ends the trajectory.
+      if (recorder && calculator.state.size() != recorder->body_count())
+        recorder->finish();
+      else if (recorder)
+        recorder->record(calculator.elapsed_simulation_time, calculator.state);
+      // And the ephemeris.
+      if (ephemeris && calculator.state.size() == ephemeris->body_count()) {
+        ephemeris->record(calculator.elapsed_simulation_time, calculator.state);
+        if (i % probe_every == probe_every / 2) {
+          probe_times.push_back(calculator.elapsed_simulation_time);
+          probe_states.push_back(calculator.state);
+        }
+      }
+      if (calculator.collisions) {
+        for (const auto &event : calculator.collisions->events()) {
+          const bool collision = event.type == EncounterType::COLLISION;
+          ++(collision ? collisions : encounters);
+          if (event_file != nullptr)
+            std::fprintf(event_file, "%.6f,%s,%s,%s,%.9e,%.9e\n", event.time,
+                         collision ? "collision" : "encounter",
+                         event.body.c_str(), event.other.c_str(),
+                         event.distance, event.relative_speed);
+        }
+        calculator.collisions->clear_events();
+      }
+      // Skip a periodic save if the previous one is still being written.
+      if (checkpoint_interval > 0 && (i + 1) % checkpoint_interval == 0 &&
+          (!pending_save.valid() ||
+           pending_save.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready)) {
+        if (pending_save.valid())
+          pending_save.get();
+        pending_save = Checkpoint::write_async(
+            options->checkpoint, Checkpoint::capture(calculator));
+      }
+    }
+    seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    if (recorder)
+      recorder->finish();
+    if (event_file != nullptr)
+      std::fclose(event_file);
+    if (pending_save.valid())
+      pending_save.get();
+    if (!options->checkpoint.empty())
+      Checkpoint::write(options->checkpoint, Checkpoint::capture(calculator));
+    if (!options->trace.empty())
+      Profiler::write_chrome_trace(options->trace);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  const auto bodies = static_cast<double>(calculator.state.size());
+  const double body_interactions =
+      static_cast<double>(calculator.force_evaluations()) * bodies;
+  const auto tracer_count = static_cast<double>(calculator.tracers.size());
+  const double tracer_interactions =
+      2.0 * static_cast<double>(steps) * tracer_count * bodies;
+
+  std::printf("integrator: %s, engine: %s, kernel: %s %s, threads: %zu\n",
+              Integrator::name(calculator.integrator_kind()),
+              calculator.force_engine == ForceEngine::BARNES_HUT
+                  ? "barnes-hut"
+                  : "direct",
+              GravityKernel::isa_name(calculator.kernel_isa()),
+              GravityKernel::precision_name(calculator.precision()),
+              calculator.pool().size());
+  std::printf("bodies: %zu, tracers: %zu\n", calculator.state.size(),
+              calculator.tracers.size());
+  std::printf("simulated %.1f days in %llu steps, %.3f s\n",
+              calculator.elapsed_simulation_time,
+              static_cast<unsigned long long>(steps), seconds);
+  std::printf("steps/s: %.1f\n", static_cast<double>(steps) / seconds);
+  std::printf("body interactions/s: %.3e%s\n", body_interactions / seconds,
+              calculator.force_engine == ForceEngine::BARNES_HUT
+                  ? " (direct-summation equivalent)"
+                  : "");
+  if (tracer_count > 0)
+    std::printf("tracer interactions/s: %.3e\n",
+                tracer_interactions / seconds);
+  if (recorder)
+    std::printf("recorded %llu frames (%llu dropped), %.2f MB, %.1fx smaller "
+                "than raw doubles\n",
+                static_cast<unsigned long long>(recorder->frames_recorded()),
+                static_cast<unsigned long long>(recorder->frames_dropped()),
+                static_cast<double>(recorder->bytes_written()) / 1e6,
+                static_cast<double>(recorder->raw_bytes()) /
+                    static_cast<double>(recorder->bytes_written()));
+  if (recorder && calculator.state.size() != recorder->body_count())
+    std::printf("recording stopped when bodies merged\n");
+  if (ephemeris)
+    report_ephemeris(*ephemeris, probe_times, probe_states);
+  if (calculator.collisions)
+    std::printf("close encounters: %llu, collisions: %llu\n",
+                static_cast<unsigned long long>(encounters),
+                static_cast<unsigned long long>(collisions));
+  if (!options->trace.empty()) {
+    std::printf("last %zu steps, ms per step:   mean    p50    p95    p99\n",
+                Profiler::frame_times().size());
+    auto stats = Profiler::zone_stats();
+    stats.insert(stats.begin(), Profiler::frame_stats());
+    stats.front().name = "step";
+    for (const auto &zone : stats)
+      std::printf("  %-28s %6.3f %6.3f %6.3f %6.3f\n", zone.name.c_str(),
+                  zone.mean, zone.p50, zone.p95, zone.p99);
+  }
+  // Relative to nothing, as for a single resting body, only the drift means
+  // something.
+  if (check_energy && initial_energy != 0.0)
+    std::printf("relative energy error: %.3e\n",
+                std::abs(calculator.total_energy() / initial_energy - 1.0));
+  else if (check_energy)
+    std::printf("absolute energy error: %.3e\n",
+                std::abs(calculator.total_energy() - initial_energy));
+  return 0;
+}
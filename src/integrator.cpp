@@ -0,0 +1,483 @@
+#include "integrator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "kepler.h"
+#include "solar_system_calculator.h"
+
+std::unique_ptr<Integrator> Integrator::create(const IntegratorKind kind) {
+  switch (kind) {
+  case IntegratorKind::BLOCK:
+    return std::make_unique<BlockTimestep>();
+  case IntegratorKind::YOSHIDA4:
+    return std::make_unique<Yoshida4>();
+  case IntegratorKind::WISDOM_HOLMAN:
+    return std::make_unique<WisdomHolman>();
+  case IntegratorKind::HYBRID:
+    return std::make_unique<HybridKepler>();
+  default:
+    return std::make_unique<VelocityVerlet>();
+  }
+}
+
+const char *Integrator::name(const IntegratorKind kind) {
+  switch (kind) {
+  case IntegratorKind::BLOCK:
+    return "Block timesteps";
+  case IntegratorKind::YOSHIDA4:
+    return "Yoshida 4th order";
+  case IntegratorKind::WISDOM_HOLMAN:
+    return "Wisdom-Holman";
+  case IntegratorKind::HYBRID:
+    return "Hybrid Kepler";
+  default:
+    return "Velocity Verlet";
+  }
+}
+
+// The closing accelerations of one step open the next, so a step costs one
+// force evaluation.
+void VelocityVerlet::step(SolarSystemCalculator &calculator, const double dt) {
+  if (!calculator.accelerations_current())
+    calculator.compute_accelerations();
+  calculator.kick(0.5 * dt);
+  calculator.drift(dt);
+  calculator.compute_accelerations();
+  calculator.kick(0.5 * dt);
+}
+
+void Yoshida4::step(SolarSystemCalculator &calculator, const double dt) {
+  const double cbrt2 = std::cbrt(2.0);
+  const double w1 = 1.0 / (2.0 - cbrt2);
+  const double w0 = -cbrt2 * w1;
+  const double drifts[] = {0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1),
+                           0.5 * w1};
+  const double kicks[] = {w1, w0, w1};
+
+  for (int stage = 0; stage < 3; ++stage) {
+    calculator.drift(drifts[stage] * dt);
+    calculator.compute_accelerations();
+    calculator.kick(kicks[stage] * dt);
+  }
+  calculator.drift(drifts[3] * dt);
+}
+
+unsigned BlockTimestep::level_for(const double dt, const double desired) const {
+  if (std::isinf(desired))
+    return 0;
+  if (!(desired > 0.0))
+    return max_level;
+  const double level = std::ceil(std::log2(dt / desired));
+  return static_cast<unsigned>(
+      std::clamp(level, 0.0, static_cast<double>(max_level)));
+}
+
+// accuracy and max_level, then the levels, which are the only state;
+// accelerations live in the body state.
+std::vector<std::byte> BlockTimestep::save_state() const {
+  constexpr std::size_t header = sizeof(double) + sizeof(unsigned);
+  std::vector<std::byte> bytes(header +
+                               block_levels.size() * sizeof(unsigned));
+  std::memcpy(bytes.data(), &accuracy, sizeof(double));
+  std::memcpy(bytes.data() + sizeof(double), &max_level, sizeof(unsigned));
+  std::memcpy(bytes.data() + header, block_levels.data(),
+              block_levels.size() * sizeof(unsigned));
+  return bytes;
+}
+
+bool BlockTimestep::restore_state(const std::span<const std::byte> bytes,
+                                  const std::size_t body_count) {
+  constexpr std::size_t header = sizeof(double) + sizeof(unsigned);
+  if (bytes.size() < header)
+    return false;
+  double saved_accuracy;
+  unsigned saved_max_level;
+  std::memcpy(&saved_accuracy, bytes.data(), sizeof(double));
+  std::memcpy(&saved_max_level, bytes.data() + sizeof(double),
+              sizeof(unsigned));
+  // Levels are saved before the first step and after each.
+  const std::size_t count = (bytes.size() - header) / sizeof(unsigned);
+  if (!(saved_accuracy > 0.0) || saved_max_level >= 64 ||
+      (bytes.size() - header) % sizeof(unsigned) != 0 ||
+      (count != 0 && count != body_count))
+    return false;
+  std::vector<unsigned> levels(count);
+  std::memcpy(levels.data(), bytes.data() + header, count * sizeof(unsigned));
+  if (std::any_of(levels.begin(), levels.end(), [&](const unsigned level) {
+        return level > saved_max_level;
+      }))
+    return false;
+  *this = BlockTimestep(saved_accuracy, saved_max_level);
+  block_levels = std::move(levels);
+  return true;
+}
+
+void BlockTimestep::step(SolarSystemCalculator &calculator, const double dt) {
+  auto &state = calculator.state;
+  const std::size_t n = state.size();
+  const std::uint64_t total_ticks = std::uint64_t{1} << max_level;
+  const double tick = dt / static_cast<double>(total_ticks);
+  const auto ticks_of = [this](const unsigned level) {
+    return std::uint64_t{1} << (max_level - level);
+  };
+
+  if (block_levels.size() != n) {
+    // Seed levels from |v|/|a|, which equals 1/omega on a circular orbit,
+    // the same time scale the jerk criterion measures later on. Bodies at
+    // rest start on the finest level and coarsen at their first boundaries.
+    calculator.compute_accelerations();
+    block_levels.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      const double speed = glm::length(state.velocity(i));
+      const double acceleration = glm::length(state.acceleration(i));
+      block_levels[i] = level_for(dt, accuracy * speed / acceleration);
+    }
+  }
+
+  next_tick.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const double h = tick * static_cast<double>(ticks_of(block_levels[i]));
+    state.vx[i] += 0.5 * h * state.ax[i];
+    state.vy[i] += 0.5 * h * state.ay[i];
+    state.vz[i] += 0.5 * h * state.az[i];
+    next_tick[i] = ticks_of(block_levels[i]);
+  }
+
+  std::uint64_t now = 0;
+  while (now < total_ticks) {
+    const std::uint64_t next =
+        *std::min_element(next_tick.begin(), next_tick.end());
+    calculator.drift(tick * static_cast<double>(next - now));
+    now = next;
+
+    active.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+      if (next_tick[i] == now)
+        active.push_back(i);
+    }
+    targets.resize(active.size());
+    for (std::size_t k = 0; k < active.size(); ++k) {
+      const std::size_t i = active[k];
+      targets.x[k] = state.x[i];
+      targets.y[k] = state.y[i];
+      targets.z[k] = state.z[i];
+    }
+    calculator.compute_accelerations(GravityKernel::targets_of(targets));
+
+    for (std::size_t k = 0; k < active.size(); ++k) {
+      const std::size_t i = active[k];
+      const glm::dvec3 previous = state.acceleration(i);
+      const glm::dvec3 current = targets.acceleration(k);
+      const double h = tick * static_cast<double>(ticks_of(block_levels[i]));
+
+      state.vx[i] += 0.5 * h * current.x;
+      state.vy[i] += 0.5 * h * current.y;
+      state.vz[i] += 0.5 * h * current.z;
+      state.ax[i] = current.x;
+      state.ay[i] = current.y;
+      state.az[i] = current.z;
+
+      const double jerk = glm::length(current - previous) / h;
+      unsigned level =
+          jerk == 0.0
+              ? 0
+              : level_for(dt, accuracy * glm::length(current) / jerk);
+      while (level < block_levels[i] && now % ticks_of(level) != 0)
+        ++level;
+      block_levels[i] = level;
+
+      if (now < total_ticks) {
+        const double next_h = tick * static_cast<double>(ticks_of(level));
+        state.vx[i] += 0.5 * next_h * current.x;
+        state.vy[i] += 0.5 * next_h * current.y;
+        state.vz[i] += 0.5 * next_h * current.z;
+        next_tick[i] = now + ticks_of(level);
+      }
+    }
+  }
+}
+
+void WisdomHolman::interaction_kick(SolarSystemCalculator &calculator,
+                                    const double dt) {
+  calculator.compute_accelerations(GravityKernel::sources_of(heliocentric),
+                                   GravityKernel::targets_of(heliocentric));
+  for (std::size_t k = 0; k < heliocentric.size(); ++k) {
+    heliocentric.vx[k] += dt * heliocentric.ax[k];
+    heliocentric.vy[k] += dt * heliocentric.ay[k];
+    heliocentric.vz[k] += dt * heliocentric.az[k];
+  }
+}
+
+void WisdomHolman::jump(const double central_mass, const double dt) {
+  glm::dvec3 momentum(0.0);
+  for (std::size_t k = 0; k < heliocentric.size(); ++k)
+    momentum += heliocentric.mass[k] * heliocentric.velocity(k);
+  const glm::dvec3 shift = (dt / central_mass) * momentum;
+  for (std::size_t k = 0; k < heliocentric.size(); ++k) {
+    heliocentric.x[k] += shift.x;
+    heliocentric.y[k] += shift.y;
+    heliocentric.z[k] += shift.z;
+  }
+}
+
+void WisdomHolman::step(SolarSystemCalculator &calculator, const double dt) {
+  auto &state = calculator.state;
+  const std::size_t n = state.size();
+  if (n < 2) {
+    calculator.drift(dt);
+    return;
+  }
+
+  const auto central = static_cast<std::size_t>(
+      std::max_element(state.mass.begin(), state.mass.end()) -
+      state.mass.begin());
+  const double central_mass = state.mass[central];
+
+  double total_mass = 0.0;
+  glm::dvec3 center_of_mass(0.0);
+  glm::dvec3 barycentric_velocity(0.0);
+  for (std::size_t i = 0; i < n; ++i) {
+    total_mass += state.mass[i];
+    center_of_mass += state.mass[i] * state.position(i);
+    barycentric_velocity += state.mass[i] * state.velocity(i);
+  }
+  center_of_mass /= total_mass;
+  barycentric_velocity /= total_mass;
+
+  heliocentric.resize(n - 1);
+  body_index.resize(n - 1);
+  const glm::dvec3 central_position = state.position(central);
+  for (std::size_t i = 0, k = 0; i < n; ++i) {
+    if (i == central)
+      continue;
+    body_index[k] = i;
+    heliocentric.set_position(k, state.position(i) - central_position);
+    heliocentric.set_velocity(k, state.velocity(i) - barycentric_velocity);
+    heliocentric.mass[k] = state.mass[i];
+    ++k;
+  }
+
+  const double mu = calculator.gravitational_constant() * central_mass;
+  interaction_kick(calculator, 0.5 * dt);
+  jump(central_mass, 0.5 * dt);
+  calculator.pool().parallel_for(
+      0, heliocentric.size(), 1024,
+      [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+          glm::dvec3 r = heliocentric.position(k);
+          glm::dvec3 v = heliocentric.velocity(k);
+          if (Kepler::drift(mu, r, v, dt)) {
+            heliocentric.set_position(k, r);
+            heliocentric.set_velocity(k, v);
+          } else {
+            heliocentric.set_position(k, r + dt * v);
+          }
+        }
+      });
+  jump(central_mass, 0.5 * dt);
+  interaction_kick(calculator, 0.5 * dt);
+
+  center_of_mass += dt * barycentric_velocity;
+  glm::dvec3 weighted_position(0.0);
+  glm::dvec3 weighted_velocity(0.0);
+  for (std::size_t k = 0; k < heliocentric.size(); ++k) {
+    weighted_position += heliocentric.mass[k] * heliocentric.position(k);
+    weighted_velocity += heliocentric.mass[k] * heliocentric.velocity(k);
+  }
+  const glm::dvec3 new_central_position =
+      center_of_mass - weighted_position / total_mass;
+  state.set_position(central, new_central_position);
+  state.set_velocity(central, barycentric_velocity -
+                                  weighted_velocity / central_mass);
+  for (std::size_t k = 0; k < heliocentric.size(); ++k) {
+    const std::size_t i = body_index[k];
+    state.set_position(i, heliocentric.position(k) + new_central_position);
+    state.set_velocity(i, heliocentric.velocity(k) + barycentric_velocity);
+  }
+}
+
+// threshold and perturber_mass, then the flags.
+std::vector<std::byte> HybridKepler::save_state() const {
+  constexpr std::size_t header = 2 * sizeof(double);
+  std::vector<std::byte> bytes(header + analytic_flags.size());
+  std::memcpy(bytes.data(), &threshold, sizeof(double));
+  std::memcpy(bytes.data() + sizeof(double), &perturber_mass, sizeof(double));
+  std::memcpy(bytes.data() + header, analytic_flags.data(),
+              analytic_flags.size());
+  return bytes;
+}
+
+bool HybridKepler::restore_state(const std::span<const std::byte> bytes,
+                                 const std::size_t body_count) {
+  constexpr std::size_t header = 2 * sizeof(double);
+  if (bytes.size() < header)
+    return false;
+  double saved_threshold;
+  double saved_perturber_mass;
+  std::memcpy(&saved_threshold, bytes.data(), sizeof(double));
+  std::memcpy(&saved_perturber_mass, bytes.data() + sizeof(double),
+              sizeof(double));
+  const std::size_t count = bytes.size() - header;
+  if (!(saved_threshold > 0.0) || !(saved_perturber_mass >= 0.0) ||
+      (count != 0 && count != body_count))
+    return false;
+  *this = HybridKepler(saved_threshold, saved_perturber_mass);
+  analytic_flags.resize(count);
+  std::memcpy(analytic_flags.data(), bytes.data() + header, count);
+  return true;
+}
+
+// |sum_p G m_p ((r_p - r) / |r_p - r|^3 - (r_p - r_c) / |r_p - r_c|^3)|
+// over G M_c / |r - r_c|^2, with the hysteresis described in the header.
+void HybridKepler::classify(SolarSystemCalculator &calculator,
+                            const std::size_t central) {
+  const auto &state = calculator.state;
+  const std::size_t n = state.size();
+  perturbers.clear();
+  for (std::size_t i = 0; i < n; ++i) {
+    if (i != central && state.mass[i] >= perturber_mass)
+      perturbers.push_back(i);
+  }
+  const glm::dvec3 central_position = state.position(central);
+  const double central_mass = state.mass[central];
+  perturbation.assign(perturbers.size() * 3, 0.0);
+  for (std::size_t k = 0; k < perturbers.size(); ++k) {
+    const glm::dvec3 d = state.position(perturbers[k]) - central_position;
+    const double r2 = glm::dot(d, d);
+    const glm::dvec3 a = state.mass[perturbers[k]] / (r2 * std::sqrt(r2)) * d;
+    perturbation[3 * k] = a.x;
+    perturbation[3 * k + 1] = a.y;
+    perturbation[3 * k + 2] = a.z;
+  }
+
+  analytic_flags.resize(n, 0);
+  calculator.pool().parallel_for(
+      0, n, 1024, [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (i == central || state.mass[i] >= perturber_mass) {
+            analytic_flags[i] = 0;
+            continue;
+          }
+          const glm::dvec3 r = state.position(i);
+          const glm::dvec3 from_central = r - central_position;
+          const double central_r2 = glm::dot(from_central, from_central);
+          glm::dvec3 tidal(0.0);
+          for (std::size_t k = 0; k < perturbers.size(); ++k) {
+            const std::size_t p = perturbers[k];
+            const glm::dvec3 d = state.position(p) - r;
+            const double r2 = glm::dot(d, d);
+            tidal += state.mass[p] / (r2 * std::sqrt(r2)) * d;
+            tidal.x -= perturbation[3 * k];
+            tidal.y -= perturbation[3 * k + 1];
+            tidal.z -= perturbation[3 * k + 2];
+          }
+          const double ratio = glm::length(tidal) * central_r2 / central_mass;
+          if (analytic_flags[i])
+            analytic_flags[i] = !(ratio > threshold);
+          else
+            analytic_flags[i] = ratio < 0.5 * threshold;
+        }
+      });
+}
+
+void HybridKepler::numerical_kick(SolarSystemCalculator &calculator,
+                                  const double dt) {
+  calculator.compute_accelerations(GravityKernel::targets_of(numerical));
+  for (std::size_t k = 0; k < numerical.size(); ++k) {
+    numerical.vx[k] += dt * numerical.ax[k];
+    numerical.vy[k] += dt * numerical.ay[k];
+    numerical.vz[k] += dt * numerical.az[k];
+  }
+}
+
+void HybridKepler::step(SolarSystemCalculator &calculator, const double dt) {
+  auto &state = calculator.state;
+  const std::size_t n = state.size();
+  if (n < 2) {
+    VelocityVerlet{}.step(calculator, dt);
+    return;
+  }
+  const auto central = static_cast<std::size_t>(
+      std::max_element(state.mass.begin(), state.mass.end()) -
+      state.mass.begin());
+  classify(calculator, central);
+
+  numerical_index.clear();
+  analytic_index.clear();
+  for (std::size_t i = 0; i < n; ++i)
+    (analytic_flags[i] ? analytic_index : numerical_index).push_back(i);
+  if (analytic_index.empty()) {
+    VelocityVerlet{}.step(calculator, dt);
+    return;
+  }
+
+  const glm::dvec3 central_position = state.position(central);
+  const glm::dvec3 central_velocity = state.velocity(central);
+  relative.resize(analytic_index.size());
+  for (std::size_t k = 0; k < analytic_index.size(); ++k) {
+    const std::size_t i = analytic_index[k];
+    const glm::dvec3 r = state.position(i) - central_position;
+    const glm::dvec3 v = state.velocity(i) - central_velocity;
+    relative.x[k] = r.x;
+    relative.y[k] = r.y;
+    relative.z[k] = r.z;
+    relative.vx[k] = v.x;
+    relative.vy[k] = v.y;
+    relative.vz[k] = v.z;
+  }
+  numerical.resize(numerical_index.size());
+  for (std::size_t k = 0; k < numerical_index.size(); ++k) {
+    const std::size_t i = numerical_index[k];
+    numerical.set_position(k, state.position(i));
+    numerical.set_velocity(k, state.velocity(i));
+    numerical.mass[k] = state.mass[i];
+  }
+
+  // Kick and drift the numerical bodies against the state at the start of
+  // the step, move the analytic ones along their orbits, then kick again
+  // against the state at the end.
+  numerical_kick(calculator, 0.5 * dt);
+  for (std::size_t k = 0; k < numerical.size(); ++k) {
+    numerical.x[k] += dt * numerical.vx[k];
+    numerical.y[k] += dt * numerical.vy[k];
+    numerical.z[k] += dt * numerical.vz[k];
+  }
+  const double mu = calculator.gravitational_constant() * state.mass[central];
+  const GravityTracers orbits = GravityKernel::tracers_of(relative);
+  calculator.pool().parallel_for(
+      0, orbits.count, 1024,
+      [&](const std::size_t begin, const std::size_t end) {
+        Kepler::drift(mu, orbits, begin, end, dt);
+      });
+
+  for (std::size_t k = 0; k < numerical_index.size(); ++k)
+    state.set_position(numerical_index[k], numerical.position(k));
+  const glm::dvec3 new_central_position = state.position(central);
+  for (std::size_t k = 0; k < analytic_index.size(); ++k) {
+    state.set_position(analytic_index[k],
+                       relative.position(k) + new_central_position);
+  }
+  numerical_kick(calculator, 0.5 * dt);
+
+  for (std::size_t k = 0; k < numerical_index.size(); ++k) {
+    const std::size_t i = numerical_index[k];
+    state.set_velocity(i, numerical.velocity(k));
+    state.ax[i] = numerical.ax[k];
+    state.ay[i] = numerical.ay[k];
+    state.az[i] = numerical.az[k];
+  }
+  const glm::dvec3 new_central_velocity = state.velocity(central);
+  for (std::size_t k = 0; k < analytic_index.size(); ++k) {
+    const std::size_t i = analytic_index[k];
+    const glm::dvec3 r = relative.position(k);
+    const double r2 = glm::dot(r, r);
+    const glm::dvec3 a = -mu / (r2 * std::sqrt(r2)) * r;
+    state.set_velocity(i, relative.velocity(k) + new_central_velocity);
+    state.ax[i] = a.x;
+    state.ay[i] = a.y;
+    state.az[i] = a.z;
+  }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "body_store.h"
+#include "tracer_store.h"
+
+class SolarSystemCalculator;
+
+enum class IntegratorKind {
+  VERLET,
+  BLOCK,
+  YOSHIDA4,
+  WISDOM_HOLMAN,
+  HYBRID
+};
+
+// Advances SolarSystemCalculator::state by dt. Implementations use the
+// calculator's force engine, thread pool and kick/drift helpers, and may keep
+// state between steps; the calculator calls reset() whenever the body set
+// changes.
+class Integrator {
+public:
+  virtual ~Integrator() = default;
+  virtual void step(SolarSystemCalculator &calculator, double dt) = 0;
+  [[nodiscard]] virtual IntegratorKind kind() const = 0;
+  // Drops the per-body state, keeping the parameters.
+  virtual void reset() {}
+
+  // Parameters and state carried from one step to the next, for
+  // checkpoints. Stateless integrators save nothing. restore_state() returns
+  // false, and may leave the integrator reset, if bytes are not what
+  // save_state() writes for body_count bodies.
+  [[nodiscard]] virtual std::vector<std::byte> save_state() const {
+    return {};
+  }
+  [[nodiscard]] virtual bool restore_state(std::span<const std::byte> bytes,
+                                           std::size_t /*body_count*/) {
+    return bytes.empty();
+  }
+
+  static std::unique_ptr<Integrator> create(IntegratorKind kind);
+  static const char *name(IntegratorKind kind);
+};
+
+// Second order kick-drift-kick leapfrog, one force evaluation per step once
+// the accelerations are current.
+class VelocityVerlet : public Integrator {
+public:
+  void step(SolarSystemCalculator &calculator, double dt) override;
+  [[nodiscard]] IntegratorKind kind() const override {
+    return IntegratorKind::VERLET;
+  }
+};
+
+// Fourth order Forest-Ruth / Yoshida composition of three drift-kick-drift
+// leapfrogs, three force evaluations per step.
+class Yoshida4 : public Integrator {
+public:
+  void step(SolarSystemCalculator &calculator, double dt) override;
+  [[nodiscard]] IntegratorKind kind() const override {
+    return IntegratorKind::YOSHIDA4;
+  }
+};
+
+// Leapfrog with individual power-of-two steps. Time is counted in ticks of
+// dt / 2^max_level; every body drifts at each event, but only bodies whose
+// step ends there get a new acceleration. Levels come from
+// eta * |a| / |jerk|; a body may shorten its step at any of its step
+// boundaries and lengthen it only where the longer step is aligned to the
+// block grid.
+class BlockTimestep : public Integrator {
+public:
+  explicit BlockTimestep(const double accuracy = 0.02,
+                         const unsigned max_level = 12)
+      : accuracy(accuracy), max_level(max_level) {}
+  void step(SolarSystemCalculator &calculator, double dt) override;
+  [[nodiscard]] IntegratorKind kind() const override {
+    return IntegratorKind::BLOCK;
+  }
+  void reset() override { *this = BlockTimestep(accuracy, max_level); }
+  [[nodiscard]] double get_accuracy() const { return accuracy; }
+  [[nodiscard]] unsigned get_max_level() const { return max_level; }
+  [[nodiscard]] const std::vector<unsigned> &levels() const {
+    return block_levels;
+  }
+  [[nodiscard]] std::vector<std::byte> save_state() const override;
+  [[nodiscard]] bool restore_state(std::span<const std::byte> bytes,
+                                   std::size_t body_count) override;
+
+private:
+  double accuracy; // eta
+  unsigned max_level;
+  std::vector<unsigned> block_levels;
+  std::vector<std::uint64_t> next_tick;
+  std::vector<std::size_t> active;
+  BodyStore targets;
+
+  [[nodiscard]] unsigned level_for(double dt, double desired) const;
+};
+
+// Wisdom-Holman mapping in democratic heliocentric coordinates: Kepler
+// drifts about the most massive body alternate with kicks from the mutual
+// interactions of all other bodies. Accurate with steps of a few percent of
+// the shortest orbital period as long as that body dominates.
+class WisdomHolman : public Integrator {
+public:
+  void step(SolarSystemCalculator &calculator, double dt) override;
+  [[nodiscard]] IntegratorKind kind() const override {
+    return IntegratorKind::WISDOM_HOLMAN;
+  }
+  void reset() override { *this = WisdomHolman(); }
+
+private:
+  BodyStore heliocentric; // positions relative to, velocities barycentric
+  std::vector<std::size_t> body_index;
+
+  void interaction_kick(SolarSystemCalculator &calculator, double dt);
+  void jump(double central_mass, double dt);
+};
+
+// Velocity Verlet for the perturbers and perturbed bodies, closed-form Kepler
+// orbits about the most massive body for the rest. Bodies lighter than
+// perturber_mass are checked every step: the tidal acceleration of the
+// perturbers, relative to the pull of the central body, must stay below
+// threshold. Above it a body is integrated numerically again until the ratio
+// falls under half the threshold. Analytic bodies still attract the
+// numerical ones, so each step costs O(N * numerical) forces rather than
+// O(N^2). Without analytic bodies this is plain velocity Verlet.
+class HybridKepler : public Integrator {
+public:
+  explicit HybridKepler(const double threshold = 1e-4,
+                        const double perturber_mass = 1e-9)
+      : threshold(threshold), perturber_mass(perturber_mass) {}
+  void step(SolarSystemCalculator &calculator, double dt) override;
+  [[nodiscard]] IntegratorKind kind() const override {
+    return IntegratorKind::HYBRID;
+  }
+  void reset() override { *this = HybridKepler(threshold, perturber_mass); }
+  [[nodiscard]] double get_threshold() const { return threshold; }
+  [[nodiscard]] double get_perturber_mass() const { return perturber_mass; }
+  // One flag per body, nonzero for those on Kepler orbits.
+  [[nodiscard]] const std::vector<std::uint8_t> &analytic() const {
+    return analytic_flags;
+  }
+  [[nodiscard]] std::vector<std::byte> save_state() const override;
+  [[nodiscard]] bool restore_state(std::span<const std::byte> bytes,
+                                   std::size_t body_count) override;
+
+private:
+  double threshold;
+  double perturber_mass;
+  std::vector<std::uint8_t> analytic_flags;
+  std::vector<double> perturbation;
+  std::vector<std::size_t> perturbers;
+  std::vector<std::size_t> numerical_index;
+  std::vector<std::size_t> analytic_index;
+  BodyStore numerical;
+  TracerStore relative; // analytic bodies about the central one
+
+  void classify(SolarSystemCalculator &calculator, std::size_t central);
+  void numerical_kick(SolarSystemCalculator &calculator, double dt);
+};
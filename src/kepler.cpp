@@ -0,0 +1,292 @@
+#include "kepler.h"
+
+#include <array>
+#include <cmath>
+
+#include "glm/gtc/constants.hpp"
+#include "x86_simd.h"
+
+namespace {
+
+// Terms of the Stumpff series, as in Kepler::stumpff.
+constexpr int SERIES_TERMS = 8;
+constexpr double SERIES_RANGE = 0.1;
+
+void drift_scalar(const double mu, const GravityTracers &states,
+                  const std::size_t begin, const std::size_t end,
+                  const double dt) {
+  for (std::size_t i = begin; i < end; ++i) {
+    glm::dvec3 r(states.x[i], states.y[i], states.z[i]);
+    glm::dvec3 v(states.vx[i], states.vy[i], states.vz[i]);
+    if (!Kepler::drift(mu, r, v, dt))
+      r += dt * v;
+    states.x[i] = r.x;
+    states.y[i] = r.y;
+    states.z[i] = r.z;
+    states.vx[i] = v.x;
+    states.vy[i] = v.y;
+    states.vz[i] = v.z;
+  }
+}
+
+#ifdef MAG3D_X86_KERNELS
+
+// 1 / n! for the series of c0 to c3.
+constexpr std::array<double, 2 * SERIES_TERMS + 2> inverse_factorials() {
+  std::array<double, 2 * SERIES_TERMS + 2> values{};
+  double factorial = 1.0;
+  for (std::size_t n = 0; n < values.size(); ++n) {
+    if (n > 0)
+      factorial *= static_cast<double>(n);
+    values[n] = 1.0 / factorial;
+  }
+  return values;
+}
+constexpr auto INVERSE_FACTORIALS = inverse_factorials();
+
+// c_n(x) = sum_k (-x)^k / (2k + n)!, by Horner's rule.
+__attribute__((target("avx2,fma"))) void
+stumpff_series(const __m256d x, __m256d &c0, __m256d &c1, __m256d &c2,
+               __m256d &c3) {
+  const __m256d minus_x = _mm256_sub_pd(_mm256_setzero_pd(), x);
+  constexpr int last = 2 * (SERIES_TERMS - 1);
+  c0 = _mm256_set1_pd(INVERSE_FACTORIALS[last]);
+  c1 = _mm256_set1_pd(INVERSE_FACTORIALS[last + 1]);
+  c2 = _mm256_set1_pd(INVERSE_FACTORIALS[last + 2]);
+  c3 = _mm256_set1_pd(INVERSE_FACTORIALS[last + 3]);
+  for (int k = SERIES_TERMS - 2; k >= 0; --k) {
+    c0 = _mm256_fmadd_pd(c0, minus_x,
+                         _mm256_set1_pd(INVERSE_FACTORIALS[2 * k]));
+    c1 = _mm256_fmadd_pd(c1, minus_x,
+                         _mm256_set1_pd(INVERSE_FACTORIALS[2 * k + 1]));
+    c2 = _mm256_fmadd_pd(c2, minus_x,
+                         _mm256_set1_pd(INVERSE_FACTORIALS[2 * k + 2]));
+    c3 = _mm256_fmadd_pd(c3, minus_x,
+                         _mm256_set1_pd(INVERSE_FACTORIALS[2 * k + 3]));
+  }
+}
+
+// Kepler::drift for the four states from i on. Returns false, leaving them
+// untouched, unless every iterate stays in the range of the series.
+__attribute__((target("avx2,fma"))) bool
+drift_avx2(const double mu, const GravityTracers &states, const std::size_t i,
+           const double dt) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d range = _mm256_set1_pd(SERIES_RANGE);
+  const __m256d mu4 = _mm256_set1_pd(mu);
+  const __m256d dt4 = _mm256_set1_pd(dt);
+  const __m256d x = _mm256_loadu_pd(states.x + i);
+  const __m256d y = _mm256_loadu_pd(states.y + i);
+  const __m256d z = _mm256_loadu_pd(states.z + i);
+  const __m256d vx = _mm256_loadu_pd(states.vx + i);
+  const __m256d vy = _mm256_loadu_pd(states.vy + i);
+  const __m256d vz = _mm256_loadu_pd(states.vz + i);
+
+  __m256d r0 = _mm256_mul_pd(x, x);
+  r0 = _mm256_fmadd_pd(y, y, r0);
+  r0 = _mm256_sqrt_pd(_mm256_fmadd_pd(z, z, r0));
+  if (_mm256_movemask_pd(_mm256_cmp_pd(r0, zero, _CMP_GT_OQ)) != 0xF)
+    return false;
+  __m256d eta0 = _mm256_mul_pd(x, vx);
+  eta0 = _mm256_fmadd_pd(y, vy, eta0);
+  eta0 = _mm256_fmadd_pd(z, vz, eta0);
+  __m256d v2 = _mm256_mul_pd(vx, vx);
+  v2 = _mm256_fmadd_pd(vy, vy, v2);
+  v2 = _mm256_fmadd_pd(vz, vz, v2);
+  const __m256d beta =
+      _mm256_sub_pd(_mm256_div_pd(_mm256_add_pd(mu4, mu4), r0), v2);
+  const __m256d zeta0 = _mm256_fnmadd_pd(beta, r0, mu4);
+
+  // Laguerre iteration as in Kepler::drift, until all four converged.
+  __m256d s = _mm256_div_pd(dt4, r0);
+  __m256d c0, c1, c2, c3;
+  bool converged = false;
+  for (int iteration = 0; iteration < 50 && !converged; ++iteration) {
+    const __m256d s2 = _mm256_mul_pd(s, s);
+    const __m256d xs = _mm256_mul_pd(beta, s2);
+    if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, xs), range,
+                                         _CMP_LT_OQ)) != 0xF)
+      return false;
+    stumpff_series(xs, c0, c1, c2, c3);
+    const __m256d g1 = _mm256_mul_pd(s, c1);
+    const __m256d g2 = _mm256_mul_pd(s2, c2);
+    const __m256d g3 = _mm256_mul_pd(_mm256_mul_pd(s2, s), c3);
+    __m256d f = _mm256_fmsub_pd(r0, s, dt4);
+    f = _mm256_fmadd_pd(eta0, g2, f);
+    f = _mm256_fmadd_pd(zeta0, g3, f);
+    __m256d df = _mm256_fmadd_pd(eta0, g1, r0);
+    df = _mm256_fmadd_pd(zeta0, g2, df);
+    const __m256d ddf = _mm256_fmadd_pd(zeta0, g1, _mm256_mul_pd(eta0, c0));
+    // n = 5: sqrt|16 df^2 - 20 f ddf|, with the sign of df.
+    const __m256d radicand =
+        _mm256_fmsub_pd(_mm256_set1_pd(16.0), _mm256_mul_pd(df, df),
+                        _mm256_mul_pd(_mm256_set1_pd(20.0),
+                                      _mm256_mul_pd(f, ddf)));
+    const __m256d root =
+        _mm256_sqrt_pd(_mm256_andnot_pd(sign, radicand));
+    const __m256d denominator =
+        _mm256_add_pd(df, _mm256_or_pd(root, _mm256_and_pd(sign, df)));
+    const __m256d step =
+        _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(5.0), f), denominator);
+    s = _mm256_sub_pd(s, step);
+    const __m256d tolerance =
+        _mm256_fmadd_pd(_mm256_set1_pd(1e-15), _mm256_andnot_pd(sign, s),
+                        _mm256_set1_pd(1e-300));
+    converged = _mm256_movemask_pd(_mm256_cmp_pd(
+                    _mm256_andnot_pd(sign, step), tolerance, _CMP_LE_OQ)) ==
+                0xF;
+  }
+  if (!converged)
+    return false;
+
+  const __m256d s2 = _mm256_mul_pd(s, s);
+  const __m256d xs = _mm256_mul_pd(beta, s2);
+  if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, xs), range,
+                                       _CMP_LT_OQ)) != 0xF)
+    return false;
+  stumpff_series(xs, c0, c1, c2, c3);
+  const __m256d g1 = _mm256_mul_pd(s, c1);
+  const __m256d g2 = _mm256_mul_pd(s2, c2);
+  const __m256d g3 = _mm256_mul_pd(_mm256_mul_pd(s2, s), c3);
+  __m256d radius = _mm256_fmadd_pd(eta0, g1, r0);
+  radius = _mm256_fmadd_pd(zeta0, g2, radius);
+
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d mu_g2 = _mm256_mul_pd(mu4, g2);
+  const __m256d f = _mm256_sub_pd(one, _mm256_div_pd(mu_g2, r0));
+  const __m256d g = _mm256_fnmadd_pd(mu4, g3, dt4);
+  const __m256d f_dot = _mm256_div_pd(_mm256_mul_pd(mu4, g1),
+                                      _mm256_sub_pd(zero,
+                                                    _mm256_mul_pd(radius, r0)));
+  const __m256d g_dot = _mm256_sub_pd(one, _mm256_div_pd(mu_g2, radius));
+
+  _mm256_storeu_pd(states.x + i, _mm256_fmadd_pd(f, x, _mm256_mul_pd(g, vx)));
+  _mm256_storeu_pd(states.y + i, _mm256_fmadd_pd(f, y, _mm256_mul_pd(g, vy)));
+  _mm256_storeu_pd(states.z + i, _mm256_fmadd_pd(f, z, _mm256_mul_pd(g, vz)));
+  _mm256_storeu_pd(states.vx + i,
+                   _mm256_fmadd_pd(f_dot, x, _mm256_mul_pd(g_dot, vx)));
+  _mm256_storeu_pd(states.vy + i,
+                   _mm256_fmadd_pd(f_dot, y, _mm256_mul_pd(g_dot, vy)));
+  _mm256_storeu_pd(states.vz + i,
+                   _mm256_fmadd_pd(f_dot, z, _mm256_mul_pd(g_dot, vz)));
+  return true;
+}
+
+#endif
+
+} // namespace
+
+void Kepler::stumpff(const double x, double &c0, double &c1, double &c2,
+                     double &c3) {
+  if (std::abs(x) < SERIES_RANGE) {
+    // Series c_n(x) = sum_k (-x)^k / (2k + n)!, good to 1e-17 here.
+    c0 = c1 = c2 = c3 = 0.0;
+    double term0 = 1.0; // (-x)^k / (2k)!
+    double term1 = 1.0; // (-x)^k / (2k + 1)!
+    for (int k = 0; k < SERIES_TERMS; ++k) {
+      const double two_k = 2.0 * k;
+      c0 += term0;
+      c1 += term1;
+      c2 += term0 / ((two_k + 1.0) * (two_k + 2.0));
+      c3 += term1 / ((two_k + 2.0) * (two_k + 3.0));
+      term0 *= -x / ((two_k + 1.0) * (two_k + 2.0));
+      term1 *= -x / ((two_k + 2.0) * (two_k + 3.0));
+    }
+    return;
+  }
+  if (x > 0.0) {
+    const double z = std::sqrt(x);
+    c0 = std::cos(z);
+    c1 = std::sin(z) / z;
+  } else {
+    const double z = std::sqrt(-x);
+    c0 = std::cosh(z);
+    c1 = std::sinh(z) / z;
+  }
+  c2 = (1.0 - c0) / x;
+  c3 = (1.0 - c1) / x;
+}
+
+bool Kepler::drift(const double mu, glm::dvec3 &r, glm::dvec3 &v, double dt) {
+  if (dt == 0.0)
+    return true;
+  // Nothing attracts: a straight line.
+  if (mu <= 0.0) {
+    r += dt * v;
+    return true;
+  }
+  const double r0 = glm::length(r);
+  if (r0 == 0.0)
+    return false;
+
+  const double eta0 = glm::dot(r, v);
+  const double beta = 2.0 * mu / r0 - glm::dot(v, v);
+  const double zeta0 = mu - beta * r0;
+
+  // Whole periods of a bound orbit do not change the state.
+  if (beta > 0.0) {
+    const double period = glm::two_pi<double>() * mu / (beta * std::sqrt(beta));
+    dt = std::fmod(dt, period);
+  }
+
+  // Laguerre iteration on Kepler's equation in the universal anomaly s:
+  //   t(s) = r0 s + eta0 G2 + zeta0 G3 = dt,  G_n = s^n c_n(beta s^2)
+  double s = dt / r0;
+  double c0 = 0.0;
+  double c1 = 0.0;
+  double c2 = 0.0;
+  double c3 = 0.0;
+  bool converged = false;
+  for (int iteration = 0; iteration < 50; ++iteration) {
+    stumpff(beta * s * s, c0, c1, c2, c3);
+    const double g1 = s * c1;
+    const double g2 = s * s * c2;
+    const double g3 = s * s * s * c3;
+    const double f = r0 * s + eta0 * g2 + zeta0 * g3 - dt;
+    const double df = r0 + eta0 * g1 + zeta0 * g2;
+    const double ddf = eta0 * c0 + zeta0 * g1;
+    constexpr double n = 5.0;
+    const double root = std::sqrt(
+        std::abs((n - 1.0) * (n - 1.0) * df * df - n * (n - 1.0) * f * ddf));
+    const double step = n * f / (df + std::copysign(root, df));
+    s -= step;
+    if (std::abs(step) <= 1e-15 * std::abs(s) + 1e-300) {
+      converged = true;
+      break;
+    }
+  }
+  if (!converged)
+    return false;
+
+  stumpff(beta * s * s, c0, c1, c2, c3);
+  const double g1 = s * c1;
+  const double g2 = s * s * c2;
+  const double g3 = s * s * s * c3;
+  const double radius = r0 + eta0 * g1 + zeta0 * g2;
+
+  const double f = 1.0 - mu * g2 / r0;
+  const double g = dt - mu * g3;
+  const double f_dot = -mu * g1 / (radius * r0);
+  const double g_dot = 1.0 - mu * g2 / radius;
+
+  const glm::dvec3 r_new = f * r + g * v;
+  v = f_dot * r + g_dot * v;
+  r = r_new;
+  return true;
+}
+
+void Kepler::drift(const double mu, const GravityTracers &states,
+                   std::size_t begin, const std::size_t end, const double dt) {
+  if (dt == 0.0)
+    return;
+#ifdef MAG3D_X86_KERNELS
+  if (mu > 0.0 && GravityKernel::detect_isa() == KernelIsa::AVX2) {
+    for (; begin + 4 <= end; begin += 4) {
+      if (!drift_avx2(mu, states, begin, dt))
+        drift_scalar(mu, states, begin, begin + 4, dt);
+    }
+  }
+#endif
+  drift_scalar(mu, states, begin, end, dt);
+}
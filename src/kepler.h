@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include "glm/glm.hpp"
+#include "gravity_kernel.h"
+
+// Two-body propagation in universal variables, valid for elliptic, parabolic
+// and hyperbolic orbits alike.
+class Kepler {
+public:
+  // Advances position and velocity relative to the attracting body by dt
+  // along the Kepler orbit with gravitational parameter mu = G * M.
+  // Moves in a straight line for mu <= 0. Returns false if the solver did
+  // not converge or r is zero; r and v are then unchanged.
+  static bool drift(double mu, glm::dvec3 &r, glm::dvec3 &v, double dt);
+
+  // drift() for the states begin..end of a view, all about the same mass.
+  // With AVX2, four states at a time go through a vector solver as long as
+  // dt is a small part of each orbit, where the Stumpff series converge
+  // fast; other states take drift(). States it fails on move in a straight
+  // line.
+  static void drift(double mu, const GravityTracers &states, std::size_t begin,
+                    std::size_t end, double dt);
+
+  // Stumpff functions c0..c3 of x.
+  static void stumpff(double x, double &c0, double &c1, double &c2,
+                      double &c3);
+};
@@ -1,17 +1,26 @@
 #include <exception>
 #include <iostream>
 #include <ostream>
+#include <string>
 
 #include "gui_handler.hpp"
 
-int main(int, char**) {
+int main(int argc, char** argv) {
   GuiHandler gui;
+  if (argc > 1) {
+    const std::string path = argv[1];
+    if (path.ends_with(".scn")) {
+      gui.scenario_path = path;
+    } else {
+      gui.restore_path = path;
+    }
+  }
   try {
     gui.init();
+    gui.start_main_loop();
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
     return -1;
   }
-  gui.start_main_loop();
   return 0;
 }
@@ -4,30 +4,54 @@
 
 #include "opengl_utils.h"
 
+#include <cstddef>
 #include <vector>
 
 #include "glm/vec3.hpp"
 
+RenderState OpenGLUtils::state;
+
+void OpenGLUtils::use_program(const GLuint program_id) {
+    if (state.change(RenderState::Binding::PROGRAM, program_id)) glUseProgram(program_id);
+}
+
+void OpenGLUtils::bind_vertex_array(const GLuint vertex_array_id) {
+    if (state.change(RenderState::Binding::VERTEX_ARRAY, vertex_array_id)) glBindVertexArray(vertex_array_id);
+}
+
+void OpenGLUtils::bind_buffer(const GLuint buffer_id) {
+    if (state.change(RenderState::Binding::ARRAY_BUFFER, buffer_id)) glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+}
+
+const RenderState &OpenGLUtils::render_state() {
+    return state;
+}
+
+void OpenGLUtils::end_frame() {
+    state.end_frame();
+}
+
+GLuint OpenGLUtils::create_vertex_array() {
+    GLuint vertex_array_id;
+    glGenVertexArrays(1, &vertex_array_id);
+    bind_vertex_array(vertex_array_id);
+    return vertex_array_id;
+}
+
 void OpenGLUtils::bind_array_buffer(const GLuint index, const GLuint buffer_id) {
     glEnableVertexAttribArray(index);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    bind_buffer(buffer_id);
     glVertexAttribPointer(index, 3,GL_FLOAT,GL_FALSE,0, nullptr);
 }
 
 void OpenGLUtils::bind_frame_buffer(const GLuint buffer_id) {
-    glBindFramebuffer(GL_FRAMEBUFFER, buffer_id);
+    if (state.change(RenderState::Binding::FRAMEBUFFER, buffer_id)) glBindFramebuffer(GL_FRAMEBUFFER, buffer_id);
 }
 
 void OpenGLUtils::set_viewport(const int32_t width, const int32_t height) {
     glViewport(0, 0, width, height);
 }
 
-void OpenGLUtils::bind_array_buffer_with_data(const GLuint index, const GLuint buffer_id, const std::vector<glm::vec3> &data) {
-    bind_array_buffer(index, buffer_id);
-    glBufferData(GL_ARRAY_BUFFER,data.size() * sizeof(glm::vec3),
-                 data.data(), GL_DYNAMIC_DRAW);
-}
-
 GLuint OpenGLUtils::create_render_buffer(const int32_t width, const int32_t height) {
     GLuint buffer_id;
     glGenRenderbuffers(1, &buffer_id);
@@ -37,6 +61,23 @@ GLuint OpenGLUtils::create_render_buffer(const int32_t width, const int32_t heig
     return buffer_id;
 }
 
+// Half floats, so that fading in small steps is not rounded away.
+GLuint OpenGLUtils::create_render_texture(const int32_t width, const int32_t height) {
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    bind_texture(GL_TEXTURE0, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id, 0);
+    return texture_id;
+}
+
+void OpenGLUtils::delete_texture(const GLuint texture_id) {
+    glDeleteTextures(1, &texture_id);
+    state.deleted_texture(texture_id);
+}
+
 void OpenGLUtils::check_buffer() {
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         throw std::runtime_error("Framebuffer is not complete");
@@ -60,13 +101,13 @@ GLuint OpenGLUtils::create_buffer() {
 GLuint OpenGLUtils::create_framebuffer() {
     GLuint framebuffer_id;
     glGenFramebuffers(1, &framebuffer_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+    bind_frame_buffer(framebuffer_id);
     return framebuffer_id;
 }
 
 Texture OpenGLUtils::setup_texture(const std::string& name, GLuint& texture_id, const std::int32_t& width, const std::int32_t& height, const GLenum color_attachment, const GLenum target) {
     glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    bind_texture(target, texture_id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,  GL_LINEAR);
@@ -80,13 +121,82 @@ void OpenGLUtils::draw_triangle_faces(const GLsizei number_of_triangles) {
     glDrawArrays(GL_TRIANGLES, 0, number_of_triangles * number_of_vertices);
 }
 
-void OpenGLUtils::draw_line(const std::vector<glm::vec3>& path_vec) {
-    glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(path_vec.size()));
+
+void OpenGLUtils::draw_points(const GLsizei count) {
+    glDrawArrays(GL_POINTS, 0, count);
+}
+
+void OpenGLUtils::draw_triangle_faces_instanced(const GLsizei number_of_triangles, const GLsizei instances) {
+    constexpr int number_of_vertices = 3;
+    glDrawArraysInstanced(GL_TRIANGLES, 0, number_of_triangles * number_of_vertices, instances);
+}
+
+void OpenGLUtils::bind_planet_instances(const GLuint buffer_id) {
+    constexpr auto stride = static_cast<GLsizei>(sizeof(PlanetInstance));
+    bind_buffer(buffer_id);
+    for (GLuint index = 2; index < 5; index++) {
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void *>(offsetof(PlanetInstance, position)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<const void *>(offsetof(PlanetInstance, color)));
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, stride,
+                           reinterpret_cast<const void *>(offsetof(PlanetInstance, flags)));
+}
+
+void OpenGLUtils::bind_trail_buffer(const GLuint buffer_id) {
+    constexpr auto stride = static_cast<GLsizei>(sizeof(TrailVertex));
+    bind_buffer(buffer_id);
+    for (GLuint index = 0; index < 4; index++) glEnableVertexAttribArray(index);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void *>(offsetof(TrailVertex, position)));
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, stride,
+                           reinterpret_cast<const void *>(offsetof(TrailVertex, sample)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<const void *>(offsetof(TrailVertex, color)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void *>(offsetof(TrailVertex, span)));
+}
+
+void OpenGLUtils::allocate_array_buffer(const GLuint buffer_id, const std::size_t bytes) {
+    bind_buffer(buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_DYNAMIC_DRAW);
+}
+
+void OpenGLUtils::update_array_buffer(const GLuint buffer_id, const std::size_t offset, const std::size_t bytes,
+                                      const void *data) {
+    bind_buffer(buffer_id);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
 }
 
+void OpenGLUtils::draw_line_strips(const std::vector<std::int32_t> &firsts, const std::vector<std::int32_t> &counts) {
+    glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), static_cast<GLsizei>(firsts.size()));
+}
+
+void OpenGLUtils::bind_inset_buffer(const GLuint buffer_id) {
+    constexpr auto stride = static_cast<GLsizei>(sizeof(InsetVertex));
+    bind_buffer(buffer_id);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void *>(offsetof(InsetVertex, position)));
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<const void *>(offsetof(InsetVertex, color)));
+}
+
+void OpenGLUtils::begin_blended_2d() {
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
 
-void OpenGLUtils::disable_array_buffer(const GLuint index) {
-    glDisableVertexAttribArray(index);
+void OpenGLUtils::end_blended_2d() {
+    glDisable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
 }
 
 void OpenGLUtils::use_main_framebuffer() {
@@ -97,8 +207,11 @@ void OpenGLUtils::clear() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+// Switches the active unit only when the texture has to be bound.
 void OpenGLUtils::bind_texture(const GLenum target, const GLuint texture_id) {
-    glActiveTexture(target);
+    const auto unit = static_cast<std::uint32_t>(target - GL_TEXTURE0);
+    if (!state.change_texture(unit, texture_id)) return;
+    if (state.change(RenderState::Binding::ACTIVE_TEXTURE, unit)) glActiveTexture(target);
     glBindTexture(GL_TEXTURE_2D, texture_id);
 }
 
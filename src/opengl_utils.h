@@ -3,10 +3,16 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <OpenGL/gl3.h>
 
 #include "glm/vec3.hpp"
+#include "orbit_inset.h"
+#include "planet_instances.h"
+#include "render_state.h"
+#include "trail_ring.h"
 
 
 struct Texture {
@@ -18,11 +24,20 @@ struct Texture {
 
 class OpenGLUtils {
     public:
+    // Binds go through a cache of the context's state and are skipped if the
+    // object is bound already.
+    static void use_program(GLuint program_id);
+    static void bind_vertex_array(GLuint vertex_array_id);
+    static void bind_buffer(GLuint buffer_id);
+    // Binds and counts of the last frame; call once a frame.
+    static const RenderState &render_state();
+    static void end_frame();
+    // Creates and binds a vertex array; attribute layouts set up next stay in it.
+    static GLuint create_vertex_array();
+    // Tightly packed vec3s at index.
     static void bind_array_buffer( GLuint index, GLuint buffer_id);
-    static void bind_array_buffer_with_data( GLuint index, GLuint buffer_id, const std::vector<glm::vec3> &);
     static Texture setup_texture(const std::string& name, GLuint& texture_id, const std::int32_t& width, const std::int32_t& height, GLenum color_attachment, GLenum target);
     static void draw_triangle_faces(GLsizei number_of_triangles);
-    static void disable_array_buffer(GLuint index);
     static void use_main_framebuffer();
     static GLuint create_framebuffer();
     static GLuint create_buffer();
@@ -31,9 +46,28 @@ class OpenGLUtils {
     static void check_buffer();
     static void bind_frame_buffer(GLuint buffer_id);
     static void clear();
-    static void draw_line(const std::vector<glm::vec3>& path_vec);
+    static void draw_points(GLsizei count);
+    static void draw_triangle_faces_instanced(GLsizei number_of_triangles, GLsizei instances);
+    // Planet instances: position and scale, RGBA8 color and flags at locations 2 to 4, one per instance.
+    static void bind_planet_instances(GLuint buffer_id);
+    // Trail vertices: position, sample, RGBA8 color and span at locations 0 to 3.
+    static void bind_trail_buffer(GLuint buffer_id);
+    static void allocate_array_buffer(GLuint buffer_id, std::size_t bytes);
+    static void update_array_buffer(GLuint buffer_id, std::size_t offset, std::size_t bytes, const void *data);
+    static void draw_line_strips(const std::vector<std::int32_t> &firsts, const std::vector<std::int32_t> &counts);
+    // Orbit view vertices: pixel position and RGBA8 color at locations 0 and 1.
+    static void bind_inset_buffer(GLuint buffer_id);
+    // Alpha blending without depth test or culling, for drawing into a 2D texture.
+    static void begin_blended_2d();
+    static void end_blended_2d();
     static GLuint create_render_buffer(int32_t width, int32_t height);
+    // A half float color texture, attached to the bound framebuffer.
+    static GLuint create_render_texture(int32_t width, int32_t height);
+    static void delete_texture(GLuint texture_id);
     static void bind_texture(GLenum target, GLuint texture_id);
+
+    private:
+    static RenderState state;
 };
 
 
@@ -0,0 +1,153 @@
+#include "orbit_inset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "color.h"
+
+namespace {
+constexpr double NEVER = -std::numeric_limits<double>::infinity();
+// Fading in steps of at least this many 255ths keeps the blend from
+// rounding away most of each step.
+constexpr int MIN_FADE_ALPHA = 4;
+// Bodies whose whole trail lies within this distance are drawn as dots.
+constexpr float STATIONARY = 1e-3f;
+constexpr float DOT_RADIUS = 2.0f;
+
+bool stationary(const CompactTrail &trail) {
+  return glm::length(trail.newest() - trail.oldest()) < STATIONARY;
+}
+} // namespace
+
+void OrbitInset::update(const std::vector<CompactTrail> &paths,
+                        const std::vector<Body> &bodies, const float new_scale,
+                        const int new_width, const int new_height) {
+  triangles.clear();
+  double newest = NEVER;
+  double longest = 0.0;
+  for (const CompactTrail &trail : paths) {
+    if (trail.empty())
+      continue;
+    newest = std::max(newest, trail.newest_time());
+    longest = std::max(longest, trail.duration());
+  }
+  // Lines fade to 1/255 over the longest trail's duration.
+  const double new_fade_time = std::max(longest, 1e-9) / std::log(255.0);
+  redraw = new_scale != scale || new_width != width || new_height != height ||
+           new_fade_time != fade_time || drawn.size() != paths.size();
+  scale = new_scale;
+  width = new_width;
+  height = new_height;
+  fade_time = new_fade_time;
+  if (redraw) {
+    redraw_all(paths, bodies, newest);
+    return;
+  }
+  if (newest == NEVER)
+    return;
+
+  // Fades in whole 255ths and moves on by just the time the step stands for,
+  // so rounding does not change the rate.
+  const double factor = std::exp(-(newest - faded) / fade_time);
+  const int alpha = static_cast<int>(255.0 * (1.0 - factor));
+  const bool fading = alpha >= MIN_FADE_ALPHA;
+  if (fading) {
+    add_quad({0.0f, 0.0f}, glm::vec2(width, height),
+             pack_color(glm::vec3(BACKGROUND),
+                        static_cast<float>(alpha) / 255.0f));
+    faded -= fade_time * std::log(1.0 - alpha / 255.0);
+  }
+  for (std::size_t b = 0; b < paths.size(); ++b) {
+    const CompactTrail &trail = paths[b];
+    Drawn &end = drawn[b];
+    if (trail.empty() || trail.newest_time() <= end.time)
+      continue;
+    if (end.time == NEVER || trail.size() < 2) {
+      end = {trail.newest_time(), trail.newest()};
+      continue;
+    }
+    const std::uint32_t color = pack_color(bodies[b].color);
+    if (stationary(trail)) {
+      if (fading)
+        add_dot(trail.newest(), color);
+      continue;
+    }
+    add_segment(to_pixels(end.position), to_pixels(trail.newest()), color);
+    end = {trail.newest_time(), trail.newest()};
+  }
+}
+
+void OrbitInset::redraw_all(const std::vector<CompactTrail> &paths,
+                            const std::vector<Body> &bodies,
+                            const double newest) {
+  faded = newest == NEVER ? 0.0 : newest;
+  drawn.assign(paths.size(), {NEVER, glm::vec3(0.0f)});
+  add_quad({0.0f, 0.0f}, glm::vec2(width, height),
+           pack_color(glm::vec3(BACKGROUND)));
+  for (std::size_t b = 0; b < paths.size(); ++b) {
+    const CompactTrail &trail = paths[b];
+    if (trail.empty())
+      continue;
+    drawn[b] = {trail.newest_time(), trail.newest()};
+    if (trail.size() < 2)
+      continue;
+    const glm::vec3 &color = bodies[b].color;
+    if (stationary(trail)) {
+      add_dot(trail.newest(), pack_color(color));
+      continue;
+    }
+    // As the incremental updates would have left them.
+    const glm::vec3 background(BACKGROUND);
+    bool first = true;
+    glm::vec2 from{0.0f};
+    trail.for_each([&](const double time, const glm::vec3 &position) {
+      const glm::vec2 to = to_pixels(position);
+      if (!first) {
+        const auto weight =
+            static_cast<float>(std::exp(-(faded - time) / fade_time));
+        add_segment(from, to,
+                    pack_color(background + weight * (color - background)));
+      }
+      first = false;
+      from = to;
+    });
+  }
+}
+
+glm::vec2 OrbitInset::to_pixels(const glm::vec3 &position) const {
+  return {0.5f * static_cast<float>(width) + position.x / scale,
+          0.5f * static_cast<float>(height) + position.y / scale};
+}
+
+void OrbitInset::add_quad(const glm::vec2 &min, const glm::vec2 &max,
+                          const std::uint32_t color) {
+  triangles.insert(triangles.end(), {{min, color},
+                                     {{max.x, min.y}, color},
+                                     {max, color},
+                                     {min, color},
+                                     {max, color},
+                                     {{min.x, max.y}, color}});
+}
+
+void OrbitInset::add_segment(const glm::vec2 &from, const glm::vec2 &to,
+                             const std::uint32_t color) {
+  const glm::vec2 along = to - from;
+  const float length = glm::length(along);
+  if (length <= 0.0f)
+    return;
+  const glm::vec2 side =
+      glm::vec2(-along.y, along.x) * (0.5f * LINE_WIDTH / length);
+  triangles.insert(triangles.end(), {{from - side, color},
+                                     {to - side, color},
+                                     {to + side, color},
+                                     {from - side, color},
+                                     {to + side, color},
+                                     {from + side, color}});
+}
+
+void OrbitInset::add_dot(const glm::vec3 &position, const std::uint32_t color) {
+  const glm::vec2 center = to_pixels(position);
+  add_quad(center - glm::vec2(DOT_RADIUS), center + glm::vec2(DOT_RADIUS),
+           color);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.h"
+#include "compact_trail.h"
+#include "glm/glm.hpp"
+
+// Corner of a triangle blended into the orbit view's texture: in pixels with
+// y up, RGBA8 color with red in the lowest byte.
+struct InsetVertex {
+  glm::vec2 position;
+  std::uint32_t color;
+};
+
+// The top-down orbit view, kept in a persistent texture that only gets the
+// new end of each trail drawn into it, so a frame costs the same however long
+// the trails are. Older lines fade as a translucent quad of the background is
+// blended over them. Everything is redrawn only when the view changes or a
+// trail starts over. Free of GL calls: update() lists what to draw.
+class OrbitInset {
+public:
+  // Gray level of the background lines fade into.
+  static constexpr float BACKGROUND = 10.0f / 255.0f;
+  static constexpr float LINE_WIDTH = 2.0f;
+
+  // Brings the view up to date with the trails, at scale au per pixel in a
+  // width by height texture centered on the origin.
+  void update(const std::vector<CompactTrail> &paths,
+              const std::vector<Body> &bodies, float scale, int width,
+              int height);
+  // Redraws everything on the next update(), as after trails started over.
+  void invalidate() { drawn.clear(); }
+
+  // Triangles to blend into the texture this frame, the quad that fades or
+  // clears it first. Empty if nothing changed.
+  [[nodiscard]] const std::vector<InsetVertex> &vertices() const {
+    return triangles;
+  }
+  // True if this frame's vertices replace the whole texture.
+  [[nodiscard]] bool redrawn() const { return redraw; }
+
+private:
+  struct Drawn {
+    double time; // of the trail point the texture's line ends at
+    glm::vec3 position;
+  };
+
+  float scale = 0.0f;
+  int width = 0;
+  int height = 0;
+  double fade_time = 0.0; // over which lines fade to 1/e
+  double faded = 0.0;     // trail time the texture has faded up to
+  std::vector<Drawn> drawn;
+  std::vector<InsetVertex> triangles;
+  bool redraw = false;
+
+  void redraw_all(const std::vector<CompactTrail> &paths,
+                  const std::vector<Body> &bodies, double newest);
+  [[nodiscard]] glm::vec2 to_pixels(const glm::vec3 &position) const;
+  void add_quad(const glm::vec2 &min, const glm::vec2 &max,
+                std::uint32_t color);
+  void add_segment(const glm::vec2 &from, const glm::vec2 &to,
+                   std::uint32_t color);
+  void add_dot(const glm::vec3 &position, std::uint32_t color);
+};
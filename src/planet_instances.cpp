@@ -0,0 +1,30 @@
+#include "planet_instances.h"
+
+#include <algorithm>
+
+#include "color.h"
+
+void PlanetInstances::update(const std::vector<glm::vec3> &positions,
+                             const std::vector<double> &masses,
+                             const std::vector<Body> &bodies,
+                             const std::optional<std::size_t> selected) {
+  staged.resize(positions.size());
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    const Body &body = bodies[i];
+    std::uint32_t flags = 0;
+    if (body.is_emitter) {
+      flags |= PlanetInstance::EMISSIVE;
+      light = positions[i];
+    }
+    if (selected == i)
+      flags |= PlanetInstance::SELECTED;
+    staged[i] = {.position = positions[i],
+                 .scale = scale(masses[i]),
+                 .color = pack_color(body.color),
+                 .flags = flags};
+  }
+}
+
+float PlanetInstances::scale(const double mass) {
+  return static_cast<float>(std::min(mass * 50000.0, 0.2));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "body_store.h"
+#include "glm/glm.hpp"
+
+// One body as the instanced planet shader sees it: 24 bytes. The model
+// transform is a translation and a uniform scale, so it takes four floats.
+struct PlanetInstance {
+  static constexpr std::uint32_t EMISSIVE = 1;
+  static constexpr std::uint32_t SELECTED = 2;
+
+  glm::vec3 position;
+  float scale;
+  std::uint32_t color; // RGBA8, red in the lowest byte
+  std::uint32_t flags;
+};
+
+// Per-body attributes for drawing every body of a mesh with one instanced
+// call, rebuilt once a frame into one buffer. Free of GL calls.
+class PlanetInstances {
+public:
+  void update(const std::vector<glm::vec3> &positions,
+              const std::vector<double> &masses,
+              const std::vector<Body> &bodies,
+              std::optional<std::size_t> selected);
+
+  [[nodiscard]] const std::vector<PlanetInstance> &instances() const {
+    return staged;
+  }
+  // Where the last emitting body was seen.
+  [[nodiscard]] const glm::vec3 &light_position() const { return light; }
+
+  // Radius of a body's sphere, growing with its mass up to a cap.
+  static float scale(double mass);
+
+private:
+  std::vector<PlanetInstance> staged;
+  glm::vec3 light{0.0f};
+};
@@ -0,0 +1,248 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::uint32_t GPU_TRACK = 0;
+
+struct Event {
+  const char *name;
+  std::int64_t begin, end;
+  std::uint32_t track;
+};
+
+struct Zone {
+  const char *name;
+  bool gpu;
+  std::size_t first_frame;
+  std::int64_t current = 0; // nanoseconds in the open frame
+  std::array<float, Profiler::HISTORY> history{};
+};
+
+std::mutex mutex;
+std::vector<Event> events; // ring of MAX_EVENTS once full
+std::size_t events_written = 0;
+std::vector<Zone> zones;
+std::array<float, Profiler::HISTORY> frames{};
+std::size_t frame_count = 0; // closed frames
+std::int64_t frame_begin = -1;
+std::vector<std::string> track_names{"GPU"};
+thread_local std::uint32_t thread_track = GPU_TRACK; // unassigned
+
+// Call with the mutex held.
+std::uint32_t track_of_thread() {
+  if (thread_track == GPU_TRACK) {
+    thread_track = static_cast<std::uint32_t>(track_names.size());
+    track_names.push_back("thread " + std::to_string(thread_track));
+  }
+  return thread_track;
+}
+
+// Call with the mutex held. Literals with the same text may still have
+// different addresses in different translation units.
+Zone &zone_of(const char *name, const bool gpu) {
+  for (auto &zone : zones) {
+    if (zone.gpu == gpu &&
+        (zone.name == name || std::strcmp(zone.name, name) == 0))
+      return zone;
+  }
+  return zones.emplace_back(
+      Zone{.name = name, .gpu = gpu, .first_frame = frame_count});
+}
+
+void add(const char *name, const std::int64_t begin, const std::int64_t end,
+         const bool gpu) {
+  const std::lock_guard lock(mutex);
+  const Event event{.name = name,
+                    .begin = begin,
+                    .end = end,
+                    .track = gpu ? GPU_TRACK : track_of_thread()};
+  if (events.size() < Profiler::MAX_EVENTS)
+    events.push_back(event);
+  else
+    events[events_written % Profiler::MAX_EVENTS] = event;
+  ++events_written;
+  zone_of(name, gpu).current += end - begin;
+}
+
+double percentile(const std::vector<float> &sorted, const double p) {
+  const auto rank = static_cast<std::size_t>(
+      p * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// Call with the mutex held. Covers the last count closed frames.
+ZoneStats summarize(const char *name, const bool gpu,
+                    const std::array<float, Profiler::HISTORY> &history,
+                    const std::size_t count) {
+  ZoneStats stats{.name = name, .gpu = gpu};
+  if (count == 0)
+    return stats;
+  std::vector<float> values;
+  values.reserve(count);
+  double sum = 0.0;
+  for (std::size_t k = frame_count - count; k < frame_count; ++k) {
+    values.push_back(history[k % Profiler::HISTORY]);
+    sum += values.back();
+  }
+  stats.last = values.back();
+  stats.mean = sum / static_cast<double>(count);
+  std::sort(values.begin(), values.end());
+  stats.p50 = percentile(values, 0.5);
+  stats.p95 = percentile(values, 0.95);
+  stats.p99 = percentile(values, 0.99);
+  stats.max = values.back();
+  return stats;
+}
+
+void write_escaped(std::FILE *file, const char *text) {
+  for (; *text != '\0'; ++text) {
+    if (*text == '"' || *text == '\\')
+      std::fputc('\\', file);
+    std::fputc(*text, file);
+  }
+}
+
+} // namespace
+
+void Profiler::set_enabled(const bool enabled) {
+  const std::lock_guard lock(mutex);
+  // The time spent disabled is not a frame.
+  if (enabled && !active.load(std::memory_order_relaxed))
+    frame_begin = -1;
+  active.store(enabled, std::memory_order_relaxed);
+}
+
+std::int64_t Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Profiler::record(const char *name, const std::int64_t begin,
+                      const std::int64_t end) {
+  add(name, begin, end, false);
+}
+
+void Profiler::record_gpu(const char *name, const std::int64_t begin,
+                          const std::int64_t end) {
+  add(name, begin, end, true);
+}
+
+void Profiler::set_thread_name(const char *name) {
+  const std::lock_guard lock(mutex);
+  track_names[track_of_thread()] = name;
+}
+
+void Profiler::end_frame() {
+  if (!enabled())
+    return;
+  const std::int64_t time = now();
+  const std::lock_guard lock(mutex);
+  if (frame_begin >= 0) {
+    const std::size_t slot = frame_count % HISTORY;
+    frames[slot] = static_cast<float>(time - frame_begin) * 1e-6f;
+    for (auto &zone : zones)
+      zone.history[slot] = static_cast<float>(zone.current) * 1e-6f;
+    ++frame_count;
+  }
+  for (auto &zone : zones)
+    zone.current = 0;
+  frame_begin = time;
+}
+
+std::vector<float> Profiler::frame_times() {
+  const std::lock_guard lock(mutex);
+  std::vector<float> times;
+  for (std::size_t k = frame_count - std::min(frame_count, HISTORY);
+       k < frame_count; ++k)
+    times.push_back(frames[k % HISTORY]);
+  return times;
+}
+
+ZoneStats Profiler::frame_stats() {
+  const std::lock_guard lock(mutex);
+  return summarize("frame", false, frames, std::min(frame_count, HISTORY));
+}
+
+std::vector<ZoneStats> Profiler::zone_stats() {
+  const std::lock_guard lock(mutex);
+  std::vector<ZoneStats> stats;
+  for (const auto &zone : zones) {
+    const std::size_t count =
+        std::min(frame_count - std::min(zone.first_frame, frame_count),
+                 HISTORY);
+    if (count > 0)
+      stats.push_back(summarize(zone.name, zone.gpu, zone.history, count));
+  }
+  return stats;
+}
+
+void Profiler::write_chrome_trace(const std::string &path) {
+  std::vector<Event> copy;
+  std::vector<std::string> names;
+  {
+    const std::lock_guard lock(mutex);
+    // Oldest first once the ring has wrapped.
+    const std::size_t start =
+        events.size() < MAX_EVENTS ? 0 : events_written % MAX_EVENTS;
+    copy.reserve(events.size());
+    copy.insert(copy.end(), events.begin() + static_cast<long>(start),
+                events.end());
+    copy.insert(copy.end(), events.begin(),
+                events.begin() + static_cast<long>(start));
+    names = track_names;
+  }
+
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr)
+    throw std::runtime_error("Cannot create trace " + path);
+  std::int64_t origin = 0;
+  if (!copy.empty())
+    origin = std::min_element(copy.begin(), copy.end(),
+                              [](const Event &a, const Event &b) {
+                                return a.begin < b.begin;
+                              })
+                 ->begin;
+
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+  for (std::size_t track = 0; track < names.size(); ++track) {
+    std::fprintf(file,
+                 "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%zu,\"args\":{\"name\":\"",
+                 track == 0 ? "" : ",", track);
+    write_escaped(file, names[track].c_str());
+    std::fputs("\"}}", file);
+  }
+  for (const auto &event : copy) {
+    std::fputs(",\n{\"name\":\"", file);
+    write_escaped(file, event.name);
+    // Microseconds, as the format expects.
+    std::fprintf(file,
+                 "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                 "\"ts\":%.3f,\"dur\":%.3f}",
+                 event.track == GPU_TRACK ? "gpu" : "cpu", event.track,
+                 static_cast<double>(event.begin - origin) * 1e-3,
+                 static_cast<double>(event.end - event.begin) * 1e-3);
+  }
+  std::fputs("\n]}\n", file);
+  const bool failed = std::ferror(file) != 0;
+  if (std::fclose(file) != 0 || failed)
+    throw std::runtime_error("Cannot write trace " + path);
+}
+
+void Profiler::reset() {
+  const std::lock_guard lock(mutex);
+  events.clear();
+  events_written = 0;
+  zones.clear();
+  frame_count = 0;
+  frame_begin = -1;
+}
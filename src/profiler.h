@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-frame timings of named zones, from CPU scopes and GPU timer queries.
+// Every zone is kept twice: summed per frame into a history of the last
+// HISTORY frames for the overlay's percentiles, and as a single event in a
+// ring of the last MAX_EVENTS for write_chrome_trace.
+//
+// Zones are cheap enough to stay in release builds: disabled, a zone is one
+// relaxed atomic load; enabled, it reads the clock twice and takes a mutex
+// once. Building without MAG3D_PROFILER removes them altogether.
+struct ZoneStats {
+  std::string name;
+  bool gpu;
+  // Milliseconds per frame over the frames since the zone first appeared.
+  double last = 0.0, mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+class Profiler {
+public:
+  static constexpr std::size_t HISTORY = 240;
+  static constexpr std::size_t MAX_EVENTS = std::size_t{1} << 16;
+
+  [[nodiscard]] static bool enabled() {
+    return active.load(std::memory_order_relaxed);
+  }
+  static void set_enabled(bool enabled);
+
+  // Steady clock in nanoseconds, the time base of all zones.
+  [[nodiscard]] static std::int64_t now();
+
+  // The name must outlive the profiler, usually a string literal.
+  static void record(const char *name, std::int64_t begin, std::int64_t end);
+  // GPU zones go on their own track and usually arrive a few frames late;
+  // they count towards the frame in which they are recorded.
+  static void record_gpu(const char *name, std::int64_t begin,
+                         std::int64_t end);
+  // Names the calling thread's track in the trace.
+  static void set_thread_name(const char *name);
+
+  // Closes the current frame. Call once per frame from the render thread.
+  static void end_frame();
+
+  // Milliseconds between calls to end_frame, oldest first.
+  [[nodiscard]] static std::vector<float> frame_times();
+  // Frame times summarised like a zone.
+  [[nodiscard]] static ZoneStats frame_stats();
+  [[nodiscard]] static std::vector<ZoneStats> zone_stats();
+
+  // Writes the event ring in Chrome's trace event format.
+  static void write_chrome_trace(const std::string &path);
+  static void reset();
+
+private:
+  static inline std::atomic<bool> active{false};
+};
+
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name)
+      : name(name), begin(Profiler::enabled() ? Profiler::now() : -1) {}
+  ~ProfileZone() {
+    if (begin >= 0)
+      Profiler::record(name, begin, Profiler::now());
+  }
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+  const char *name;
+  std::int64_t begin;
+};
+
+#define MAG3D_PROFILE_CONCAT_(a, b) a##b
+#define MAG3D_PROFILE_CONCAT(a, b) MAG3D_PROFILE_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as zone `name`.
+#ifdef MAG3D_PROFILER
+#define MAG3D_PROFILE_ZONE(name)                                               \
+  const ProfileZone MAG3D_PROFILE_CONCAT(profile_zone_, __LINE__) { name }
+#else
+#define MAG3D_PROFILE_ZONE(name) static_cast<void>(0)
+#endif
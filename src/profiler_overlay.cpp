@@ -0,0 +1,73 @@
+#include "profiler_overlay.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <exception>
+
+#include "imgui.h"
+#include "profiler.h"
+
+void ProfilerOverlay::draw() {
+    bool open = true;
+    ImGui::SetNextWindowSize(ImVec2(460, 0), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Profiler", &open);
+
+    const auto frames = Profiler::frame_times();
+    const auto frame = Profiler::frame_stats();
+    ImGui::Text("Frame: %.2f ms mean, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f", frame.mean, frame.p50, frame.p95,
+                frame.p99, frame.max);
+    const auto plot_max = static_cast<float>(std::max(frame.max, 1.0));
+    ImGui::PlotHistogram("##frame_times", frames.data(), static_cast<int>(frames.size()), 0, "last frames", 0.0f,
+                         plot_max, ImVec2(-1.0f, 60.0f));
+
+    // Distribution of the same frames from 0 to the slowest one.
+    std::array<float, 32> buckets{};
+    for (const float time: frames) {
+        const auto bucket = static_cast<std::size_t>(time / plot_max * static_cast<float>(buckets.size()));
+        buckets[std::min(bucket, buckets.size() - 1)] += 1.0f;
+    }
+    ImGui::PlotHistogram("##frame_distribution", buckets.data(), static_cast<int>(buckets.size()), 0,
+                         "distribution", 0.0f, FLT_MAX, ImVec2(-1.0f, 60.0f));
+
+    if (ImGui::BeginTable("zones", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        for (const char* label: {"Zone (ms per frame)", "Last", "Mean", "p50", "p95", "p99"}) {
+            ImGui::TableSetupColumn(label);
+        }
+        ImGui::TableHeadersRow();
+        for (const auto& zone: Profiler::zone_stats()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s%s", zone.name.c_str(), zone.gpu ? " (GPU)" : "");
+            for (const double value: {zone.last, zone.mean, zone.p50, zone.p95, zone.p99}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+#ifndef MAG3D_PROFILER
+    ImGui::TextDisabled("Built without MAG3D_PROFILER, only frame times are recorded");
+#endif
+
+    if (ImGui::Button("Export trace")) {
+        try {
+            Profiler::write_chrome_trace(trace_path);
+            status = "Wrote " + trace_path;
+        } catch (const std::exception& e) {
+            status = e.what();
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+        Profiler::reset();
+        status.clear();
+    }
+    if (!status.empty()) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(status.c_str());
+    }
+    ImGui::End();
+
+    if (!open) Profiler::set_enabled(false);
+}
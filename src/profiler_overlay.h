@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+
+// ImGui window with frame-time plots and the per-zone percentiles of the
+// Profiler, plus the Chrome trace export.
+class ProfilerOverlay {
+    std::string trace_path = "mag3d_trace.json";
+    std::string status;
+
+public:
+    // Closing the window disables the profiler.
+    void draw();
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// What is bound on the GL context, so that binding an object that already
+// is can be skipped. Free of GL calls: change() says whether the caller has
+// to issue one. Code that binds behind its back must call invalidate().
+class RenderState {
+public:
+  enum class Binding {
+    PROGRAM,
+    VERTEX_ARRAY,
+    ARRAY_BUFFER,
+    FRAMEBUFFER,
+    ACTIVE_TEXTURE, // the unit, counted from 0
+    COUNT
+  };
+  static constexpr std::size_t TEXTURE_UNITS = 16;
+
+  // True if binding does not hold id yet; from now on it does.
+  bool change(const Binding binding, const std::uint32_t id) {
+    return update(bound[static_cast<std::size_t>(binding)], id);
+  }
+  // Same for the 2D texture of a unit.
+  bool change_texture(const std::size_t unit, const std::uint32_t id) {
+    return update(textures[unit], id);
+  }
+  // Deleting a texture unbinds it from every unit.
+  void deleted_texture(const std::uint32_t id) {
+    for (std::uint32_t &texture : textures) {
+      if (texture == id)
+        texture = 0;
+    }
+  }
+  // Nothing is known to be bound any more.
+  void invalidate() {
+    bound.fill(UNKNOWN);
+    textures.fill(UNKNOWN);
+  }
+
+  // Binds issued and skipped, in the last frame and so far in this one.
+  [[nodiscard]] std::uint64_t issued() const { return last_issued; }
+  [[nodiscard]] std::uint64_t skipped() const { return last_skipped; }
+  void end_frame() {
+    last_issued = issuing;
+    last_skipped = skipping;
+    issuing = 0;
+    skipping = 0;
+  }
+
+private:
+  static constexpr std::uint32_t UNKNOWN =
+      std::numeric_limits<std::uint32_t>::max();
+
+  std::array<std::uint32_t, static_cast<std::size_t>(Binding::COUNT)> bound =
+      filled<static_cast<std::size_t>(Binding::COUNT)>();
+  std::array<std::uint32_t, TEXTURE_UNITS> textures =
+      filled<TEXTURE_UNITS>();
+  std::uint64_t issuing = 0;
+  std::uint64_t skipping = 0;
+  std::uint64_t last_issued = 0;
+  std::uint64_t last_skipped = 0;
+
+  template <std::size_t N> static std::array<std::uint32_t, N> filled() {
+    std::array<std::uint32_t, N> slots{};
+    slots.fill(UNKNOWN);
+    return slots;
+  }
+
+  bool update(std::uint32_t &slot, const std::uint32_t id) {
+    if (slot == id) {
+      ++skipping;
+      return false;
+    }
+    slot = id;
+    ++issuing;
+    return true;
+  }
+};
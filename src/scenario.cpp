@@ -0,0 +1,515 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include "glm/gtc/constants.hpp"
+
+const char *const Scenario::INNER_SOLAR_SYSTEM = R"(
+# Velocities are tilted out of the ecliptic by each orbit's inclination.
+body Sun mass=1 color=1,0.5,0 emitter max_path=10
+body Mercury mass=1.1e-7 position=0.39,0,0
+  velocity=0,0.027148573418823693,0.003335349584895216
+  color=0.678,0.6588,0.647 max_path=2000
+body Venus mass=1.63e-6 position=0.72,0,0
+  velocity=0,0.020190245814298725,0.0011977534841347282
+  color=0.7568,0.56078,0.0901
+body Earth mass=2e-6 position=1,0,0 velocity=0,0.017199389,0
+  color=0.4196,0.57647,0.83921
+body Mars mass=3.213e-7 position=1.5,0,0
+  velocity=0,0.013898398711830314,0.00044843007958946467
+  color=0.757,0.27,0.0549 max_path=10000
+)";
+
+namespace {
+
+enum Column { A, E, I, NODE, PERI, MEAN_ANOMALY, NAME, COLUMN_COUNT };
+
+constexpr std::array<std::array<std::string_view, 3>, COLUMN_COUNT>
+    COLUMN_NAMES{{{"a"},
+                  {"e"},
+                  {"i", "incl"},
+                  {"node", "om"},
+                  {"peri", "w"},
+                  {"M", "ma"},
+                  {"name", "full_name", "designation"}}};
+
+std::runtime_error error_at(const std::size_t line, const std::string &what) {
+  return std::runtime_error("line " + std::to_string(line) + ": " + what);
+}
+
+std::string_view trim(std::string_view text) {
+  const auto first = text.find_first_not_of(" \t\r\"");
+  if (first == std::string_view::npos)
+    return {};
+  const auto last = text.find_last_not_of(" \t\r\"");
+  return text.substr(first, last - first + 1);
+}
+
+bool parse_number(const std::string_view text, double &value) {
+  const auto field = trim(text);
+  const char *end = field.data() + field.size();
+  const auto result = std::from_chars(field.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end && !field.empty();
+}
+
+template <std::size_t N>
+bool parse_numbers(std::string_view text, std::array<double, N> &values) {
+  for (std::size_t k = 0; k < N; ++k) {
+    const auto comma = k + 1 < N ? text.find(',') : text.size();
+    if (comma == std::string_view::npos ||
+        !parse_number(text.substr(0, comma), values[k]))
+      return false;
+    text.remove_prefix(std::min(text.size(), comma + 1));
+  }
+  return true;
+}
+
+// A slice of a catalog's rows. Row numbers count from the start of the
+// slice until the results are merged.
+struct CatalogChunk {
+  std::string_view text;
+  ElementCatalog elements;
+  std::size_t rows = 0;
+  std::size_t error_row = 0;
+  std::string error;
+};
+
+void parse_rows(CatalogChunk &chunk,
+                const std::array<int, COLUMN_COUNT> &columns,
+                const bool with_names) {
+  const int last_column = *std::max_element(columns.begin(), columns.end());
+  AlignedVector<double> *outputs[] = {
+      &chunk.elements.a,    &chunk.elements.e,    &chunk.elements.i,
+      &chunk.elements.node, &chunk.elements.peri, &chunk.elements.mean_anomaly};
+  std::string_view text = chunk.text;
+  while (!text.empty()) {
+    const auto newline = text.find('\n');
+    const auto line = text.substr(0, newline);
+    text.remove_prefix(newline == std::string_view::npos ? text.size()
+                                                         : newline + 1);
+    ++chunk.rows;
+    if (trim(line).empty())
+      continue;
+
+    std::array<double, NAME> values{};
+    std::string_view name;
+    std::string_view rest = line;
+    int column = 0;
+    for (; column <= last_column; ++column) {
+      const auto comma = rest.find(',');
+      const auto field = rest.substr(0, comma);
+      for (int k = 0; k < NAME; ++k) {
+        if (columns[k] == column && !parse_number(field, values[k])) {
+          chunk.error_row = chunk.rows;
+          chunk.error = "cannot read '" + std::string(trim(field)) + "'";
+          return;
+        }
+      }
+      if (columns[NAME] == column)
+        name = trim(field);
+      if (comma == std::string_view::npos)
+        break;
+      rest.remove_prefix(comma + 1);
+    }
+    if (column < last_column) {
+      chunk.error_row = chunk.rows;
+      chunk.error = "too few columns";
+      return;
+    }
+    if (!(values[E] >= 0.0 && values[E] < 1.0) || !(values[A] > 0.0)) {
+      chunk.error_row = chunk.rows;
+      chunk.error = "only elliptic orbits are supported";
+      return;
+    }
+    for (int k = 0; k < NAME; ++k)
+      outputs[k]->push_back(values[k]);
+    if (with_names)
+      chunk.elements.names.emplace_back(name);
+  }
+}
+
+void add_catalog(SolarSystemCalculator &calculator, const std::string &path,
+                 const std::optional<double> mass,
+                 const std::size_t max_path) {
+  auto &pool = calculator.pool();
+  const auto elements = Scenario::load_catalog(path, pool, mass.has_value());
+  TracerStore states;
+  Scenario::to_state_vectors(elements,
+                             calculator.gravitational_constant() *
+                                 calculator.state.mass[0],
+                             states, pool);
+  const glm::dvec3 center = calculator.state.position(0);
+  const glm::dvec3 center_velocity = calculator.state.velocity(0);
+
+  if (!mass) {
+    auto &tracers = calculator.tracers;
+    const std::size_t first = tracers.size();
+    tracers.resize(first + states.size());
+    pool.parallel_for(0, states.size(), 16384,
+                      [&](const std::size_t begin, const std::size_t end) {
+                        for (std::size_t k = begin; k < end; ++k) {
+                          tracers.x[first + k] = states.x[k] + center.x;
+                          tracers.y[first + k] = states.y[k] + center.y;
+                          tracers.z[first + k] = states.z[k] + center.z;
+                          tracers.vx[first + k] =
+                              states.vx[k] + center_velocity.x;
+                          tracers.vy[first + k] =
+                              states.vy[k] + center_velocity.y;
+                          tracers.vz[first + k] =
+                              states.vz[k] + center_velocity.z;
+                        }
+                      });
+    return;
+  }
+
+  calculator.bodies.reserve(calculator.bodies.size() + states.size());
+  for (std::size_t k = 0; k < states.size(); ++k) {
+    calculator.state.add(states.position(k) + center,
+                         states.velocity(k) + center_velocity, *mass);
+    calculator.bodies.push_back(
+        {.name = elements.names[k].empty() ? "Asteroid" : elements.names[k],
+         .color = glm::vec3(0.6f),
+         .max_path = max_path});
+  }
+}
+
+} // namespace
+
+void ElementCatalog::resize(const std::size_t count) {
+  for (auto *column : {&a, &e, &i, &node, &peri, &mean_anomaly})
+    column->resize(count);
+}
+
+void Scenario::load(const std::string &path,
+                    SolarSystemCalculator &calculator) {
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Cannot open scenario " + path);
+  std::stringstream text;
+  text << file.rdbuf();
+  try {
+    parse(text.str(), calculator,
+          std::filesystem::path(path).parent_path());
+  } catch (const std::runtime_error &e) {
+    throw std::runtime_error(path + ", " + e.what());
+  }
+}
+
+void Scenario::parse(std::string_view text, SolarSystemCalculator &calculator,
+                     const std::filesystem::path &directory) {
+  calculator.state.clear();
+  calculator.bodies.clear();
+  calculator.tracers.clear();
+  calculator.elapsed_simulation_time = 0.0;
+
+  // A directive continues on indented lines, so split into statements
+  // first and remember the line each one starts on.
+  std::vector<std::pair<std::size_t, std::string>> statements;
+  for (std::size_t line_number = 1; !text.empty(); ++line_number) {
+    const auto newline = text.find('\n');
+    auto line = text.substr(0, newline);
+    text.remove_prefix(newline == std::string_view::npos ? text.size()
+                                                         : newline + 1);
+    line = line.substr(0, line.find('#'));
+    if (trim(line).empty())
+      continue;
+    if ((line.front() == ' ' || line.front() == '\t') && !statements.empty())
+      statements.back().second.append(" ").append(line);
+    else
+      statements.emplace_back(line_number, std::string(line));
+  }
+
+  for (const auto &[line_number, statement] : statements) {
+    std::istringstream tokens(statement);
+    std::string directive;
+    std::string subject;
+    tokens >> directive >> subject;
+    if (subject.empty())
+      throw error_at(line_number, "expected a name after " + directive);
+    if (directive == "precision") {
+      const auto precision = GravityKernel::parse_precision(subject);
+      if (!precision)
+        throw error_at(line_number, "unknown precision '" + subject + "'");
+      calculator.set_precision(*precision);
+      continue;
+    }
+
+    std::optional<double> mass;
+    std::optional<std::array<double, 3>> position, velocity;
+    std::array<double, 3> color{1.0, 1.0, 1.0};
+    std::array<std::optional<double>, NAME> elements;
+    bool emitter = false;
+    std::size_t max_path = 5000;
+    double radius = 0.0;
+
+    std::string token;
+    while (tokens >> token) {
+      const auto equals = token.find('=');
+      const std::string key = token.substr(0, equals);
+      const std::string_view value =
+          equals == std::string::npos
+              ? std::string_view{}
+              : std::string_view(token).substr(equals + 1);
+      double number = 0.0;
+      std::array<double, 3> vector{};
+      bool valid = true;
+      if (key == "emitter") {
+        emitter = true;
+      } else if (key == "mass") {
+        valid = parse_number(value, number) && number >= 0.0;
+        mass = number;
+      } else if (key == "max_path") {
+        valid = parse_number(value, number) && number >= 0.0;
+        max_path = static_cast<std::size_t>(number);
+      } else if (key == "radius") {
+        valid = parse_number(value, number) && number >= 0.0;
+        radius = number;
+      } else if (key == "position" || key == "velocity" || key == "color") {
+        valid = parse_numbers(value, vector);
+        if (key == "position")
+          position = vector;
+        else if (key == "velocity")
+          velocity = vector;
+        else
+          color = vector;
+      } else {
+        const auto column = std::find_if(
+            COLUMN_NAMES.begin(), COLUMN_NAMES.begin() + NAME,
+            [&](const auto &names) { return names[0] == key; });
+        if (column == COLUMN_NAMES.begin() + NAME)
+          throw error_at(line_number, "unknown key '" + key + "'");
+        valid = parse_number(value, number);
+        elements[column - COLUMN_NAMES.begin()] = number;
+      }
+      if (!valid)
+        throw error_at(line_number, "invalid value in '" + token + "'");
+    }
+
+    if (directive == "catalog") {
+      if (calculator.state.size() == 0)
+        throw error_at(line_number, "a catalog needs a central body first");
+      try {
+        add_catalog(calculator, (directory / subject).string(), mass,
+                    max_path);
+      } catch (const std::runtime_error &e) {
+        throw error_at(line_number, subject + ", " + e.what());
+      }
+      continue;
+    }
+    if (directive != "body")
+      throw error_at(line_number, "unknown directive '" + directive + "'");
+
+    const bool has_elements = std::any_of(
+        elements.begin(), elements.end(),
+        [](const auto &element) { return element.has_value(); });
+    glm::dvec3 r(0.0), v(0.0);
+    if (has_elements) {
+      if (position || velocity)
+        throw error_at(line_number,
+                       "give either orbital elements or position/velocity");
+      if (calculator.state.size() == 0)
+        throw error_at(line_number,
+                       "orbital elements need a central body first");
+      ElementCatalog single;
+      single.a.push_back(elements[A].value_or(0.0));
+      single.e.push_back(elements[E].value_or(0.0));
+      single.i.push_back(elements[I].value_or(0.0));
+      single.node.push_back(elements[NODE].value_or(0.0));
+      single.peri.push_back(elements[PERI].value_or(0.0));
+      single.mean_anomaly.push_back(elements[MEAN_ANOMALY].value_or(0.0));
+      if (!(single.a[0] > 0.0) || !(single.e[0] >= 0.0 && single.e[0] < 1.0))
+        throw error_at(line_number, "only elliptic orbits are supported");
+      TracerStore state;
+      to_state_vectors(single,
+                       calculator.gravitational_constant() *
+                           (calculator.state.mass[0] + mass.value_or(0.0)),
+                       state, calculator.pool());
+      r = calculator.state.position(0) + state.position(0);
+      v = calculator.state.velocity(0) + state.velocity(0);
+    } else {
+      if (position)
+        r = {(*position)[0], (*position)[1], (*position)[2]};
+      if (velocity)
+        v = {(*velocity)[0], (*velocity)[1], (*velocity)[2]};
+    }
+    if (!mass)
+      throw error_at(line_number, "body " + subject + " has no mass");
+    calculator.state.add(r, v, *mass);
+    calculator.bodies.push_back(
+        {.name = subject,
+         .color = glm::vec3(color[0], color[1], color[2]),
+         .is_emitter = emitter,
+         .max_path = max_path,
+         .radius = radius});
+  }
+  calculator.current_integrator().reset();
+  calculator.invalidate_accelerations();
+}
+
+ElementCatalog Scenario::load_catalog(const std::string &path,
+                                      ThreadPool &pool,
+                                      const bool with_names) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    throw std::runtime_error("Cannot open catalog " + path);
+  std::string text(static_cast<std::size_t>(file.tellg()), '\0');
+  file.seekg(0);
+  file.read(text.data(), static_cast<std::streamsize>(text.size()));
+  return parse_catalog(text, pool, with_names);
+}
+
+ElementCatalog Scenario::parse_catalog(std::string_view text, ThreadPool &pool,
+                                       const bool with_names) {
+  const auto newline = text.find('\n');
+  const auto header = text.substr(0, newline);
+  text.remove_prefix(newline == std::string_view::npos ? text.size()
+                                                       : newline + 1);
+
+  std::array<int, COLUMN_COUNT> columns;
+  columns.fill(-1);
+  std::string_view rest = header;
+  for (int column = 0;; ++column) {
+    const auto comma = rest.find(',');
+    const auto field = trim(rest.substr(0, comma));
+    for (int k = 0; k < COLUMN_COUNT; ++k) {
+      if (std::find(COLUMN_NAMES[k].begin(), COLUMN_NAMES[k].end(), field) !=
+              COLUMN_NAMES[k].end() &&
+          !field.empty() && columns[k] < 0)
+        columns[k] = column;
+    }
+    if (comma == std::string_view::npos)
+      break;
+    rest.remove_prefix(comma + 1);
+  }
+  for (int k = 0; k < NAME; ++k) {
+    if (columns[k] < 0)
+      throw error_at(1, "missing column '" +
+                            std::string(COLUMN_NAMES[k][0]) + "'");
+  }
+  if (!with_names)
+    columns[NAME] = -1;
+
+  // Cut at line ends near equal byte offsets; a few chunks per thread so
+  // that stealing evens out lines of different length.
+  const std::size_t chunk_count = std::clamp<std::size_t>(
+      text.size() / 65536, 1, 4 * pool.size());
+  std::vector<CatalogChunk> chunks(chunk_count);
+  std::size_t begin = 0;
+  for (std::size_t c = 0; c < chunk_count; ++c) {
+    std::size_t end = c + 1 == chunk_count
+                          ? text.size()
+                          : text.size() * (c + 1) / chunk_count;
+    end = std::max(end, begin);
+    const auto line_end = text.find('\n', end == 0 ? 0 : end - 1);
+    end = line_end == std::string_view::npos ? text.size() : line_end + 1;
+    chunks[c].text = text.substr(begin, end - begin);
+    begin = end;
+  }
+  pool.parallel_for(0, chunk_count, 1,
+                    [&](const std::size_t first, const std::size_t last) {
+                      for (std::size_t c = first; c < last; ++c)
+                        parse_rows(chunks[c], columns, with_names);
+                    });
+
+  std::vector<std::size_t> offsets(chunk_count + 1, 0);
+  std::size_t rows_before = 1; // the header
+  for (std::size_t c = 0; c < chunk_count; ++c) {
+    if (!chunks[c].error.empty())
+      throw error_at(rows_before + chunks[c].error_row, chunks[c].error);
+    rows_before += chunks[c].rows;
+    offsets[c + 1] = offsets[c] + chunks[c].elements.size();
+  }
+
+  ElementCatalog catalog;
+  catalog.resize(offsets.back());
+  if (with_names)
+    catalog.names.resize(offsets.back());
+  pool.parallel_for(
+      0, chunk_count, 1, [&](const std::size_t first, const std::size_t last) {
+        for (std::size_t c = first; c < last; ++c) {
+          const auto &part = chunks[c].elements;
+          const std::size_t at = offsets[c];
+          std::copy(part.a.begin(), part.a.end(), catalog.a.begin() + at);
+          std::copy(part.e.begin(), part.e.end(), catalog.e.begin() + at);
+          std::copy(part.i.begin(), part.i.end(), catalog.i.begin() + at);
+          std::copy(part.node.begin(), part.node.end(),
+                    catalog.node.begin() + at);
+          std::copy(part.peri.begin(), part.peri.end(),
+                    catalog.peri.begin() + at);
+          std::copy(part.mean_anomaly.begin(), part.mean_anomaly.end(),
+                    catalog.mean_anomaly.begin() + at);
+          std::move(chunks[c].elements.names.begin(),
+                    chunks[c].elements.names.end(),
+                    catalog.names.begin() + at);
+        }
+      });
+  return catalog;
+}
+
+// Kepler's equation is solved with a fixed number of Halley steps and no
+// data-dependent branches, so every iteration of the loop does the same
+// work. Very eccentric orbits start from E = pi, which converges for any
+// mean anomaly in [0, 2 pi).
+void Scenario::to_state_vectors(const ElementCatalog &elements,
+                                const double mu, TracerStore &out,
+                                ThreadPool &pool) {
+  out.resize(elements.size());
+  constexpr double degrees = glm::pi<double>() / 180.0;
+  constexpr int halley_steps = 6;
+  pool.parallel_for(
+      0, elements.size(), 16384,
+      [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+          const double a = elements.a[k];
+          const double e = elements.e[k];
+          double mean_anomaly = std::fmod(elements.mean_anomaly[k] * degrees,
+                                          glm::two_pi<double>());
+          mean_anomaly += mean_anomaly < 0.0 ? glm::two_pi<double>() : 0.0;
+          double eccentric_anomaly =
+              e < 0.8 ? mean_anomaly : glm::pi<double>();
+          for (int step = 0; step < halley_steps; ++step) {
+            const double sin_e = e * std::sin(eccentric_anomaly);
+            const double cos_e = e * std::cos(eccentric_anomaly);
+            const double f = eccentric_anomaly - sin_e - mean_anomaly;
+            const double slope = 1.0 - cos_e;
+            eccentric_anomaly -= f * slope / (slope * slope - 0.5 * f * sin_e);
+          }
+          const double sin_e = std::sin(eccentric_anomaly);
+          const double cos_e = std::cos(eccentric_anomaly);
+          const double root = std::sqrt(1.0 - e * e);
+          const double rate = std::sqrt(mu / a) / (1.0 - e * cos_e);
+
+          // Perifocal frame, then rotated by peri, i and node.
+          const double px = a * (cos_e - e);
+          const double py = a * root * sin_e;
+          const double pvx = -rate * sin_e;
+          const double pvy = rate * root * cos_e;
+
+          const double cos_o = std::cos(elements.node[k] * degrees);
+          const double sin_o = std::sin(elements.node[k] * degrees);
+          const double cos_w = std::cos(elements.peri[k] * degrees);
+          const double sin_w = std::sin(elements.peri[k] * degrees);
+          const double cos_i = std::cos(elements.i[k] * degrees);
+          const double sin_i = std::sin(elements.i[k] * degrees);
+          const double p[] = {cos_o * cos_w - sin_o * sin_w * cos_i,
+                              sin_o * cos_w + cos_o * sin_w * cos_i,
+                              sin_w * sin_i};
+          const double q[] = {-cos_o * sin_w - sin_o * cos_w * cos_i,
+                              -sin_o * sin_w + cos_o * cos_w * cos_i,
+                              cos_w * sin_i};
+          out.x[k] = px * p[0] + py * q[0];
+          out.y[k] = px * p[1] + py * q[1];
+          out.z[k] = px * p[2] + py * q[2];
+          out.vx[k] = pvx * p[0] + pvy * q[0];
+          out.vy[k] = pvx * p[1] + pvy * q[1];
+          out.vz[k] = pvx * p[2] + pvy * q[2];
+        }
+      });
+}
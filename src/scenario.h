@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "solar_system_calculator.h"
+#include "thread_pool.h"
+#include "tracer_store.h"
+
+// Keplerian elements of many small bodies, one array per element so the
+// conversion to state vectors runs as one loop over contiguous memory.
+struct ElementCatalog {
+  AlignedVector<double> a;            // semi-major axis, au
+  AlignedVector<double> e;            // eccentricity, < 1
+  AlignedVector<double> i;            // inclination, degrees
+  AlignedVector<double> node;         // longitude of ascending node, degrees
+  AlignedVector<double> peri;         // argument of perihelion, degrees
+  AlignedVector<double> mean_anomaly; // degrees
+  std::vector<std::string> names;     // empty unless asked for
+
+  [[nodiscard]] std::size_t size() const { return a.size(); }
+  void resize(std::size_t count);
+};
+
+// Scenario files describe a system line by line:
+//
+//   # comment
+//   body Sun mass=1 color=1,0.5,0 emitter max_path=10
+//   body Earth mass=2e-6 position=1,0,0 velocity=0,0.0172,0
+//   body Ceres mass=4.7e-10 a=2.77 e=0.079 i=10.6 node=80.3 peri=73.6 M=291
+//   catalog main_belt.csv
+//   catalog big_asteroids.csv mass=1e-12
+//
+// A body may also give its radius= in au for collision detection. A line
+// `precision float` (or mixed, double) selects the kernel arithmetic, see
+// Precision; without one the calculator keeps its own.
+// Units are au, au/day and m_sun. Orbital elements are relative to the
+// first body. A catalog is a CSV file of orbital elements with a header
+// row naming the columns a, e, i, node (or om), peri (or w) and M (or ma),
+// plus optionally name; other columns are ignored, quoted fields may not
+// contain commas. Catalog objects become massless tracers unless a mass is
+// given. Relative paths are resolved against the scenario file.
+class Scenario {
+public:
+  // Sun, Mercury, Venus, Earth and Mars.
+  static const char *const INNER_SOLAR_SYSTEM;
+
+  // Replace the bodies, tracers and time of calculator and keep its
+  // integrator and force settings, apart from a precision line. Throw
+  // std::runtime_error naming the line of the first error.
+  static void load(const std::string &path, SolarSystemCalculator &calculator);
+  static void parse(std::string_view text, SolarSystemCalculator &calculator,
+                    const std::filesystem::path &directory = {});
+
+  // Splits the rows into chunks that are parsed in parallel. Throws
+  // std::runtime_error on a missing column or a malformed row.
+  static ElementCatalog load_catalog(const std::string &path, ThreadPool &pool,
+                                     bool with_names = false);
+  static ElementCatalog parse_catalog(std::string_view text, ThreadPool &pool,
+                                      bool with_names = false);
+
+  // Positions and velocities relative to a central body with gravitational
+  // parameter mu = G * M. Resizes out to the catalog size.
+  static void to_state_vectors(const ElementCatalog &elements, double mu,
+                               TracerStore &out, ThreadPool &pool);
+};
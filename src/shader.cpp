@@ -1,12 +1,16 @@
 #include "shader.h"
+#include "opengl_utils.h"
 
-void Shader::use() const { glUseProgram(programID); }
+void Shader::use() const { OpenGLUtils::use_program(programID); }
 void Shader::setBool(const std::string &name, const bool value) const {
   glUniform1i(glGetUniformLocation(programID, name.c_str()), (int)value);
 }
 void Shader::setInt(const std::string &name, const int value) const {
   glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
 }
+void Shader::setUInt(const std::string &name, const unsigned int value) const {
+  glUniform1ui(glGetUniformLocation(programID, name.c_str()), value);
+}
 void Shader::setFloat(const std::string &name, const float value) const {
   glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
 }
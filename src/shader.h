@@ -17,6 +17,7 @@ public:
     void use() const;
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
+    void setUInt(const std::string &name, unsigned int value) const;
     void setFloat(const std::string &name, float value) const;
     void setVec2(const std::string &name, const glm::vec2 &value) const;
     void setVec2(const std::string &name, float x, float y) const;
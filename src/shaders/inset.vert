@@ -0,0 +1,10 @@
+#version 330 core
+layout(location = 0) in vec2 vertexPosition;
+layout(location = 1) in vec4 vertexColor;
+uniform vec2 size;
+out vec4 insetColor;
+
+void main() {
+    insetColor = vertexColor;
+    gl_Position = vec4(2.0 * vertexPosition / size - 1.0, 0.0, 1.0);
+}
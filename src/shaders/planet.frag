@@ -2,18 +2,19 @@
 
 in vec3 FragPos;
 in vec3 Normal;
+flat in vec3 objectColor;
+flat in uint flags;
 
 uniform vec3 lightPos;
-uniform vec3 objectColor;
 uniform vec3 lightColor;
-uniform bool isEmissive;
-uniform bool selected;
 
 layout(location = 0) out vec4 color;
 layout(location = 1) out vec4 emissive_color;
 
 
 void main() {
+	bool isEmissive = (flags & 1u) != 0u;
+	bool selected = (flags & 2u) != 0u;
 	if (isEmissive) {
 		color = vec4(0.0); // no lighting
 		emissive_color = vec4(objectColor, 1.0);
@@ -2,16 +2,23 @@
 
 layout(location = 0) in vec3 vertexPosition_modelspace;
 layout(location = 1) in vec3 vertexNormal_modelspace;
+// Per body: position and scale, RGBA8 color, EMISSIVE = 1 | SELECTED = 2.
+layout(location = 2) in vec4 instancePositionScale;
+layout(location = 3) in vec4 instanceColor;
+layout(location = 4) in uint instanceFlags;
 
-uniform mat4 MVP;
-uniform mat4 V;
-uniform mat4 M;
+uniform mat4 VP;
 
 out vec3 FragPos;
 out vec3 Normal;
+flat out vec3 objectColor;
+flat out uint flags;
 
 void main() {
-    FragPos = vec3(M * vec4(vertexPosition_modelspace, 1.0));
-    Normal = mat3(transpose(inverse(M))) * vertexNormal_modelspace;
-    gl_Position = MVP * vec4(vertexPosition_modelspace, 1.0);
+    // A translation and a uniform scale leave the normals as they are.
+    FragPos = instancePositionScale.xyz + instancePositionScale.w * vertexPosition_modelspace;
+    Normal = vertexNormal_modelspace;
+    objectColor = instanceColor.rgb;
+    flags = instanceFlags;
+    gl_Position = VP * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,7 @@
+#version 330 core
+in vec3 trailColor;
+out vec4 color;
+
+void main() {
+    color = vec4(trailColor, 1.0);
+}
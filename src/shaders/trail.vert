@@ -0,0 +1,15 @@
+#version 330 core
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in uint vertexSample;
+layout(location = 2) in vec4 vertexColor;
+layout(location = 3) in float vertexSpan;
+uniform mat4 VP;
+uniform uint newestSample;
+out vec3 trailColor;
+
+void main() {
+    // Fades to the black background over the trail's length, oldest last.
+    float age = float(newestSample - vertexSample) / vertexSpan;
+    trailColor = vertexColor.rgb * (1.0 - clamp(age, 0.0, 1.0));
+    gl_Position = VP * vec4(vertexPosition, 1.0);
+}
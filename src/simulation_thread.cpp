@@ -0,0 +1,316 @@
+#include "simulation_thread.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "checkpoint.h"
+#include "profiler.h"
+
+SimulationThread::SimulationThread(SolarSystemCalculator &calculator,
+                                   const double step_rate,
+                                   std::string checkpoint_path,
+                                   std::string trajectory_path)
+    : m_calculator(calculator), step_rate(step_rate),
+      checkpoint_path(std::move(checkpoint_path)),
+      trajectory_path(std::move(trajectory_path)) {
+  publish();
+}
+
+SimulationThread::~SimulationThread() { stop(); }
+
+void SimulationThread::start() {
+  if (running.exchange(true))
+    return;
+  thread = std::thread([this] { run(); });
+}
+
+void SimulationThread::stop() {
+  running = false;
+  if (thread.joinable())
+    thread.join();
+  collect_checkpoint(true);
+  set_recording(false);
+}
+
+bool SimulationThread::send(const SimulationCommand &command) {
+  return commands.push(command);
+}
+
+const std::vector<Body> &SimulationThread::bodies() const {
+  static const std::vector<Body> none;
+  const auto &bodies = snapshots.read_buffer().bodies;
+  return bodies ? *bodies : none;
+}
+
+bool SimulationThread::update_tracers() { return tracer_frames.update(); }
+
+const SimulationSnapshot &SimulationThread::snapshot() {
+  snapshots.update();
+  return snapshots.read_buffer();
+}
+
+void SimulationThread::run() {
+  using clock = std::chrono::steady_clock;
+  auto next_step = clock::now();
+  auto window_start = next_step;
+  std::uint64_t window_steps = 0;
+  double window_simulated_time = 0.0;
+  Profiler::set_thread_name("simulation");
+
+  while (running.load(std::memory_order_relaxed)) {
+    while (const auto command = commands.pop())
+      apply(*command);
+    collect_checkpoint(false);
+
+    const auto step_duration = std::chrono::duration<double>(1.0 / step_rate);
+    if (!m_calculator.paused) {
+      MAG3D_PROFILE_ZONE("physics");
+      const auto begin = clock::now();
+      last_report = scheduler.advance(
+          m_calculator,
+          step_duration.count() / 86400.0 * m_calculator.simulation_time_factor,
+          step_duration * budget_fraction);
+      step_milliseconds =
+          std::chrono::duration<double, std::milli>(clock::now() - begin)
+              .count();
+      window_simulated_time += last_report.simulated_time;
+      collect_events();
+      // A merge changes the body count, which ends the trajectory.
+      if (recorder && m_calculator.state.size() != recorder->body_count())
+        set_recording(false);
+      else if (recorder)
+        recorder->record(m_calculator.elapsed_simulation_time,
+                         m_calculator.state);
+      ++steps;
+      ++window_steps;
+    }
+
+    const auto now = clock::now();
+    if (now - window_start >= std::chrono::seconds(1)) {
+      const double window_seconds =
+          std::chrono::duration<double>(now - window_start).count();
+      steps_per_second = static_cast<double>(window_steps) / window_seconds;
+      achieved_time_factor = window_simulated_time * 86400.0 / window_seconds;
+      window_start = now;
+      window_steps = 0;
+      window_simulated_time = 0.0;
+    }
+    publish();
+
+    // A step that overruns its slot starts the next one right away instead
+    // of queueing up a backlog to catch up on.
+    next_step += std::chrono::duration_cast<clock::duration>(step_duration);
+    if (next_step < now)
+      next_step = now;
+    else
+      std::this_thread::sleep_until(next_step);
+  }
+}
+
+void SimulationThread::apply(const SimulationCommand &command) {
+  switch (command.type) {
+  case SimulationCommandType::SET_MASS:
+    if (command.index < m_calculator.state.size()) {
+      m_calculator.state.mass[command.index] = command.value;
+      m_calculator.invalidate_accelerations();
+    }
+    break;
+  case SimulationCommandType::SET_PAUSED:
+    m_calculator.paused = command.value != 0.0;
+    scheduler.reset();
+    break;
+  case SimulationCommandType::SET_TIME_FACTOR:
+    m_calculator.simulation_time_factor = static_cast<float>(command.value);
+    break;
+  case SimulationCommandType::SET_FORCE_ENGINE:
+    m_calculator.force_engine =
+        static_cast<ForceEngine>(static_cast<int>(command.value));
+    m_calculator.invalidate_accelerations();
+    break;
+  case SimulationCommandType::SET_OPENING_ANGLE:
+    m_calculator.opening_angle = command.value;
+    m_calculator.invalidate_accelerations();
+    break;
+  case SimulationCommandType::SET_INTEGRATOR:
+    m_calculator.set_integrator(
+        static_cast<IntegratorKind>(static_cast<int>(command.value)));
+    break;
+  case SimulationCommandType::SET_PRECISION:
+    m_calculator.set_precision(
+        static_cast<Precision>(static_cast<int>(command.value)));
+    break;
+  case SimulationCommandType::SET_MAX_THREADS:
+    m_calculator.set_max_threads(static_cast<std::size_t>(command.value));
+    break;
+  case SimulationCommandType::SET_STEP_RATE:
+    step_rate = std::max(1.0, command.value);
+    break;
+  case SimulationCommandType::SET_MAX_SUBSTEP:
+    if (command.value > 0.0)
+      scheduler.max_substep = command.value;
+    break;
+  case SimulationCommandType::ADD_TRACERS: {
+    // On circular orbits about the most massive body.
+    const auto &masses = m_calculator.state.mass;
+    if (masses.empty())
+      break;
+    m_calculator.tracers.add_belt(
+        static_cast<std::size_t>(command.value),
+        m_calculator.gravitational_constant() *
+            *std::max_element(masses.begin(), masses.end()),
+        2.1, 3.3, tracer_seed++);
+    break;
+  }
+  case SimulationCommandType::CLEAR_TRACERS:
+    m_calculator.tracers.clear();
+    break;
+  case SimulationCommandType::SAVE_CHECKPOINT:
+    save_checkpoint();
+    break;
+  case SimulationCommandType::SET_RECORDING:
+    set_recording(command.value != 0.0);
+    break;
+  case SimulationCommandType::SET_COLLISIONS:
+    if (command.value == 0.0) {
+      m_calculator.collisions.reset();
+    } else {
+      const auto response = static_cast<CollisionResponse>(
+          static_cast<int>(command.value) - 1);
+      if (m_calculator.collisions)
+        m_calculator.collisions->settings.response = response;
+      else
+        m_calculator.collisions.emplace(
+            CollisionSettings{.response = response});
+    }
+    break;
+  case SimulationCommandType::SET_CATCH_UP_POLICY:
+    scheduler.policy =
+        static_cast<CatchUpPolicy>(static_cast<int>(command.value));
+    scheduler.reset();
+    break;
+  }
+}
+
+void SimulationThread::publish() {
+  auto &snapshot = snapshots.write_buffer();
+  const auto &state = m_calculator.state;
+  snapshot.positions.resize(state.size());
+  snapshot.velocities.resize(state.size());
+  snapshot.masses.assign(state.mass.begin(), state.mass.end());
+  if (!published_bodies || published_bodies->size() != state.size())
+    published_bodies =
+        std::make_shared<const std::vector<Body>>(m_calculator.bodies);
+  snapshot.bodies = published_bodies;
+  for (std::size_t i = 0; i < state.size(); ++i) {
+    snapshot.positions[i] = state.position(i);
+    snapshot.velocities[i] = state.velocity(i);
+  }
+  snapshot.elapsed_simulation_time = m_calculator.elapsed_simulation_time;
+  snapshot.simulation_time_factor = m_calculator.simulation_time_factor;
+  snapshot.paused = m_calculator.paused;
+  snapshot.force_engine = m_calculator.force_engine;
+  snapshot.opening_angle = m_calculator.opening_angle;
+  snapshot.integrator = m_calculator.integrator_kind();
+  snapshot.precision = m_calculator.precision();
+  snapshot.max_threads = m_calculator.max_threads();
+  snapshot.tracer_count = m_calculator.tracers.size();
+  snapshot.step_rate = step_rate;
+  snapshot.max_substep = scheduler.max_substep;
+  snapshot.catch_up_policy = scheduler.policy;
+  snapshot.steps = steps;
+  snapshot.steps_per_second = steps_per_second;
+  snapshot.step_milliseconds = step_milliseconds;
+  snapshot.substeps = last_report.substeps;
+  snapshot.achieved_time_factor = achieved_time_factor;
+  snapshot.lag = last_report.lag;
+  snapshot.behind = last_report.behind;
+  snapshot.checkpoints_saved = checkpoints_saved;
+  snapshot.checkpoint_failed = checkpoint_failed;
+  snapshot.recording = recorder.has_value();
+  snapshot.frames_recorded = recorder ? recorder->frames_recorded() : 0;
+  snapshot.frames_dropped = recorder ? recorder->frames_dropped() : 0;
+  snapshot.recording_failed =
+      recording_failed || (recorder && recorder->failed());
+  snapshot.collisions_enabled = m_calculator.collisions.has_value();
+  if (m_calculator.collisions)
+    snapshot.collision_response = m_calculator.collisions->settings.response;
+  snapshot.close_encounters = close_encounters;
+  snapshot.collisions = collisions;
+  snapshot.last_event = last_event;
+  snapshots.publish();
+  publish_tracers();
+}
+
+void SimulationThread::publish_tracers() {
+  if (tracer_frames.pending())
+    return;
+  const auto &tracers = m_calculator.tracers;
+  auto &positions = tracer_frames.write_buffer();
+  positions.resize(tracers.size());
+  m_calculator.pool().parallel_for(
+      0, positions.size(), 16384,
+      [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+          positions[i] = glm::vec3(tracers.x[i], tracers.y[i], tracers.z[i]);
+      });
+  tracer_frames.publish();
+}
+
+// Only the copy happens on this thread; a save requested while the previous
+// one is still being written is dropped.
+void SimulationThread::save_checkpoint() {
+  if (pending_save.valid())
+    return;
+  pending_save = Checkpoint::write_async(checkpoint_path,
+                                         Checkpoint::capture(m_calculator));
+}
+
+void SimulationThread::collect_checkpoint(const bool wait) {
+  if (!pending_save.valid())
+    return;
+  if (!wait && pending_save.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready)
+    return;
+  try {
+    pending_save.get();
+    ++checkpoints_saved;
+    checkpoint_failed = false;
+  } catch (const std::exception &) {
+    checkpoint_failed = true;
+  }
+}
+
+// Starting replaces any earlier trajectory at the same path. Encoding and
+// writing happen on the recorder's own thread; frames are dropped rather
+// than slowing the simulation down.
+void SimulationThread::set_recording(const bool enabled) {
+  if (enabled == recorder.has_value())
+    return;
+  try {
+    if (enabled) {
+      recorder.emplace(trajectory_path, m_calculator.state.size());
+      recorder->record(m_calculator.elapsed_simulation_time,
+                       m_calculator.state);
+    } else {
+      recorder->finish();
+    }
+    recording_failed = false;
+  } catch (const std::exception &) {
+    recording_failed = true;
+  }
+  if (!enabled)
+    recorder.reset();
+}
+
+void SimulationThread::collect_events() {
+  if (!m_calculator.collisions)
+    return;
+  for (const auto &event : m_calculator.collisions->events()) {
+    const bool collision = event.type == EncounterType::COLLISION;
+    ++(collision ? collisions : close_encounters);
+    last_event = event.body + (collision ? " hit " : " passed ") +
+                 event.other + " on day " +
+                 std::to_string(static_cast<long long>(event.time));
+  }
+  m_calculator.collisions->clear_events();
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "solar_system_calculator.h"
+#include "spsc_queue.h"
+#include "substep_scheduler.h"
+#include "trajectory_recorder.h"
+#include "triple_buffer.h"
+
+// State published by the simulation thread after every step.
+struct SimulationSnapshot {
+  std::vector<glm::dvec3> positions;
+  std::vector<glm::dvec3> velocities;
+  std::vector<double> masses;
+  // Names, colors and radii; replaced only when bodies merge.
+  std::shared_ptr<const std::vector<Body>> bodies;
+  double elapsed_simulation_time = 0.0;
+  float simulation_time_factor = 0.0f;
+  bool paused = false;
+  ForceEngine force_engine = ForceEngine::DIRECT;
+  double opening_angle = 0.0;
+  IntegratorKind integrator = IntegratorKind::VERLET;
+  Precision precision = Precision::DOUBLE;
+  std::size_t max_threads = 0;
+  std::size_t tracer_count = 0;
+  double step_rate = 0.0;
+  double max_substep = 0.0;
+  CatchUpPolicy catch_up_policy = CatchUpPolicy::DROP;
+  std::uint64_t steps = 0;
+  double steps_per_second = 0.0; // measured
+  double step_milliseconds = 0.0;
+  std::size_t substeps = 0;          // in the last step
+  double achieved_time_factor = 0.0; // measured
+  double lag = 0.0;                  // days
+  bool behind = false;
+  std::uint64_t checkpoints_saved = 0;
+  bool checkpoint_failed = false; // the last save threw
+  bool recording = false;
+  std::uint64_t frames_recorded = 0;
+  std::uint64_t frames_dropped = 0;
+  bool recording_failed = false;
+  bool collisions_enabled = false;
+  CollisionResponse collision_response = CollisionResponse::MERGE;
+  std::uint64_t close_encounters = 0;
+  std::uint64_t collisions = 0;
+  std::string last_event;
+};
+
+enum class SimulationCommandType {
+  SET_MASS,
+  SET_PAUSED,
+  SET_TIME_FACTOR,
+  SET_FORCE_ENGINE,
+  SET_OPENING_ANGLE,
+  SET_INTEGRATOR,
+  SET_PRECISION,
+  SET_MAX_THREADS,
+  SET_STEP_RATE,
+  SET_MAX_SUBSTEP,
+  SET_CATCH_UP_POLICY,
+  ADD_TRACERS, // value = count, placed in the main belt
+  CLEAR_TRACERS,
+  SAVE_CHECKPOINT, // to the thread's checkpoint path, in the background
+  SET_RECORDING,   // value = 1 starts a trajectory, 0 finishes it
+  SET_COLLISIONS,  // value = 0 turns detection off, 1 + CollisionResponse on
+};
+
+struct SimulationCommand {
+  SimulationCommandType type;
+  std::size_t index = 0; // body index for SET_MASS
+  double value = 0.0;
+};
+
+// Runs a SolarSystemCalculator on its own thread at a fixed number of steps
+// per second. Each step advances step_duration * simulation_time_factor of
+// simulated time, split into sub-steps that may use up to budget_fraction of
+// the step duration. The GUI reads the latest state through snapshot() and
+// changes the simulation only through send(); both are lock-free and
+// must each be used from a single thread.
+class SimulationThread {
+public:
+  explicit SimulationThread(SolarSystemCalculator &calculator,
+                            double step_rate = 240.0,
+                            std::string checkpoint_path = "mag3d.ckpt",
+                            std::string trajectory_path = "mag3d.traj");
+  ~SimulationThread();
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  void start();
+  void stop();
+
+  // Returns false if the command queue is full.
+  bool send(const SimulationCommand &command);
+
+  // Latest published state. Stays valid until the next call.
+  const SimulationSnapshot &snapshot();
+
+  // Tracer positions in au. Published only after the previous frame was
+  // picked up, so copies are limited to what the reader consumes. Returns
+  // true if tracer_positions() changed.
+  bool update_tracers();
+  [[nodiscard]] const std::vector<glm::vec3> &tracer_positions() const {
+    return tracer_frames.read_buffer();
+  }
+
+  // Where SET_RECORDING writes the trajectory.
+  [[nodiscard]] const std::string &recording_path() const {
+    return trajectory_path;
+  }
+
+  // Names, colors and radii matching the last snapshot().
+  [[nodiscard]] const std::vector<Body> &bodies() const;
+
+private:
+  SolarSystemCalculator &m_calculator;
+  double step_rate;
+  double budget_fraction = 0.8;
+  SubstepScheduler scheduler;
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  SpscQueue<SimulationCommand, 256> commands;
+  TripleBuffer<SimulationSnapshot> snapshots;
+  TripleBuffer<std::vector<glm::vec3>> tracer_frames;
+  std::uint32_t tracer_seed = 1;
+
+  std::string checkpoint_path;
+  std::future<void> pending_save;
+  std::uint64_t checkpoints_saved = 0;
+  bool checkpoint_failed = false;
+
+  std::string trajectory_path;
+  std::optional<TrajectoryRecorder> recorder;
+  bool recording_failed = false;
+
+  std::shared_ptr<const std::vector<Body>> published_bodies;
+  std::uint64_t close_encounters = 0;
+  std::uint64_t collisions = 0;
+  std::string last_event;
+
+  std::uint64_t steps = 0;
+  double steps_per_second = 0.0;
+  double step_milliseconds = 0.0;
+  double achieved_time_factor = 0.0;
+  SubstepReport last_report;
+
+  void run();
+  void apply(const SimulationCommand &command);
+  void publish();
+  void publish_tracers();
+  void save_checkpoint();
+  void collect_checkpoint(bool wait);
+  void set_recording(bool enabled);
+  void collect_events();
+};
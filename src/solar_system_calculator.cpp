@@ -1,98 +1,259 @@
 #include "solar_system_calculator.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+#include "scenario.h"
+
 void SolarSystemCalculator::init() {
-  const std::unordered_map<std::string, float> orbit_inclinations{
-      {"Mercury", glm::radians(7.004f)}, {"Venus", glm::radians(3.395f)},
-      {"Earth", glm::radians(0.0f)},     {"Moon", glm::radians(5.145f)},
-      {"Mars", glm::radians(1.848f)},
-  };
-  const Body sun = {.position = glm::vec3(0),
-                    .velocity = glm::vec3(0),
-                    .mass = 1.0,
-                    .color = {1.0f, 0.5f, 0.0f},
-                    .max_path = 10,
-                    .is_emitter = true,
-                    .name = "Sun"};
-  const Body mercury = {
-      .position = glm::vec3(0.39, 0.0f, 0.0f),
-      .velocity =
-          glm::vec3(0.0, 0.027352689f * cos(orbit_inclinations.at("Mercury")),
-                    0.027352689f * sin(orbit_inclinations.at("Mercury"))),
-      .mass = 1.1e-7,
-      .color = {0.678f, 0.6588f, 0.647f},
-      .max_path = 2000,
-      .name = "Mercury"};
-  const Body venus = {
-      .position = glm::vec3(0.72, 0.0f, 0.0f),
-      .velocity =
-          glm::vec3(0.0f, 0.020225742 * cos(orbit_inclinations.at("Venus")),
-                    0.020225742 * sin(orbit_inclinations.at("Venus"))),
-      .mass = 1.63e-6,
-      .color = {0.7568f, 0.56078f, 0.0901f},
-      .name = "Venus"};
-  const Body earth = {
-      .position = glm::vec3(1.0, 0.0f, 0.0f),
-      .velocity =
-          glm::vec3(0.0, 0.017199389 * cos(orbit_inclinations.at("Earth")),
-                    0.017199389 * sin(orbit_inclinations.at("Earth"))),
-      .mass = 2e-6,
-      .color = {0.4196f, 0.57647f, 0.83921f},
-      .name = "Earth"};
-  const Body mars = {.position = glm::vec3(1.5, 0.0f, 0.0f),
-                     .velocity = glm::vec3(
-                         0.0, 0.0139056311 * cos(orbit_inclinations.at("Mars")),
-                         0.0139056311 * sin(orbit_inclinations.at("Mars"))),
-                     .mass = 3.213e-7,
-                     .color = {0.757f, 0.27f, 0.0549f},
-                     .max_path = 10000,
-                     .name = "Mars"};
-  bodies.push_back(sun);
-  bodies.push_back(mercury);
-  bodies.push_back(venus);
-  bodies.push_back(earth);
-  bodies.push_back(mars);
-}
-
-void SolarSystemCalculator::compute_forces() {
-  for (auto &b : bodies)
-    b.force = glm::vec3(0.0f);
-
-  for (size_t i = 0; i < bodies.size(); ++i) {
-    for (size_t j = i + 1; j < bodies.size(); ++j) {
-      glm::vec3 r = bodies[j].position - bodies[i].position;
-      const double dist = glm::length(r);
-      glm::vec3 direction = glm::normalize(r);
-
-      const double force_magnitude =
-          G * bodies[i].mass * bodies[j].mass / (dist * dist);
-      const glm::vec3 force = static_cast<float>(force_magnitude) * direction;
-
-      bodies[i].force += force;
-      bodies[j].force -= force;
-    }
+  Scenario::parse(Scenario::INNER_SOLAR_SYSTEM, *this);
+}
+
+std::size_t SolarSystemCalculator::add_body(const BodyState &body_state,
+                                            Body body) {
+  bodies.push_back(std::move(body));
+  integrator->reset();
+  accelerations_fresh = false;
+  return state.add(body_state.position, body_state.velocity, body_state.mass);
+}
+
+void SolarSystemCalculator::add_belt(const std::size_t count, const double mu,
+                                     const double inner_radius,
+                                     const double outer_radius,
+                                     const double mass) {
+  constexpr double GOLDEN_ANGLE = 2.399963;
+  constexpr double GOLDEN_FRACTION = 0.618034;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto k = static_cast<double>(i);
+    const double angle = GOLDEN_ANGLE * k;
+    const double radius = inner_radius + (outer_radius - inner_radius) *
+                                             std::fmod(GOLDEN_FRACTION * k, 1.0);
+    const double speed = std::sqrt(mu / radius);
+    add_body(
+        {.position = {radius * std::cos(angle), radius * std::sin(angle), 0.0},
+         .velocity = {-speed * std::sin(angle), speed * std::cos(angle), 0.0},
+         .mass = mass},
+        {.name = "Asteroid"});
+  }
+}
+
+void SolarSystemCalculator::set_integrator(const IntegratorKind kind) {
+  integrator = Integrator::create(kind);
+  accelerations_fresh = false;
+}
+
+void SolarSystemCalculator::set_integrator(
+    std::unique_ptr<Integrator> new_integrator) {
+  integrator = std::move(new_integrator);
+  accelerations_fresh = false;
+}
+
+void SolarSystemCalculator::set_kernel_isa(const KernelIsa kernel_isa) {
+  isa = kernel_isa;
+  kernel = GravityKernel::get(isa, kernel_precision);
+  tracer_kernel = GravityKernel::get_tracer(isa, kernel_precision);
+  accelerations_fresh = false;
+}
+
+void SolarSystemCalculator::set_precision(const Precision precision) {
+  kernel_precision = precision;
+  kernel = GravityKernel::get(isa, kernel_precision);
+  tracer_kernel = GravityKernel::get_tracer(isa, kernel_precision);
+  accelerations_fresh = false;
+}
+
+void SolarSystemCalculator::set_max_threads(const std::size_t count) {
+  if (count == thread_limit)
+    return;
+  thread_limit = count;
+  thread_pool.reset();
+}
+
+ThreadPool &SolarSystemCalculator::pool() {
+  if (!thread_pool)
+    thread_pool = std::make_unique<ThreadPool>(thread_limit);
+  return *thread_pool;
+}
+
+// Every target sums over all sources in a fixed order and owns its output,
+// so the split into chunks does not change a single bit of the result.
+void SolarSystemCalculator::compute_accelerations() {
+  const auto sources = GravityKernel::sources_of(state);
+  const auto targets = GravityKernel::targets_of(state);
+  auto &workers = pool();
+  const std::size_t grain =
+      std::max<std::size_t>(1, targets.count / (8 * workers.size()));
+  switch (force_engine) {
+  case ForceEngine::DIRECT:
+    workers.parallel_for(0, targets.count, grain,
+                         [&](const std::size_t begin, const std::size_t end) {
+                           kernel(sources, targets, begin, end, G, 0.0);
+                         });
+    break;
+  case ForceEngine::BARNES_HUT:
+    tree.build(sources);
+    workers.parallel_for(0, tree.size(), grain,
+                         [&](const std::size_t begin, const std::size_t end) {
+                           tree.evaluate_sources(targets, begin, end, G,
+                                                 opening_angle, 0.0);
+                         });
+    break;
+  }
+  evaluation_count += targets.count;
+  accelerations_fresh = true;
+}
+
+void SolarSystemCalculator::compute_accelerations(
+    const GravityTargets &targets) {
+  compute_accelerations(GravityKernel::sources_of(state), targets);
+}
+
+// May leave some of state's accelerations from other sources or times.
+void SolarSystemCalculator::compute_accelerations(
+    const GravitySources &sources, const GravityTargets &targets) {
+  accelerations_fresh = false;
+  auto &workers = pool();
+  const std::size_t grain =
+      std::max<std::size_t>(1, targets.count / (8 * workers.size()));
+  switch (force_engine) {
+  case ForceEngine::DIRECT:
+    workers.parallel_for(0, targets.count, grain,
+                         [&](const std::size_t begin, const std::size_t end) {
+                           kernel(sources, targets, begin, end, G, 0.0);
+                         });
+    break;
+  case ForceEngine::BARNES_HUT:
+    tree.build(sources);
+    workers.parallel_for(0, targets.count, grain,
+                         [&](const std::size_t begin, const std::size_t end) {
+                           tree.evaluate(targets, begin, end, G, opening_angle,
+                                         0.0);
+                         });
+    break;
   }
+  evaluation_count += targets.count;
 }
 
-void SolarSystemCalculator::update_bodies_verlet(const float dt) {
-  compute_forces();
+void SolarSystemCalculator::kick(const double dt) {
+  pool().parallel_for(
+      0, state.size(), 4096,
+      [this, dt](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          state.vx[i] += dt * state.ax[i];
+          state.vy[i] += dt * state.ay[i];
+          state.vz[i] += dt * state.az[i];
+        }
+      });
+}
+
+void SolarSystemCalculator::drift(const double dt) {
+  accelerations_fresh = false;
+  pool().parallel_for(
+      0, state.size(), 4096,
+      [this, dt](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          state.x[i] += dt * state.vx[i];
+          state.y[i] += dt * state.vy[i];
+          state.z[i] += dt * state.vz[i];
+        }
+      });
+}
+
+ForceErrorReport
+SolarSystemCalculator::measure_force_error(const std::size_t samples) {
+  ForceErrorReport report;
+  const std::size_t n = state.size();
+  if (n == 0 || samples == 0)
+    return report;
+
+  const std::size_t stride = std::max<std::size_t>(1, n / samples);
+  BodyStore probes;
+  for (std::size_t i = 0; i < n; i += stride)
+    probes.add(state.position(i), glm::dvec3(0.0), 0.0);
+  BodyStore reference = probes;
 
-  for (auto &body : bodies) {
-    glm::vec3 acceleration = body.force / static_cast<float>(body.mass);
+  const auto sources = GravityKernel::sources_of(state);
+  const auto reference_targets = GravityKernel::targets_of(reference);
+  GravityKernel::get(isa)(sources, reference_targets, 0,
+                          reference_targets.count, G, 0.0);
 
-    body.prev_acceleration = acceleration;
-    body.position += body.velocity * dt + 0.5f * acceleration * dt * dt;
+  const auto probe_targets = GravityKernel::targets_of(probes);
+  if (force_engine == ForceEngine::BARNES_HUT) {
+    tree.build(sources);
+    tree.evaluate(probe_targets, 0, probe_targets.count, G, opening_angle,
+                  0.0);
+  } else {
+    kernel(sources, probe_targets, 0, probe_targets.count, G, 0.0);
   }
 
-  compute_forces();
+  double sum_squared = 0.0;
+  for (std::size_t k = 0; k < probes.size(); ++k) {
+    const double reference_magnitude = glm::length(reference.acceleration(k));
+    if (reference_magnitude == 0.0)
+      continue;
+    const double error =
+        glm::length(probes.acceleration(k) - reference.acceleration(k)) /
+        reference_magnitude;
+    sum_squared += error * error;
+    report.max_relative_error = std::max(report.max_relative_error, error);
+    ++report.samples;
+  }
+  if (report.samples > 0)
+    report.rms_relative_error =
+        std::sqrt(sum_squared / static_cast<double>(report.samples));
+  return report;
+}
+
+void SolarSystemCalculator::step(const double dt) {
+  if (tracers.size() > 0)
+    state_before_step = state;
+  {
+    MAG3D_PROFILE_ZONE("integrator");
+    integrator->step(*this, dt);
+  }
+  if (tracers.size() > 0) {
+    MAG3D_PROFILE_ZONE("tracers");
+    advance_tracers(dt);
+  }
+  elapsed_simulation_time += dt;
+  if (!collisions)
+    return;
+  MAG3D_PROFILE_ZONE("collisions");
+  if (collisions->process(state, bodies, tracers, pool(),
+                          elapsed_simulation_time, dt)) {
+    integrator->reset();
+    accelerations_fresh = false;
+  }
+}
 
-  for (auto &body : bodies) {
-    glm::vec3 new_acceleration = body.force / static_cast<float>(body.mass);
+// Tracers take their own kick-drift-kick step against the massive bodies at
+// the start and the end of the step, whatever integrator moved those.
+void SolarSystemCalculator::advance_tracers(const double dt) {
+  const auto sources_before = GravityKernel::sources_of(state_before_step);
+  const auto sources_after = GravityKernel::sources_of(state);
+  const auto targets = GravityKernel::tracers_of(tracers);
+  pool().parallel_for(0, targets.count, 4096,
+                      [&](const std::size_t begin, const std::size_t end) {
+                        tracer_kernel(sources_before, sources_after, targets,
+                                      begin, end, G, dt);
+                      });
+}
+
+void SolarSystemCalculator::update_bodies_verlet(const double dt) {
+  VelocityVerlet{}.step(*this, dt);
+  elapsed_simulation_time += dt;
+}
 
-    body.velocity += 0.5f * (body.prev_acceleration + new_acceleration) * dt;
-    body.draw_position = body.position * position_scale;
-    body.path_3d.emplace_back(body.draw_position);
-    while (body.path_3d.size() > body.max_path) {
-      body.path_3d.pop_front();
+double SolarSystemCalculator::total_energy() const {
+  double energy = 0.0;
+  for (std::size_t i = 0; i < state.size(); ++i) {
+    const glm::dvec3 v = state.velocity(i);
+    energy += 0.5 * state.mass[i] * glm::dot(v, v);
+    for (std::size_t j = i + 1; j < state.size(); ++j) {
+      energy -= G * state.mass[i] * state.mass[j] /
+                glm::length(state.position(j) - state.position(i));
     }
   }
+  return energy;
 }
@@ -4,37 +4,126 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "barnes_hut.h"
+#include "body_store.h"
+#include "collision_detector.h"
 #include "glm/glm.hpp"
+#include "gravity_kernel.h"
+#include "integrator.h"
+#include "thread_pool.h"
+#include "tracer_store.h"
 
-struct Body {
-  glm::vec3 position; // au
-  glm::vec3 draw_position;
-  glm::vec3 velocity; // au/day
-  double mass;        // m_sun
-  glm::vec3 color;
-  glm::vec3 force;
-  std::deque<glm::vec3> path_3d;
-  bool is_emitter = false;
-  glm::vec3 prev_acceleration;
-  const std::size_t max_path = 5000;
-  std::string name;
+struct BodyState {
+  glm::dvec3 position; // au
+  glm::dvec3 velocity; // au/day
+  double mass;         // m_sun
 };
 
+enum class ForceEngine { DIRECT, BARNES_HUT };
+
 class SolarSystemCalculator {
 public:
+  BodyStore state;
   std::vector<Body> bodies;
-  const float position_scale = 2.0f;
+  // Massless particles moved along by step(); they do not affect state.
+  TracerStore tracers;
   double elapsed_simulation_time = 0.0;
   float simulation_time_factor = 1000.0;
   bool paused = false;
+  ForceEngine force_engine = ForceEngine::DIRECT;
+  double opening_angle = 0.5; // Barnes-Hut theta
+  // Looks for close encounters and collisions after every step if set.
+  // Merged bodies leave state and bodies, so indices may shift.
+  std::optional<CollisionDetector> collisions;
 
   void init();
-  void update_bodies_verlet(float dt);
+  std::size_t add_body(const BodyState &body_state, Body body);
+  // Adds `count` asteroids of the given mass on circular orbits in the
+  // ecliptic around a central mass at the origin, with radii in
+  // [inner_radius, outer_radius). Spaced by the golden angle rather than
+  // drawn at random like TracerStore::add_belt, so the same count always
+  // gives the same belt.
+  void add_belt(std::size_t count, double mu, double inner_radius,
+                double outer_radius, double mass);
+
+  // Advances by dt with the selected integrator.
+  void step(double dt);
+  void update_bodies_verlet(double dt);
+
+  [[nodiscard]] IntegratorKind integrator_kind() const {
+    return integrator->kind();
+  }
+  void set_integrator(IntegratorKind kind);
+  void set_integrator(std::unique_ptr<Integrator> new_integrator);
+  [[nodiscard]] Integrator &current_integrator() { return *integrator; }
+  [[nodiscard]] const Integrator &current_integrator() const {
+    return *integrator;
+  }
+
+  // Total kinetic plus potential energy, direct summation.
+  [[nodiscard]] double total_energy() const;
+
+  // Number of per-body acceleration evaluations performed so far.
+  [[nodiscard]] std::uint64_t force_evaluations() const {
+    return evaluation_count;
+  }
+
+  // Upper bound on threads used for force evaluation and integration,
+  // 0 = all hardware threads. Results do not depend on this value.
+  [[nodiscard]] std::size_t max_threads() const { return thread_limit; }
+  void set_max_threads(std::size_t count);
+
+  [[nodiscard]] KernelIsa kernel_isa() const { return isa; }
+  void set_kernel_isa(KernelIsa kernel_isa);
+  // Arithmetic of direct summation and the tracer step. Barnes-Hut always
+  // evaluates in double.
+  [[nodiscard]] Precision precision() const { return kernel_precision; }
+  void set_precision(Precision precision);
+
+  // Compares the selected force engine and precision against direct
+  // summation in double on up to `samples` evenly spaced bodies at the
+  // current state.
+  [[nodiscard]] ForceErrorReport measure_force_error(std::size_t samples = 256);
+
+  // Building blocks for integrators. The accelerations land in the targets;
+  // without explicit sources, all bodies in state attract.
+  void compute_accelerations();
+  // True while state's accelerations are those of all bodies at their
+  // current positions, as compute_accelerations() left them. Code that moves
+  // bodies or changes masses other than through drift() must invalidate.
+  [[nodiscard]] bool accelerations_current() const {
+    return accelerations_fresh;
+  }
+  void invalidate_accelerations() { accelerations_fresh = false; }
+  void compute_accelerations(const GravityTargets &targets);
+  void compute_accelerations(const GravitySources &sources,
+                             const GravityTargets &targets);
+  void kick(double dt);
+  void drift(double dt);
+  ThreadPool &pool();
+  [[nodiscard]] double gravitational_constant() const { return G; }
 
 private:
   const double G = 2.96e-4;   // au^3 / m_s day^2
-  void compute_forces();
+  KernelIsa isa = GravityKernel::detect_isa();
+  Precision kernel_precision = Precision::DOUBLE;
+  GravityKernelFn kernel = GravityKernel::get(isa);
+  TracerKernelFn tracer_kernel = GravityKernel::get_tracer(isa);
+  BarnesHutTree tree;
+  std::size_t thread_limit = 0;
+  std::unique_ptr<ThreadPool> thread_pool;
+  std::unique_ptr<Integrator> integrator = Integrator::create(IntegratorKind::VERLET);
+
+  std::uint64_t evaluation_count = 0;
+  bool accelerations_fresh = false;
+  BodyStore state_before_step;
+
+  void advance_tracers(double dt);
 };
@@ -4,14 +4,33 @@
 #include "glm/glm.hpp"
 #include "imgui.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
+#include "gpu_profiler.h"
 #include "opengl_utils.h"
-#include "scoped_array_buffer.h"
 
 void SolarSystemGraphics::init(const int32_t width, const int32_t height) {
     OpenGLUtils::set_viewport(width, height);
-
-    path_vbo = OpenGLUtils::create_buffer();
+    viewport_width = width;
+    viewport_height = height;
+
+    trail_vbo = OpenGLUtils::create_buffer();
+    tracer_vbo = OpenGLUtils::create_buffer();
+    inset_vbo = OpenGLUtils::create_buffer();
+    planet_instance_vbo = OpenGLUtils::create_buffer();
+    // One vertex array per kind of draw, with the layout fixed here.
+    OpenGLUtils::bind_vertex_array(planet_shape.vertex_array_id);
+    OpenGLUtils::bind_planet_instances(planet_instance_vbo);
+    trail_vao = OpenGLUtils::create_vertex_array();
+    OpenGLUtils::bind_trail_buffer(trail_vbo);
+    tracer_vao = OpenGLUtils::create_vertex_array();
+    OpenGLUtils::bind_array_buffer(0, tracer_vbo);
+    inset_vao = OpenGLUtils::create_vertex_array();
+    OpenGLUtils::bind_inset_buffer(inset_vbo);
+    // The full-screen triangle has no attributes.
+    screen_vao = OpenGLUtils::create_vertex_array();
     scene_fbo = OpenGLUtils::create_framebuffer();
 
     const auto draw_buffers = OpenGLUtils::create_draw_buffers(2);
@@ -22,6 +41,138 @@ void SolarSystemGraphics::init(const int32_t width, const int32_t height) {
 
     depth_render_buffer = OpenGLUtils::create_render_buffer(width, height);
     OpenGLUtils::check_buffer();
+
+    update();
+}
+
+void SolarSystemGraphics::update() {
+    MAG3D_PROFILE_ZONE("update");
+    m_snapshot = &m_simulation.snapshot();
+    tracers_changed |= m_simulation.update_tracers();
+    if (playback) {
+        update_playback();
+        return;
+    }
+    draw_positions.resize(m_snapshot->positions.size());
+    // Merged bodies shift the indices of all later ones.
+    if (paths.size() != m_snapshot->positions.size()) {
+        reset_trails(m_snapshot->positions.size());
+        m_selected_body.reset();
+    }
+    for (std::size_t i = 0; i < draw_positions.size(); ++i) {
+        draw_positions[i] = glm::vec3(m_snapshot->positions[i]) * position_scale;
+    }
+    // Trails follow simulated time, whatever the frame and step rates; a
+    // jump back in time, as from loading a checkpoint, starts them over.
+    const double time = m_snapshot->elapsed_simulation_time;
+    if (time >= last_trail_time && time < last_trail_time + trail_interval) return;
+    last_trail_time = time;
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        add_trail_point(i, time, draw_positions[i]);
+    }
+}
+
+void SolarSystemGraphics::reset_trails(const std::size_t count) {
+    const auto &bodies = m_simulation.bodies();
+    paths.clear();
+    std::vector<std::size_t> capacities(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::size_t max_path = bodies[i].max_path;
+        paths.emplace_back(trail_interval * static_cast<double>(max_path), trail_tolerance, max_path);
+        capacities[i] = max_path;
+    }
+    trail_ring.reset(capacities);
+    orbit_inset.invalidate();
+    last_trail_time = -std::numeric_limits<double>::infinity();
+}
+
+// Samples count in trail intervals; the shader only needs their differences,
+// so wrapping around is harmless.
+void SolarSystemGraphics::add_trail_point(const std::size_t body, const double time, const glm::vec3 &position) {
+    auto &trail = paths[body];
+    const auto update = trail.add(time, position);
+    trail_sample = static_cast<std::uint32_t>(std::llround(trail.newest_time() / trail_interval));
+    const auto &color = m_simulation.bodies()[body].color;
+    switch (update.kind) {
+        case CompactTrail::Update::Kind::APPENDED:
+            trail_ring.append(body, trail.newest(), trail_sample, color);
+            break;
+        case CompactTrail::Update::Kind::REPLACED:
+            trail_ring.replace_last(body, trail.newest(), trail_sample, color);
+            break;
+        case CompactTrail::Update::Kind::RESTARTED:
+            trail_ring.clear(body);
+            trail_ring.append(body, trail.newest(), trail_sample, color);
+            orbit_inset.invalidate();
+            break;
+    }
+    trail_ring.drop_oldest(body, update.expired);
+}
+
+void SolarSystemGraphics::set_playback(const bool enabled) {
+    playback_error.clear();
+    if (!enabled) {
+        playback_ephemeris.reset();
+        playback.reset();
+        for (auto &path: paths) path.clear();
+        for (std::size_t i = 0; i < trail_ring.trail_count(); ++i) trail_ring.clear(i);
+        orbit_inset.invalidate();
+        last_trail_time = -std::numeric_limits<double>::infinity();
+        return;
+    }
+    try {
+        playback.emplace(m_simulation.recording_path());
+    } catch (const std::exception &e) {
+        playback_error = e.what();
+        return;
+    }
+    if (playback->body_count() != m_simulation.bodies().size()) {
+        playback.reset();
+        playback_error = "Recording has a different number of bodies";
+        return;
+    }
+    playback_ephemeris.emplace(playback->body_count());
+    playback_ephemeris->set_source(
+        [this](const double time, std::vector<glm::dvec3> &positions) { playback->positions_at(time, positions); },
+        playback->start_time(), playback->end_time());
+    m_simulation.send({.type = SimulationCommandType::SET_PAUSED, .value = 1.0});
+    playback_time = playback->end_time();
+    playback_changed = true;
+    update_playback();
+}
+
+// Positions and trails are only looked up again after the timeline moved.
+void SolarSystemGraphics::update_playback() {
+    if (!playback_changed) return;
+    playback_changed = false;
+    const auto &bodies = m_simulation.bodies();
+    path_lengths.resize(bodies.size());
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        path_lengths[i] = bodies[i].max_path;
+    }
+    try {
+        if (!playback_ephemeris->positions(playback_time, playback_positions)) {
+            playback->positions_at(playback_time, playback_positions);
+        }
+        playback->paths_at(playback_time, path_lengths, playback_paths);
+    } catch (const std::exception &e) {
+        set_playback(false);
+        playback_error = e.what();
+        return;
+    }
+    draw_positions.resize(playback_positions.size());
+    if (paths.size() != playback_paths.size()) reset_trails(playback_paths.size());
+    // Scrubbing rebuilds whole trails. The recorded points are spaced one
+    // trail interval apart, ending at the playback time.
+    for (std::size_t i = 0; i < draw_positions.size(); ++i) {
+        draw_positions[i] = glm::vec3(playback_positions[i]) * position_scale;
+        paths[i].clear();
+        const auto &points = playback_paths[i];
+        for (std::size_t k = 0; k < points.size(); ++k) {
+            const double age = static_cast<double>(points.size() - 1 - k) * trail_interval;
+            add_trail_point(i, playback_time - age, glm::vec3(points[k]) * position_scale);
+        }
+    }
 }
 
 bool ray_sphere_intersect(const glm::vec3 ray_origin, const glm::vec3 ray_dir, const glm::vec3 sphere_center,
@@ -37,50 +188,35 @@ bool ray_sphere_intersect(const glm::vec3 ray_origin, const glm::vec3 ray_dir, c
 
 void SolarSystemGraphics::check_selection() {
     if (m_camera.current_mouse_ray != glm::vec3(0.0)) {
-        bool found = false;
-        for (auto &body: m_calculator.bodies) {
-            if (ray_sphere_intersect(m_camera.position, m_camera.current_mouse_ray, body.draw_position, 0.2)) {
-                m_selected_body = &body;
-                found = true;
+        m_selected_body.reset();
+        for (std::size_t i = 0; i < draw_positions.size(); ++i) {
+            if (ray_sphere_intersect(m_camera.position, m_camera.current_mouse_ray, draw_positions[i], 0.2)) {
+                m_selected_body = i;
             }
         }
-        if (!found) {
-            m_selected_body = nullptr;
-        }
     }
     m_camera.current_mouse_ray = glm::vec3(0.0);
 }
 
 
+// Packs every body into the instance buffer, then draws them all in one call.
 void SolarSystemGraphics::draw_planets() {
+    MAG3D_PROFILE_GPU_ZONE("draw_planets");
+    planet_instances.update(draw_positions, m_snapshot->masses, m_simulation.bodies(), m_selected_body);
+    const auto &instances = planet_instances.instances();
+    if (instances.empty()) return;
+    const auto bytes = instances.size() * sizeof(PlanetInstance);
+    OpenGLUtils::allocate_array_buffer(planet_instance_vbo, bytes);
+    OpenGLUtils::update_array_buffer(planet_instance_vbo, 0, bytes, instances.data());
+
     planet_shader.use();
     planet_shader.setVec3("lightColor", glm::vec3(1.0f));
+    planet_shader.setVec3("lightPos", planet_instances.light_position());
+    planet_shader.setMat4("VP", m_camera.get_vp_matrix());
 
-    const auto view = m_camera.get_view_matrix();
-    const auto vp = m_camera.get_vp_matrix();
-
-    for (auto &body: m_calculator.bodies) {
-        if (body.is_emitter) {
-            light_position = body.draw_position;
-        }
-
-        auto model = glm::translate(glm::mat4(1.0f), body.draw_position);
-        model = glm::scale(model,
-                           glm::vec3(static_cast<float>(std::min(body.mass * 50000.0, 0.2))));
-        auto mvp = vp * model;
-
-        planet_shader.setBool("isEmissive", body.is_emitter);
-        planet_shader.setMat4("MVP", mvp);
-        planet_shader.setMat4("V", view);
-        planet_shader.setMat4("M", model);
-        planet_shader.setBool("selected", &body == m_selected_body);
-        planet_shader.setVec3("objectColor", body.color);
-
-        ScopedArrayBuffer vertex_buffer{0, planet_shape.vertex_buffer_id};
-        ScopedArrayBuffer normal_buffer{1, planet_shape.normal_buffer_id};
-
-        OpenGLUtils::draw_triangle_faces(planet_shape.number_of_triangles);
-    }
+    OpenGLUtils::bind_vertex_array(planet_shape.vertex_array_id);
+    OpenGLUtils::draw_triangle_faces_instanced(planet_shape.number_of_triangles,
+                                               static_cast<GLsizei>(instances.size()));
 }
 
 bool SolarSystemGraphics::slider_double(const char *label, double &value, const float min, const float max) {
@@ -90,18 +226,167 @@ bool SolarSystemGraphics::slider_double(const char *label, double &value, const
     return changed;
 }
 
-void SolarSystemGraphics::draw_control_window() const {
+void SolarSystemGraphics::draw_control_window() {
+    MAG3D_PROFILE_ZONE("draw_control_window");
+    const auto &snapshot = *m_snapshot;
+    const auto send = [this](const SimulationCommandType type, const double value, const std::size_t index = 0) {
+        m_simulation.send({.type = type, .index = index, .value = value});
+    };
+
     ImGui::Begin("Control");
-    slider_double("Sun mass", m_calculator.bodies[0].mass, 0.01f, 100.0f);
-    slider_double("Earth mass", m_calculator.bodies[3].mass, 0.0000001f, 1.0f);
-    ImGui::SliderFloat("Simulation time factor", &m_calculator.simulation_time_factor, 1.0, 1000000.0, "%.0f",
-                       ImGuiSliderFlags_Logarithmic);
-    ImGui::Checkbox("Pause", &m_calculator.paused);
-    ImGui::Text("Time: %.1f days", m_calculator.elapsed_simulation_time);
+    if (snapshot.masses.size() > 3) {
+        auto sun_mass = snapshot.masses[0];
+        if (slider_double("Sun mass", sun_mass, 0.01f, 100.0f)) {
+            send(SimulationCommandType::SET_MASS, sun_mass, 0);
+        }
+        auto earth_mass = snapshot.masses[3];
+        if (slider_double("Earth mass", earth_mass, 0.0000001f, 1.0f)) {
+            send(SimulationCommandType::SET_MASS, earth_mass, 3);
+        }
+    }
+    auto time_factor = snapshot.simulation_time_factor;
+    if (ImGui::SliderFloat("Simulation time factor", &time_factor, 1.0, 100000000.0, "%.0f",
+                           ImGuiSliderFlags_Logarithmic)) {
+        send(SimulationCommandType::SET_TIME_FACTOR, time_factor);
+    }
+    bool barnes_hut = snapshot.force_engine == ForceEngine::BARNES_HUT;
+    if (ImGui::Checkbox("Barnes-Hut", &barnes_hut)) {
+        send(SimulationCommandType::SET_FORCE_ENGINE,
+             static_cast<int>(barnes_hut ? ForceEngine::BARNES_HUT : ForceEngine::DIRECT));
+    }
+    if (barnes_hut) {
+        auto theta = static_cast<float>(snapshot.opening_angle);
+        if (ImGui::SliderFloat("Opening angle", &theta, 0.0f, 1.5f, "%.2f")) {
+            send(SimulationCommandType::SET_OPENING_ANGLE, theta);
+        }
+    }
+    if (ImGui::BeginCombo("Integrator", Integrator::name(snapshot.integrator))) {
+        for (const auto kind: {IntegratorKind::VERLET, IntegratorKind::BLOCK, IntegratorKind::YOSHIDA4,
+                               IntegratorKind::WISDOM_HOLMAN, IntegratorKind::HYBRID}) {
+            if (ImGui::Selectable(Integrator::name(kind), kind == snapshot.integrator)) {
+                send(SimulationCommandType::SET_INTEGRATOR, static_cast<int>(kind));
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (ImGui::BeginCombo("Precision", GravityKernel::precision_name(snapshot.precision))) {
+        for (const auto precision: {Precision::DOUBLE, Precision::MIXED, Precision::FLOAT}) {
+            if (ImGui::Selectable(GravityKernel::precision_name(precision), precision == snapshot.precision)) {
+                send(SimulationCommandType::SET_PRECISION, static_cast<int>(precision));
+            }
+        }
+        ImGui::EndCombo();
+    }
+    auto threads = static_cast<int>(snapshot.max_threads);
+    if (ImGui::SliderInt("Threads (0 = all)", &threads, 0, static_cast<int>(std::thread::hardware_concurrency()))) {
+        send(SimulationCommandType::SET_MAX_THREADS, threads);
+    }
+    auto step_rate = static_cast<float>(snapshot.step_rate);
+    if (ImGui::SliderFloat("Steps per second", &step_rate, 10.0f, 2000.0f, "%.0f", ImGuiSliderFlags_Logarithmic)) {
+        send(SimulationCommandType::SET_STEP_RATE, step_rate);
+    }
+    auto max_substep = static_cast<float>(snapshot.max_substep);
+    if (ImGui::SliderFloat("Max step (days)", &max_substep, 0.01f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic)) {
+        send(SimulationCommandType::SET_MAX_SUBSTEP, max_substep);
+    }
+    bool carry_over = snapshot.catch_up_policy == CatchUpPolicy::EXTEND;
+    if (ImGui::Checkbox("Catch up when behind", &carry_over)) {
+        send(SimulationCommandType::SET_CATCH_UP_POLICY,
+             static_cast<int>(carry_over ? CatchUpPolicy::EXTEND : CatchUpPolicy::DROP));
+    }
+    ImGui::Text("Tracers: %zu", snapshot.tracer_count);
+    ImGui::SameLine();
+    if (ImGui::Button("+100k")) {
+        send(SimulationCommandType::ADD_TRACERS, 100000);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("+1M")) {
+        send(SimulationCommandType::ADD_TRACERS, 1000000);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        send(SimulationCommandType::CLEAR_TRACERS, 0);
+    }
+    if (ImGui::Button("Save checkpoint")) {
+        send(SimulationCommandType::SAVE_CHECKPOINT, 0);
+    }
+    ImGui::SameLine();
+    if (snapshot.checkpoint_failed) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "Saving failed");
+    } else {
+        ImGui::Text("%llu saved", static_cast<unsigned long long>(snapshot.checkpoints_saved));
+    }
+    bool recording = snapshot.recording;
+    // Recording truncates the file that playback has mapped.
+    ImGui::BeginDisabled(playback.has_value());
+    if (ImGui::Checkbox("Record trajectory", &recording)) {
+        send(SimulationCommandType::SET_RECORDING, recording ? 1.0 : 0.0);
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (snapshot.recording_failed) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "Recording failed");
+    } else if (snapshot.recording) {
+        ImGui::Text("%llu frames, %llu dropped", static_cast<unsigned long long>(snapshot.frames_recorded),
+                    static_cast<unsigned long long>(snapshot.frames_dropped));
+    }
+    const char* collision_modes[] = {"Off", "Log only", "Merge", "Bounce"};
+    int collision_mode = snapshot.collisions_enabled ? 1 + static_cast<int>(snapshot.collision_response) : 0;
+    if (ImGui::Combo("Collisions", &collision_mode, collision_modes, IM_ARRAYSIZE(collision_modes))) {
+        send(SimulationCommandType::SET_COLLISIONS, collision_mode);
+    }
+    if (snapshot.collisions_enabled) {
+        ImGui::Text("%llu close encounters, %llu collisions",
+                    static_cast<unsigned long long>(snapshot.close_encounters),
+                    static_cast<unsigned long long>(snapshot.collisions));
+        if (!snapshot.last_event.empty()) {
+            ImGui::Text("Last: %s", snapshot.last_event.c_str());
+        }
+    }
+    bool paused = snapshot.paused;
+    if (ImGui::Checkbox("Pause", &paused)) {
+        send(SimulationCommandType::SET_PAUSED, paused ? 1.0 : 0.0);
+    }
+    ImGui::SameLine();
+    bool playing_back = playback.has_value();
+    ImGui::BeginDisabled(snapshot.recording);
+    if (ImGui::Checkbox("Playback", &playing_back)) {
+        set_playback(playing_back);
+    }
+    ImGui::EndDisabled();
+    if (playback) {
+        ImGui::SameLine();
+        const double start = playback->start_time();
+        const double end = playback->end_time();
+        if (ImGui::SliderScalar("Timeline (days)", ImGuiDataType_Double, &playback_time, &start, &end, "%.1f")) {
+            playback_changed = true;
+        }
+    }
+    if (!playback_error.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "%s", playback_error.c_str());
+    }
+    ImGui::Text("Time: %.1f days", snapshot.elapsed_simulation_time);
+    ImGui::Text("Simulation: %.0f steps/s, %.2f ms/step, %zu sub-steps", snapshot.steps_per_second,
+                snapshot.step_milliseconds, snapshot.substeps);
+    ImGui::Text("Achieved time factor: %.0f", snapshot.achieved_time_factor);
+    if (snapshot.behind && !snapshot.paused) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "Behind real time (lag %.2f days)", snapshot.lag);
+    }
+    ImGui::Text("Rendering: %.1f fps", ImGui::GetIO().Framerate);
+    const auto &render_state = OpenGLUtils::render_state();
+    ImGui::Text("GL binds: %llu, %llu skipped", static_cast<unsigned long long>(render_state.issued()),
+                static_cast<unsigned long long>(render_state.skipped()));
+    bool profiling = Profiler::enabled();
+    if (ImGui::Checkbox("Profiler", &profiling)) {
+        Profiler::set_enabled(profiling);
+    }
     ImGui::End();
+
+    if (Profiler::enabled()) profiler_overlay.draw();
 }
 
 void SolarSystemGraphics::render_texture() const {
+    MAG3D_PROFILE_GPU_ZONE("render_texture");
     OpenGLUtils::use_main_framebuffer();
     texture_shader.use();
 
@@ -111,47 +396,110 @@ void SolarSystemGraphics::render_texture() const {
     }
 
     texture_shader.setVec2("tex_size", glm::vec2(m_camera.window_width, m_camera.window_height));
+    OpenGLUtils::bind_vertex_array(screen_vao);
     OpenGLUtils::draw_triangle_faces(1);
 }
 
-void SolarSystemGraphics::draw_paths() const {
-    path_shader.use();
-    const auto vp = m_camera.get_vp_matrix();
-    path_shader.setMat4("VP", vp);
+// Uploads the ring slots written since the last frame, then draws every trail
+// in one call.
+void SolarSystemGraphics::draw_paths() {
+    MAG3D_PROFILE_GPU_ZONE("draw_paths");
+    const auto &vertices = trail_ring.vertices();
+    if (trail_ring.resized()) {
+        OpenGLUtils::allocate_array_buffer(trail_vbo, vertices.size() * sizeof(TrailVertex));
+    }
+    for (const auto &[first, count]: trail_ring.dirty()) {
+        OpenGLUtils::update_array_buffer(trail_vbo, first * sizeof(TrailVertex), count * sizeof(TrailVertex),
+                                         vertices.data() + first);
+    }
+    trail_ring.clear_dirty();
+
+    trail_ring.draw_ranges(trail_firsts, trail_counts);
+    if (trail_firsts.empty()) return;
+    trail_shader.use();
+    trail_shader.setMat4("VP", m_camera.get_vp_matrix());
+    trail_shader.setUInt("newestSample", trail_sample);
+    OpenGLUtils::bind_vertex_array(trail_vao);
+    OpenGLUtils::draw_line_strips(trail_firsts, trail_counts);
+}
 
-    for (const auto &body: m_calculator.bodies) {
-        if (body.path_3d.size() < 2) continue;
-        path_shader.setVec3("objectColor", body.color);
+void SolarSystemGraphics::draw_tracers() {
+    MAG3D_PROFILE_GPU_ZONE("draw_tracers");
+    const auto &positions = m_simulation.tracer_positions();
+    if (positions.empty()) return;
 
-        std::vector path_vec(body.path_3d.begin(), body.path_3d.end());
-        ScopedArrayBuffer path{0, path_vbo, path_vec};
-        OpenGLUtils::draw_line(path_vec);
+    path_shader.use();
+    path_shader.setMat4("VP", m_camera.get_vp_matrix() * glm::scale(glm::mat4(1.0f), glm::vec3(position_scale)));
+    path_shader.setVec3("objectColor", glm::vec3(0.55f));
+    if (tracers_changed) {
+        const auto bytes = positions.size() * sizeof(glm::vec3);
+        OpenGLUtils::allocate_array_buffer(tracer_vbo, bytes);
+        OpenGLUtils::update_array_buffer(tracer_vbo, 0, bytes, positions.data());
+        tracers_changed = false;
     }
+    OpenGLUtils::bind_vertex_array(tracer_vao);
+    OpenGLUtils::draw_points(static_cast<GLsizei>(positions.size()));
 }
 
-void SolarSystemGraphics::render_info() const {
+void SolarSystemGraphics::render_info() {
     if (!m_selected_body) return;
 
+    const std::size_t i = *m_selected_body;
+    glm::dvec3 position = m_snapshot->positions[i];
+    glm::dvec3 velocity = m_snapshot->velocities[i];
+    if (playback_ephemeris) playback_ephemeris->state(i, playback_time, position, velocity);
     ImGui::Begin("Planet info");
-    ImGui::Text("Name: %s", m_selected_body->name.c_str());
-    ImGui::Text("Distance from sun (AU): %.2f", glm::length(m_selected_body->position));
-    ImGui::Text("Orbital velocity (AU/day): %.5f, %.5f, %.5f", m_selected_body->velocity.x, m_selected_body->velocity.y,
-                m_selected_body->velocity.z);
+    ImGui::Text("Name: %s", m_simulation.bodies()[i].name.c_str());
+    ImGui::Text("Distance from sun (AU): %.2f", glm::length(position));
+    ImGui::Text("Orbital velocity (AU/day): %.5f, %.5f, %.5f", velocity.x, velocity.y, velocity.z);
     ImGui::End();
 }
 
 void SolarSystemGraphics::draw_solar_system() {
+    MAG3D_PROFILE_GPU_ZONE("draw_solar_system");
     OpenGLUtils::bind_frame_buffer(scene_fbo);
     OpenGLUtils::clear();
 
     check_selection();
     draw_planets();
     draw_paths();
+    draw_tracers();
     render_texture();
     render_info();
 }
 
+// Blends this frame's part of the orbit view into its texture.
+void SolarSystemGraphics::render_orbit_inset(const int32_t width, const int32_t height) {
+    MAG3D_PROFILE_GPU_ZONE("render_orbit_inset");
+    const auto &vertices = orbit_inset.vertices();
+    if (vertices.empty()) return;
+    if (inset_fbo == 0) inset_fbo = OpenGLUtils::create_framebuffer();
+    OpenGLUtils::bind_frame_buffer(inset_fbo);
+    if (width != inset_width || height != inset_height) {
+        if (inset_texture != 0) OpenGLUtils::delete_texture(inset_texture);
+        inset_texture = OpenGLUtils::create_render_texture(width, height);
+        OpenGLUtils::check_buffer();
+        inset_width = width;
+        inset_height = height;
+    }
+    OpenGLUtils::set_viewport(width, height);
+    OpenGLUtils::begin_blended_2d();
+    inset_shader.use();
+    inset_shader.setVec2("size", glm::vec2(width, height));
+    const auto bytes = vertices.size() * sizeof(InsetVertex);
+    OpenGLUtils::allocate_array_buffer(inset_vbo, bytes);
+    OpenGLUtils::update_array_buffer(inset_vbo, 0, bytes, vertices.data());
+    OpenGLUtils::bind_vertex_array(inset_vao);
+    OpenGLUtils::draw_triangle_faces(static_cast<GLsizei>(vertices.size() / 3));
+    OpenGLUtils::end_blended_2d();
+    OpenGLUtils::set_viewport(viewport_width, viewport_height);
+    OpenGLUtils::use_main_framebuffer();
+}
+
+// The trails are kept in a texture that ImGui shows as a single image, so the
+// inset costs the same however long they are.
 void SolarSystemGraphics::draw_orbit_view() {
+    MAG3D_PROFILE_ZONE("draw_orbit_view");
     ImGui::SetNextWindowSize(ImVec2(200, 200));
     ImGui::SetNextWindowPos(ImVec2(10, 10)); // top-left corner
     ImGui::Begin("Orbit View", nullptr,
@@ -160,41 +508,17 @@ void SolarSystemGraphics::draw_orbit_view() {
 
     const ImVec2 canvas_pos = ImGui::GetCursorScreenPos(); // Top-left of drawing area
     const ImVec2 canvas_size = ImGui::GetContentRegionAvail(); // Size of the window
+    const ImVec2 pixel_scale = ImGui::GetIO().DisplayFramebufferScale;
+    const auto width = std::max(1, static_cast<int32_t>(canvas_size.x * pixel_scale.x));
+    const auto height = std::max(1, static_cast<int32_t>(canvas_size.y * pixel_scale.y));
 
-    ImDrawList *draw_list = ImGui::GetWindowDrawList();
-    draw_list->AddRectFilled(canvas_pos,
-                             ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y),
-                             IM_COL32(10, 10, 10, 255));
+    orbit_inset.update(paths, m_simulation.bodies(), inset_scale / pixel_scale.x, width, height);
+    render_orbit_inset(width, height);
+    // Texture rows run bottom to top.
+    ImGui::GetWindowDrawList()->AddImage(static_cast<ImTextureID>(inset_texture), canvas_pos,
+                                         ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y),
+                                         ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 
     ImGui::SliderFloat("Scale", &inset_scale, 0.0f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
-    const auto origin = ImVec2(canvas_pos.x + canvas_size.x * 0.5f,
-                               canvas_pos.y + canvas_size.y * 0.5f);
-
-    for (const auto &body: m_calculator.bodies) {
-        if (body.path_3d.size() < 2) continue;
-        if (glm::length(body.path_3d.back() - body.path_3d.front()) < 1e-3f) {
-            // Draw a dot if the path is too short or stationary
-            const glm::vec2 pos = body.path_3d.back();
-            auto point = ImVec2(origin.x + pos.x / inset_scale, origin.y - pos.y / inset_scale);
-            draw_list->AddCircleFilled(point, 2.0f,
-                                       IM_COL32(body.color.r * 255, body.color.g * 255, body.color.b * 255, 255));
-        } else {
-            for (size_t i = 1; i < body.path_3d.size(); ++i) {
-                const glm::vec2 p0 = body.path_3d[i - 1];
-                const glm::vec2 p1 = body.path_3d[i];
-
-                auto point0 = ImVec2(origin.x + p0.x / inset_scale, origin.y - p0.y / inset_scale);
-                auto point1 = ImVec2(origin.x + p1.x / inset_scale, origin.y - p1.y / inset_scale);
-
-                const auto fraction = static_cast<double>(body.path_3d.size() - i) / body.path_3d.size();
-                const auto alpha = 255 * (1.0 - fraction);
-
-                draw_list->AddLine(point0, point1,
-                                   IM_COL32(body.color.r * 255, body.color.g * 255, body.color.b * 255, alpha), 2.0f);
-            }
-        }
-    }
     ImGui::End();
 }
-
-
@@ -1,55 +1,125 @@
 #pragma once
-#include "solar_system_calculator.h"
+#include "simulation_thread.h"
 #include <OpenGL/gl3.h>
+#include <cstdint>
+#include <limits>
+#include <optional>
 #include <string>
 
 #include "camera.hpp"
+#include "compact_trail.h"
+#include "ephemeris.h"
 #include "file_loader.h"
 #include "opengl_utils.h"
+#include "orbit_inset.h"
+#include "planet_instances.h"
+#include "profiler_overlay.h"
 #include "shader.h"
+#include "trail_ring.h"
+#include "trajectory_playback.h"
 
 
 class SolarSystemGraphics {
-    SolarSystemCalculator& m_calculator;
+    SimulationThread& m_simulation;
     Camera& m_camera;
-    Body* m_selected_body = nullptr;
+    const SimulationSnapshot* m_snapshot = nullptr;
+    std::optional<std::size_t> m_selected_body;
+
+    const float position_scale = 2.0f;
+    std::vector<glm::vec3> draw_positions;
+    // Sampled every trail_interval simulated days and simplified to within
+    // trail_tolerance; each spans max_path samples.
+    std::vector<CompactTrail> paths;
+    const double trail_interval = 0.1;
+    const float trail_tolerance = 1e-3f;
+    double last_trail_time = -std::numeric_limits<double>::infinity();
+    // GPU copy of the trails; only points changed since the last frame are uploaded.
+    TrailRing trail_ring;
+    std::uint32_t trail_sample = 0; // of the newest points
+    std::vector<std::int32_t> trail_firsts;
+    std::vector<std::int32_t> trail_counts;
+
+    // Playback shows a recorded trajectory instead of the live simulation.
+    std::optional<TrajectoryPlayback> playback;
+    // Fitted from the recording on first use, so scrubbing back over the
+    // timeline evaluates polynomials instead of decoding chunks.
+    std::optional<Ephemeris> playback_ephemeris;
+    double playback_time = 0.0;
+    bool playback_changed = false;
+    std::string playback_error;
+    std::vector<glm::dvec3> playback_positions;
+    std::vector<std::vector<glm::dvec3>> playback_paths;
+    std::vector<std::size_t> path_lengths;
+
     std::vector<Texture> textures;
     const std::string planet_fragment_shader_path = "../src/shaders/planet.frag";
     const std::string planet_vertex_shader_path = "../src/shaders/planet.vert";
     const std::string path_fragment_shader_path = "../src/shaders/path.frag";
     const std::string path_vertex_shader_path = "../src/shaders/path.vert";
+    const std::string trail_fragment_shader_path = "../src/shaders/trail.frag";
+    const std::string trail_vertex_shader_path = "../src/shaders/trail.vert";
+    const std::string inset_fragment_shader_path = "../src/shaders/inset.frag";
+    const std::string inset_vertex_shader_path = "../src/shaders/inset.vert";
     const std::string planet_shape_path = "../src/obj_files/sphere_auto_smooth.obj";
     const std::string passthrough_vertex_shader_path = "../src/shaders/passthrough.vert";
     const std::string texture_fragment_shader_path = "../src/shaders/texture.frag";
 
     Shader planet_shader{planet_vertex_shader_path, planet_fragment_shader_path};
     Shader path_shader{path_vertex_shader_path, path_fragment_shader_path};
+    Shader trail_shader{trail_vertex_shader_path, trail_fragment_shader_path};
+    Shader inset_shader{inset_vertex_shader_path, inset_fragment_shader_path};
     Shader texture_shader{passthrough_vertex_shader_path, texture_fragment_shader_path};
 
     Shape planet_shape = FileLoader::load_shape(planet_shape_path);
 
-    GLuint path_vbo = 0;
+    // Rebuilt every frame; all bodies are drawn with one instanced call.
+    PlanetInstances planet_instances;
+    GLuint planet_instance_vbo = 0;
+    GLuint trail_vbo = 0;
+    GLuint trail_vao = 0;
+    GLuint tracer_vbo = 0;
+    GLuint tracer_vao = 0;
+    GLuint screen_vao = 0;
+    bool tracers_changed = false;
     GLuint scene_fbo = 0;
     GLuint non_emissive_texture = 0;
     GLuint emissive_texture = 0;
     GLuint depth_render_buffer = 0;
+    int32_t viewport_width = 0;
+    int32_t viewport_height = 0;
 
     float inset_scale{0.015};
+    // The orbit view's texture; only the new ends of the trails are drawn into it.
+    OrbitInset orbit_inset;
+    GLuint inset_fbo = 0;
+    GLuint inset_texture = 0;
+    GLuint inset_vbo = 0;
+    GLuint inset_vao = 0;
+    int32_t inset_width = 0;
+    int32_t inset_height = 0;
 
-    glm::vec3 light_position{0.0};
+    ProfilerOverlay profiler_overlay;
 
     void draw_planets();
-    void draw_paths() const;
+    void reset_trails(std::size_t count);
+    void add_trail_point(std::size_t body, double time, const glm::vec3 &position);
+    void draw_paths();
+    void draw_tracers();
     void render_texture() const;
+    void render_orbit_inset(int32_t width, int32_t height);
     void check_selection();
-    void render_info() const;
+    void render_info();
+    void set_playback(bool enabled);
+    void update_playback();
 
     static bool slider_double(const char* label, double& value, float min, float max);
 
     public:
-    SolarSystemGraphics(SolarSystemCalculator& calculator, Camera& camera) : m_calculator(calculator), m_camera(camera) {};
+    SolarSystemGraphics(SimulationThread& simulation, Camera& camera) : m_simulation(simulation), m_camera(camera) {};
     void init(int32_t, int32_t);
-    void draw_control_window() const;
+    // Picks up the latest simulation snapshot; call once per frame before drawing.
+    void update();
+    void draw_control_window();
     void draw_solar_system();
     void draw_orbit_view();
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Indices grow without wrapping; Capacity must be a power of two.
+template <typename T, std::size_t Capacity> class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  // Returns false without blocking if the queue is full.
+  bool push(const T &value) {
+    const std::size_t tail = write_index.load(std::memory_order_relaxed);
+    if (tail - cached_read_index >= Capacity) {
+      cached_read_index = read_index.load(std::memory_order_acquire);
+      if (tail - cached_read_index >= Capacity)
+        return false;
+    }
+    slots[tail & (Capacity - 1)] = value;
+    write_index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> pop() {
+    const std::size_t head = read_index.load(std::memory_order_relaxed);
+    if (head == cached_write_index) {
+      cached_write_index = write_index.load(std::memory_order_acquire);
+      if (head == cached_write_index)
+        return std::nullopt;
+    }
+    T value = slots[head & (Capacity - 1)];
+    read_index.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+private:
+  std::array<T, Capacity> slots{};
+  alignas(64) std::atomic<std::size_t> write_index{0};
+  std::size_t cached_read_index = 0; // producer only
+  alignas(64) std::atomic<std::size_t> read_index{0};
+  std::size_t cached_write_index = 0; // consumer only
+};
@@ -0,0 +1,52 @@
+#include "substep_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "solar_system_calculator.h"
+
+SubstepReport SubstepScheduler::advance(SolarSystemCalculator &calculator,
+                                        const double interval,
+                                        std::chrono::duration<double> budget) {
+  using clock = std::chrono::steady_clock;
+  SubstepReport report;
+  const double owed = interval + carried_lag;
+  carried_lag = 0.0;
+  if (owed <= 0.0)
+    return report;
+
+  // Equal sub-steps keep the step size constant while the time factor is,
+  // which the symplectic integrators rely on.
+  const auto count =
+      static_cast<std::size_t>(std::ceil(owed / max_substep - 1e-9));
+  const double substep =
+      owed / static_cast<double>(std::max<std::size_t>(1, count));
+  if (policy == CatchUpPolicy::EXTEND)
+    budget *= max_overrun;
+
+  const auto start = clock::now();
+  double remaining = owed;
+  while (remaining > 0.5 * substep) {
+    const auto elapsed = clock::now() - start;
+    if (report.substeps > 0) {
+      const auto average = elapsed / static_cast<double>(report.substeps);
+      if (elapsed + average > budget)
+        break;
+    }
+    calculator.step(substep);
+    remaining -= substep;
+    report.simulated_time += substep;
+    ++report.substeps;
+  }
+
+  if (remaining > 0.5 * substep) {
+    report.behind = true;
+    if (policy == CatchUpPolicy::EXTEND) {
+      carried_lag = std::min(remaining, max_lag);
+      remaining -= carried_lag;
+    }
+    report.dropped_time = remaining;
+  }
+  report.lag = carried_lag;
+  return report;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+class SolarSystemCalculator;
+
+// What to do with simulated time that did not fit into the CPU budget.
+enum class CatchUpPolicy {
+  DROP,  // discard it; the simulation runs slower than requested
+  EXTEND // overrun the budget, then carry the rest over to the next call
+};
+
+struct SubstepReport {
+  std::size_t substeps = 0;
+  double simulated_time = 0.0; // days
+  double dropped_time = 0.0;   // days
+  double lag = 0.0;            // days carried over to the next call
+  bool behind = false;         // the requested interval was not simulated
+};
+
+// Splits a requested interval of simulated time into equal sub-steps of at
+// most max_substep and runs as many of them as fit into a CPU budget. At
+// least one sub-step is taken per call.
+class SubstepScheduler {
+public:
+  double max_substep = 0.25; // days
+  CatchUpPolicy policy = CatchUpPolicy::DROP;
+  double max_overrun = 2.0; // EXTEND: budget multiplier
+  double max_lag = 10.0;    // EXTEND: days of lag kept before dropping
+
+  SubstepReport advance(SolarSystemCalculator &calculator, double interval,
+                        std::chrono::duration<double> budget);
+
+  [[nodiscard]] double lag() const { return carried_lag; }
+  void reset() { carried_lag = 0.0; }
+
+private:
+  double carried_lag = 0.0;
+};
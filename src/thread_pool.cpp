@@ -0,0 +1,146 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+std::uint64_t pack(const std::uint32_t first, const std::uint32_t last) {
+  return static_cast<std::uint64_t>(first) << 32 | last;
+}
+
+std::uint32_t first_of(const std::uint64_t range) {
+  return static_cast<std::uint32_t>(range >> 32);
+}
+
+std::uint32_t last_of(const std::uint64_t range) {
+  return static_cast<std::uint32_t>(range);
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t max_threads) {
+  if (max_threads == 0)
+    max_threads = std::max(1u, std::thread::hardware_concurrency());
+  queues = std::make_unique<ChunkQueue[]>(max_threads);
+  workers.reserve(max_threads - 1);
+  for (std::size_t i = 1; i < max_threads; ++i)
+    workers.emplace_back([this, i] { worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::run(const Job new_job, const std::size_t begin,
+                     const std::size_t end, const std::size_t grain) {
+  const std::size_t chunks = (end - begin + grain - 1) / grain;
+  const std::size_t participants = size();
+  {
+    std::unique_lock lock(mutex);
+    work_done.wait(lock, [this] { return draining == 0; });
+    job = new_job;
+    job_begin = begin;
+    job_end = end;
+    job_grain = grain;
+    remaining_chunks.store(chunks, std::memory_order_relaxed);
+    for (std::size_t q = 0; q < participants; ++q) {
+      const auto first = static_cast<std::uint32_t>(chunks * q / participants);
+      const auto last =
+          static_cast<std::uint32_t>(chunks * (q + 1) / participants);
+      queues[q].range.store(pack(first, last), std::memory_order_release);
+    }
+    ++generation;
+  }
+  work_available.notify_all();
+
+  drain(0);
+
+  if (remaining_chunks.load(std::memory_order_acquire) != 0) {
+    std::unique_lock lock(mutex);
+    work_done.wait(lock, [this] {
+      return remaining_chunks.load(std::memory_order_acquire) == 0;
+    });
+  }
+}
+
+void ThreadPool::worker_loop(const std::size_t queue_index) {
+  std::uint64_t seen_generation = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      work_available.wait(lock, [&] {
+        return stopping || generation != seen_generation;
+      });
+      if (stopping)
+        return;
+      seen_generation = generation;
+      ++draining;
+    }
+    drain(queue_index);
+    std::lock_guard lock(mutex);
+    if (--draining == 0)
+      work_done.notify_all();
+  }
+}
+
+void ThreadPool::drain(const std::size_t queue_index) {
+  do {
+    std::uint32_t chunk = 0;
+    while (pop_own(queue_index, chunk))
+      execute(chunk);
+  } while (steal(queue_index));
+}
+
+bool ThreadPool::pop_own(const std::size_t queue_index, std::uint32_t &chunk) {
+  auto &range = queues[queue_index].range;
+  std::uint64_t current = range.load(std::memory_order_acquire);
+  while (first_of(current) < last_of(current)) {
+    if (range.compare_exchange_weak(
+            current, pack(first_of(current) + 1, last_of(current)),
+            std::memory_order_acq_rel)) {
+      chunk = first_of(current);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Takes the back half of the first non-empty queue after our own. Our own
+// queue is empty at this point, and run() does not refill it for the next
+// job before we left drain(), so nobody else writes to it concurrently
+// except thieves whose CAS on the old value will fail.
+bool ThreadPool::steal(const std::size_t queue_index) {
+  const std::size_t participants = size();
+  for (std::size_t offset = 1; offset < participants; ++offset) {
+    auto &victim = queues[(queue_index + offset) % participants].range;
+    std::uint64_t current = victim.load(std::memory_order_acquire);
+    while (first_of(current) < last_of(current)) {
+      const std::uint32_t first = first_of(current);
+      const std::uint32_t last = last_of(current);
+      const std::uint32_t split = last - std::max(1u, (last - first) / 2);
+      if (victim.compare_exchange_weak(current, pack(first, split),
+                                       std::memory_order_acq_rel)) {
+        queues[queue_index].range.store(pack(split, last),
+                                        std::memory_order_release);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(const std::uint32_t chunk) {
+  const std::size_t begin = job_begin + chunk * job_grain;
+  const std::size_t end = std::min(job_end, begin + job_grain);
+  job.invoke(job.context, begin, end);
+  if (remaining_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard lock(mutex);
+    work_done.notify_all();
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool for data-parallel loops. parallel_for cuts the range into
+// grain-sized chunks, deals contiguous blocks of chunks to every participant
+// and lets idle participants steal half of another block. The calling thread
+// takes part, so a pool of size 1 has no workers and runs inline.
+//
+// Chunks are only a scheduling unit: callers that write disjoint outputs per
+// index get identical results for every thread count. Not reentrant.
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t max_threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  [[nodiscard]] std::size_t size() const { return workers.size() + 1; }
+
+  template <typename F>
+  void parallel_for(const std::size_t begin, const std::size_t end,
+                    const std::size_t grain, F &&body) {
+    if (end <= begin)
+      return;
+    if (workers.empty() || end - begin <= grain) {
+      body(begin, end);
+      return;
+    }
+    run({.context = &body,
+         .invoke =
+             [](void *context, const std::size_t b, const std::size_t e) {
+               (*static_cast<std::remove_reference_t<F> *>(context))(b, e);
+             }},
+        begin, end, grain);
+  }
+
+private:
+  struct Job {
+    void *context;
+    void (*invoke)(void *, std::size_t, std::size_t);
+  };
+
+  // [first, last) chunk indices packed into one word so the owner (front)
+  // and thieves (back) can both claim chunks with a CAS.
+  struct alignas(64) ChunkQueue {
+    std::atomic<std::uint64_t> range{0};
+  };
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<ChunkQueue[]> queues;
+
+  std::mutex mutex;
+  std::condition_variable work_available;
+  std::condition_variable work_done;
+  std::uint64_t generation = 0;
+  // Workers inside drain(). The queues are only refilled once it is zero,
+  // so that no thief from the last job can write a stale range into them.
+  std::size_t draining = 0;
+  bool stopping = false;
+
+  Job job{};
+  std::size_t job_begin = 0;
+  std::size_t job_end = 0;
+  std::size_t job_grain = 1;
+  std::atomic<std::size_t> remaining_chunks{0};
+
+  void run(Job new_job, std::size_t begin, std::size_t end, std::size_t grain);
+  void worker_loop(std::size_t queue_index);
+  void drain(std::size_t queue_index);
+  bool pop_own(std::size_t queue_index, std::uint32_t &chunk);
+  bool steal(std::size_t queue_index);
+  void execute(std::uint32_t chunk);
+};
@@ -0,0 +1,76 @@
+#include "tracer_store.h"
+
+#include <cmath>
+#include <random>
+
+#include "glm/gtc/constants.hpp"
+
+std::size_t TracerStore::add(const glm::dvec3 &position,
+                             const glm::dvec3 &velocity) {
+  x.push_back(position.x);
+  y.push_back(position.y);
+  z.push_back(position.z);
+  vx.push_back(velocity.x);
+  vy.push_back(velocity.y);
+  vz.push_back(velocity.z);
+  return x.size() - 1;
+}
+
+void TracerStore::clear() {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz}) {
+    component->clear();
+  }
+}
+
+void TracerStore::resize(const std::size_t count) {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz}) {
+    component->resize(count);
+  }
+}
+
+void TracerStore::reserve(const std::size_t count) {
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz}) {
+    component->reserve(count);
+  }
+}
+
+void TracerStore::remove(const std::vector<std::size_t> &sorted_indices) {
+  if (sorted_indices.empty())
+    return;
+  for (auto *component : {&x, &y, &z, &vx, &vy, &vz}) {
+    std::size_t out = sorted_indices.front();
+    std::size_t next = 0;
+    for (std::size_t i = out; i < component->size(); ++i) {
+      if (next < sorted_indices.size() && sorted_indices[next] == i) {
+        ++next;
+        continue;
+      }
+      (*component)[out++] = (*component)[i];
+    }
+    component->resize(out);
+  }
+}
+
+void TracerStore::add_belt(const std::size_t count, const double mu,
+                           const double inner_radius,
+                           const double outer_radius,
+                           const std::uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<double> radius_distribution(inner_radius,
+                                                             outer_radius);
+  std::uniform_real_distribution<double> angle_distribution(
+      0.0, glm::two_pi<double>());
+  std::normal_distribution<double> tilt_distribution(0.0, 0.05);
+
+  reserve(size() + count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const double radius = radius_distribution(generator);
+    const double angle = angle_distribution(generator);
+    const double tilt = tilt_distribution(generator);
+    const double speed = std::sqrt(mu / radius);
+    const glm::dvec3 radial(std::cos(angle), std::sin(angle), 0.0);
+    const glm::dvec3 tangent(-std::sin(angle) * std::cos(tilt),
+                             std::cos(angle) * std::cos(tilt), std::sin(tilt));
+    add(radius * radial, speed * tangent);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "glm/glm.hpp"
+
+// Massless test particles: they feel the massive bodies but exert no force,
+// so they need neither mass nor stored accelerations. 48 bytes per tracer.
+struct TracerStore {
+  AlignedVector<double> x, y, z;    // au
+  AlignedVector<double> vx, vy, vz; // au/day
+
+  [[nodiscard]] std::size_t size() const { return x.size(); }
+
+  std::size_t add(const glm::dvec3 &position, const glm::dvec3 &velocity);
+  void clear();
+  void resize(std::size_t count);
+  void reserve(std::size_t count);
+  // Removes the tracers at the given ascending indices and keeps the order
+  // of the rest.
+  void remove(const std::vector<std::size_t> &sorted_indices);
+
+  // Adds `count` tracers on near-circular orbits around a central mass at
+  // the origin, with semi-major axes in [inner_radius, outer_radius].
+  void add_belt(std::size_t count, double mu, double inner_radius,
+                double outer_radius, std::uint32_t seed = 1);
+
+  [[nodiscard]] glm::dvec3 position(const std::size_t i) const {
+    return {x[i], y[i], z[i]};
+  }
+  [[nodiscard]] glm::dvec3 velocity(const std::size_t i) const {
+    return {vx[i], vy[i], vz[i]};
+  }
+};
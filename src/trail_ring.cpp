@@ -0,0 +1,126 @@
+#include "trail_ring.h"
+
+#include <algorithm>
+
+#include "color.h"
+
+void TrailRing::reset(const std::vector<std::size_t> &capacities) {
+  trails.clear();
+  std::size_t offset = 0;
+  for (const std::size_t capacity : capacities) {
+    trails.push_back({.offset = offset, .capacity = capacity});
+    offset += capacity + 1;
+  }
+  staged.assign(offset, TrailVertex{});
+  written.clear();
+  layout_changed = true;
+}
+
+void TrailRing::append(const std::size_t trail, const glm::vec3 &position,
+                       const std::uint32_t sample, const glm::vec3 &color) {
+  Trail &ring = trails[trail];
+  if (ring.capacity == 0)
+    return;
+  write(ring, ring.head,
+        {.position = position,
+         .sample = sample,
+         .color = pack_color(color),
+         .span = static_cast<float>(ring.capacity)});
+  ring.head = (ring.head + 1) % ring.capacity;
+  ring.count = std::min(ring.count + 1, ring.capacity);
+}
+
+void TrailRing::replace_last(const std::size_t trail, const glm::vec3 &position,
+                             const std::uint32_t sample,
+                             const glm::vec3 &color) {
+  const Trail &ring = trails[trail];
+  if (ring.count == 0)
+    return;
+  write(ring, (ring.head + ring.capacity - 1) % ring.capacity,
+        {.position = position,
+         .sample = sample,
+         .color = pack_color(color),
+         .span = static_cast<float>(ring.capacity)});
+}
+
+void TrailRing::drop_oldest(const std::size_t trail, const std::size_t count) {
+  trails[trail].count -= std::min(count, trails[trail].count);
+}
+
+void TrailRing::write(const Trail &ring, const std::size_t slot,
+                      const TrailVertex &vertex) {
+  staged[ring.offset + slot] = vertex;
+  mark(ring.offset + slot);
+  if (slot == 0) {
+    staged[ring.offset + ring.capacity] = vertex;
+    mark(ring.offset + ring.capacity);
+  }
+}
+
+void TrailRing::clear(const std::size_t trail) {
+  trails[trail].head = 0;
+  trails[trail].count = 0;
+}
+
+void TrailRing::mark(const std::size_t vertex) {
+  if (!written.empty()) {
+    Range &last = written.back();
+    if (vertex >= last.first && vertex <= last.first + last.count) {
+      last.count = std::max(last.count, vertex - last.first + 1);
+      return;
+    }
+  }
+  written.push_back({vertex, 1});
+}
+
+std::vector<TrailRing::Range>
+TrailRing::dirty(const std::size_t merge_gap) const {
+  if (layout_changed)
+    return staged.empty() ? std::vector<Range>{}
+                          : std::vector<Range>{{0, staged.size()}};
+  std::vector<Range> ranges = written;
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range &a, const Range &b) { return a.first < b.first; });
+  std::vector<Range> merged;
+  for (const Range &range : ranges) {
+    if (!merged.empty()) {
+      Range &last = merged.back();
+      const std::size_t end = last.first + last.count;
+      if (range.first <= end + merge_gap) {
+        last.count = std::max(end, range.first + range.count) - last.first;
+        continue;
+      }
+    }
+    merged.push_back(range);
+  }
+  return merged;
+}
+
+void TrailRing::clear_dirty() {
+  written.clear();
+  layout_changed = false;
+}
+
+void TrailRing::draw_ranges(std::vector<std::int32_t> &firsts,
+                            std::vector<std::int32_t> &counts) const {
+  firsts.clear();
+  counts.clear();
+  const auto add = [&](const std::size_t first, const std::size_t count) {
+    firsts.push_back(static_cast<std::int32_t>(first));
+    counts.push_back(static_cast<std::int32_t>(count));
+  };
+  for (const Trail &ring : trails) {
+    if (ring.count < 2)
+      continue;
+    const std::size_t oldest =
+        (ring.head + ring.capacity - ring.count) % ring.capacity;
+    if (oldest + ring.count <= ring.capacity) {
+      add(ring.offset + oldest, ring.count);
+      continue;
+    }
+    // Up to the copy of slot 0, then on from slot 0.
+    add(ring.offset + oldest, ring.capacity - oldest + 1);
+    if (ring.head >= 2)
+      add(ring.offset, ring.head);
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// One vertex of a trail as the GPU sees it: 24 bytes.
+struct TrailVertex {
+  glm::vec3 position;
+  std::uint32_t sample; // when the point was recorded, counted by the caller
+  std::uint32_t color;  // RGBA8, red in the lowest byte
+  float span;           // samples until the point has faded out
+};
+
+// CPU mirror of a vertex buffer holding every trail in one ring of its own,
+// so the viewer can upload only what changed since the last frame and draw
+// all trails with one glMultiDrawArrays of line strips. Free of GL calls.
+//
+// A trail of capacity c owns c + 1 consecutive vertices. The extra one
+// repeats slot 0, so a wrapped ring draws as two strips that meet there:
+// [oldest, c] and [0, newest].
+class TrailRing {
+public:
+  struct Range {
+    std::size_t first;
+    std::size_t count;
+  };
+
+  // Drops all points and lays out one empty trail per capacity.
+  void reset(const std::vector<std::size_t> &capacities);
+
+  // Adds a point, overwriting the oldest one once the trail is full.
+  void append(std::size_t trail, const glm::vec3 &position,
+              std::uint32_t sample, const glm::vec3 &color);
+  // Moves the newest point of a trail that has one.
+  void replace_last(std::size_t trail, const glm::vec3 &position,
+                    std::uint32_t sample, const glm::vec3 &color);
+  // Forgets up to count of the oldest points.
+  void drop_oldest(std::size_t trail, std::size_t count);
+  void clear(std::size_t trail);
+
+  [[nodiscard]] std::size_t trail_count() const { return trails.size(); }
+  [[nodiscard]] std::size_t size(std::size_t trail) const {
+    return trails[trail].count;
+  }
+  [[nodiscard]] std::size_t capacity(std::size_t trail) const {
+    return trails[trail].capacity;
+  }
+  // All vertices, including unused slots; the buffer is allocated to this.
+  [[nodiscard]] const std::vector<TrailVertex> &vertices() const {
+    return staged;
+  }
+
+  // Vertex ranges written since the last clear_dirty(), ascending. Ranges
+  // less than merge_gap vertices apart are joined, trading a few redundant
+  // bytes for fewer uploads.
+  [[nodiscard]] std::vector<Range> dirty(std::size_t merge_gap = 64) const;
+  void clear_dirty();
+  // True after reset(), until clear_dirty(): the whole buffer is new.
+  [[nodiscard]] bool resized() const { return layout_changed; }
+
+  // Line strips of all trails with at least two points, oldest first.
+  void draw_ranges(std::vector<std::int32_t> &firsts,
+                   std::vector<std::int32_t> &counts) const;
+
+private:
+  struct Trail {
+    std::size_t offset;   // first vertex
+    std::size_t capacity; // points kept
+    std::size_t head = 0; // slot the next point goes to
+    std::size_t count = 0;
+  };
+
+  std::vector<Trail> trails;
+  std::vector<TrailVertex> staged;
+  std::vector<Range> written;
+  bool layout_changed = false;
+
+  void write(const Trail &ring, std::size_t slot, const TrailVertex &vertex);
+  void mark(std::size_t vertex);
+};
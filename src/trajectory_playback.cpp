@@ -0,0 +1,215 @@
+#include "trajectory_playback.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TrajectoryPlayback::TrajectoryPlayback(const std::string &path,
+                                       const std::size_t cache_bytes) {
+  const int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0)
+    throw std::runtime_error("Cannot open trajectory " + path);
+  struct stat file_status {};
+  if (::fstat(descriptor, &file_status) != 0 ||
+      static_cast<std::size_t>(file_status.st_size) <
+          sizeof(TrajectoryFormat::FileHeader)) {
+    ::close(descriptor);
+    throw std::runtime_error("Trajectory " + path + " is truncated");
+  }
+  size = static_cast<std::size_t>(file_status.st_size);
+  data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  ::close(descriptor);
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    throw std::runtime_error("Cannot map trajectory " + path);
+  }
+  // Scrubbing jumps around; read-ahead would only pull in unused chunks.
+  ::madvise(data, size, MADV_RANDOM);
+
+  const auto *bytes = static_cast<const std::uint8_t *>(data);
+  std::memcpy(&file_header, bytes, sizeof(file_header));
+  try {
+    TrajectoryFormat::validate(file_header);
+  } catch (const std::exception &) {
+    ::munmap(data, size);
+    data = nullptr;
+    throw;
+  }
+
+  // Headers are not aligned in the file, so they are copied out.
+  std::uint64_t offset = sizeof(file_header);
+  double previous_time = 0.0;
+  while (size - offset >= sizeof(TrajectoryFormat::ChunkHeader)) {
+    ChunkEntry entry{};
+    std::memcpy(&entry.header, bytes + offset, sizeof(entry.header));
+    entry.offset = offset + sizeof(entry.header);
+    entry.first_frame = total_frames;
+    if (entry.header.frame_count == 0 ||
+        entry.header.compressed_size > size - entry.offset ||
+        entry.header.last_time < entry.header.first_time ||
+        (!chunks.empty() && entry.header.first_time < previous_time))
+      break;
+    chunks.push_back(entry);
+    total_frames += entry.header.frame_count;
+    previous_time = entry.header.last_time;
+    offset = entry.offset + entry.header.compressed_size;
+  }
+  if (chunks.empty()) {
+    ::munmap(data, size);
+    data = nullptr;
+    throw std::runtime_error("Trajectory " + path + " has no frames");
+  }
+
+  const std::size_t components = file_header.velocities != 0 ? 6 : 3;
+  const std::size_t chunk_bytes = file_header.frames_per_chunk *
+                                  (1 + components * file_header.body_count) *
+                                  sizeof(double);
+  cache_capacity =
+      std::max<std::size_t>(2, cache_bytes / std::max<std::size_t>(
+                                                 1, chunk_bytes));
+}
+
+TrajectoryPlayback::~TrajectoryPlayback() {
+  if (data != nullptr)
+    ::munmap(data, size);
+}
+
+// Least recently used chunks are evicted first.
+const TrajectoryFrames &TrajectoryPlayback::chunk(const std::size_t index) {
+  ++use_counter;
+  for (const auto &cached : cache) {
+    if (cached->index == index) {
+      cached->last_used = use_counter;
+      return cached->frames;
+    }
+  }
+
+  CachedChunk *slot = nullptr;
+  if (cache.size() < cache_capacity) {
+    slot = cache.emplace_back(std::make_unique<CachedChunk>()).get();
+  } else {
+    slot = std::min_element(cache.begin(), cache.end(),
+                            [](const auto &a, const auto &b) {
+                              return a->last_used < b->last_used;
+                            })
+               ->get();
+  }
+  // The slot holds no chunk until decoding succeeds, so a damaged chunk
+  // leaves nothing half-decoded behind.
+  const auto &entry = chunks[index];
+  slot->index = NO_CHUNK;
+  TrajectoryFormat::decode(file_header, entry.header,
+                           static_cast<const std::uint8_t *>(data) +
+                               entry.offset,
+                           slot->frames);
+  slot->index = index;
+  slot->last_used = use_counter;
+  return slot->frames;
+}
+
+std::size_t TrajectoryPlayback::chunk_of(const std::uint64_t frame) const {
+  const auto it = std::upper_bound(
+      chunks.begin(), chunks.end(), frame,
+      [](const std::uint64_t value, const ChunkEntry &entry) {
+        return value < entry.first_frame;
+      });
+  return static_cast<std::size_t>(it - chunks.begin()) - 1;
+}
+
+std::uint64_t TrajectoryPlayback::locate(const double time) {
+  const auto it = std::upper_bound(
+      chunks.begin(), chunks.end(), time,
+      [](const double value, const ChunkEntry &entry) {
+        return value < entry.header.first_time;
+      });
+  const std::size_t index =
+      it == chunks.begin() ? 0 : static_cast<std::size_t>(it - chunks.begin()) - 1;
+  const auto &times = chunk(index).times;
+  const auto frame = std::upper_bound(times.begin(), times.end(), time);
+  return chunks[index].first_frame +
+         (frame == times.begin()
+              ? 0
+              : static_cast<std::uint64_t>(frame - times.begin()) - 1);
+}
+
+void TrajectoryPlayback::positions_at(const double time,
+                                      std::vector<glm::dvec3> &positions) {
+  const std::size_t n = file_header.body_count;
+  const double t = std::clamp(time, start_time(), end_time());
+  const std::uint64_t frame = locate(t);
+  const std::size_t index = chunk_of(frame);
+  const auto &a = chunk(index);
+  const auto fa = static_cast<std::size_t>(frame - chunks[index].first_frame);
+  positions.resize(n);
+  if (frame + 1 == total_frames || a.times[fa] == t) {
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t k = fa * n + i;
+      positions[i] = {a.x[k], a.y[k], a.z[k]};
+    }
+    return;
+  }
+
+  // The next frame may start the next chunk. a stays cached meanwhile,
+  // since it was used last and the cache holds at least two chunks.
+  const std::size_t next_index = chunk_of(frame + 1);
+  const auto &b = chunk(next_index);
+  const auto fb =
+      static_cast<std::size_t>(frame + 1 - chunks[next_index].first_frame);
+  const double h = b.times[fb] - a.times[fa];
+  const double s = h > 0.0 ? (t - a.times[fa]) / h : 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::size_t ka = fa * n + i;
+    const std::size_t kb = fb * n + i;
+    const glm::dvec3 p0(a.x[ka], a.y[ka], a.z[ka]);
+    const glm::dvec3 p1(b.x[kb], b.y[kb], b.z[kb]);
+    if (a.vx.empty()) {
+      positions[i] = p0 + s * (p1 - p0);
+      continue;
+    }
+    const glm::dvec3 v0(a.vx[ka], a.vy[ka], a.vz[ka]);
+    const glm::dvec3 v1(b.vx[kb], b.vy[kb], b.vz[kb]);
+    const double s2 = s * s;
+    const double s3 = s2 * s;
+    positions[i] = (2.0 * s3 - 3.0 * s2 + 1.0) * p0 +
+                   (s3 - 2.0 * s2 + s) * h * v0 +
+                   (-2.0 * s3 + 3.0 * s2) * p1 + (s3 - s2) * h * v1;
+  }
+}
+
+void TrajectoryPlayback::paths_at(
+    const double time, const std::vector<std::size_t> &lengths,
+    std::vector<std::vector<glm::dvec3>> &paths) {
+  const std::size_t n = std::min(lengths.size(), body_count());
+  const std::uint64_t last = locate(std::clamp(time, start_time(), end_time()));
+  std::vector<std::uint64_t> first(n);
+  std::uint64_t earliest = last;
+  paths.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    first[i] = last + 1 - std::min<std::uint64_t>(lengths[i], last + 1);
+    earliest = std::min(earliest, first[i]);
+    paths[i].clear();
+    paths[i].reserve(last + 1 - first[i]);
+  }
+
+  for (std::uint64_t frame = earliest; frame <= last;) {
+    const std::size_t index = chunk_of(frame);
+    const auto &frames = chunk(index);
+    const std::uint64_t chunk_end = std::min<std::uint64_t>(
+        last + 1, chunks[index].first_frame + frames.frame_count);
+    for (; frame < chunk_end; ++frame) {
+      const std::size_t base =
+          static_cast<std::size_t>(frame - chunks[index].first_frame) *
+          frames.body_count;
+      for (std::size_t i = 0; i < n; ++i) {
+        if (frame >= first[i])
+          paths[i].emplace_back(frames.x[base + i], frames.y[base + i],
+                                frames.z[base + i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "trajectory_recorder.h"
+
+// Random access into a recorded trajectory. The file is mapped, not read:
+// opening it only walks the chunk headers to build a time index, and
+// chunks are decompressed on demand into a cache of at most cache_bytes.
+class TrajectoryPlayback {
+public:
+  // Throws std::runtime_error if path is not a supported trajectory or holds
+  // no frames. A damaged or unfinished last chunk is ignored.
+  explicit TrajectoryPlayback(const std::string &path,
+                              std::size_t cache_bytes = 256 << 20);
+  ~TrajectoryPlayback();
+  TrajectoryPlayback(const TrajectoryPlayback &) = delete;
+  TrajectoryPlayback &operator=(const TrajectoryPlayback &) = delete;
+
+  [[nodiscard]] const TrajectoryFormat::FileHeader &header() const {
+    return file_header;
+  }
+  [[nodiscard]] std::size_t body_count() const {
+    return file_header.body_count;
+  }
+  [[nodiscard]] std::uint64_t frame_count() const { return total_frames; }
+  [[nodiscard]] double start_time() const {
+    return chunks.front().header.first_time;
+  }
+  [[nodiscard]] double end_time() const {
+    return chunks.back().header.last_time;
+  }
+
+  // Positions in au of all bodies at time, clamped to the recorded range.
+  // Cubic Hermite between the neighbouring frames if velocities were
+  // recorded, linear otherwise. Throws std::runtime_error if a chunk it
+  // needs is damaged, as does paths_at().
+  void positions_at(double time, std::vector<glm::dvec3> &positions);
+
+  // For every body i, the last lengths[i] recorded positions at or before
+  // time, oldest first. Each chunk involved is decoded once for all bodies.
+  void paths_at(double time, const std::vector<std::size_t> &lengths,
+                std::vector<std::vector<glm::dvec3>> &paths);
+
+private:
+  struct ChunkEntry {
+    TrajectoryFormat::ChunkHeader header;
+    std::uint64_t offset; // of the compressed data
+    std::uint64_t first_frame;
+  };
+
+  static constexpr std::size_t NO_CHUNK =
+      std::numeric_limits<std::size_t>::max();
+  struct CachedChunk {
+    std::size_t index = NO_CHUNK;
+    std::uint64_t last_used = 0;
+    TrajectoryFrames frames;
+  };
+
+  void *data = nullptr;
+  std::size_t size = 0;
+  TrajectoryFormat::FileHeader file_header{};
+  std::vector<ChunkEntry> chunks;
+  std::uint64_t total_frames = 0;
+
+  std::size_t cache_capacity = 2;
+  std::vector<std::unique_ptr<CachedChunk>> cache;
+  std::uint64_t use_counter = 0;
+
+  // The returned frames stay valid until two other chunks were requested.
+  const TrajectoryFrames &chunk(std::size_t index);
+  // Global index of the last frame at or before time, clamped.
+  std::uint64_t locate(double time);
+  [[nodiscard]] std::size_t chunk_of(std::uint64_t frame) const;
+};
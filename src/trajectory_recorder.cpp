@@ -0,0 +1,385 @@
+#include "trajectory_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'A', 'G', '3', 'D', 'T', 'R', 'J'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+// Deflate expands at most this much, which bounds a chunk's raw size.
+constexpr std::uint64_t MAX_DEFLATE_RATIO = 1032;
+// Far more than any recording holds, and small enough that sizes derived
+// from it cannot overflow.
+constexpr std::uint64_t MAX_BODIES = std::uint64_t{1} << 32;
+
+std::size_t components_of(const TrajectoryFormat::FileHeader &header) {
+  return header.velocities != 0 ? 6 : 3;
+}
+
+// Signed values near zero become small unsigned ones: 0, -1, 1, -2, ...
+std::uint64_t zigzag(const std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(const std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+void put_varint(std::vector<std::uint8_t> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t get_varint(const std::uint8_t *&in, const std::uint8_t *end) {
+  std::uint64_t value = 0;
+  for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+    const std::uint8_t byte = *in++;
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  throw std::runtime_error("Trajectory chunk is damaged");
+}
+
+// Quadratic extrapolation from the three previous frames, lower order at
+// the start of a chunk. Wrapping arithmetic, so damaged input cannot cause
+// signed overflow.
+std::int64_t predict(const std::size_t frame,
+                     const std::int64_t (&history)[3]) {
+  const auto h0 = static_cast<std::uint64_t>(history[0]);
+  const auto h1 = static_cast<std::uint64_t>(history[1]);
+  const auto h2 = static_cast<std::uint64_t>(history[2]);
+  switch (frame) {
+  case 0:
+    return 0;
+  case 1:
+    return history[0];
+  case 2:
+    return static_cast<std::int64_t>(2 * h0 - h1);
+  default:
+    return static_cast<std::int64_t>(3 * h0 - 3 * h1 + h2);
+  }
+}
+
+} // namespace
+
+TrajectoryFormat::FileHeader
+TrajectoryFormat::make_header(const std::size_t body_count,
+                              const TrajectorySettings &settings) {
+  FileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.body_count = body_count;
+  header.velocities = settings.velocities ? 1 : 0;
+  const std::size_t values_per_frame =
+      (settings.velocities ? 6 : 3) * std::max<std::size_t>(1, body_count);
+  header.frames_per_chunk = static_cast<std::uint32_t>(std::clamp<std::size_t>(
+      settings.max_chunk_values / values_per_frame, 1,
+      std::max<std::size_t>(1, settings.frames_per_chunk)));
+  header.position_quantum = settings.position_quantum;
+  header.velocity_quantum = settings.velocity_quantum;
+  return header;
+}
+
+void TrajectoryFormat::validate(const FileHeader &header) {
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw std::runtime_error("Not a trajectory file");
+  if (header.version != VERSION)
+    throw std::runtime_error("Unsupported trajectory version " +
+                             std::to_string(header.version));
+  if (header.byte_order != BYTE_ORDER_MARK)
+    throw std::runtime_error(
+        "Trajectory was written with a different byte order");
+  if (!(header.position_quantum > 0.0) || !(header.velocity_quantum > 0.0))
+    throw std::runtime_error("Trajectory has an invalid quantum");
+  if (header.body_count == 0 || header.body_count > MAX_BODIES)
+    throw std::runtime_error("Trajectory has an invalid body count " +
+                             std::to_string(header.body_count));
+}
+
+std::vector<std::uint8_t>
+TrajectoryFormat::encode(const FileHeader &header,
+                         const std::size_t frame_count, const double *times,
+                         const double *values, const int compression_level) {
+  const std::size_t n = header.body_count;
+  const std::size_t components = components_of(header);
+
+  std::vector<std::uint8_t> raw(frame_count * sizeof(double));
+  std::memcpy(raw.data(), times, raw.size());
+  raw.reserve(raw.size() + 2 * frame_count * components * n);
+  for (std::size_t c = 0; c < components; ++c) {
+    const double scale =
+        1.0 / (c < 3 ? header.position_quantum : header.velocity_quantum);
+    for (std::size_t i = 0; i < n; ++i) {
+      std::int64_t history[3] = {};
+      for (std::size_t f = 0; f < frame_count; ++f) {
+        const std::int64_t quantized =
+            std::llround(values[(f * components + c) * n + i] * scale);
+        const std::int64_t prediction = predict(f, history);
+        put_varint(raw, zigzag(static_cast<std::int64_t>(
+                            static_cast<std::uint64_t>(quantized) -
+                            static_cast<std::uint64_t>(prediction))));
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = quantized;
+      }
+    }
+  }
+
+  uLongf compressed_size = compressBound(static_cast<uLong>(raw.size()));
+  std::vector<std::uint8_t> chunk(sizeof(ChunkHeader) + compressed_size);
+  if (compress2(chunk.data() + sizeof(ChunkHeader), &compressed_size,
+                raw.data(), static_cast<uLong>(raw.size()),
+                compression_level) != Z_OK)
+    throw std::runtime_error("Cannot compress trajectory chunk");
+  chunk.resize(sizeof(ChunkHeader) + compressed_size);
+
+  ChunkHeader chunk_header{};
+  chunk_header.frame_count = static_cast<std::uint32_t>(frame_count);
+  chunk_header.first_time = frame_count > 0 ? times[0] : 0.0;
+  chunk_header.last_time = frame_count > 0 ? times[frame_count - 1] : 0.0;
+  chunk_header.raw_size = raw.size();
+  chunk_header.compressed_size = compressed_size;
+  std::memcpy(chunk.data(), &chunk_header, sizeof(ChunkHeader));
+  return chunk;
+}
+
+void TrajectoryFormat::decode(const FileHeader &header,
+                              const ChunkHeader &chunk,
+                              const std::uint8_t *compressed,
+                              TrajectoryFrames &frames) {
+  const std::size_t n = header.body_count;
+  const std::size_t f_count = chunk.frame_count;
+  const std::size_t components = components_of(header);
+  // A frame holds its time and at least a byte per varint; dividing keeps
+  // damaged counts from overflowing.
+  const std::uint64_t min_frame_size = sizeof(double) + components * n;
+  if (n == 0 || n > MAX_BODIES || chunk.raw_size / min_frame_size < f_count ||
+      chunk.raw_size / MAX_DEFLATE_RATIO > chunk.compressed_size)
+    throw std::runtime_error("Trajectory chunk is damaged");
+
+  std::vector<std::uint8_t> raw(chunk.raw_size);
+  uLongf raw_size = static_cast<uLongf>(raw.size());
+  if (uncompress(raw.data(), &raw_size, compressed,
+                 static_cast<uLong>(chunk.compressed_size)) != Z_OK ||
+      raw_size != raw.size())
+    throw std::runtime_error("Trajectory chunk is damaged");
+
+  frames.body_count = n;
+  frames.frame_count = f_count;
+  frames.times.resize(f_count);
+  std::memcpy(frames.times.data(), raw.data(), f_count * sizeof(double));
+  std::vector<double> *outputs[] = {&frames.x,  &frames.y,  &frames.z,
+                                    &frames.vx, &frames.vy, &frames.vz};
+  for (std::size_t c = 0; c < 6; ++c)
+    outputs[c]->resize(c < components ? f_count * n : 0);
+
+  const std::uint8_t *in = raw.data() + f_count * sizeof(double);
+  const std::uint8_t *end = raw.data() + raw.size();
+  for (std::size_t c = 0; c < components; ++c) {
+    const double quantum =
+        c < 3 ? header.position_quantum : header.velocity_quantum;
+    auto &output = *outputs[c];
+    for (std::size_t i = 0; i < n; ++i) {
+      std::int64_t history[3] = {};
+      for (std::size_t f = 0; f < f_count; ++f) {
+        const std::int64_t quantized = static_cast<std::int64_t>(
+            static_cast<std::uint64_t>(predict(f, history)) +
+            static_cast<std::uint64_t>(unzigzag(get_varint(in, end))));
+        output[f * n + i] = static_cast<double>(quantized) * quantum;
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = quantized;
+      }
+    }
+  }
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string &path,
+                                       const std::size_t body_count,
+                                       TrajectorySettings settings)
+    : header(TrajectoryFormat::make_header(body_count, settings)),
+      settings(settings), components(components_of(header)),
+      file(path, std::ios::binary | std::ios::trunc) {
+  if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header)))
+    throw std::runtime_error("Cannot create trajectory " + path);
+  written = sizeof(header);
+  writer = std::thread([this] { write_loop(); });
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+  try {
+    finish();
+  } catch (const std::exception &) {
+  }
+}
+
+bool TrajectoryRecorder::record(const double time, const BodyStore &state) {
+  if (state.size() != header.body_count)
+    throw std::runtime_error("Body count changed while recording");
+  if (has_last_time && time - last_time < settings.interval)
+    return false;
+  has_last_time = true;
+  last_time = time;
+  if (!current) {
+    current = take_chunk();
+    if (!current) {
+      ++dropped_frames;
+      return false;
+    }
+  }
+
+  const std::size_t n = header.body_count;
+  const double *sources[] = {state.x.data(),  state.y.data(),
+                             state.z.data(),  state.vx.data(),
+                             state.vy.data(), state.vz.data()};
+  Chunk &chunk = *current;
+  chunk.times[chunk.frame_count] = time;
+  double *frame = chunk.values.data() + chunk.frame_count * components * n;
+  for (std::size_t c = 0; c < components; ++c)
+    std::copy_n(sources[c], n, frame + c * n);
+  ++chunk.frame_count;
+  ++recorded_frames;
+  if (chunk.frame_count == header.frames_per_chunk)
+    hand_over();
+  return true;
+}
+
+// Returns nullptr when too many chunks wait for the writer and frames may
+// be dropped.
+std::unique_ptr<TrajectoryRecorder::Chunk> TrajectoryRecorder::take_chunk() {
+  const std::size_t max_pending =
+      std::max<std::size_t>(1, settings.max_pending_chunks);
+  std::unique_ptr<Chunk> chunk;
+  {
+    std::unique_lock lock(mutex);
+    if (full.size() >= max_pending) {
+      if (settings.drop_when_behind)
+        return nullptr;
+      chunk_returned.wait(lock, [&] { return full.size() < max_pending; });
+    }
+    if (!spare.empty()) {
+      chunk = std::move(spare.back());
+      spare.pop_back();
+    }
+  }
+  if (!chunk) {
+    chunk = std::make_unique<Chunk>();
+    chunk->times.resize(header.frames_per_chunk);
+    chunk->values.resize(header.frames_per_chunk * components *
+                         header.body_count);
+  }
+  chunk->frame_count = 0;
+  return chunk;
+}
+
+void TrajectoryRecorder::hand_over() {
+  {
+    const std::lock_guard lock(mutex);
+    full.push_back(std::move(current));
+  }
+  work_ready.notify_one();
+}
+
+void TrajectoryRecorder::write_loop() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    work_ready.wait(lock, [this] { return stopping || !full.empty(); });
+    if (full.empty())
+      return;
+    auto chunk = std::move(full.front());
+    full.pop_front();
+    const bool skip = write_failed;
+    lock.unlock();
+
+    bool ok = true;
+    std::size_t size = 0;
+    if (!skip) {
+      try {
+        const auto bytes = TrajectoryFormat::encode(
+            header, chunk->frame_count, chunk->times.data(),
+            chunk->values.data(), settings.compression_level);
+        size = bytes.size();
+        ok = static_cast<bool>(
+            file.write(reinterpret_cast<const char *>(bytes.data()),
+                       static_cast<std::streamsize>(bytes.size())));
+      } catch (const std::exception &) {
+        ok = false;
+      }
+    }
+
+    lock.lock();
+    written += size;
+    write_failed = write_failed || !ok;
+    spare.push_back(std::move(chunk));
+    chunk_returned.notify_one();
+  }
+}
+
+void TrajectoryRecorder::finish() {
+  if (!writer.joinable())
+    return;
+  if (current && current->frame_count > 0)
+    hand_over();
+  {
+    const std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  work_ready.notify_one();
+  writer.join();
+  file.close();
+  if (write_failed || file.fail())
+    throw std::runtime_error("Writing the trajectory failed");
+}
+
+std::uint64_t TrajectoryRecorder::bytes_written() {
+  const std::lock_guard lock(mutex);
+  return written;
+}
+
+std::uint64_t TrajectoryRecorder::raw_bytes() const {
+  return sizeof(header) + recorded_frames * (1 + components *
+                                                     header.body_count) *
+                              sizeof(double);
+}
+
+bool TrajectoryRecorder::failed() {
+  const std::lock_guard lock(mutex);
+  return write_failed;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &path)
+    : file(path, std::ios::binary) {
+  if (!file.read(reinterpret_cast<char *>(&file_header), sizeof(file_header)))
+    throw std::runtime_error("Cannot read trajectory " + path);
+  TrajectoryFormat::validate(file_header);
+  file.seekg(0, std::ios::end);
+  file_size = static_cast<std::uint64_t>(file.tellg());
+  file.seekg(sizeof(file_header));
+}
+
+bool TrajectoryReader::next(TrajectoryFrames &frames) {
+  TrajectoryFormat::ChunkHeader chunk{};
+  if (!file.read(reinterpret_cast<char *>(&chunk), sizeof(chunk)))
+    return false;
+  if (chunk.compressed_size >
+      file_size - static_cast<std::uint64_t>(file.tellg()))
+    throw std::runtime_error("Trajectory is truncated");
+  buffer.resize(chunk.compressed_size);
+  if (!file.read(reinterpret_cast<char *>(buffer.data()),
+                 static_cast<std::streamsize>(buffer.size())))
+    throw std::runtime_error("Trajectory is truncated");
+  TrajectoryFormat::decode(file_header, chunk, buffer.data(), frames);
+  return true;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "body_store.h"
+
+struct TrajectorySettings {
+  double interval = 1.0; // simulated days between frames, 0 = every call
+  std::size_t frames_per_chunk = 256;
+  // Fewer frames per chunk for many bodies, so that playback never has to
+  // decode more than this many coordinates to reach one frame.
+  std::size_t max_chunk_values = std::size_t{1} << 21;
+  double position_quantum = 1e-8;  // au, about 1.5 km
+  double velocity_quantum = 1e-10; // au/day, about 2 mm/s
+  bool velocities = false;
+  int compression_level = 6; // zlib, 1 = fastest
+  // Chunks that may wait for the writer before record() drops frames, or
+  // waits for the writer if dropping is off (batch runs).
+  std::size_t max_pending_chunks = 8;
+  bool drop_when_behind = true;
+};
+
+// Frames of one chunk, decoded. Arrays are frame-major:
+// x[frame * body_count + body]. Velocities are empty unless recorded.
+struct TrajectoryFrames {
+  std::size_t body_count = 0;
+  std::size_t frame_count = 0;
+  std::vector<double> times;
+  std::vector<double> x, y, z;
+  std::vector<double> vx, vy, vz;
+};
+
+// On-disk layout: a FileHeader, then chunks of ChunkHeader plus a zlib
+// stream. Each chunk decodes on its own. Inside, every coordinate is
+// quantized to a multiple of the quantum and stored per body as the error
+// of a quadratic extrapolation from the previous three frames, zigzag
+// varint encoded. On smooth orbits that is close to zero and compresses
+// well.
+class TrajectoryFormat {
+public:
+  static constexpr std::uint32_t VERSION = 2;
+
+  struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order; // 0x01020304 as written
+    std::uint64_t body_count;
+    std::uint32_t velocities;
+    std::uint32_t frames_per_chunk;
+    double position_quantum;
+    double velocity_quantum;
+  };
+
+  // The time range lets readers index a file without decompressing it.
+  struct ChunkHeader {
+    std::uint32_t frame_count;
+    std::uint32_t reserved;
+    double first_time;
+    double last_time;
+    std::uint64_t raw_size;
+    std::uint64_t compressed_size;
+  };
+
+  static FileHeader make_header(std::size_t body_count,
+                                const TrajectorySettings &settings);
+  // Throws std::runtime_error if header is not a supported trajectory.
+  static void validate(const FileHeader &header);
+
+  // values holds, for each frame, the components x, y, z (and vx, vy, vz)
+  // one after the other, each with one entry per body.
+  static std::vector<std::uint8_t> encode(const FileHeader &header,
+                                          std::size_t frame_count,
+                                          const double *times,
+                                          const double *values,
+                                          int compression_level);
+  static void decode(const FileHeader &header, const ChunkHeader &chunk,
+                     const std::uint8_t *compressed, TrajectoryFrames &frames);
+};
+
+// Streams body states to a file at a fixed simulated-time cadence. Frames
+// are copied into a chunk buffer; full chunks are encoded, compressed and
+// written on a background thread, so record() never waits for the disk.
+// If the writer falls max_pending_chunks behind, frames are dropped and
+// counted, unless settings.drop_when_behind is off. Used from a single
+// thread.
+class TrajectoryRecorder {
+public:
+  // Throws std::runtime_error if the file cannot be created.
+  TrajectoryRecorder(const std::string &path, std::size_t body_count,
+                     TrajectorySettings settings = {});
+  // Writes what is left; errors are swallowed, call finish() to see them.
+  ~TrajectoryRecorder();
+  TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+  // Adds a frame if at least settings.interval has passed since the last
+  // one. Returns true if the frame was kept. Throws std::runtime_error if
+  // state does not hold body_count() bodies.
+  bool record(double time, const BodyStore &state);
+
+  // Hands over the partial chunk, waits for the writer and closes the
+  // file. Throws std::runtime_error if writing failed.
+  void finish();
+
+  [[nodiscard]] std::size_t body_count() const { return header.body_count; }
+  [[nodiscard]] std::uint64_t frames_recorded() const {
+    return recorded_frames;
+  }
+  [[nodiscard]] std::uint64_t frames_dropped() const { return dropped_frames; }
+  // Size of the file so far and of the same frames as raw doubles.
+  [[nodiscard]] std::uint64_t bytes_written();
+  [[nodiscard]] std::uint64_t raw_bytes() const;
+  [[nodiscard]] bool failed();
+
+private:
+  struct Chunk {
+    std::size_t frame_count = 0;
+    std::vector<double> times;
+    std::vector<double> values;
+  };
+
+  TrajectoryFormat::FileHeader header;
+  TrajectorySettings settings;
+  std::size_t components;
+  std::ofstream file;
+
+  std::unique_ptr<Chunk> current;
+  double last_time = 0.0;
+  bool has_last_time = false;
+  std::uint64_t recorded_frames = 0;
+  std::uint64_t dropped_frames = 0;
+
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable chunk_returned;
+  std::deque<std::unique_ptr<Chunk>> full;
+  std::vector<std::unique_ptr<Chunk>> spare;
+  bool stopping = false;
+  bool write_failed = false;
+  std::uint64_t written = 0;
+  std::thread writer;
+
+  std::unique_ptr<Chunk> take_chunk();
+  void hand_over();
+  void write_loop();
+};
+
+// Reads a trajectory chunk by chunk.
+class TrajectoryReader {
+public:
+  // Throws std::runtime_error if path is not a supported trajectory.
+  explicit TrajectoryReader(const std::string &path);
+
+  [[nodiscard]] const TrajectoryFormat::FileHeader &header() const {
+    return file_header;
+  }
+
+  // Decodes the next chunk into frames. Returns false at the end of the
+  // file; throws std::runtime_error if the chunk is damaged.
+  bool next(TrajectoryFrames &frames);
+
+private:
+  std::ifstream file;
+  TrajectoryFormat::FileHeader file_header{};
+  std::uint64_t file_size = 0;
+  std::vector<std::uint8_t> buffer;
+};
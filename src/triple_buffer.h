@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer single-consumer exchange of the latest value.
+// The producer fills write_buffer() and publishes it, the consumer calls
+// update() and reads read_buffer(). Neither side ever waits; the consumer
+// simply skips values that were overwritten before it looked.
+template <typename T> class TripleBuffer {
+public:
+  T &write_buffer() { return slots[back].value; }
+
+  void publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Picks up the most recently published value. Returns false if nothing
+  // was published since the last call.
+  bool update() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+      return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  [[nodiscard]] const T &read_buffer() const { return slots[front].value; }
+
+  // Producer side: true while the last published value is still waiting for
+  // the consumer. Lets the producer skip expensive values nobody reads.
+  [[nodiscard]] bool pending() const {
+    return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+  }
+
+private:
+  static constexpr std::uint8_t INDEX = 3;
+  static constexpr std::uint8_t FRESH = 4;
+
+  struct alignas(64) Slot {
+    T value{};
+  };
+
+  std::array<Slot, 3> slots{};
+  alignas(64) std::atomic<std::uint8_t> middle{1};
+  alignas(64) std::uint8_t back = 0; // producer only
+  alignas(64) std::uint8_t front = 2; // consumer only
+};
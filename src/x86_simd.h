@@ -0,0 +1,34 @@
+#pragma once
+
+// Shared pieces of the hand-vectorized kernels. MAG3D_X86_KERNELS is defined
+// where the SSE2/AVX2 paths can be compiled; which one runs is still decided
+// at runtime by GravityKernel::detect_isa().
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define MAG3D_X86_KERNELS 1
+#include <immintrin.h>
+
+// 1/sqrt(r2) from the single precision estimate, refined with three
+// Newton-Raphson steps to full double precision. Much cheaper than the
+// sqrt/div pair, which dominates the loop otherwise.
+__attribute__((target("avx2,fma"))) inline __m256d
+rsqrt(const __m256d r2, const __m256d half, const __m256d three_halves) {
+  __m256d y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+  const __m256d half_r2 = _mm256_mul_pd(half, r2);
+  for (int k = 0; k < 3; ++k) {
+    const __m256d yy = _mm256_mul_pd(y, y);
+    y = _mm256_mul_pd(y, _mm256_fnmadd_pd(half_r2, yy, three_halves));
+  }
+  return y;
+}
+
+// The same in single precision: one Newton-Raphson step takes the 12 bit
+// estimate to about 23 bits.
+__attribute__((target("avx2,fma"))) inline __m256
+rsqrt(const __m256 r2, const __m256 half, const __m256 three_halves) {
+  const __m256 y = _mm256_rsqrt_ps(r2);
+  const __m256 yy = _mm256_mul_ps(y, y);
+  return _mm256_mul_ps(
+      y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), yy, three_halves));
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// Where tests write their scratch files; they remove them when done.
+inline std::string temporary_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "solar_system_calculator.h"
+
+TEST(BarnesHutTest, ZeroOpeningAngleMatchesDirectSummation) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.add_belt(500, solar_system.gravitational_constant(), 2.0, 3.5, 1e-9);
+    solar_system.force_engine = ForceEngine::BARNES_HUT;
+    solar_system.opening_angle = 0.0;
+
+    const auto report = solar_system.measure_force_error(100);
+    EXPECT_EQ(report.samples, 101);
+    EXPECT_LT(report.max_relative_error, 1e-10);
+}
+
+TEST(BarnesHutTest, ErrorGrowsWithOpeningAngle) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.add_belt(3000, solar_system.gravitational_constant(), 2.0, 3.5, 1e-9);
+    solar_system.force_engine = ForceEngine::BARNES_HUT;
+
+    solar_system.opening_angle = 0.3;
+    const auto tight = solar_system.measure_force_error();
+    solar_system.opening_angle = 1.0;
+    const auto loose = solar_system.measure_force_error();
+
+    EXPECT_LT(tight.rms_relative_error, 1e-3);
+    EXPECT_LT(tight.rms_relative_error, loose.rms_relative_error);
+    EXPECT_LT(loose.rms_relative_error, 0.05);
+}
+
+TEST(BarnesHutTest, OrbitMatchesDirectEngine) {
+    SolarSystemCalculator direct{};
+    direct.init();
+    SolarSystemCalculator tree{};
+    tree.init();
+    tree.force_engine = ForceEngine::BARNES_HUT;
+    tree.opening_angle = 0.5;
+    for (int i = 0; i < 100; i++) {
+        direct.update_bodies_verlet(0.1);
+        tree.update_bodies_verlet(0.1);
+    }
+    EXPECT_NEAR(tree.state.x[3], direct.state.x[3], 1e-9);
+    EXPECT_NEAR(tree.state.y[3], direct.state.y[3], 1e-9);
+}
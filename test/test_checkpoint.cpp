@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "checkpoint.h"
+#include "solar_system_calculator.h"
+#include "temporary_path.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+TEST(CheckpointTest, RoundTripRestoresEverything) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.tracers.add_belt(1000, 2.96e-4, 2.0, 3.0);
+    solar_system.set_integrator(IntegratorKind::BLOCK);
+    solar_system.force_engine = ForceEngine::BARNES_HUT;
+    solar_system.opening_angle = 0.3;
+    solar_system.set_precision(Precision::MIXED);
+    for (int i = 0; i < 10; i++) {
+        solar_system.step(4.0);
+    }
+    const std::vector<std::vector<glm::vec3>> paths{{}, {glm::vec3(1.0f)}, {}, {glm::vec3(2.0f), glm::vec3(3.0f)}, {}};
+    const auto path = temporary_path("mag3d_round_trip.ckpt");
+    Checkpoint::write(path, Checkpoint::capture(solar_system, paths));
+
+    SolarSystemCalculator restored{};
+    const auto restored_paths = Checkpoint::load(path, restored);
+    std::filesystem::remove(path);
+
+    ASSERT_EQ(restored.state.size(), solar_system.state.size());
+    ASSERT_EQ(restored.tracers.size(), 1000);
+    EXPECT_EQ(restored.bodies[3].name, "Earth");
+    EXPECT_EQ(restored.bodies[4].max_path, 10000);
+    EXPECT_TRUE(restored.bodies[0].is_emitter);
+    EXPECT_FLOAT_EQ(restored.bodies[2].color.g, solar_system.bodies[2].color.g);
+    EXPECT_EQ(restored.elapsed_simulation_time, 40.0);
+    EXPECT_EQ(restored.integrator_kind(), IntegratorKind::BLOCK);
+    EXPECT_EQ(restored.precision(), Precision::MIXED);
+    EXPECT_EQ(restored.force_engine, ForceEngine::BARNES_HUT);
+    EXPECT_EQ(restored.opening_angle, 0.3);
+    EXPECT_EQ(restored_paths, paths);
+    for (std::size_t i = 0; i < restored.state.size(); ++i) {
+        EXPECT_EQ(restored.state.position(i), solar_system.state.position(i));
+        EXPECT_EQ(restored.state.velocity(i), solar_system.state.velocity(i));
+        EXPECT_EQ(restored.state.mass[i], solar_system.state.mass[i]);
+    }
+    EXPECT_EQ(restored.tracers.position(999), solar_system.tracers.position(999));
+}
+
+TEST(CheckpointTest, RestartContinuesBitForBit) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    reference.set_integrator(IntegratorKind::BLOCK);
+    for (int i = 0; i < 20; i++) {
+        reference.step(8.0);
+    }
+
+    SolarSystemCalculator first_half{};
+    first_half.init();
+    first_half.set_integrator(IntegratorKind::BLOCK);
+    for (int i = 0; i < 10; i++) {
+        first_half.step(8.0);
+    }
+    const auto path = temporary_path("mag3d_restart.ckpt");
+    Checkpoint::write_async(path, Checkpoint::capture(first_half)).get();
+
+    SolarSystemCalculator second_half{};
+    Checkpoint::load(path, second_half);
+    std::filesystem::remove(path);
+    for (int i = 0; i < 10; i++) {
+        second_half.step(8.0);
+    }
+    for (std::size_t i = 0; i < reference.state.size(); ++i) {
+        EXPECT_EQ(second_half.state.position(i), reference.state.position(i));
+        EXPECT_EQ(second_half.state.velocity(i), reference.state.velocity(i));
+    }
+}
+
+TEST(CheckpointTest, KeepsIntegratorParameters) {
+    const auto path = temporary_path("mag3d_parameters.ckpt");
+    SolarSystemCalculator block{};
+    block.init();
+    block.set_integrator(std::make_unique<BlockTimestep>(0.03, 20));
+    block.step(8192.0);
+    Checkpoint::write(path, Checkpoint::capture(block));
+    SolarSystemCalculator restored{};
+    Checkpoint::load(path, restored);
+    const auto *restored_block = dynamic_cast<const BlockTimestep *>(&restored.current_integrator());
+    ASSERT_NE(restored_block, nullptr);
+    EXPECT_EQ(restored_block->get_accuracy(), 0.03);
+    EXPECT_EQ(restored_block->get_max_level(), 20u);
+    EXPECT_EQ(restored_block->levels(), dynamic_cast<const BlockTimestep &>(block.current_integrator()).levels());
+    restored.step(8192.0);
+
+    SolarSystemCalculator hybrid{};
+    hybrid.init();
+    hybrid.set_integrator(std::make_unique<HybridKepler>(0.3, 1e-5));
+    hybrid.step(0.25);
+    Checkpoint::write(path, Checkpoint::capture(hybrid));
+    Checkpoint::load(path, restored);
+    const auto *restored_hybrid = dynamic_cast<const HybridKepler *>(&restored.current_integrator());
+    ASSERT_NE(restored_hybrid, nullptr);
+    EXPECT_EQ(restored_hybrid->get_threshold(), 0.3);
+    EXPECT_EQ(restored_hybrid->get_perturber_mass(), 1e-5);
+    std::filesystem::remove(path);
+
+    // Levels beyond the maximum are rejected.
+    BlockTimestep damaged;
+    auto bytes = BlockTimestep(0.02, 20).save_state();
+    const unsigned level = 15;
+    bytes.resize(bytes.size() + sizeof(level));
+    std::memcpy(bytes.data() + bytes.size() - sizeof(level), &level, sizeof(level));
+    EXPECT_TRUE(damaged.restore_state(bytes, 1));
+    EXPECT_EQ(damaged.get_max_level(), 20u);
+    const unsigned max_level = 12;
+    std::memcpy(bytes.data() + sizeof(double), &max_level, sizeof(max_level));
+    EXPECT_FALSE(damaged.restore_state(bytes, 1));
+    EXPECT_FALSE(damaged.restore_state(bytes, 2));
+}
+
+TEST(CheckpointTest, RejectsBrokenFiles) {
+    SolarSystemCalculator solar_system{};
+    EXPECT_THROW(Checkpoint::load(temporary_path("mag3d_missing.ckpt"), solar_system), std::runtime_error);
+
+    const auto path = temporary_path("mag3d_broken.ckpt");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not a checkpoint, but long enough to hold a header........................................"
+                "................................................................................................"
+                "................................................................................................";
+    }
+    EXPECT_THROW(Checkpoint::load(path, solar_system), std::runtime_error);
+
+    solar_system.init();
+    Checkpoint::write(path, Checkpoint::capture(solar_system));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    SolarSystemCalculator truncated{};
+    EXPECT_THROW(Checkpoint::load(path, truncated), std::runtime_error);
+    std::filesystem::remove(path);
+}
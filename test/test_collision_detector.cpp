@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "collision_detector.h"
+#include "solar_system_calculator.h"
+
+#include <cmath>
+#include <random>
+
+namespace {
+// Two bodies that passed through each other during a step of one day.
+void add_crossing_pair(BodyStore &state, std::vector<Body> &bodies, const double mass_a, const double mass_b) {
+    state.add({0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 1.0);
+    state.add({1.0, 0.005, 0.0}, {0.0, 0.01, 0.0}, mass_a);
+    state.add({1.0, -0.005, 0.0}, {0.0, -0.01, 0.0}, mass_b);
+    bodies = {{.name = "Sun"}, {.name = "A", .radius = 1e-4}, {.name = "B", .radius = 1e-4}};
+}
+}
+
+TEST(CollisionDetectorTest, MergesBodiesThatTunnelledThrough) {
+    BodyStore state;
+    std::vector<Body> bodies;
+    add_crossing_pair(state, bodies, 3e-6, 1e-6);
+    TracerStore tracers;
+    ThreadPool pool(1);
+    CollisionDetector detector({.response = CollisionResponse::MERGE});
+
+    EXPECT_TRUE(detector.process(state, bodies, tracers, pool, 10.0, 1.0));
+    ASSERT_EQ(state.size(), 2);
+    ASSERT_EQ(bodies.size(), 2);
+    EXPECT_EQ(bodies[1].name, "A");
+    EXPECT_DOUBLE_EQ(state.mass[1], 4e-6);
+    EXPECT_NEAR(state.vy[1], (3e-6 * 0.01 - 1e-6 * 0.01) / 4e-6, 1e-15);
+    EXPECT_NEAR(bodies[1].radius, std::cbrt(2.0) * 1e-4, 1e-15);
+
+    ASSERT_EQ(detector.events().size(), 1);
+    const auto &event = detector.events()[0];
+    EXPECT_EQ(event.type, EncounterType::COLLISION);
+    EXPECT_EQ(event.other, "B");
+    // Contact at a separation of two radii, closing at 0.02 au/day.
+    EXPECT_NEAR(event.time, 9.0 + (0.01 - 2e-4) / 0.02, 1e-12);
+    EXPECT_NEAR(event.distance, 0.0, 1e-15);
+}
+
+TEST(CollisionDetectorTest, BounceConservesMomentumAndEnergy) {
+    BodyStore state;
+    std::vector<Body> bodies;
+    add_crossing_pair(state, bodies, 2e-6, 2e-6);
+    TracerStore tracers;
+    ThreadPool pool(1);
+    CollisionDetector detector({.response = CollisionResponse::BOUNCE});
+
+    EXPECT_FALSE(detector.process(state, bodies, tracers, pool, 1.0, 1.0));
+    ASSERT_EQ(state.size(), 3);
+    // Equal masses head on swap velocities and end up apart again.
+    EXPECT_NEAR(state.vy[1], -0.01, 1e-15);
+    EXPECT_NEAR(state.vy[2], 0.01, 1e-15);
+    EXPECT_LT(state.y[1], 0.0);
+    EXPECT_GT(state.y[2], 0.0);
+    EXPECT_GT(state.y[2] - state.y[1], 2e-4);
+    EXPECT_NEAR(state.vy[1] * state.vy[1] + state.vy[2] * state.vy[2], 2e-4, 1e-18);
+}
+
+TEST(CollisionDetectorTest, LogsEachCloseEncounterOnce) {
+    BodyStore state;
+    state.add({0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 1.0);
+    state.add({1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 3e-6);
+    std::vector<Body> bodies{{.name = "Sun"}, {.name = "Earth"}};
+    TracerStore tracers;
+    tracers.add({1.01, -0.1, 0.0}, {0.0, 0.001, 0.0});
+    ThreadPool pool(1);
+    CollisionDetector detector;
+    const double hill = 3.0 * std::cbrt(1e-6);
+
+    for (int step = 1; step <= 200; step++) {
+        tracers.y[0] += 0.001;
+        detector.process(state, bodies, tracers, pool, step, 1.0);
+    }
+    ASSERT_EQ(detector.events().size(), 1);
+    const auto &event = detector.events()[0];
+    EXPECT_EQ(event.type, EncounterType::CLOSE_ENCOUNTER);
+    EXPECT_EQ(event.body, "Earth");
+    EXPECT_EQ(event.other, "tracer 0");
+    EXPECT_LT(event.distance, hill);
+    EXPECT_NEAR(event.time, 100.0 - std::sqrt(hill * hill - 1e-4) / 0.001, 1.0);
+}
+
+TEST(CollisionDetectorTest, GridFindsWhatBruteForceFinds) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+    BodyStore state;
+    std::vector<Body> bodies;
+    state.add({0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 1.0);
+    bodies.push_back({.name = "Sun", .radius = 0.3});
+    for (int i = 0; i < 300; i++) {
+        state.add({coordinate(generator), coordinate(generator), coordinate(generator)}, {0.0, 0.0, 0.0}, 0.0);
+        bodies.push_back({.name = std::to_string(i), .radius = 0.01});
+    }
+    TracerStore tracers;
+    for (int t = 0; t < 100000; t++)
+        tracers.add({coordinate(generator), coordinate(generator), coordinate(generator)}, {0.0, 0.0, 0.0});
+
+    std::size_t expected = 0;
+    for (std::size_t t = 0; t < tracers.size(); t++) {
+        for (std::size_t i = 0; i < state.size(); i++)
+            expected += glm::length(tracers.position(t) - state.position(i)) <= bodies[i].radius;
+    }
+    for (std::size_t i = 0; i < state.size(); i++) {
+        for (std::size_t j = i + 1; j < state.size(); j++)
+            expected += glm::length(state.position(j) - state.position(i)) <= bodies[i].radius + bodies[j].radius;
+    }
+    ASSERT_GT(expected, 1000);
+
+    ThreadPool pool(4);
+    CollisionDetector detector({.response = CollisionResponse::NONE});
+    detector.process(state, bodies, tracers, pool, 1.0, 1.0);
+    EXPECT_EQ(detector.events().size(), expected);
+    EXPECT_LT(detector.candidate_pairs(), 4 * expected);
+}
+
+TEST(CollisionDetectorTest, CalculatorContinuesAfterMerge) {
+    SolarSystemCalculator solar_system{};
+    solar_system.add_body({.position = {0.0, 0.0, 0.0}, .velocity = {0.0, 0.0, 0.0}, .mass = 1.0}, {.name = "Sun"});
+    solar_system.add_body({.position = {1.0, -0.01, 0.0}, .velocity = {0.0, 0.02, 0.0}, .mass = 1e-6},
+                          {.name = "A", .radius = 1e-4});
+    solar_system.add_body({.position = {1.0, 0.01, 0.0}, .velocity = {0.0, -0.02, 0.0}, .mass = 1e-6},
+                          {.name = "B", .radius = 1e-4});
+    solar_system.set_integrator(IntegratorKind::YOSHIDA4);
+    solar_system.collisions.emplace();
+    const double momentum = 1e-6 * 0.02 - 1e-6 * 0.02;
+
+    for (int i = 0; i < 10; i++)
+        solar_system.step(0.1);
+    ASSERT_EQ(solar_system.state.size(), 2);
+    ASSERT_EQ(solar_system.bodies.size(), 2);
+    EXPECT_EQ(solar_system.integrator_kind(), IntegratorKind::YOSHIDA4);
+    double total = 0.0;
+    for (std::size_t i = 0; i < solar_system.state.size(); i++)
+        total += solar_system.state.mass[i] * solar_system.state.vy[i];
+    EXPECT_NEAR(total, momentum, 1e-10);
+    EXPECT_EQ(solar_system.collisions->events().back().type, EncounterType::COLLISION);
+}
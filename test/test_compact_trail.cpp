@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "compact_trail.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+std::vector<glm::vec3> points_of(const CompactTrail &trail) {
+    std::vector<glm::vec3> points;
+    trail.for_each([&](double, const glm::vec3 &position) { points.push_back(position); });
+    return points;
+}
+
+float distance_to_polyline(const glm::vec3 &point, const std::vector<glm::vec3> &polyline) {
+    float best = glm::length(point - polyline.front());
+    for (std::size_t i = 1; i < polyline.size(); i++) {
+        const glm::vec3 line = polyline[i] - polyline[i - 1];
+        const float length2 = glm::dot(line, line);
+        const float t = length2 > 0.0f ? std::clamp(glm::dot(point - polyline[i - 1], line) / length2, 0.0f, 1.0f)
+                                       : 0.0f;
+        best = std::min(best, glm::length(point - (polyline[i - 1] + t * line)));
+    }
+    return best;
+}
+
+glm::vec3 on_circle(const double time, const float radius, const double period) {
+    const double angle = 2.0 * M_PI * time / period;
+    return {radius * static_cast<float>(std::cos(angle)), radius * static_cast<float>(std::sin(angle)), 0.0f};
+}
+}
+
+TEST(CompactTrailTest, SmoothArcsKeepFewPoints) {
+    CompactTrail trail(500.0, 1e-3f);
+    std::vector<glm::vec3> samples;
+    for (int i = 0; i <= 7300; i++) {
+        samples.push_back(on_circle(0.1 * i, 2.0f, 365.0));
+        trail.add(0.1 * i, samples.back());
+    }
+    // 5000 samples over 1.4 orbits, in chords of about 5 degrees.
+    EXPECT_LT(trail.size(), 150);
+    EXPECT_GT(trail.size(), 50);
+    EXPECT_EQ(trail.newest(), points_of(trail).back());
+
+    // Every sample of the last 500 days lies on the drawn line, give or take
+    // the quantization.
+    const auto points = points_of(trail);
+    for (std::size_t i = samples.size() - 5000; i < samples.size(); i++) {
+        EXPECT_LT(distance_to_polyline(samples[i], points), 1.25e-3f) << i;
+    }
+}
+
+TEST(CompactTrailTest, SharpTurnsKeepTheirCorners) {
+    CompactTrail trail(100.0, 1e-3f);
+    const glm::vec3 corners[] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 1}};
+    double time = 0.0;
+    for (int side = 0; side < 3; side++) {
+        for (int i = 0; i < 20; i++) {
+            const float t = static_cast<float>(i) / 20.0f;
+            trail.add(time, corners[side] + t * (corners[side + 1] - corners[side]));
+            time += 0.1;
+        }
+    }
+    trail.add(time, corners[3]);
+    const auto points = points_of(trail);
+    ASSERT_EQ(points.size(), 4);
+    for (int k = 0; k < 4; k++) {
+        EXPECT_LT(glm::length(points[k] - corners[k]), 1e-3f) << k;
+    }
+}
+
+TEST(CompactTrailTest, ForgetsPointsOlderThanItsDuration) {
+    CompactTrail trail(50.0, 1e-3f);
+    for (int i = 0; i <= 2000; i++) {
+        trail.add(0.1 * i, on_circle(0.1 * i, 1.0f, 20.0));
+    }
+    double oldest = -1.0;
+    trail.for_each([&](const double time, const glm::vec3 &) {
+        if (oldest < 0.0) oldest = time;
+    });
+    EXPECT_NEAR(trail.newest_time(), 200.0, 0.01);
+    EXPECT_GE(oldest, 150.0 - 0.01);
+    EXPECT_LT(oldest, 152.0);
+    // A bit over two orbits.
+    EXPECT_LT(trail.bytes(), 8 * 1024);
+}
+
+TEST(CompactTrailTest, UpdatesDescribeTheChanges) {
+    CompactTrail trail(30.0, 1e-3f, 40);
+    std::vector<glm::vec3> copy;
+    for (int i = 0; i <= 3000; i++) {
+        const double time = 0.1 * i;
+        // Jumps out of the 16-bit range at 100 days and goes back at 200.
+        const double shown = i < 2000 ? time : time - 150.0;
+        glm::vec3 position = on_circle(shown, 1.0f + 0.1f * static_cast<float>(i % 7), 11.0);
+        if (i >= 1000) position.x += 50.0f;
+        const auto update = trail.add(shown, position);
+        switch (update.kind) {
+        case CompactTrail::Update::Kind::APPENDED:
+            copy.push_back(trail.newest());
+            break;
+        case CompactTrail::Update::Kind::REPLACED:
+            copy.back() = trail.newest();
+            break;
+        case CompactTrail::Update::Kind::RESTARTED:
+            EXPECT_TRUE(i == 0 || i == 1000 || i == 2000) << i;
+            copy.assign(1, trail.newest());
+            break;
+        }
+        copy.erase(copy.begin(), copy.begin() + static_cast<std::ptrdiff_t>(update.expired));
+        ASSERT_EQ(copy, points_of(trail)) << i;
+        ASSERT_LE(trail.size(), 40);
+    }
+}
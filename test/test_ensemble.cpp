@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "ensemble.h"
+#include "solar_system_calculator.h"
+
+namespace {
+std::vector<EnsembleSummary> run_sweep(const KernelIsa isa, const std::size_t count) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    const auto members = Ensemble::mass_sweep(solar_system.state, 0, 0.5, 2.0, count);
+    return Ensemble::run(solar_system.state, solar_system.gravitational_constant(), members,
+                         {.dt = 0.25, .duration = 365.0, .max_threads = 2}, isa);
+}
+}
+
+TEST(EnsembleTest, MemberMatchesCalculator) {
+    const auto summaries = run_sweep(KernelIsa::SCALAR, 6);
+    ASSERT_EQ(summaries.size(), 6);
+
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.set_kernel_isa(KernelIsa::SCALAR);
+    solar_system.state.mass[0] = 2.0;
+    for (int i = 0; i < 1460; i++) {
+        solar_system.step(0.25);
+    }
+    for (std::size_t i = 0; i < solar_system.state.size(); ++i) {
+        EXPECT_DOUBLE_EQ(summaries[5].positions[i].x, solar_system.state.x[i]);
+        EXPECT_DOUBLE_EQ(summaries[5].positions[i].y, solar_system.state.y[i]);
+        EXPECT_DOUBLE_EQ(summaries[5].velocities[i].x, solar_system.state.vx[i]);
+    }
+}
+
+TEST(EnsembleTest, SimdBatchMatchesScalar) {
+    if (GravityKernel::detect_isa() != KernelIsa::AVX2) GTEST_SKIP();
+    const auto reference = run_sweep(KernelIsa::SCALAR, 9);
+    const auto summaries = run_sweep(KernelIsa::AVX2, 9);
+    for (std::size_t m = 0; m < summaries.size(); ++m) {
+        for (std::size_t i = 0; i < summaries[m].positions.size(); ++i) {
+            EXPECT_NEAR(summaries[m].positions[i].x, reference[m].positions[i].x, 1e-9);
+            EXPECT_NEAR(summaries[m].positions[i].y, reference[m].positions[i].y, 1e-9);
+        }
+        EXPECT_LT(summaries[m].relative_energy_error, 1e-2);
+    }
+}
+
+TEST(EnsembleTest, MassSweepIsLogarithmic) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    const auto members = Ensemble::mass_sweep(solar_system.state, 3, 1e-6, 1e-4, 3);
+    ASSERT_EQ(members.size(), 3);
+    EXPECT_DOUBLE_EQ(members[0].masses[3], 1e-6);
+    EXPECT_NEAR(members[1].masses[3], 1e-5, 1e-18);
+    EXPECT_DOUBLE_EQ(members[2].masses[3], 1e-4);
+    EXPECT_DOUBLE_EQ(members[1].masses[0], 1.0);
+}
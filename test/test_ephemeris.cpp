@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "ephemeris.h"
+#include "solar_system_calculator.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+// A body on a circle of radius 1 au with a period of 100 days.
+glm::dvec3 circle(const double time) {
+    const double angle = 2.0 * M_PI * time / 100.0;
+    return {std::cos(angle), std::sin(angle), 0.0};
+}
+
+void circle_source(const double time, std::vector<glm::dvec3> &positions) {
+    positions.assign(1, circle(time));
+}
+}
+
+TEST(EphemerisTest, FitsRecordedStates) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    Ephemeris ephemeris(solar_system.state.size());
+    std::vector<double> times;
+    std::vector<BodyStore> states;
+    for (int i = 0; i <= 4 * 200; i++) {
+        ephemeris.record(solar_system.elapsed_simulation_time, solar_system.state);
+        if (i % 7 == 3) {
+            times.push_back(solar_system.elapsed_simulation_time);
+            states.push_back(solar_system.state);
+        }
+        solar_system.step(0.25);
+    }
+    // Twelve whole intervals of 16 days.
+    EXPECT_EQ(ephemeris.interval_count(), 12);
+    EXPECT_EQ(ephemeris.bytes_used(), 12 * 3 * 13 * solar_system.state.size() * sizeof(double));
+
+    glm::dvec3 position, velocity;
+    for (std::size_t s = 0; s < times.size(); s++) {
+        const bool fitted = times[s] <= 192.0;
+        for (std::size_t i = 0; i < solar_system.state.size(); i++) {
+            ASSERT_EQ(ephemeris.state(i, times[s], position, velocity), fitted) << times[s];
+            if (!fitted) continue;
+            EXPECT_LT(glm::length(position - states[s].position(i)), 1e-10) << times[s] << " " << i;
+            // Verlet's velocities only agree with its positions to O(dt^2).
+            EXPECT_LT(glm::length(velocity - states[s].velocity(i)), 1e-4 * glm::length(states[s].velocity(i)) + 1e-10)
+                << times[s] << " " << i;
+        }
+    }
+    std::vector<glm::dvec3> positions;
+    ASSERT_TRUE(ephemeris.positions(times[5], positions));
+    EXPECT_TRUE(ephemeris.position(2, times[5], position));
+    EXPECT_EQ(positions[2], position);
+    EXPECT_FALSE(ephemeris.position(solar_system.state.size(), times[5], position));
+}
+
+TEST(EphemerisTest, FitsMissesFromTheSource) {
+    Ephemeris ephemeris(1, {.interval = 10.0});
+    ephemeris.set_source(circle_source, 5.0, 95.0);
+    glm::dvec3 position;
+    EXPECT_FALSE(ephemeris.position(0, 4.0, position));
+    EXPECT_FALSE(ephemeris.position(0, 96.0, position));
+    EXPECT_EQ(ephemeris.interval_count(), 0);
+
+    // Each interval is fitted once; the first and last are cut to the range.
+    for (int pass = 0; pass < 2; pass++) {
+        for (double time = 5.0; time <= 95.0; time += 0.7) {
+            ASSERT_TRUE(ephemeris.position(0, time, position));
+            EXPECT_LT(glm::length(position - circle(time)), 1e-11) << time;
+        }
+    }
+    EXPECT_EQ(ephemeris.intervals_fitted(), 10);
+
+    glm::dvec3 velocity;
+    ASSERT_TRUE(ephemeris.state(0, 40.0, position, velocity));
+    EXPECT_NEAR(glm::length(velocity), 2.0 * M_PI / 100.0, 1e-10);
+}
+
+TEST(EphemerisTest, EvictsLeastRecentlyUsed) {
+    const std::size_t interval_bytes = 3 * 13 * sizeof(double);
+    Ephemeris ephemeris(1, {.interval = 10.0, .max_bytes = 3 * interval_bytes});
+    ephemeris.set_source(circle_source, 0.0, 100.0);
+    glm::dvec3 position;
+    for (const double time : {5.0, 15.0, 25.0, 5.0, 35.0}) {
+        ASSERT_TRUE(ephemeris.position(0, time, position));
+    }
+    EXPECT_EQ(ephemeris.interval_count(), 3);
+    EXPECT_EQ(ephemeris.bytes_used(), 3 * interval_bytes);
+    EXPECT_EQ(ephemeris.intervals_evicted(), 1);
+
+    // [10, 20] went, [0, 10] stayed.
+    ASSERT_TRUE(ephemeris.position(0, 6.0, position));
+    EXPECT_EQ(ephemeris.intervals_fitted(), 4);
+    ASSERT_TRUE(ephemeris.position(0, 16.0, position));
+    EXPECT_EQ(ephemeris.intervals_fitted(), 5);
+}
+
+TEST(EphemerisTest, StartsOverWhenTimeGoesBack) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    const BodyStore start = solar_system.state;
+    Ephemeris ephemeris(solar_system.state.size(), {.interval = 4.0});
+    for (int i = 0; i < 10; i++) {
+        ephemeris.record(solar_system.elapsed_simulation_time, solar_system.state);
+        solar_system.step(0.25);
+    }
+    // Back to 0; the half-filled interval [0, 4] must not mix both runs.
+    solar_system.state = start;
+    solar_system.state.x[1] += 0.5;
+    for (int i = 0; i <= 16; i++) {
+        ephemeris.record(0.25 * i, solar_system.state);
+        solar_system.step(0.25);
+    }
+    glm::dvec3 position;
+    ASSERT_TRUE(ephemeris.position(1, 0.0, position));
+    EXPECT_NEAR(position.x, start.x[1] + 0.5, 1e-9);
+
+    BodyStore fewer = start;
+    fewer.erase(0);
+    EXPECT_THROW(ephemeris.record(5.0, fewer), std::runtime_error);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "gravity_kernel.h"
+
+#include <cmath>
+
+namespace {
+BodyStore make_cluster(const std::size_t count) {
+    BodyStore store;
+    for (std::size_t i = 0; i < count; ++i) {
+        const double angle = 0.37 * static_cast<double>(i);
+        const double radius = 0.5 + 0.01 * static_cast<double>(i);
+        store.add({radius * std::cos(angle), radius * std::sin(angle), 0.001 * static_cast<double>(i % 7)},
+                  glm::dvec3(0.0), 1e-6 * static_cast<double>(i + 1));
+    }
+    return store;
+}
+}
+
+TEST(GravityKernelTest, SimdKernelsMatchScalar) {
+    const auto host_isa = GravityKernel::detect_isa();
+    BodyStore reference = make_cluster(37);
+    const auto reference_targets = GravityKernel::targets_of(reference);
+    GravityKernel::get(KernelIsa::SCALAR)(GravityKernel::sources_of(reference), reference_targets, 0,
+                                          reference_targets.count, 2.96e-4, 0.0);
+
+    for (const auto isa: {KernelIsa::SSE2, KernelIsa::AVX2}) {
+        if (isa == KernelIsa::AVX2 && host_isa != KernelIsa::AVX2) continue;
+        if (host_isa == KernelIsa::SCALAR) continue;
+        BodyStore store = make_cluster(37);
+        const auto targets = GravityKernel::targets_of(store);
+        GravityKernel::get(isa)(GravityKernel::sources_of(store), targets, 0, targets.count, 2.96e-4, 0.0);
+        for (std::size_t i = 0; i < store.size(); ++i) {
+            EXPECT_NEAR(store.ax[i], reference.ax[i], 1e-12 * std::abs(reference.ax[i]) + 1e-18);
+            EXPECT_NEAR(store.ay[i], reference.ay[i], 1e-12 * std::abs(reference.ay[i]) + 1e-18);
+            EXPECT_NEAR(store.az[i], reference.az[i], 1e-12 * std::abs(reference.az[i]) + 1e-18);
+        }
+    }
+}
+
+TEST(GravityKernelTest, ReducedPrecisionStaysClose) {
+    // Far from the origin, where float coordinates would be coarse.
+    BodyStore reference = make_cluster(37);
+    for (std::size_t i = 0; i < reference.size(); ++i) reference.x[i] += 30.0;
+    const auto reference_targets = GravityKernel::targets_of(reference);
+    GravityKernel::get(KernelIsa::SCALAR)(GravityKernel::sources_of(reference), reference_targets, 0,
+                                          reference_targets.count, 2.96e-4, 0.0);
+
+    const auto host_isa = GravityKernel::detect_isa();
+    for (const auto precision: {Precision::MIXED, Precision::FLOAT}) {
+        for (const auto isa: {KernelIsa::SCALAR, KernelIsa::SSE2, KernelIsa::AVX2}) {
+            if (isa == KernelIsa::AVX2 && host_isa != KernelIsa::AVX2) continue;
+            BodyStore store = reference;
+            const auto targets = GravityKernel::targets_of(store);
+            // Two chunks with different origins.
+            const auto kernel = GravityKernel::get(isa, precision);
+            kernel(GravityKernel::sources_of(store), targets, 0, 20, 2.96e-4, 0.0);
+            kernel(GravityKernel::sources_of(store), targets, 20, targets.count, 2.96e-4, 0.0);
+            for (std::size_t i = 0; i < store.size(); ++i) {
+                const double error = glm::length(store.acceleration(i) - reference.acceleration(i));
+                EXPECT_LT(error, 1e-5 * glm::length(reference.acceleration(i)))
+                    << GravityKernel::precision_name(precision) << " " << GravityKernel::isa_name(isa) << " " << i;
+            }
+        }
+    }
+}
+
+TEST(GravityKernelTest, SelfInteractionIsSkipped) {
+    for (const auto precision: {Precision::DOUBLE, Precision::MIXED, Precision::FLOAT}) {
+        BodyStore store;
+        store.add(glm::dvec3(0.0), glm::dvec3(0.0), 1.0);
+        const auto targets = GravityKernel::targets_of(store);
+        GravityKernel::get(GravityKernel::detect_isa(), precision)(GravityKernel::sources_of(store), targets, 0,
+                                                                   targets.count, 2.96e-4, 0.0);
+        EXPECT_EQ(store.ax[0], 0.0);
+        EXPECT_EQ(store.ay[0], 0.0);
+        EXPECT_EQ(store.az[0], 0.0);
+    }
+}
+
+TEST(GravityKernelTest, ParsesPrecisionNames) {
+    for (const auto precision: {Precision::DOUBLE, Precision::MIXED, Precision::FLOAT}) {
+        EXPECT_EQ(GravityKernel::parse_precision(GravityKernel::precision_name(precision)), precision);
+    }
+    EXPECT_FALSE(GravityKernel::parse_precision("half"));
+}
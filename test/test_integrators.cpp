@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include "integrator.h"
+#include "kepler.h"
+#include "solar_system_calculator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+double max_energy_error(const IntegratorKind kind, const double dt, const double days) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.set_integrator(kind);
+    const double initial_energy = solar_system.total_energy();
+    double max_error = 0.0;
+    for (int i = 0; i < static_cast<int>(days / dt); i++) {
+        solar_system.step(dt);
+        max_error = std::max(max_error, std::abs(solar_system.total_energy() / initial_energy - 1.0));
+    }
+    return max_error;
+}
+}
+
+TEST(KeplerTest, FullPeriodReturnsToStart) {
+    const double mu = 2.96e-4;
+    const glm::dvec3 r0(1.0, 0.0, 0.0);
+    const glm::dvec3 v0(0.0, 0.02, 0.003);
+    const double a = 1.0 / (2.0 / glm::length(r0) - glm::dot(v0, v0) / mu);
+    const double period = 2.0 * M_PI * std::sqrt(a * a * a / mu);
+
+    glm::dvec3 r = r0;
+    glm::dvec3 v = v0;
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(Kepler::drift(mu, r, v, 0.1 * period));
+    }
+    EXPECT_NEAR(r.x, r0.x, 1e-10);
+    EXPECT_NEAR(r.y, r0.y, 1e-10);
+    EXPECT_NEAR(r.z, r0.z, 1e-10);
+    EXPECT_NEAR(v.y, v0.y, 1e-12);
+}
+
+TEST(KeplerTest, MasslessCentralBodyDriftsInAStraightLine) {
+    glm::dvec3 r(1.0, 0.0, 0.0);
+    glm::dvec3 v(0.0, 0.02, 0.0);
+    ASSERT_TRUE(Kepler::drift(0.0, r, v, 10.0));
+    EXPECT_EQ(r, glm::dvec3(1.0, 0.2, 0.0));
+    EXPECT_EQ(v, glm::dvec3(0.0, 0.02, 0.0));
+}
+
+TEST(KeplerTest, HyperbolicOrbitConservesEnergy) {
+    const double mu = 2.96e-4;
+    glm::dvec3 r(1.0, 0.0, 0.0);
+    glm::dvec3 v(0.0, 0.05, 0.0);
+    const double energy = 0.5 * glm::dot(v, v) - mu / glm::length(r);
+    ASSERT_TRUE(Kepler::drift(mu, r, v, 400.0));
+    EXPECT_NEAR(0.5 * glm::dot(v, v) - mu / glm::length(r), energy, 1e-14);
+    EXPECT_GT(glm::length(r), 10.0);
+}
+
+TEST(IntegratorTest, VerletReusesClosingAccelerations) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    const std::size_t n = solar_system.state.size();
+    solar_system.step(0.25);
+    EXPECT_EQ(solar_system.force_evaluations(), 2 * n);
+    solar_system.step(0.25);
+    EXPECT_EQ(solar_system.force_evaluations(), 3 * n);
+
+    // A changed mass must not kick with the old accelerations: the next step
+    // matches one from scratch.
+    solar_system.state.mass[0] *= 1.5;
+    solar_system.invalidate_accelerations();
+    SolarSystemCalculator restarted{};
+    for (std::size_t i = 0; i < n; i++) {
+        restarted.add_body({.position = solar_system.state.position(i),
+                            .velocity = solar_system.state.velocity(i),
+                            .mass = solar_system.state.mass[i]},
+                           solar_system.bodies[i]);
+    }
+    solar_system.step(0.25);
+    restarted.step(0.25);
+    EXPECT_EQ(solar_system.force_evaluations(), 5 * n);
+    for (std::size_t i = 0; i < n; i++) {
+        EXPECT_EQ(solar_system.state.position(i), restarted.state.position(i));
+        EXPECT_EQ(solar_system.state.velocity(i), restarted.state.velocity(i));
+    }
+
+    solar_system.add_body({.position = {3.0, 0.0, 0.0}, .velocity = {0.0, 0.01, 0.0}, .mass = 1e-10},
+                          {.name = "Asteroid"});
+    solar_system.step(0.25);
+    EXPECT_EQ(solar_system.force_evaluations(), 5 * n + 2 * (n + 1));
+}
+
+TEST(IntegratorTest, YoshidaIsMoreAccurateThanVerlet) {
+    EXPECT_LT(max_energy_error(IntegratorKind::YOSHIDA4, 1.0, 365.0),
+              max_energy_error(IntegratorKind::VERLET, 0.25, 365.0));
+}
+
+TEST(IntegratorTest, WisdomHolmanAllowsMuchLargerSteps) {
+    EXPECT_LT(max_energy_error(IntegratorKind::WISDOM_HOLMAN, 8.0, 3650.0),
+              max_energy_error(IntegratorKind::VERLET, 0.25, 3650.0));
+}
+
+TEST(IntegratorTest, WisdomHolmanFollowsVerletOrbit) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    for (int i = 0; i < 3650; i++) {
+        reference.update_bodies_verlet(0.1);
+    }
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.set_integrator(IntegratorKind::WISDOM_HOLMAN);
+    for (int i = 0; i < 91; i++) {
+        solar_system.step(4.0);
+    }
+    solar_system.step(1.0);
+    EXPECT_NEAR(solar_system.state.x[3], reference.state.x[3], 1e-3);
+    EXPECT_NEAR(solar_system.state.y[3], reference.state.y[3], 1e-3);
+}
+
+TEST(KeplerTest, BatchMatchesSingleDrift) {
+    const double mu = 2.96e-4;
+    TracerStore states;
+    states.add_belt(37, mu, 0.5, 3.0);
+    // An eccentric, a hyperbolic and a resting state take the scalar path.
+    states.vx[5] *= 1.3;
+    states.vy[9] *= 2.0;
+    states.vx[12] = states.vy[12] = states.vz[12] = 0.0;
+    const TracerStore start = states;
+    for (const double dt : {0.25, 8.0, 400.0}) {
+        states = start;
+        Kepler::drift(mu, GravityKernel::tracers_of(states), 0, states.size(), dt);
+        for (std::size_t i = 0; i < states.size(); i++) {
+            glm::dvec3 r = start.position(i);
+            glm::dvec3 v = start.velocity(i);
+            ASSERT_TRUE(Kepler::drift(mu, r, v, dt));
+            EXPECT_LT(glm::length(states.position(i) - r), 1e-12 * glm::length(r)) << dt << " " << i;
+            EXPECT_LT(glm::length(states.velocity(i) - v), 1e-12 * glm::length(v) + 1e-15) << dt << " " << i;
+        }
+    }
+}
+
+TEST(IntegratorTest, HybridWithoutSmallBodiesIsVerlet) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.set_integrator(IntegratorKind::HYBRID);
+    for (int i = 0; i < 100; i++) {
+        reference.step(0.25);
+        solar_system.step(0.25);
+    }
+    for (std::size_t i = 0; i < solar_system.state.size(); i++) {
+        EXPECT_EQ(solar_system.state.position(i), reference.state.position(i));
+        EXPECT_EQ(solar_system.state.velocity(i), reference.state.velocity(i));
+    }
+}
+
+TEST(IntegratorTest, HybridFollowsVerletForAsteroids) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    reference.add_belt(200, reference.gravitational_constant(), 2.0, 3.5, 1e-10);
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.add_belt(200, solar_system.gravitational_constant(), 2.0, 3.5, 1e-10);
+    // A stray asteroid right next to Earth must stay numerical.
+    const std::size_t stray = solar_system.state.size();
+    for (auto *calculator : {&reference, &solar_system}) {
+        calculator->add_body({.position = calculator->state.position(3) + glm::dvec3(0.01, 0.0, 0.0),
+                              .velocity = calculator->state.velocity(3),
+                              .mass = 1e-10},
+                             {.name = "Stray"});
+    }
+    auto hybrid = std::make_unique<HybridKepler>();
+    const HybridKepler &integrator = *hybrid;
+    solar_system.set_integrator(std::move(hybrid));
+
+    for (int i = 0; i < 4 * 365; i++) {
+        reference.step(0.25);
+        solar_system.step(0.25);
+    }
+    const auto &analytic = integrator.analytic();
+    ASSERT_EQ(analytic.size(), solar_system.state.size());
+    EXPECT_FALSE(analytic[0]);
+    EXPECT_FALSE(analytic[3]);
+    EXPECT_FALSE(analytic[stray]);
+    const auto analytic_count = std::count(analytic.begin(), analytic.end(), 1);
+    EXPECT_GT(analytic_count, 180);
+
+    double max_error = 0.0;
+    for (std::size_t i = 0; i < solar_system.state.size(); i++) {
+        max_error = std::max(max_error, glm::length(solar_system.state.position(i) - reference.state.position(i)));
+    }
+    EXPECT_LT(max_error, 1e-3);
+
+    // The flags survive a checkpoint, for the same bodies only.
+    HybridKepler restored;
+    EXPECT_FALSE(restored.restore_state(integrator.save_state(), analytic.size() + 1));
+    ASSERT_TRUE(restored.restore_state(integrator.save_state(), analytic.size()));
+    EXPECT_EQ(restored.analytic(), analytic);
+}
+
+TEST(IntegratorTest, AddingBodiesKeepsIntegratorParameters) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.set_integrator(std::make_unique<HybridKepler>(0.3, 1e-5));
+    solar_system.step(0.25);
+    solar_system.add_body({.position = {3.0, 0.0, 0.0}, .velocity = {0.0, 0.01, 0.0}, .mass = 1e-10},
+                          {.name = "Asteroid"});
+    const auto *hybrid = dynamic_cast<const HybridKepler *>(&solar_system.current_integrator());
+    ASSERT_NE(hybrid, nullptr);
+    EXPECT_EQ(hybrid->get_threshold(), 0.3);
+    EXPECT_EQ(hybrid->get_perturber_mass(), 1e-5);
+    // Per-body state starts over for the new body set.
+    EXPECT_TRUE(hybrid->analytic().empty());
+    solar_system.step(0.25);
+    EXPECT_EQ(hybrid->analytic().size(), solar_system.state.size());
+
+    solar_system.set_integrator(std::make_unique<BlockTimestep>(0.05, 7));
+    solar_system.add_body({.position = {4.0, 0.0, 0.0}, .velocity = {0.0, 0.01, 0.0}, .mass = 1e-10},
+                          {.name = "Asteroid"});
+    const auto *block = dynamic_cast<const BlockTimestep *>(&solar_system.current_integrator());
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(block->get_accuracy(), 0.05);
+    EXPECT_EQ(block->get_max_level(), 7u);
+}
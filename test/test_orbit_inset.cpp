@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "orbit_inset.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+glm::vec3 on_circle(const double time, const float radius) {
+    const double angle = 2.0 * M_PI * time / 365.0;
+    return {radius * static_cast<float>(std::cos(angle)), radius * static_cast<float>(std::sin(angle)), 0.0f};
+}
+
+// The Sun and two planets, sampled every 0.1 days up to time.
+void add_samples(std::vector<CompactTrail> &paths, const double from, const double to) {
+    for (double time = from; time <= to + 1e-9; time += 0.1) {
+        paths[0].add(time, glm::vec3(0.0f));
+        paths[1].add(time, on_circle(time, 1.0f));
+        paths[2].add(time, on_circle(time, 2.0f));
+    }
+}
+
+float alpha_of(const InsetVertex &vertex) {
+    return static_cast<float>(vertex.color >> 24) / 255.0f;
+}
+}
+
+TEST(OrbitInsetTest, RedrawsOnlyWhenTheViewChanges) {
+    std::vector<CompactTrail> paths(3, CompactTrail(500.0, 1e-3f));
+    const std::vector<Body> bodies(3);
+    add_samples(paths, 0.0, 400.0);
+    OrbitInset inset;
+
+    inset.update(paths, bodies, 0.02f, 200, 200);
+    ASSERT_TRUE(inset.redrawn());
+    // The background, opaque, then the Sun's dot and two trails.
+    const auto &vertices = inset.vertices();
+    ASSERT_GT(vertices.size(), 12);
+    EXPECT_EQ(alpha_of(vertices[0]), 1.0f);
+    EXPECT_EQ(vertices[2].position, glm::vec2(200.0f, 200.0f));
+
+    inset.update(paths, bodies, 0.02f, 200, 200);
+    EXPECT_FALSE(inset.redrawn());
+    EXPECT_TRUE(inset.vertices().empty());
+
+    inset.update(paths, bodies, 0.01f, 200, 200);
+    EXPECT_TRUE(inset.redrawn());
+    inset.update(paths, bodies, 0.01f, 300, 200);
+    EXPECT_TRUE(inset.redrawn());
+    inset.invalidate();
+    inset.update(paths, bodies, 0.01f, 300, 200);
+    EXPECT_TRUE(inset.redrawn());
+}
+
+TEST(OrbitInsetTest, AddsOnlyTheNewEndOfEachTrail) {
+    std::vector<CompactTrail> paths(3, CompactTrail(500.0, 1e-3f));
+    const std::vector<Body> bodies(3);
+    add_samples(paths, 0.0, 400.0);
+    OrbitInset inset;
+    inset.update(paths, bodies, 0.02f, 200, 200);
+
+    for (int frame = 1; frame <= 100; frame++) {
+        const double time = 400.0 + 0.1 * frame;
+        const glm::vec2 before(100.0f + paths[2].newest().x / 0.02f, 100.0f + paths[2].newest().y / 0.02f);
+        add_samples(paths, time, time);
+        inset.update(paths, bodies, 0.02f, 200, 200);
+        ASSERT_FALSE(inset.redrawn());
+        // One quad per moving trail, and sometimes the fade and the Sun's dot.
+        const auto &vertices = inset.vertices();
+        ASSERT_GE(vertices.size(), 12);
+        ASSERT_LE(vertices.size(), 24);
+        // The outer trail's new end starts where its line ended, a line
+        // width across.
+        const InsetVertex *segment = &vertices[vertices.size() - 6];
+        const glm::vec2 start = 0.5f * (segment[0].position + segment[5].position);
+        EXPECT_LT(glm::length(start - before), 1e-3f) << frame;
+        EXPECT_NEAR(glm::length(segment[5].position - segment[0].position), OrbitInset::LINE_WIDTH, 1e-3f);
+    }
+}
+
+TEST(OrbitInsetTest, FadesAtTheRateOfTheLongestTrail) {
+    std::vector<CompactTrail> paths(3, CompactTrail(500.0, 1e-3f));
+    const std::vector<Body> bodies(3);
+    add_samples(paths, 0.0, 10.0);
+    OrbitInset inset;
+    inset.update(paths, bodies, 0.02f, 200, 200);
+
+    // What is left of a line drawn at 10 days after each fade.
+    double left = 1.0;
+    for (double time = 10.1; time <= 260.0; time += 0.1) {
+        add_samples(paths, time, time);
+        inset.update(paths, bodies, 0.02f, 200, 200);
+        const auto &vertices = inset.vertices();
+        if (alpha_of(vertices[0]) < 1.0f) left *= 1.0 - (vertices[0].color >> 24) / 255.0;
+    }
+    // Half the duration: 1/255 after all of it.
+    EXPECT_NEAR(left, 1.0 / std::sqrt(255.0), 4.0 / 255.0);
+}
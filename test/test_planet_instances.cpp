@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "planet_instances.h"
+
+#include <vector>
+
+TEST(PlanetInstancesTest, PacksOneInstancePerBody) {
+    std::vector<Body> bodies(3);
+    bodies[0].is_emitter = true;
+    bodies[1].color = glm::vec3(1.0f, 0.0f, 0.5f);
+    const std::vector<glm::vec3> positions{{0.1f, 0.0f, 0.0f}, {2.0f, 0.0f, 0.0f}, {0.0f, 3.0f, 0.0f}};
+    const std::vector<double> masses{1.0, 3e-6, 1e-9};
+    PlanetInstances instances;
+
+    instances.update(positions, masses, bodies, 2);
+    const auto &packed = instances.instances();
+    ASSERT_EQ(packed.size(), 3);
+    EXPECT_EQ(packed[0].flags, PlanetInstance::EMISSIVE);
+    EXPECT_EQ(packed[1].flags, 0u);
+    EXPECT_EQ(packed[2].flags, PlanetInstance::SELECTED);
+    EXPECT_EQ(packed[1].position, positions[1]);
+    EXPECT_EQ(packed[1].color, 0xFF8000FFu);
+    // Capped for the Sun, growing with the mass below.
+    EXPECT_FLOAT_EQ(packed[0].scale, 0.2f);
+    EXPECT_FLOAT_EQ(packed[1].scale, 0.15f);
+    EXPECT_FLOAT_EQ(packed[2].scale, 5e-5f);
+    EXPECT_EQ(instances.light_position(), positions[0]);
+}
+
+TEST(PlanetInstancesTest, KeepsTheLightWhereTheEmitterWasLastSeen) {
+    std::vector<Body> bodies(2);
+    bodies[0].is_emitter = true;
+    PlanetInstances instances;
+    instances.update({{1.0f, 2.0f, 3.0f}, {4.0f, 0.0f, 0.0f}}, {1.0, 1e-6}, bodies, std::nullopt);
+
+    // The emitter merged away.
+    instances.update({{4.0f, 0.0f, 0.0f}}, {1.0}, {bodies[1]}, std::nullopt);
+    ASSERT_EQ(instances.instances().size(), 1);
+    EXPECT_EQ(instances.instances()[0].flags, 0u);
+    EXPECT_EQ(instances.light_position(), glm::vec3(1.0f, 2.0f, 3.0f));
+}
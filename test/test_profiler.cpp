@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "profiler.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+constexpr std::int64_t MS = 1'000'000;
+
+// The profiler is global; every test starts from an empty, enabled one.
+class ProfilerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Profiler::reset();
+        Profiler::set_enabled(true);
+        Profiler::end_frame();
+    }
+    void TearDown() override {
+        Profiler::set_enabled(false);
+        Profiler::reset();
+    }
+};
+}
+
+TEST_F(ProfilerTest, SumsZonesPerFrame) {
+    for (int frame = 0; frame < 10; frame++) {
+        Profiler::record("physics", 0, MS);
+        Profiler::record("physics", 5 * MS, 6 * MS);
+        Profiler::record_gpu("physics", 0, 3 * MS);
+        Profiler::end_frame();
+    }
+    EXPECT_EQ(Profiler::frame_times().size(), 10);
+    const auto stats = Profiler::zone_stats();
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_EQ(stats[0].name, "physics");
+    EXPECT_FALSE(stats[0].gpu);
+    EXPECT_DOUBLE_EQ(stats[0].mean, 2.0);
+    EXPECT_TRUE(stats[1].gpu);
+    EXPECT_DOUBLE_EQ(stats[1].last, 3.0);
+}
+
+TEST_F(ProfilerTest, PercentilesCoverTheLastFrames) {
+    for (int frame = 1; frame <= 100; frame++) {
+        Profiler::record("draw", 0, frame * MS);
+        Profiler::end_frame();
+    }
+    auto stats = Profiler::zone_stats();
+    ASSERT_EQ(stats.size(), 1);
+    EXPECT_DOUBLE_EQ(stats[0].p50, 51.0);
+    EXPECT_DOUBLE_EQ(stats[0].p95, 95.0);
+    EXPECT_DOUBLE_EQ(stats[0].p99, 99.0);
+    EXPECT_DOUBLE_EQ(stats[0].max, 100.0);
+
+    for (int frame = 101; frame <= 300; frame++) {
+        Profiler::record("draw", 0, frame * MS);
+        Profiler::end_frame();
+    }
+    stats = Profiler::zone_stats();
+    // Only the last HISTORY frames, 61 to 300, count.
+    EXPECT_DOUBLE_EQ(stats[0].mean, (61.0 + 300.0) / 2.0);
+    EXPECT_EQ(Profiler::frame_times().size(), Profiler::HISTORY);
+}
+
+TEST_F(ProfilerTest, DisabledZonesRecordNothing) {
+    Profiler::set_enabled(false);
+    {
+        const ProfileZone zone("ignored");
+    }
+    Profiler::set_enabled(true);
+    Profiler::end_frame();
+    Profiler::end_frame();
+    EXPECT_TRUE(Profiler::zone_stats().empty());
+
+    {
+        MAG3D_PROFILE_ZONE("scoped");
+    }
+    Profiler::end_frame();
+    ASSERT_EQ(Profiler::zone_stats().size(), 1);
+    EXPECT_EQ(Profiler::zone_stats()[0].name, "scoped");
+}
+
+TEST_F(ProfilerTest, WritesChromeTrace) {
+    Profiler::set_thread_name("test \"main\"");
+    Profiler::record("step", 10 * MS, 12 * MS);
+    Profiler::record_gpu("planets", 11 * MS, 11 * MS + 500);
+
+    const auto path = (std::filesystem::temp_directory_path() / "mag3d_test_trace.json").string();
+    Profiler::write_chrome_trace(path);
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string trace = buffer.str();
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"GPU\"}"), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"test \\\"main\\\"\"}"), std::string::npos);
+    // Microseconds from the first event.
+    EXPECT_NE(trace.find("{\"name\":\"step\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":"), std::string::npos);
+    EXPECT_NE(trace.find("\"ts\":0.000,\"dur\":2000.000}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"planets\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"
+                         "\"ts\":1000.000,\"dur\":0.500}"),
+              std::string::npos);
+    EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+TEST_F(ProfilerTest, KeepsTheNewestEvents) {
+    for (std::size_t i = 0; i < Profiler::MAX_EVENTS + 10; i++) {
+        Profiler::record(i < 10 ? "old" : "new", static_cast<std::int64_t>(i), static_cast<std::int64_t>(i) + 1);
+    }
+    const auto path = (std::filesystem::temp_directory_path() / "mag3d_test_ring.json").string();
+    Profiler::write_chrome_trace(path);
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::filesystem::remove(path);
+    EXPECT_EQ(buffer.str().find("\"old\""), std::string::npos);
+}
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "render_state.h"
+
+TEST(RenderStateTest, SkipsWhatIsAlreadyBound) {
+    RenderState state;
+    // Nothing is known at first, not even the defaults.
+    EXPECT_TRUE(state.change(RenderState::Binding::PROGRAM, 0));
+    EXPECT_TRUE(state.change(RenderState::Binding::PROGRAM, 3));
+    EXPECT_FALSE(state.change(RenderState::Binding::PROGRAM, 3));
+    // Bindings are tracked apart.
+    EXPECT_TRUE(state.change(RenderState::Binding::VERTEX_ARRAY, 3));
+    EXPECT_TRUE(state.change_texture(0, 5));
+    EXPECT_TRUE(state.change_texture(1, 5));
+    EXPECT_FALSE(state.change_texture(0, 5));
+
+    state.end_frame();
+    EXPECT_EQ(state.issued(), 5);
+    EXPECT_EQ(state.skipped(), 2);
+    EXPECT_FALSE(state.change(RenderState::Binding::VERTEX_ARRAY, 3));
+    state.end_frame();
+    EXPECT_EQ(state.issued(), 0);
+    EXPECT_EQ(state.skipped(), 1);
+}
+
+TEST(RenderStateTest, ForgetsDeletedAndForeignBindings) {
+    RenderState state;
+    state.change_texture(0, 5);
+    state.change_texture(2, 5);
+    state.change_texture(1, 6);
+    state.deleted_texture(5);
+    EXPECT_FALSE(state.change_texture(0, 0));
+    EXPECT_FALSE(state.change_texture(2, 0));
+    EXPECT_FALSE(state.change_texture(1, 6));
+
+    state.change(RenderState::Binding::FRAMEBUFFER, 2);
+    state.invalidate();
+    EXPECT_TRUE(state.change(RenderState::Binding::FRAMEBUFFER, 2));
+    EXPECT_TRUE(state.change_texture(1, 6));
+}
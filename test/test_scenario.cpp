@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "integrator.h"
+#include "kepler.h"
+#include "scenario.h"
+#include "temporary_path.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace {
+std::string catalog_text(const std::size_t rows) {
+    std::string text = "designation,epoch,a,e,i,om,w,ma\n";
+    for (std::size_t k = 0; k < rows; k++) {
+        text += "\"A" + std::to_string(k) + "\",60000.5," + std::to_string(2.0 + 1e-6 * static_cast<double>(k)) +
+                ",0.1,5," + std::to_string(k % 360) + ",30,45\n";
+    }
+    return text;
+}
+}
+
+TEST(ScenarioTest, DefaultMatchesTheInnerSolarSystem) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    ASSERT_EQ(solar_system.bodies.size(), 5);
+    EXPECT_EQ(solar_system.bodies[1].name, "Mercury");
+    EXPECT_EQ(solar_system.bodies[1].max_path, 2000);
+    EXPECT_TRUE(solar_system.bodies[0].is_emitter);
+    EXPECT_FLOAT_EQ(solar_system.bodies[4].color.r, 0.757f);
+    EXPECT_DOUBLE_EQ(solar_system.state.vy[1], 0.027352689 * std::cos(glm::radians(7.004)));
+    EXPECT_DOUBLE_EQ(solar_system.state.vz[4], 0.0139056311 * std::sin(glm::radians(1.848)));
+    EXPECT_DOUBLE_EQ(solar_system.state.mass[3], 2e-6);
+
+    // Loading again replaces everything.
+    solar_system.tracers.add_belt(10, 2.96e-4, 2.0, 3.0);
+    solar_system.init();
+    EXPECT_EQ(solar_system.bodies.size(), 5);
+    EXPECT_EQ(solar_system.tracers.size(), 0);
+}
+
+TEST(ScenarioTest, SelectsPrecision) {
+    SolarSystemCalculator solar_system{};
+    Scenario::parse("precision float\nbody Sun mass=1\n", solar_system);
+    EXPECT_EQ(solar_system.precision(), Precision::FLOAT);
+    // Scenarios without a precision line keep the current one.
+    Scenario::parse("body Sun mass=1\n", solar_system);
+    EXPECT_EQ(solar_system.precision(), Precision::FLOAT);
+    try {
+        Scenario::parse("body Sun mass=1\nprecision half\n", solar_system);
+        FAIL();
+    } catch (const std::runtime_error &e) {
+        EXPECT_EQ(std::string(e.what()), "line 2: unknown precision 'half'");
+    }
+}
+
+TEST(ScenarioTest, KeepsIntegratorParameters) {
+    SolarSystemCalculator solar_system{};
+    solar_system.set_integrator(std::make_unique<HybridKepler>(0.3, 1e-5));
+    Scenario::parse("body Sun mass=1\nbody Earth mass=3e-6 position=1,0,0 velocity=0,0.017,0\n", solar_system);
+    const auto *hybrid = dynamic_cast<const HybridKepler *>(&solar_system.current_integrator());
+    ASSERT_NE(hybrid, nullptr);
+    EXPECT_EQ(hybrid->get_threshold(), 0.3);
+    EXPECT_EQ(hybrid->get_perturber_mass(), 1e-5);
+}
+
+TEST(ScenarioTest, OrbitalElementsFollowKeplerOrbits) {
+    const double mu = 2.96e-4;
+    for (const double e : {0.0, 0.3, 0.97}) {
+        ElementCatalog elements;
+        elements.a = {2.5, 2.5};
+        elements.e = {e, e};
+        elements.i = {12.0, 12.0};
+        elements.node = {80.0, 80.0};
+        elements.peri = {73.0, 73.0};
+        const double days = 100.0;
+        const double motion = std::sqrt(mu / (2.5 * 2.5 * 2.5)) * 180.0 / 3.14159265358979323846;
+        elements.mean_anomaly = {-20.0, -20.0 + motion * days};
+
+        ThreadPool pool(1);
+        TracerStore states;
+        Scenario::to_state_vectors(elements, mu, states, pool);
+        glm::dvec3 r = states.position(0);
+        glm::dvec3 v = states.velocity(0);
+        ASSERT_TRUE(Kepler::drift(mu, r, v, days));
+        EXPECT_NEAR(glm::length(r - states.position(1)), 0.0, 1e-9) << e;
+        EXPECT_NEAR(glm::length(v - states.velocity(1)), 0.0, 1e-11) << e;
+    }
+}
+
+TEST(ScenarioTest, CatalogChunksKeepRowOrder) {
+    ThreadPool pool(4);
+    const auto catalog = Scenario::parse_catalog(catalog_text(100000), pool, true);
+    ASSERT_EQ(catalog.size(), 100000);
+    for (std::size_t k = 0; k < catalog.size(); k += 997) {
+        EXPECT_DOUBLE_EQ(catalog.a[k], std::stod(std::to_string(2.0 + 1e-6 * static_cast<double>(k))));
+        EXPECT_EQ(catalog.node[k], static_cast<double>(k % 360));
+        EXPECT_EQ(catalog.names[k], "A" + std::to_string(k));
+    }
+    EXPECT_EQ(catalog.peri.back(), 30.0);
+    EXPECT_EQ(catalog.mean_anomaly.back(), 45.0);
+}
+
+TEST(ScenarioTest, CatalogErrorsNameTheLine) {
+    ThreadPool pool(4);
+    auto text = catalog_text(100000);
+    const auto row = text.find("\"A77777\"");
+    text.replace(text.find(",0.1,", row), 5, ",0.x,");
+    try {
+        Scenario::parse_catalog(text, pool);
+        FAIL();
+    } catch (const std::runtime_error &e) {
+        EXPECT_EQ(std::string(e.what()), "line 77779: cannot read '0.x'");
+    }
+    EXPECT_THROW(Scenario::parse_catalog("a,e,i,om,w\n2,0.1,1,2,3\n", pool), std::runtime_error);
+    EXPECT_THROW(Scenario::parse_catalog("a,e,i,om,w,ma\n2,1.5,1,2,3,4\n", pool), std::runtime_error);
+}
+
+TEST(ScenarioTest, LoadsFilesWithCatalogs) {
+    const std::filesystem::path directory = temporary_path("mag3d_scenario");
+    std::filesystem::create_directories(directory);
+    std::ofstream(directory / "belt.csv") << catalog_text(1000);
+    std::ofstream(directory / "big.csv") << "name,a,e,i,node,peri,M\nCeres,2.77,0.079,10.6,80.3,73.6,291\n";
+    std::ofstream(directory / "system.scn") << "# test system\n"
+                                               "body Sun mass=1 emitter\n"
+                                               "body Earth mass=3e-6 a=1 e=0 i=0 node=0 peri=0 M=90\n"
+                                               "  color=0,0,1\n"
+                                               "catalog belt.csv\n"
+                                               "catalog big.csv mass=4.7e-10 max_path=100\n";
+
+    SolarSystemCalculator solar_system{};
+    Scenario::load((directory / "system.scn").string(), solar_system);
+    ASSERT_EQ(solar_system.bodies.size(), 3);
+    EXPECT_EQ(solar_system.tracers.size(), 1000);
+    EXPECT_EQ(solar_system.bodies[1].name, "Earth");
+    EXPECT_FLOAT_EQ(solar_system.bodies[1].color.b, 1.0f);
+    EXPECT_NEAR(solar_system.state.y[1], 1.0, 1e-12);
+    EXPECT_NEAR(solar_system.state.vx[1], -std::sqrt(2.96e-4 * (1.0 + 3e-6)), 1e-12);
+    EXPECT_EQ(solar_system.bodies[2].name, "Ceres");
+    EXPECT_EQ(solar_system.bodies[2].max_path, 100);
+    EXPECT_DOUBLE_EQ(solar_system.state.mass[2], 4.7e-10);
+    EXPECT_NEAR(glm::length(solar_system.tracers.position(0)), 2.0 * (1.0 - 0.1 * std::cos(0.0)), 0.25);
+
+    std::ofstream(directory / "broken.scn") << "body Sun mass=1\n\nbody Earth mass=1e-6 colour=1,1,1\n";
+    try {
+        Scenario::load((directory / "broken.scn").string(), solar_system);
+        FAIL();
+    } catch (const std::runtime_error &e) {
+        EXPECT_NE(std::string(e.what()).find("line 3: unknown key 'colour'"), std::string::npos) << e.what();
+    }
+    std::filesystem::remove_all(directory);
+}
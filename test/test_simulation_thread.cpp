@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "simulation_thread.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+
+namespace {
+template <typename Predicate>
+bool wait_for(SimulationThread &simulation, Predicate predicate) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (predicate(simulation.snapshot())) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+}
+
+TEST(SpscQueueTest, DeliversEverythingInOrder) {
+    SpscQueue<int, 16> queue;
+    constexpr int count = 100000;
+    std::thread producer([&] {
+        for (int i = 0; i < count; i++) {
+            while (!queue.push(i)) std::this_thread::yield();
+        }
+    });
+    for (int expected = 0; expected < count;) {
+        if (const auto value = queue.pop()) {
+            ASSERT_EQ(*value, expected);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(TripleBufferTest, ReaderSeesCompleteValuesInOrder) {
+    TripleBuffer<std::vector<int>> buffer;
+    constexpr int count = 20000;
+    std::thread producer([&] {
+        for (int i = 1; i <= count; i++) {
+            buffer.write_buffer().assign(64, i);
+            buffer.publish();
+        }
+    });
+    int last = 0;
+    while (last < count) {
+        if (!buffer.update()) {
+            std::this_thread::yield();
+            continue;
+        }
+        const auto &value = buffer.read_buffer();
+        ASSERT_EQ(value.size(), 64);
+        for (const auto element: value) ASSERT_EQ(element, value.front());
+        ASSERT_GT(value.front(), last);
+        last = value.front();
+    }
+    producer.join();
+    EXPECT_FALSE(buffer.update());
+}
+
+TEST(SimulationThreadTest, StepsAndAppliesCommands) {
+    SolarSystemCalculator calculator{};
+    calculator.init();
+    SimulationThread simulation(calculator, 1000.0);
+    EXPECT_EQ(simulation.snapshot().positions.size(), 5);
+    EXPECT_EQ(simulation.snapshot().steps, 0);
+
+    simulation.start();
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return snapshot.steps >= 10; }));
+
+    simulation.send({.type = SimulationCommandType::SET_MASS, .index = 3, .value = 1e-3});
+    simulation.send({.type = SimulationCommandType::SET_INTEGRATOR,
+                     .value = static_cast<int>(IntegratorKind::YOSHIDA4)});
+    simulation.send({.type = SimulationCommandType::SET_PRECISION, .value = static_cast<int>(Precision::MIXED)});
+    simulation.send({.type = SimulationCommandType::SET_PAUSED, .value = 1.0});
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return snapshot.paused; }));
+    const auto &snapshot = simulation.snapshot();
+    EXPECT_DOUBLE_EQ(snapshot.masses[3], 1e-3);
+    EXPECT_EQ(snapshot.integrator, IntegratorKind::YOSHIDA4);
+    EXPECT_EQ(snapshot.precision, Precision::MIXED);
+    EXPECT_GT(snapshot.elapsed_simulation_time, 0.0);
+
+    const auto paused_steps = snapshot.steps;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(simulation.snapshot().steps, paused_steps);
+    simulation.stop();
+}
+
+TEST(SimulationThreadTest, RecordsTrajectory) {
+    SolarSystemCalculator calculator{};
+    calculator.init();
+    calculator.simulation_time_factor = 1e8;
+    const auto path = (std::filesystem::temp_directory_path() / "mag3d_thread.traj").string();
+    SimulationThread simulation(calculator, 1000.0, "mag3d_unused.ckpt", path);
+    simulation.send({.type = SimulationCommandType::SET_RECORDING, .value = 1.0});
+    simulation.start();
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return snapshot.frames_recorded >= 5; }));
+    simulation.send({.type = SimulationCommandType::SET_RECORDING, .value = 0.0});
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return !snapshot.recording; }));
+    simulation.stop();
+    EXPECT_FALSE(simulation.snapshot().recording_failed);
+
+    TrajectoryReader reader(path);
+    TrajectoryFrames frames;
+    ASSERT_TRUE(reader.next(frames));
+    EXPECT_GE(frames.frame_count, 5);
+    EXPECT_EQ(frames.body_count, 5);
+    EXPECT_EQ(frames.times[0], 0.0);
+    std::filesystem::remove(path);
+}
+
+TEST(SimulationThreadTest, PublishesBodiesAfterMerge) {
+    SolarSystemCalculator calculator{};
+    calculator.add_body({.position = {0.0, 0.0, 0.0}, .velocity = {0.0, 0.0, 0.0}, .mass = 1.0}, {.name = "Sun"});
+    calculator.add_body({.position = {1.0, -0.01, 0.0}, .velocity = {0.0, 0.02, 0.0}, .mass = 1e-6},
+                        {.name = "A", .radius = 1e-4});
+    calculator.add_body({.position = {1.0, 0.01, 0.0}, .velocity = {0.0, -0.02, 0.0}, .mass = 2e-6},
+                        {.name = "B", .radius = 1e-4});
+    calculator.simulation_time_factor = 1e6;
+    const auto path = (std::filesystem::temp_directory_path() / "mag3d_merge.traj").string();
+    SimulationThread simulation(calculator, 1000.0, "mag3d_unused.ckpt", path);
+    simulation.send({.type = SimulationCommandType::SET_RECORDING, .value = 1.0});
+    simulation.send({.type = SimulationCommandType::SET_COLLISIONS,
+                     .value = 1.0 + static_cast<double>(CollisionResponse::MERGE)});
+    simulation.start();
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return snapshot.collisions == 1; }));
+    const auto &snapshot = simulation.snapshot();
+    EXPECT_TRUE(snapshot.collisions_enabled);
+    ASSERT_EQ(snapshot.positions.size(), 2);
+    ASSERT_EQ(simulation.bodies().size(), 2);
+    EXPECT_EQ(simulation.bodies()[1].name, "B");
+    EXPECT_FALSE(snapshot.recording);
+    EXPECT_FALSE(snapshot.recording_failed);
+    simulation.stop();
+    std::filesystem::remove(path);
+}
+
+TEST(SimulationThreadTest, AddsTracersAboutTheMostMassiveBody) {
+    SolarSystemCalculator empty{};
+    SimulationThread nothing(empty, 1000.0);
+    nothing.send({.type = SimulationCommandType::SET_PAUSED, .value = 1.0});
+    nothing.send({.type = SimulationCommandType::ADD_TRACERS, .value = 100.0});
+    nothing.start();
+    EXPECT_TRUE(wait_for(nothing, [](const SimulationSnapshot &snapshot) { return snapshot.paused; }));
+    nothing.stop();
+    EXPECT_EQ(empty.tracers.size(), 0);
+
+    SolarSystemCalculator calculator{};
+    calculator.add_body({.position = {10.0, 0.0, 0.0}, .velocity = {0.0, 0.0, 0.0}, .mass = 1e-3}, {.name = "Planet"});
+    calculator.add_body({.position = {0.0, 0.0, 0.0}, .velocity = {0.0, 0.0, 0.0}, .mass = 1.0}, {.name = "Sun"});
+    SimulationThread simulation(calculator, 1000.0);
+    simulation.send({.type = SimulationCommandType::SET_PAUSED, .value = 1.0});
+    simulation.send({.type = SimulationCommandType::ADD_TRACERS, .value = 100.0});
+    simulation.start();
+    EXPECT_TRUE(wait_for(simulation, [](const SimulationSnapshot &snapshot) { return snapshot.tracer_count == 100; }));
+    simulation.stop();
+    const double mu = calculator.gravitational_constant();
+    for (std::size_t i = 0; i < calculator.tracers.size(); i++) {
+        const double radius = glm::length(calculator.tracers.position(i));
+        EXPECT_NEAR(glm::length(calculator.tracers.velocity(i)), std::sqrt(mu / radius), 1e-12);
+    }
+}
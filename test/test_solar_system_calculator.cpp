@@ -17,9 +17,40 @@ TEST(SolarSystemTest, ForcesAreCorrect) {
         for (int i = 0; i < 100; i++) {
             solar_system.update_bodies_verlet(0.1);
         }
-        EXPECT_FLOAT_EQ(solar_system.bodies[3].position.x, 0.98523641);
-        EXPECT_FLOAT_EQ(solar_system.bodies[3].position.y, 0.17114672);
-        EXPECT_NEAR(solar_system.bodies[3].position.z, 0.0, 1e-8);
+        EXPECT_FLOAT_EQ(solar_system.state.x[3], 0.98523611);
+        EXPECT_FLOAT_EQ(solar_system.state.y[3], 0.17114672);
+        EXPECT_NEAR(solar_system.state.z[3], 0.0, 1e-8);
 }
 
+TEST(SolarSystemTest, BlockTimestepsBeatUniformSteps) {
+        SolarSystemCalculator reference{};
+        reference.init();
+        reference.add_belt(100, reference.gravitational_constant(), 2.0, 3.5, 1e-10);
+        for (int i = 0; i < 7680; i++) {
+            reference.update_bodies_verlet(0.05);
+        }
+        SolarSystemCalculator uniform{};
+        uniform.init();
+        uniform.add_belt(100, uniform.gravitational_constant(), 2.0, 3.5, 1e-10);
+        for (int i = 0; i < 1536; i++) {
+            uniform.update_bodies_verlet(0.25);
+        }
+        SolarSystemCalculator block{};
+        block.init();
+        block.add_belt(100, block.gravitational_constant(), 2.0, 3.5, 1e-10);
+        block.set_integrator(IntegratorKind::BLOCK);
+        for (int i = 0; i < 48; i++) {
+            block.step(8.0);
+        }
 
+        double uniform_error = 0.0;
+        double block_error = 0.0;
+        for (std::size_t i = 1; i < reference.state.size(); i++) {
+            uniform_error = std::max(uniform_error,
+                                     glm::length(uniform.state.position(i) - reference.state.position(i)));
+            block_error = std::max(block_error,
+                                   glm::length(block.state.position(i) - reference.state.position(i)));
+        }
+        EXPECT_LT(block_error, 1.1 * uniform_error);
+        EXPECT_LT(block.force_evaluations() * 10, uniform.force_evaluations());
+}
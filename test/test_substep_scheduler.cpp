@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "solar_system_calculator.h"
+#include "substep_scheduler.h"
+
+#include <chrono>
+
+TEST(SubstepSchedulerTest, SplitsIntervalIntoEqualSubsteps) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    SubstepScheduler scheduler;
+    scheduler.max_substep = 0.25;
+    const auto report = scheduler.advance(solar_system, 10.1, std::chrono::seconds(10));
+    EXPECT_EQ(report.substeps, 41);
+    EXPECT_FALSE(report.behind);
+    EXPECT_NEAR(report.simulated_time, 10.1, 1e-12);
+    EXPECT_NEAR(solar_system.elapsed_simulation_time, 10.1, 1e-12);
+}
+
+TEST(SubstepSchedulerTest, HighTimeWarpMatchesSmallSteps) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    for (int i = 0; i < 400; i++) {
+        reference.step(0.25);
+    }
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    SubstepScheduler scheduler;
+    scheduler.max_substep = 0.25;
+    for (int i = 0; i < 4; i++) {
+        scheduler.advance(solar_system, 25.0, std::chrono::seconds(10));
+    }
+    EXPECT_NEAR(solar_system.state.x[3], reference.state.x[3], 1e-12);
+    EXPECT_NEAR(solar_system.state.y[3], reference.state.y[3], 1e-12);
+}
+
+TEST(SubstepSchedulerTest, DropDiscardsTimeOverBudget) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    SubstepScheduler scheduler;
+    scheduler.policy = CatchUpPolicy::DROP;
+    const auto report = scheduler.advance(solar_system, 10.0, std::chrono::seconds(0));
+    EXPECT_EQ(report.substeps, 1);
+    EXPECT_TRUE(report.behind);
+    EXPECT_NEAR(report.dropped_time, 9.75, 1e-12);
+    EXPECT_EQ(scheduler.lag(), 0.0);
+}
+
+TEST(SubstepSchedulerTest, ExtendCarriesLagOver) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    SubstepScheduler scheduler;
+    scheduler.policy = CatchUpPolicy::EXTEND;
+    scheduler.max_lag = 5.0;
+    auto report = scheduler.advance(solar_system, 10.0, std::chrono::seconds(0));
+    EXPECT_TRUE(report.behind);
+    EXPECT_NEAR(report.lag, 5.0, 1e-12);
+    EXPECT_NEAR(report.dropped_time, 4.75, 1e-12);
+
+    report = scheduler.advance(solar_system, 1.0, std::chrono::seconds(10));
+    EXPECT_FALSE(report.behind);
+    EXPECT_NEAR(report.simulated_time, 6.0, 1e-12);
+    EXPECT_EQ(scheduler.lag(), 0.0);
+}
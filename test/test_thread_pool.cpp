@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "solar_system_calculator.h"
+#include "thread_pool.h"
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool{4};
+    std::vector<int> visits(10007, 0);
+    for (int round = 0; round < 20; round++) {
+        pool.parallel_for(0, visits.size(), 13, [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) visits[i]++;
+        });
+    }
+    for (const auto count: visits) {
+        ASSERT_EQ(count, 20);
+    }
+}
+
+// Many short jobs on more threads than cores: workers still stealing from
+// the last job must not clobber the ranges of the next one.
+TEST(ThreadPoolTest, BackToBackJobsAllFinish) {
+    ThreadPool pool{32};
+    std::vector<int> visits(256, 0);
+    constexpr int rounds = 20000;
+    for (int round = 0; round < rounds; round++) {
+        pool.parallel_for(0, visits.size(), 4, [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) visits[i]++;
+        });
+    }
+    for (const auto count: visits) {
+        ASSERT_EQ(count, rounds);
+    }
+}
+
+TEST(ThreadPoolTest, ResultsDoNotDependOnThreadCount) {
+    for (const auto engine: {ForceEngine::DIRECT, ForceEngine::BARNES_HUT}) {
+        std::vector<SolarSystemCalculator> runs(3);
+        const std::size_t thread_counts[] = {1, 3, 8};
+        for (std::size_t r = 0; r < runs.size(); ++r) {
+            auto &solar_system = runs[r];
+            solar_system.init();
+            solar_system.add_belt(700, solar_system.gravitational_constant(), 2.0, 2.7, 1e-9);
+            solar_system.force_engine = engine;
+            solar_system.set_max_threads(thread_counts[r]);
+            for (int step = 0; step < 10; step++) {
+                solar_system.update_bodies_verlet(0.5);
+            }
+        }
+        for (std::size_t r = 1; r < runs.size(); ++r) {
+            ASSERT_EQ(runs[r].state.x, runs[0].state.x);
+            ASSERT_EQ(runs[r].state.vy, runs[0].state.vy);
+        }
+    }
+}
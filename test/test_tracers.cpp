@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "gravity_kernel.h"
+#include "solar_system_calculator.h"
+
+#include <cmath>
+
+TEST(TracerTest, SimdKernelMatchesScalar) {
+    if (GravityKernel::detect_isa() != KernelIsa::AVX2) GTEST_SKIP();
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    TracerStore reference;
+    reference.add_belt(1003, 2.96e-4, 0.3, 3.0);
+    TracerStore tracers = reference;
+
+    const auto sources = GravityKernel::sources_of(solar_system.state);
+    const auto reference_view = GravityKernel::tracers_of(reference);
+    const auto view = GravityKernel::tracers_of(tracers);
+    GravityKernel::get_tracer(KernelIsa::SCALAR)(sources, sources, reference_view, 0, reference_view.count, 2.96e-4,
+                                                 1.0);
+    GravityKernel::get_tracer(KernelIsa::AVX2)(sources, sources, view, 0, view.count, 2.96e-4, 1.0);
+    for (std::size_t i = 0; i < tracers.size(); ++i) {
+        EXPECT_NEAR(tracers.x[i], reference.x[i], 1e-14);
+        EXPECT_NEAR(tracers.vy[i], reference.vy[i], 1e-16);
+    }
+}
+
+TEST(TracerTest, ReducedPrecisionKernelsStayClose) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    TracerStore reference;
+    reference.add_belt(1003, 2.96e-4, 0.3, 3.0);
+    const TracerStore start = reference;
+    const auto sources = GravityKernel::sources_of(solar_system.state);
+    const auto reference_view = GravityKernel::tracers_of(reference);
+    GravityKernel::get_tracer(KernelIsa::SCALAR)(sources, sources, reference_view, 0, reference_view.count, 2.96e-4,
+                                                 1.0);
+
+    for (const auto isa: {KernelIsa::SCALAR, GravityKernel::detect_isa()}) {
+        for (const auto precision: {Precision::MIXED, Precision::FLOAT}) {
+            TracerStore tracers = start;
+            const auto view = GravityKernel::tracers_of(tracers);
+            GravityKernel::get_tracer(isa, precision)(sources, sources, view, 0, view.count, 2.96e-4, 1.0);
+            for (std::size_t i = 0; i < tracers.size(); ++i) {
+                const glm::dvec3 kick = reference.velocity(i) - start.velocity(i);
+                EXPECT_LT(glm::length(tracers.velocity(i) - reference.velocity(i)), 1e-6 * glm::length(kick));
+                EXPECT_LT(glm::length(tracers.position(i) - reference.position(i)), 1e-6 * glm::length(kick));
+            }
+        }
+    }
+}
+
+TEST(TracerTest, TracersDoNotDisturbMassiveBodies) {
+    SolarSystemCalculator reference{};
+    reference.init();
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.tracers.add_belt(10000, 2.96e-4, 2.0, 3.5);
+    for (int i = 0; i < 100; i++) {
+        reference.step(1.0);
+        solar_system.step(1.0);
+    }
+    for (std::size_t i = 0; i < reference.state.size(); ++i) {
+        EXPECT_EQ(solar_system.state.x[i], reference.state.x[i]);
+        EXPECT_EQ(solar_system.state.vy[i], reference.state.vy[i]);
+    }
+}
+
+TEST(TracerTest, TracerOppositeEarthMirrorsEarth) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    solar_system.tracers.add(-solar_system.state.position(3), -solar_system.state.velocity(3));
+    for (int i = 0; i < 1460; i++) {
+        solar_system.step(0.25);
+    }
+    const auto sun = solar_system.state.position(0);
+    EXPECT_NEAR(glm::length(solar_system.tracers.position(0) - sun), 1.0, 1e-3);
+    EXPECT_LT(glm::length(solar_system.tracers.position(0) + solar_system.state.position(3) - 2.0 * sun), 1e-2);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "trail_ring.h"
+
+#include <vector>
+
+namespace {
+// The points the draw ranges cover, in drawing order.
+std::vector<float> drawn_x(const TrailRing &ring) {
+    std::vector<std::int32_t> firsts, counts;
+    ring.draw_ranges(firsts, counts);
+    std::vector<float> xs;
+    for (std::size_t r = 0; r < firsts.size(); r++) {
+        for (std::int32_t i = 0; i < counts[r]; i++) {
+            xs.push_back(ring.vertices()[firsts[r] + i].position.x);
+        }
+    }
+    return xs;
+}
+
+void append_x(TrailRing &ring, const std::size_t trail, const float x) {
+    ring.append(trail, {x, 0.0f, 0.0f}, static_cast<std::uint32_t>(x), glm::vec3(1.0f, 0.5f, 0.0f));
+}
+}
+
+TEST(TrailRingTest, DrawsOldestToNewestAcrossTheWrap) {
+    TrailRing ring;
+    ring.reset({4});
+    EXPECT_EQ(ring.vertices().size(), 5);
+    append_x(ring, 0, 0.0f);
+    EXPECT_TRUE(drawn_x(ring).empty());
+    append_x(ring, 0, 1.0f);
+    append_x(ring, 0, 2.0f);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{0, 1, 2}));
+    append_x(ring, 0, 3.0f);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{0, 1, 2, 3}));
+    // Slot 0 is overwritten; its copy at the end joins both strips.
+    append_x(ring, 0, 4.0f);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{1, 2, 3, 4}));
+    // Both strips hold slot 0, a segment of length zero.
+    append_x(ring, 0, 5.0f);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{2, 3, 4, 4, 5}));
+    append_x(ring, 0, 6.0f);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{3, 4, 4, 5, 6}));
+    EXPECT_EQ(ring.size(0), 4);
+
+    ring.clear(0);
+    EXPECT_TRUE(drawn_x(ring).empty());
+}
+
+TEST(TrailRingTest, KeepsTrailsApart) {
+    TrailRing ring;
+    ring.reset({3, 0, 2});
+    for (int i = 0; i < 5; i++) {
+        for (std::size_t trail = 0; trail < 3; trail++) {
+            append_x(ring, trail, static_cast<float>(10 * trail + i));
+        }
+    }
+    EXPECT_EQ(ring.size(1), 0);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{2, 3, 3, 4, 23, 24}));
+    // Slot 1 of the last trail.
+    const TrailVertex &vertex = ring.vertices()[5 + 1];
+    EXPECT_EQ(vertex.sample, 23);
+    EXPECT_EQ(vertex.span, 2.0f);
+    EXPECT_EQ(vertex.color, 0xFF0080FFu);
+}
+
+TEST(TrailRingTest, ReportsOnlyWrittenVertices) {
+    TrailRing ring;
+    ring.reset({100, 100, 100});
+    EXPECT_TRUE(ring.resized());
+    ASSERT_EQ(ring.dirty().size(), 1);
+    EXPECT_EQ(ring.dirty()[0].count, 303);
+    ring.clear_dirty();
+    EXPECT_TRUE(ring.dirty().empty());
+
+    append_x(ring, 2, 1.0f);
+    append_x(ring, 0, 1.0f);
+    append_x(ring, 0, 2.0f);
+    // Slot 0 of a trail also writes its copy at the end.
+    auto dirty = ring.dirty(0);
+    ASSERT_EQ(dirty.size(), 4);
+    EXPECT_EQ(dirty[0].first, 0);
+    EXPECT_EQ(dirty[0].count, 2);
+    EXPECT_EQ(dirty[1].first, 100);
+    EXPECT_EQ(dirty[2].first, 202);
+    EXPECT_EQ(dirty[3].first, 302);
+    dirty = ring.dirty(100);
+    ASSERT_EQ(dirty.size(), 2);
+    EXPECT_EQ(dirty[0].count, 101);
+    EXPECT_EQ(dirty[1].first, 202);
+    EXPECT_EQ(dirty[1].count, 101);
+}
+
+TEST(TrailRingTest, FollowsASimplifiedTrail) {
+    TrailRing ring;
+    ring.reset({3});
+    append_x(ring, 0, 0.0f);
+    append_x(ring, 0, 1.0f);
+    append_x(ring, 0, 2.0f);
+    ring.clear_dirty();
+    // The newest point sits in slot 2, then in slot 0 and its copy.
+    ring.replace_last(0, {2.5f, 0.0f, 0.0f}, 2, glm::vec3(1.0f));
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{0, 1, 2.5f}));
+    append_x(ring, 0, 3.0f);
+    ring.replace_last(0, {3.5f, 0.0f, 0.0f}, 3, glm::vec3(1.0f));
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{1, 2.5f, 3.5f}));
+    EXPECT_EQ(ring.dirty(0).size(), 2);
+
+    ring.drop_oldest(0, 1);
+    EXPECT_EQ(drawn_x(ring), (std::vector<float>{2.5f, 3.5f}));
+    ring.drop_oldest(0, 5);
+    EXPECT_EQ(ring.size(0), 0);
+    ring.replace_last(0, {9.0f, 0.0f, 0.0f}, 9, glm::vec3(1.0f));
+    EXPECT_TRUE(drawn_x(ring).empty());
+}
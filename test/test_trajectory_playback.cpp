@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "solar_system_calculator.h"
+#include "temporary_path.h"
+#include "trajectory_playback.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+// Records one frame per day with 0.25 day steps and keeps every
+// intermediate state for comparison.
+std::vector<BodyStore> record_run(const std::string &path, const bool velocities, const int days) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    std::vector<BodyStore> states;
+    TrajectoryRecorder recorder(path, solar_system.state.size(),
+                                {.frames_per_chunk = 16, .velocities = velocities, .drop_when_behind = false});
+    for (int i = 0; i <= 4 * days; i++) {
+        recorder.record(solar_system.elapsed_simulation_time, solar_system.state);
+        states.push_back(solar_system.state);
+        solar_system.step(0.25);
+    }
+    recorder.finish();
+    return states;
+}
+}
+
+TEST(TrajectoryPlaybackTest, SeeksAndInterpolates) {
+    const auto path = temporary_path("mag3d_playback.traj");
+    const auto states = record_run(path, true, 200);
+    TrajectoryPlayback playback(path, 0);
+    EXPECT_EQ(playback.frame_count(), 201);
+    EXPECT_EQ(playback.start_time(), 0.0);
+    EXPECT_EQ(playback.end_time(), 200.0);
+
+    std::vector<glm::dvec3> positions;
+    // On a frame, on a chunk boundary (frame 16), between frames, in any order.
+    for (const double time : {50.0, 16.0, 123.25, 3.5, 15.75, 199.75}) {
+        playback.positions_at(time, positions);
+        const auto &state = states[static_cast<std::size_t>(time * 4.0)];
+        for (std::size_t i = 0; i < state.size(); i++) {
+            EXPECT_NEAR(glm::length(positions[i] - state.position(i)), 0.0, 1e-6) << time << " " << i;
+        }
+    }
+
+    playback.positions_at(-10.0, positions);
+    EXPECT_NEAR(positions[3].x, states.front().x[3], 1e-8);
+    playback.positions_at(1e6, positions);
+    EXPECT_NEAR(positions[3].x, states.back().x[3], 1e-8);
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryPlaybackTest, LinearWithoutVelocities) {
+    const auto path = temporary_path("mag3d_playback_linear.traj");
+    const auto states = record_run(path, false, 40);
+    TrajectoryPlayback playback(path);
+    std::vector<glm::dvec3> positions;
+    playback.positions_at(20.5, positions);
+    const glm::dvec3 expected = 0.5 * (states[80].position(1) + states[84].position(1));
+    EXPECT_NEAR(glm::length(positions[1] - expected), 0.0, 1e-7);
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryPlaybackTest, PathsEndAtTheCurrentFrame) {
+    const auto path = temporary_path("mag3d_playback_paths.traj");
+    const auto states = record_run(path, false, 100);
+    TrajectoryPlayback playback(path, 0);
+    std::vector<std::vector<glm::dvec3>> paths;
+    playback.paths_at(60.5, {5, 40, 0, 1000, 1}, paths);
+    ASSERT_EQ(paths.size(), 5);
+    EXPECT_EQ(paths[0].size(), 5);
+    EXPECT_EQ(paths[1].size(), 40);
+    EXPECT_EQ(paths[2].size(), 0);
+    EXPECT_EQ(paths[3].size(), 61);
+    EXPECT_EQ(paths[4].size(), 1);
+    EXPECT_NEAR(glm::length(paths[1].back() - states[240].position(1)), 0.0, 1e-7);
+    EXPECT_NEAR(glm::length(paths[1].front() - states[4 * 21].position(1)), 0.0, 1e-7);
+    EXPECT_NEAR(glm::length(paths[3].front() - states[0].position(3)), 0.0, 1e-7);
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryPlaybackTest, DamagedChunkStaysDamaged) {
+    const auto path = temporary_path("mag3d_playback_damaged.traj");
+    record_run(path, true, 100);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        TrajectoryFormat::ChunkHeader first{};
+        file.seekg(sizeof(TrajectoryFormat::FileHeader));
+        file.read(reinterpret_cast<char *>(&first), sizeof(first));
+        // The middle of the second chunk's compressed data.
+        TrajectoryFormat::ChunkHeader second{};
+        file.seekg(static_cast<std::streamoff>(sizeof(TrajectoryFormat::FileHeader) + sizeof(first) +
+                                               first.compressed_size));
+        file.read(reinterpret_cast<char *>(&second), sizeof(second));
+        file.seekp(file.tellg() + static_cast<std::streamoff>(second.compressed_size / 2));
+        const std::string garbage(16, '\xA5');
+        file.write(garbage.data(), static_cast<std::streamsize>(garbage.size()));
+    }
+    TrajectoryPlayback playback(path);
+    std::vector<glm::dvec3> positions;
+    EXPECT_NO_THROW(playback.positions_at(5.0, positions));
+    EXPECT_THROW(playback.positions_at(20.0, positions), std::runtime_error);
+    EXPECT_THROW(playback.positions_at(20.0, positions), std::runtime_error);
+    EXPECT_NO_THROW(playback.positions_at(5.0, positions));
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryPlaybackTest, IgnoresUnfinishedLastChunk) {
+    const auto path = temporary_path("mag3d_playback_truncated.traj");
+    record_run(path, false, 100);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 10);
+    TrajectoryPlayback playback(path);
+    EXPECT_EQ(playback.frame_count(), 96);
+    EXPECT_EQ(playback.end_time(), 95.0);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "solar_system_calculator.h"
+#include "temporary_path.h"
+#include "trajectory_recorder.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+struct Recorded {
+    std::vector<double> times;
+    std::vector<BodyStore> states;
+};
+
+Recorded record_run(const std::string &path, const TrajectorySettings &settings, const int steps) {
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    Recorded recorded;
+    TrajectoryRecorder recorder(path, solar_system.state.size(), settings);
+    for (int i = 0; i <= steps; i++) {
+        if (recorder.record(solar_system.elapsed_simulation_time, solar_system.state)) {
+            recorded.times.push_back(solar_system.elapsed_simulation_time);
+            recorded.states.push_back(solar_system.state);
+        }
+        solar_system.step(0.25);
+    }
+    recorder.finish();
+    EXPECT_EQ(recorder.frames_dropped(), 0);
+    EXPECT_EQ(recorder.frames_recorded(), recorded.times.size());
+    EXPECT_EQ(recorder.bytes_written(), std::filesystem::file_size(path));
+    return recorded;
+}
+}
+
+TEST(TrajectoryRecorderTest, RoundTripWithinQuantum) {
+    const auto path = temporary_path("mag3d_round_trip.traj");
+    const TrajectorySettings settings{
+        .interval = 1.0, .frames_per_chunk = 64, .velocities = true, .drop_when_behind = false};
+    const auto recorded = record_run(path, settings, 4 * 1000);
+    ASSERT_EQ(recorded.times.size(), 1001);
+
+    TrajectoryReader reader(path);
+    EXPECT_EQ(reader.header().body_count, 5);
+    TrajectoryFrames frames;
+    std::size_t frame = 0;
+    while (reader.next(frames)) {
+        ASSERT_LE(frames.frame_count, 64);
+        for (std::size_t f = 0; f < frames.frame_count; f++, frame++) {
+            ASSERT_LT(frame, recorded.times.size());
+            EXPECT_EQ(frames.times[f], recorded.times[frame]);
+            const auto &state = recorded.states[frame];
+            for (std::size_t i = 0; i < state.size(); i++) {
+                const std::size_t k = f * frames.body_count + i;
+                EXPECT_LE(std::abs(frames.x[k] - state.x[i]), 0.5 * settings.position_quantum);
+                EXPECT_LE(std::abs(frames.z[k] - state.z[i]), 0.5 * settings.position_quantum);
+                EXPECT_LE(std::abs(frames.vy[k] - state.vy[i]), 0.5 * settings.velocity_quantum);
+            }
+        }
+    }
+    EXPECT_EQ(frame, recorded.times.size());
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryRecorderTest, CompressesSmoothOrbits) {
+    const auto path = temporary_path("mag3d_compressed.traj");
+    SolarSystemCalculator solar_system{};
+    solar_system.init();
+    TrajectoryRecorder recorder(path, solar_system.state.size(), {.interval = 0.0, .drop_when_behind = false});
+    for (int i = 0; i < 10000; i++) {
+        recorder.record(solar_system.elapsed_simulation_time, solar_system.state);
+        solar_system.step(0.25);
+    }
+    recorder.finish();
+    EXPECT_GT(static_cast<double>(recorder.raw_bytes()) / static_cast<double>(recorder.bytes_written()), 8.0);
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryRecorderTest, RejectsSizesBeyondTheFile) {
+    const auto path = temporary_path("mag3d_damaged.traj");
+    record_run(path, {.interval = 1.0, .frames_per_chunk = 16, .drop_when_behind = false}, 4 * 20);
+    std::ifstream in(path, std::ios::binary);
+    const std::vector<char> original{std::istreambuf_iterator<char>(in), {}};
+    in.close();
+    TrajectoryFormat::FileHeader header{};
+    std::memcpy(&header, original.data(), sizeof(header));
+    TrajectoryFormat::ChunkHeader chunk{};
+    const std::size_t at = sizeof(TrajectoryFormat::FileHeader);
+    std::memcpy(&chunk, original.data() + at, sizeof(chunk));
+
+    const auto damage = [&](const TrajectoryFormat::ChunkHeader &damaged,
+                            const TrajectoryFormat::FileHeader &damaged_header) {
+        std::vector<char> bytes = original;
+        std::memcpy(bytes.data(), &damaged_header, sizeof(damaged_header));
+        std::memcpy(bytes.data() + at, &damaged, sizeof(damaged));
+        std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        TrajectoryReader reader(path);
+        TrajectoryFrames frames;
+        while (reader.next(frames)) {
+        }
+    };
+    auto huge_compressed = chunk;
+    huge_compressed.compressed_size = std::uint64_t{1} << 60;
+    EXPECT_THROW(damage(huge_compressed, header), std::runtime_error);
+    auto huge_raw = chunk;
+    huge_raw.raw_size = std::uint64_t{1} << 60;
+    EXPECT_THROW(damage(huge_raw, header), std::runtime_error);
+    // Body counts the chunk cannot hold, one of them wrapping the output
+    // size to zero.
+    for (const std::uint64_t bodies : {std::uint64_t{0}, std::uint64_t{1} << 20, std::uint64_t{1} << 60}) {
+        auto wrong_bodies = header;
+        wrong_bodies.body_count = bodies;
+        EXPECT_THROW(damage(chunk, wrong_bodies), std::runtime_error) << bodies;
+    }
+    EXPECT_NO_THROW(damage(chunk, header));
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryRecorderTest, RejectsOtherFiles) {
+    const auto path = temporary_path("mag3d_not_a_trajectory.traj");
+    std::ofstream(path) << "definitely not a trajectory, just some text";
+    EXPECT_THROW(TrajectoryReader{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}